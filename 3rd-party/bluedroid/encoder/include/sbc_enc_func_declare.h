@@ -40,7 +40,11 @@ extern const SINT32 gas32CoeffFor8SBs[];
 extern void sbc_enc_bit_alloc_mono(SBC_ENC_PARAMS *CodecParams);
 extern void sbc_enc_bit_alloc_ste(SBC_ENC_PARAMS *CodecParams);
 
-extern void SbcAnalysisInit (void);
+/* BK4BTSTACK_CHANGE START */
+extern void SbcAnalysisInit (SBC_ENC_PARAMS *strEncParams);
+/* select windowing implementation for encoders initialised afterwards, returns FALSE if not supported */
+extern SINT16 SbcAnalysisSetImplementation (SINT16 s16Implementation);
+/* BK4BTSTACK_CHANGE END */
 
 extern void SbcAnalysisFilter4(SBC_ENC_PARAMS *strEncParams);
 extern void SbcAnalysisFilter8(SBC_ENC_PARAMS *strEncParams);
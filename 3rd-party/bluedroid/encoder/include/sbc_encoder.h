@@ -126,6 +126,26 @@
 #define SBC_IS_64_MULT_IN_QUANTIZER  TRUE
 #endif /*SBC_IS_64_MULT_IN_IDCT */
 
+/* BK4BTSTACK_CHANGE START */
+/* Set SBC_SIMD_OPT to FALSE to always use the plain C windowing in the analysis filter */
+/* SSE2/AVX2 (x86, selected at runtime) and NEON kernels give the same result as SBC_IPAQ_OPT windowing */
+#ifndef SBC_SIMD_OPT
+#define SBC_SIMD_OPT TRUE
+#endif
+
+/* NEON kernels have not been verified on ARM yet: set SBC_NEON_OPT to TRUE to use them with SBC_SIMD_OPT */
+#ifndef SBC_NEON_OPT
+#define SBC_NEON_OPT FALSE
+#endif
+
+/* analysis filter windowing implementations, see SbcAnalysisSetImplementation */
+#define SBC_ANALYSIS_AUTO   (-1)
+#define SBC_ANALYSIS_SCALAR 0
+#define SBC_ANALYSIS_SSE2   1
+#define SBC_ANALYSIS_AVX2   2
+#define SBC_ANALYSIS_NEON   3
+/* BK4BTSTACK_CHANGE END */
+
 /* Debug only: set this flag to FALSE to disable fast DCT algorithm */
 #ifndef SBC_FAST_DCT
 #define SBC_FAST_DCT  TRUE
@@ -196,6 +216,11 @@ typedef struct SBC_ENC_PARAMS_TAG
     UINT16 u16PacketLength;
     /* BK4BTSTACK_CHANGE START */
     UINT8  mSBCEnabled;
+    /* analysis filter state per encoder instance, was static in sbc_analysis.c */
+    SINT32 s32X[ENC_VX_BUFFER_SIZE/2];      /* accessed as SINT16, must be 32 bits aligned cf SHIFTUP_X8_2 */
+    SINT16 ShiftCounter;
+    SINT16 EncMaxShiftCounter;
+    SINT16 AnalysisImpl;                    /* SBC_ANALYSIS_SCALAR, _SSE2, _AVX2 or _NEON */
     /* BK4BTSTACK_CHANGE END */
 }SBC_ENC_PARAMS;
 
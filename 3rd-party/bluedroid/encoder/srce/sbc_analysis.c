@@ -153,15 +153,9 @@
 #define WIND_8_SUBBANDS_8_2 (SINT16)0x12CF  /* 40 = 0x12CF6C75 */
 #endif
 
-#if (SBC_USE_ARM_PRAGMA==TRUE)
-#pragma arm section zidata = "sbc_s32_analysis_section"
-#endif
-static SINT32   s32DCTY[16]  = {0};
-static SINT32   s32X[ENC_VX_BUFFER_SIZE/2];
-static SINT16   *s16X=(SINT16*) s32X;      /* s16X must be 32 bits aligned cf  SHIFTUP_X8_2*/
-#if (SBC_USE_ARM_PRAGMA==TRUE)
-#pragma arm section zidata
-#endif
+/* BK4BTSTACK_CHANGE START */
+/* s32DCTY is local to the analysis filter, s32X and ShiftCounter are kept in SBC_ENC_PARAMS */
+/* BK4BTSTACK_CHANGE END */
 
 /* This macro is for 4 subbands */
 #define SHIFTUP_X4                                                               \
@@ -897,8 +891,225 @@ static SINT16   *s16X=(SINT16*) s32X;      /* s16X must be 32 bits aligned cf  S
 #endif
 #endif
 
-static SINT16 ShiftCounter=0;
-extern SINT16 EncMaxShiftCounter;
+/* BK4BTSTACK_CHANGE START */
+/* SIMD windowing: s32DCTY[i] = sum over rows j of coefficient[j][i] * s16X[ChOffset+i+j*subbands]  */
+/* with the same 16x16->32 bit products and 32 bit sums as the SBC_IPAQ_OPT WINDOW_PARTIAL macros */
+#if (SBC_SIMD_OPT == TRUE) && (SBC_ARM_ASM_OPT == FALSE) && (SBC_IPAQ_OPT == TRUE) && (SBC_IS_64_MULT_IN_WINDOW_ACCU == FALSE)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SBC_ANALYSIS_HAVE_X86
+#include <immintrin.h>
+#endif
+#if (SBC_NEON_OPT == TRUE) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define SBC_ANALYSIS_HAVE_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(SBC_ANALYSIS_HAVE_X86) || defined(SBC_ANALYSIS_HAVE_NEON)
+#define W4(i,j) WIND_4_SUBBANDS_##i##_##j
+#define W8(i,j) WIND_8_SUBBANDS_##i##_##j
+static const SINT16 sbc_window4_coeffs[5][8] = {
+    {          0, W4(1,0), W4(2,0), W4(3,0), W4(4,0), W4(3,4), W4(2,4), W4(1,4) },
+    {    W4(0,1), W4(1,1), W4(2,1), W4(3,1), W4(4,1), W4(3,3), W4(2,3), W4(1,3) },
+    {    W4(0,2), W4(1,2), W4(2,2), W4(3,2), W4(4,2), W4(3,2), W4(2,2), W4(1,2) },
+    { -W4(0,2), W4(1,3), W4(2,3), W4(3,3), W4(4,1), W4(3,1), W4(2,1), W4(1,1) },
+    { -W4(0,1), W4(1,4), W4(2,4), W4(3,4), W4(4,0), W4(3,0), W4(2,0), W4(1,0) },
+};
+static const SINT16 sbc_window8_coeffs[5][16] = {
+    {        0, W8(1,0), W8(2,0), W8(3,0), W8(4,0), W8(5,0), W8(6,0), W8(7,0),
+       W8(8,0), W8(7,4), W8(6,4), W8(5,4), W8(4,4), W8(3,4), W8(2,4), W8(1,4) },
+    {  W8(0,1), W8(1,1), W8(2,1), W8(3,1), W8(4,1), W8(5,1), W8(6,1), W8(7,1),
+       W8(8,1), W8(7,3), W8(6,3), W8(5,3), W8(4,3), W8(3,3), W8(2,3), W8(1,3) },
+    {  W8(0,2), W8(1,2), W8(2,2), W8(3,2), W8(4,2), W8(5,2), W8(6,2), W8(7,2),
+       W8(8,2), W8(7,2), W8(6,2), W8(5,2), W8(4,2), W8(3,2), W8(2,2), W8(1,2) },
+    { -W8(0,2), W8(1,3), W8(2,3), W8(3,3), W8(4,3), W8(5,3), W8(6,3), W8(7,3),
+       W8(8,1), W8(7,1), W8(6,1), W8(5,1), W8(4,1), W8(3,1), W8(2,1), W8(1,1) },
+    { -W8(0,1), W8(1,4), W8(2,4), W8(3,4), W8(4,4), W8(5,4), W8(6,4), W8(7,4),
+       W8(8,0), W8(7,0), W8(6,0), W8(5,0), W8(4,0), W8(3,0), W8(2,0), W8(1,0) },
+};
+#undef W4
+#undef W8
+#endif
+
+#ifdef SBC_ANALYSIS_HAVE_X86
+/* pmulhw/pmullw + interleave give the exact 32 bit products */
+__attribute__((target("sse2")))
+static void SbcWindow4Sse2(const SINT16 *ps16X, SINT32 *ps32Y)
+{
+    __m128i acc_lo = _mm_setzero_si128();
+    __m128i acc_hi = _mm_setzero_si128();
+    int j;
+    for (j=0;j<5;j++)
+    {
+        __m128i x  = _mm_loadu_si128((const __m128i *) &ps16X[j*8]);
+        __m128i c  = _mm_loadu_si128((const __m128i *) sbc_window4_coeffs[j]);
+        __m128i lo = _mm_mullo_epi16(x, c);
+        __m128i hi = _mm_mulhi_epi16(x, c);
+        acc_lo = _mm_add_epi32(acc_lo, _mm_unpacklo_epi16(lo, hi));
+        acc_hi = _mm_add_epi32(acc_hi, _mm_unpackhi_epi16(lo, hi));
+    }
+    _mm_storeu_si128((__m128i *) &ps32Y[0], acc_lo);
+    _mm_storeu_si128((__m128i *) &ps32Y[4], acc_hi);
+}
+
+__attribute__((target("sse2")))
+static void SbcWindow8Sse2(const SINT16 *ps16X, SINT32 *ps32Y)
+{
+    int i,j;
+    for (i=0;i<16;i+=8)
+    {
+        __m128i acc_lo = _mm_setzero_si128();
+        __m128i acc_hi = _mm_setzero_si128();
+        for (j=0;j<5;j++)
+        {
+            __m128i x  = _mm_loadu_si128((const __m128i *) &ps16X[j*16+i]);
+            __m128i c  = _mm_loadu_si128((const __m128i *) &sbc_window8_coeffs[j][i]);
+            __m128i lo = _mm_mullo_epi16(x, c);
+            __m128i hi = _mm_mulhi_epi16(x, c);
+            acc_lo = _mm_add_epi32(acc_lo, _mm_unpacklo_epi16(lo, hi));
+            acc_hi = _mm_add_epi32(acc_hi, _mm_unpackhi_epi16(lo, hi));
+        }
+        _mm_storeu_si128((__m128i *) &ps32Y[i],   acc_lo);
+        _mm_storeu_si128((__m128i *) &ps32Y[i+4], acc_hi);
+    }
+}
+
+/* one row of 16 samples per register, unpack works per 128 bit lane: fix order on store */
+__attribute__((target("avx2")))
+static void SbcWindow8Avx2(const SINT16 *ps16X, SINT32 *ps32Y)
+{
+    __m256i acc_lo = _mm256_setzero_si256();
+    __m256i acc_hi = _mm256_setzero_si256();
+    int j;
+    for (j=0;j<5;j++)
+    {
+        __m256i x  = _mm256_loadu_si256((const __m256i *) &ps16X[j*16]);
+        __m256i c  = _mm256_loadu_si256((const __m256i *) sbc_window8_coeffs[j]);
+        __m256i lo = _mm256_mullo_epi16(x, c);
+        __m256i hi = _mm256_mulhi_epi16(x, c);
+        acc_lo = _mm256_add_epi32(acc_lo, _mm256_unpacklo_epi16(lo, hi));
+        acc_hi = _mm256_add_epi32(acc_hi, _mm256_unpackhi_epi16(lo, hi));
+    }
+    _mm256_storeu_si256((__m256i *) &ps32Y[0], _mm256_permute2x128_si256(acc_lo, acc_hi, 0x20));
+    _mm256_storeu_si256((__m256i *) &ps32Y[8], _mm256_permute2x128_si256(acc_lo, acc_hi, 0x31));
+}
+#endif
+
+#ifdef SBC_ANALYSIS_HAVE_NEON
+static void SbcWindow4Neon(const SINT16 *ps16X, SINT32 *ps32Y)
+{
+    int32x4_t acc_lo = vdupq_n_s32(0);
+    int32x4_t acc_hi = vdupq_n_s32(0);
+    int j;
+    for (j=0;j<5;j++)
+    {
+        acc_lo = vmlal_s16(acc_lo, vld1_s16(&ps16X[j*8]),   vld1_s16(&sbc_window4_coeffs[j][0]));
+        acc_hi = vmlal_s16(acc_hi, vld1_s16(&ps16X[j*8+4]), vld1_s16(&sbc_window4_coeffs[j][4]));
+    }
+    vst1q_s32(&ps32Y[0], acc_lo);
+    vst1q_s32(&ps32Y[4], acc_hi);
+}
+
+static void SbcWindow8Neon(const SINT16 *ps16X, SINT32 *ps32Y)
+{
+    int i,j;
+    for (i=0;i<16;i+=8)
+    {
+        int32x4_t acc_lo = vdupq_n_s32(0);
+        int32x4_t acc_hi = vdupq_n_s32(0);
+        for (j=0;j<5;j++)
+        {
+            acc_lo = vmlal_s16(acc_lo, vld1_s16(&ps16X[j*16+i]),   vld1_s16(&sbc_window8_coeffs[j][i]));
+            acc_hi = vmlal_s16(acc_hi, vld1_s16(&ps16X[j*16+i+4]), vld1_s16(&sbc_window8_coeffs[j][i+4]));
+        }
+        vst1q_s32(&ps32Y[i],   acc_lo);
+        vst1q_s32(&ps32Y[i+4], acc_hi);
+    }
+}
+#endif
+
+#ifdef SBC_ANALYSIS_HAVE_X86
+#define SBC_ANALYSIS_X86_CASES_4 \
+    case SBC_ANALYSIS_SSE2: \
+    case SBC_ANALYSIS_AVX2: SbcWindow4Sse2(&s16X[ChOffset], s32DCTY); break;
+#define SBC_ANALYSIS_X86_CASES_8 \
+    case SBC_ANALYSIS_SSE2: SbcWindow8Sse2(&s16X[ChOffset], s32DCTY); break; \
+    case SBC_ANALYSIS_AVX2: SbcWindow8Avx2(&s16X[ChOffset], s32DCTY); break;
+#else
+#define SBC_ANALYSIS_X86_CASES_4
+#define SBC_ANALYSIS_X86_CASES_8
+#endif
+#ifdef SBC_ANALYSIS_HAVE_NEON
+#define SBC_ANALYSIS_NEON_CASES_4 \
+    case SBC_ANALYSIS_NEON: SbcWindow4Neon(&s16X[ChOffset], s32DCTY); break;
+#define SBC_ANALYSIS_NEON_CASES_8 \
+    case SBC_ANALYSIS_NEON: SbcWindow8Neon(&s16X[ChOffset], s32DCTY); break;
+#else
+#define SBC_ANALYSIS_NEON_CASES_4
+#define SBC_ANALYSIS_NEON_CASES_8
+#endif
+
+#define SBC_ANALYSIS_WINDOW_4(p) \
+    switch ((p)->AnalysisImpl) \
+    { \
+        SBC_ANALYSIS_X86_CASES_4 \
+        SBC_ANALYSIS_NEON_CASES_4 \
+        default: WINDOW_PARTIAL_4 break; \
+    }
+#define SBC_ANALYSIS_WINDOW_8(p) \
+    switch ((p)->AnalysisImpl) \
+    { \
+        SBC_ANALYSIS_X86_CASES_8 \
+        SBC_ANALYSIS_NEON_CASES_8 \
+        default: WINDOW_PARTIAL_8 break; \
+    }
+
+static SINT16 s16AnalysisImplementation = SBC_ANALYSIS_AUTO;
+
+static SINT16 SbcAnalysisImplementationSupported(SINT16 s16Implementation)
+{
+    switch (s16Implementation)
+    {
+        case SBC_ANALYSIS_SCALAR:
+            return TRUE;
+#ifdef SBC_ANALYSIS_HAVE_X86
+        case SBC_ANALYSIS_SSE2:
+            return __builtin_cpu_supports("sse2") ? TRUE : FALSE;
+        case SBC_ANALYSIS_AVX2:
+            return __builtin_cpu_supports("avx2") ? TRUE : FALSE;
+#endif
+#ifdef SBC_ANALYSIS_HAVE_NEON
+        case SBC_ANALYSIS_NEON:
+            return TRUE;
+#endif
+        default:
+            return FALSE;
+    }
+}
+
+static SINT16 SbcAnalysisGetImplementation(void)
+{
+    /* fastest first */
+    static const SINT16 as16Preferred[] = { SBC_ANALYSIS_AVX2, SBC_ANALYSIS_NEON, SBC_ANALYSIS_SSE2 };
+    SINT16 i;
+    if (s16AnalysisImplementation != SBC_ANALYSIS_AUTO) return s16AnalysisImplementation;
+    for (i=0;i<(SINT16)(sizeof(as16Preferred)/sizeof(as16Preferred[0]));i++)
+    {
+        if (SbcAnalysisImplementationSupported(as16Preferred[i])) return as16Preferred[i];
+    }
+    return SBC_ANALYSIS_SCALAR;
+}
+/* BK4BTSTACK_CHANGE END */
+
+/* BK4BTSTACK_CHANGE START */
+/* filter state is taken from the encoder instance */
+#define SBC_ANALYSIS_STATE_LOAD(p)                                     \
+    SINT32  s32DCTY[16];                                              \
+    SINT16 *s16X = (SINT16*) (p)->s32X;                               \
+    SINT16  EncMaxShiftCounter = (p)->EncMaxShiftCounter;             \
+    SINT16  ShiftCounter = (p)->ShiftCounter;
+#define SBC_ANALYSIS_STATE_STORE(p) (p)->ShiftCounter = ShiftCounter;
+/* BK4BTSTACK_CHANGE END */
 /****************************************************************************
 * SbcAnalysisFilter - performs Analysis of the input audio stream
 *
@@ -930,6 +1141,10 @@ void SbcAnalysisFilter4(SBC_ENC_PARAMS *pstrEncParams)
 #endif
 #endif
 
+    /* BK4BTSTACK_CHANGE START */
+    SBC_ANALYSIS_STATE_LOAD(pstrEncParams)
+    /* BK4BTSTACK_CHANGE END */
+
     s32NumOfChannels = pstrEncParams->s16NumOfChannels;
     s32NumOfBlocks   = pstrEncParams->s16NumOfBlocks;
 
@@ -965,7 +1180,9 @@ void SbcAnalysisFilter4(SBC_ENC_PARAMS *pstrEncParams)
         {
             ChOffset=s32Ch*Offset2+Offset;
             
-            WINDOW_PARTIAL_4
+            /* BK4BTSTACK_CHANGE START */
+            SBC_ANALYSIS_WINDOW_4(pstrEncParams)
+            /* BK4BTSTACK_CHANGE END */
 
             SBC_FastIDCT4(s32DCTY, ps32SbBuf);
             ps32SbBuf +=SUB_BANDS_4;
@@ -995,6 +1212,9 @@ void SbcAnalysisFilter4(SBC_ENC_PARAMS *pstrEncParams)
             }
         }
     }
+    /* BK4BTSTACK_CHANGE START */
+    SBC_ANALYSIS_STATE_STORE(pstrEncParams)
+    /* BK4BTSTACK_CHANGE END */
 }
 
 /* //////////////////////////////////////////////////////////////////////////////////////////////////////////////////// */
@@ -1023,6 +1243,10 @@ void SbcAnalysisFilter8 (SBC_ENC_PARAMS *pstrEncParams)
 #endif
 #endif
 
+    /* BK4BTSTACK_CHANGE START */
+    SBC_ANALYSIS_STATE_LOAD(pstrEncParams)
+    /* BK4BTSTACK_CHANGE END */
+
     s32NumOfChannels = pstrEncParams->s16NumOfChannels;
     s32NumOfBlocks   = pstrEncParams->s16NumOfBlocks;
 
@@ -1068,7 +1292,9 @@ void SbcAnalysisFilter8 (SBC_ENC_PARAMS *pstrEncParams)
         {
             ChOffset=s32Ch*Offset2+Offset;
 
-            WINDOW_PARTIAL_8
+            /* BK4BTSTACK_CHANGE START */
+            SBC_ANALYSIS_WINDOW_8(pstrEncParams)
+            /* BK4BTSTACK_CHANGE END */
 
             SBC_FastIDCT8 (s32DCTY, ps32SbBuf);
 
@@ -1099,10 +1325,23 @@ void SbcAnalysisFilter8 (SBC_ENC_PARAMS *pstrEncParams)
             }
         }
     }
+    /* BK4BTSTACK_CHANGE START */
+    SBC_ANALYSIS_STATE_STORE(pstrEncParams)
+    /* BK4BTSTACK_CHANGE END */
+}
+
+/* BK4BTSTACK_CHANGE START */
+void SbcAnalysisInit (SBC_ENC_PARAMS *pstrEncParams)
+{
+    memset(pstrEncParams->s32X,0,sizeof(pstrEncParams->s32X));
+    pstrEncParams->ShiftCounter=0;
+    pstrEncParams->AnalysisImpl=SbcAnalysisGetImplementation();
 }
 
-void SbcAnalysisInit (void)
+SINT16 SbcAnalysisSetImplementation (SINT16 s16Implementation)
 {
-    memset(s16X,0,ENC_VX_BUFFER_SIZE*sizeof(SINT16));
-    ShiftCounter=0;
+    if (s16Implementation != SBC_ANALYSIS_AUTO && !SbcAnalysisImplementationSupported(s16Implementation)) return FALSE;
+    s16AnalysisImplementation = s16Implementation;
+    return TRUE;
 }
+/* BK4BTSTACK_CHANGE END */
@@ -46,6 +46,7 @@
 #include <stddef.h> // NULL
 
 #include "btstack_linked_list.h"
+#include "btstack_timer_wheel.h"
 #include "btstack_debug.h"
 #include "btstack_run_loop_freertos.h"
 
@@ -75,7 +76,7 @@ static EventGroupHandle_t   btstack_run_loop_event_group;
 #define EVENT_GROUP_FLAG_RUN_LOOP 1
 
 // the run loop
-static btstack_linked_list_t timers;
+static btstack_timer_wheel_t timers;
 static btstack_linked_list_t data_sources;
 
 static uint32_t btstack_run_loop_freertos_get_time_ms(void){
@@ -91,36 +92,16 @@ static void btstack_run_loop_freertos_set_timer(btstack_timer_source_t *ts, uint
  * Add timer to run_loop (keep list sorted)
  */
 static void btstack_run_loop_freertos_add_timer(btstack_timer_source_t *ts){
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) &timers; it->next ; it = it->next){
-        // don't add timer that's already in there
-        if ((btstack_timer_source_t *) it->next == ts){
-            log_error( "btstack_run_loop_timer_add error: timer to add already in list!");
-            return;
-        }
-        if (ts->timeout < ((btstack_timer_source_t *) it->next)->timeout) {
-            break;
-        }
-    }
-    ts->item.next = it->next;
-    it->next = (btstack_linked_item_t *) ts;
+    btstack_timer_wheel_add(&timers, ts);
 }
 
-/**
- * Remove timer from run loop
- */
 static int btstack_run_loop_freertos_remove_timer(btstack_timer_source_t *ts){
-    return btstack_linked_list_remove(&timers, (btstack_linked_item_t *) ts);
+    return btstack_timer_wheel_remove(&timers, ts);
 }
 
 static void btstack_run_loop_freertos_dump_timer(void){
 #ifdef ENABLE_LOG_INFO 
-    btstack_linked_item_t *it;
-    int i = 0;
-    for (it = (btstack_linked_item_t *) timers; it ; it = it->next){
-        btstack_timer_source_t *ts = (btstack_timer_source_t*) it;
-        log_info("timer %u, timeout %u\n", i, (unsigned int) ts->timeout);
-    }
+    btstack_timer_wheel_dump(&timers);
 #endif
 }
 
@@ -202,19 +183,19 @@ static void btstack_run_loop_freertos_execute(void) {
         // process timers and get et next timeout
         uint32_t timeout_ms = portMAX_DELAY;
         log_debug("RL: portMAX_DELAY %u", portMAX_DELAY);
-        while (timers) {
-            btstack_timer_source_t * ts = (btstack_timer_source_t *) timers;
+        while (1) {
             uint32_t now = btstack_run_loop_freertos_get_time_ms();
-            log_debug("RL: now %u, expires %u", now, ts->timeout);
-            if (ts->timeout > now){
-                timeout_ms = ts->timeout - now;
-                break;
-            }
-            // remove timer before processing it to allow handler to re-register with run loop
-            btstack_run_loop_freertos_remove_timer(ts);
-            log_debug("RL: first timer %p", ts->process);
+            // timer is removed before processing it to allow handler to re-register with run loop
+            btstack_timer_source_t * ts = btstack_timer_wheel_get_expired(&timers, now);
+            if (!ts) break;
+            log_debug("RL: now %u, first timer %p", now, ts->process);
             ts->process(ts);
         }
+        uint32_t next_timeout;
+        if (btstack_timer_wheel_get_next_timeout(&timers, &next_timeout)){
+            int32_t delta = next_timeout - btstack_run_loop_freertos_get_time_ms();
+            timeout_ms = delta > 0 ? delta : 0;
+        }
 
         // wait for timeout or event group/task notification
         log_debug("RL: wait with timeout %u", (int) timeout_ms);
@@ -223,6 +204,11 @@ static void btstack_run_loop_freertos_execute(void) {
 #else
         xEventGroupWaitBits(btstack_run_loop_event_group, EVENT_GROUP_FLAG_RUN_LOOP, 1, 0, pdMS_TO_TICKS(timeout_ms));
 #endif
+
+        // keep timer wheel current, data sources and function calls might add timers
+        if (timeout_ms == portMAX_DELAY){
+            btstack_timer_wheel_advance(&timers, btstack_run_loop_freertos_get_time_ms());
+        }
     }
 }
 
@@ -243,7 +229,7 @@ static void btstack_run_loop_freertos_disable_data_source_callbacks(btstack_data
 }
 
 static void btstack_run_loop_freertos_init(void){
-    timers = NULL;
+    btstack_timer_wheel_init(&timers, btstack_run_loop_freertos_get_time_ms());
 
     // queue to receive events: up to 2 calls from transport, up to 3 for app
     btstack_run_loop_queue = xQueueCreate(20, sizeof(function_call_t));
@@ -75,6 +75,11 @@
 #define EVENT_IN_BUFFER_COUNT  3
 #define SCO_IN_BUFFER_COUNT   10
 
+// Outgoing ACL packets are copied into a ring of bulk transfers that are submitted without waiting for completion
+#ifndef ACL_OUT_BUFFER_COUNT
+#define ACL_OUT_BUFFER_COUNT   4
+#endif
+
 #define ASYNC_POLLING_INTERVAL_MS 1
 
 //
@@ -154,7 +159,10 @@ static libusb_device        * dev;
 static libusb_device_handle * handle;
 
 static struct libusb_transfer *command_out_transfer;
-static struct libusb_transfer *acl_out_transfer;
+static struct libusb_transfer *acl_out_transfers[ACL_OUT_BUFFER_COUNT];
+static int      acl_out_transfers_in_flight[ACL_OUT_BUFFER_COUNT];
+static int      acl_out_ring_write;  // transfer idx
+static int      acl_out_transfers_active;
 static struct libusb_transfer *event_in_transfer[EVENT_IN_BUFFER_COUNT];
 static struct libusb_transfer *acl_in_transfer[ACL_IN_BUFFER_COUNT];
 
@@ -196,6 +204,9 @@ static uint8_t hci_cmd_buffer[3 + 256 + LIBUSB_CONTROL_SETUP_SIZE];
 static uint8_t hci_event_in_buffer[EVENT_IN_BUFFER_COUNT][HCI_ACL_BUFFER_SIZE]; // bigger than largest packet
 static uint8_t hci_acl_in_buffer[ACL_IN_BUFFER_COUNT][HCI_INCOMING_PRE_BUFFER_SIZE + HCI_ACL_BUFFER_SIZE]; 
 
+// outgoing buffers for ACL packets
+static uint8_t hci_acl_out_buffer[ACL_OUT_BUFFER_COUNT][HCI_ACL_BUFFER_SIZE];
+
 // For (ab)use as a linked list of received packets
 static struct libusb_transfer *handle_packet;
 
@@ -205,7 +216,6 @@ static btstack_data_source_t * pollfd_data_sources;
 static btstack_timer_source_t usb_timer;
 static int usb_timer_active;
 
-static int usb_acl_out_active = 0;
 static int usb_command_active = 0;
 
 // endpoint addresses
@@ -220,6 +230,14 @@ static int usb_path_len;
 static uint8_t usb_path[USB_MAX_PATH_LEN];
 
 
+static void acl_out_ring_init(void){
+    acl_out_ring_write = 0;
+    acl_out_transfers_active = 0;
+}
+static int acl_out_ring_have_space(void){
+    return acl_out_transfers_active < ACL_OUT_BUFFER_COUNT;
+}
+
 #ifdef ENABLE_SCO_OVER_HCI
 static void sco_ring_init(void){
     sco_ring_write = 0;
@@ -287,6 +305,14 @@ LIBUSB_CALL static void async_callback(struct libusb_transfer *transfer){
 #endif
 
     if (libusb_state != LIB_USB_TRANSFERS_ALLOCATED) {
+        for (c=0;c<ACL_OUT_BUFFER_COUNT;c++){
+            if (transfer == acl_out_transfers[c]){
+                acl_out_transfers_in_flight[c] = 0;
+                libusb_free_transfer(transfer);
+                acl_out_transfers[c] = 0;
+                return;
+            }
+        }
         for (c=0;c<EVENT_IN_BUFFER_COUNT;c++){
             if (transfer == event_in_transfer[c]){
                 libusb_free_transfer(transfer);
@@ -304,6 +330,13 @@ LIBUSB_CALL static void async_callback(struct libusb_transfer *transfer){
         return;
     }
 
+    // mark ACL OUT transfer as done
+    for (c=0;c<ACL_OUT_BUFFER_COUNT;c++){
+        if (transfer == acl_out_transfers[c]){
+            acl_out_transfers_in_flight[c] = 0;
+        }
+    }
+
 #ifdef ENABLE_SCO_OVER_HCI
     // mark SCO OUT transfer as done
     for (c=0;c<SCO_OUT_BUFFER_COUNT;c++){
@@ -441,8 +474,9 @@ static void handle_completed_transfer(struct libusb_transfer *transfer){
         signal_done = 1;
     } else if (transfer->endpoint == acl_out_addr){
         // log_info("acl out done, size %u", transfer->actual_length);
-        usb_acl_out_active = 0;
-        signal_done = 1;
+        // packet buffer was already returned in usb_send_acl_packet, notify upper stack if ring was full
+        signal_done = !acl_out_ring_have_space();
+        acl_out_transfers_active--;
 #ifdef ENABLE_SCO_OVER_HCI
     } else if (transfer->endpoint == sco_in_addr) {
         // log_info("handle_completed_transfer for SCO IN! num packets %u", transfer->NUM_ISO_PACKETS);
@@ -757,6 +791,7 @@ static int prepare_device(libusb_device_handle * aHandle){
     return 0;
 }
 
+#ifndef HAVE_USB_VENDOR_ID_AND_PRODUCT_ID
 static libusb_device_handle * try_open_device(libusb_device * device){
     int r;
 
@@ -780,6 +815,7 @@ static libusb_device_handle * try_open_device(libusb_device * device){
     }
     return dev_handle;
 }
+#endif
 
 #ifdef ENABLE_SCO_OVER_HCI
 
@@ -1031,8 +1067,17 @@ static int usb_open(void){
         }
     }
 
+    for (c = 0 ; c < ACL_OUT_BUFFER_COUNT ; c++) {
+        acl_out_transfers[c] = libusb_alloc_transfer(0); // 0 isochronous transfers ACL out
+        acl_out_transfers_in_flight[c] = 0;
+        if (!acl_out_transfers[c]) {
+            usb_close();
+            return LIBUSB_ERROR_NO_MEM;
+        }
+    }
+    acl_out_ring_init();
+
     command_out_transfer = libusb_alloc_transfer(0);
-    acl_out_transfer     = libusb_alloc_transfer(0);
 
     // TODO check for error
 
@@ -1138,6 +1183,15 @@ static int usb_close(void){
             for (c = 0 ; c < ACL_IN_BUFFER_COUNT ; c++) {
                 libusb_cancel_transfer(acl_in_transfer[c]);
             }
+            for (c = 0 ; c < ACL_OUT_BUFFER_COUNT ; c++) {
+                if (!acl_out_transfers[c]) continue;
+                if (acl_out_transfers_in_flight[c]) {
+                    libusb_cancel_transfer(acl_out_transfers[c]);
+                } else {
+                    libusb_free_transfer(acl_out_transfers[c]);
+                    acl_out_transfers[c] = 0;
+                }
+            }
 #ifdef ENABLE_SCO_OVER_HCI
             for (c = 0 ; c < SCO_IN_BUFFER_COUNT ; c++) {
                 libusb_cancel_transfer(sco_in_transfer[c]);
@@ -1176,6 +1230,15 @@ static int usb_close(void){
                     }
                 }
 
+                if (!completed) continue;
+
+                for (c=0;c<ACL_OUT_BUFFER_COUNT;c++){
+                    if (acl_out_transfers[c]) {
+                        completed = 0;
+                        break;
+                    }
+                }
+
 #ifdef ENABLE_SCO_OVER_HCI
                 if (!completed) continue;
 
@@ -1251,25 +1314,38 @@ static int usb_send_acl_packet(uint8_t *packet, int size){
     int r;
 
     if (libusb_state != LIB_USB_TRANSFERS_ALLOCATED) return -1;
+    if (!acl_out_ring_have_space()) return -1;
 
     // log_info("usb_send_acl_packet enter, size %u", size);
-    
-    // prepare transfer
-    int completed = 0;
-    libusb_fill_bulk_transfer(acl_out_transfer, handle, acl_out_addr, packet, size,
-        async_callback, &completed, 0);
-    acl_out_transfer->type = LIBUSB_TRANSFER_TYPE_BULK;
 
-    // update stata before submitting transfer
-    usb_acl_out_active = 1;
+    // store packet in free slot, transfers on the same endpoint complete in order
+    int transfer_index = acl_out_ring_write;
+    uint8_t * data = hci_acl_out_buffer[transfer_index];
+    memcpy(data, packet, size);
 
-    r = libusb_submit_transfer(acl_out_transfer);
+    // prepare transfer
+    struct libusb_transfer * acl_transfer = acl_out_transfers[transfer_index];
+    libusb_fill_bulk_transfer(acl_transfer, handle, acl_out_addr, data, size,
+        async_callback, NULL, 0);
+    acl_transfer->type = LIBUSB_TRANSFER_TYPE_BULK;
+
+    r = libusb_submit_transfer(acl_transfer);
     if (r < 0) {
-        usb_acl_out_active = 0;
         log_error("Error submitting acl transfer, %d", r);
         return -1;
     }
 
+    // mark slot as full
+    acl_out_ring_write++;
+    if (acl_out_ring_write == ACL_OUT_BUFFER_COUNT){
+        acl_out_ring_write = 0;
+    }
+    acl_out_transfers_active++;
+    acl_out_transfers_in_flight[transfer_index] = 1;
+
+    // notify upper stack that provided buffer can be used again
+    uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
+    packet_handler(HCI_EVENT_PACKET, &event[0], sizeof(event));
     return 0;
 }
 
@@ -1278,7 +1354,7 @@ static int usb_can_send_packet_now(uint8_t packet_type){
         case HCI_COMMAND_DATA_PACKET:
             return !usb_command_active;
         case HCI_ACL_DATA_PACKET:
-            return !usb_acl_out_active;
+            return acl_out_ring_have_space();
 #ifdef ENABLE_SCO_OVER_HCI
         case HCI_SCO_DATA_PACKET:
             return sco_ring_have_space();
@@ -35,12 +35,34 @@
  *
  */
 
+
 #define __BTSTACK_FILE__ "btstack_link_key_db_fs.c"
 
+/*
+ *  btstack_link_key_db_fs.c
+ *
+ *  Stores link keys of all local and remote addresses in a single file that is memory-mapped as an open-addressing
+ *  hash table with linear probing, keyed by (local addr, remote addr).
+ *
+ *  Each slot has a CRC-32 over its content. An update writes the new entry into a free slot and syncs it before the
+ *  previous entry is marked as deleted. After a crash, slots with invalid CRC are dropped and of two entries for the
+ *  same addresses, the more recently used one is kept. The recency field is also used to evict the least recently
+ *  used entry if MAX_NR_BTSTACK_LINK_KEY_DB_FS_ENTRIES are stored.
+ *
+ *  Link key files of earlier versions are imported when the local address is set.
+ */
+
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <dirent.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#endif
 
 #include "btstack_config.h"
 #include "btstack_link_key_db_fs.h"
@@ -56,46 +78,369 @@
 #endif
 #endif
 
+#ifndef MAX_NR_BTSTACK_LINK_KEY_DB_FS_ENTRIES
+#define MAX_NR_BTSTACK_LINK_KEY_DB_FS_ENTRIES 4096
+#endif
+
+#define LINK_KEY_DB_FILE     LINK_KEY_PATH "btstack_link_key_db.bin"
+#define LINK_KEY_DB_TMP_FILE LINK_KEY_PATH "btstack_link_key_db.bin.tmp"
+
+// file names used by earlier versions: one file per link key
 #define LINK_KEY_PREFIX "btstack_at_"
 #define LINK_KEY_FOR "_link_key_for_"
 #define LINK_KEY_SUFFIX ".txt"
 #define LINK_KEY_STRING_LEN 17
 
+// header: 'B', 'T', 'L', 'K', version, 3 x reserved, num slots, slot size
+#define DB_VERSION     1
+#define DB_HEADER_SIZE 16
+
+// slot: state, link key type, local addr, remote addr, link key, 2 x reserved, recency, CRC-32 over bytes 1..31
+#define DB_SLOT_SIZE                40
+#define DB_SLOT_POS_STATE            0
+#define DB_SLOT_POS_TYPE             1
+#define DB_SLOT_POS_LOCAL_ADDR       2
+#define DB_SLOT_POS_REMOTE_ADDR      8
+#define DB_SLOT_POS_LINK_KEY        14
+#define DB_SLOT_POS_RECENCY         32
+#define DB_SLOT_POS_CRC             36
+#define DB_SLOT_CRC_LEN             31
+
+#define DB_SLOT_EMPTY   0
+#define DB_SLOT_VALID   1
+#define DB_SLOT_DELETED 2
+
+typedef struct {
+    uint8_t * data;
+    uint32_t  size;
+#ifdef _WIN32
+    FILE *    file;
+#else
+    int       fd;
+#endif
+} db_file_t;
+
+static const uint8_t db_magic[] = { 'B', 'T', 'L', 'K', DB_VERSION };
+
 static bd_addr_t local_addr;
-// note: sizeof for string literals works at compile time while strlen only works with some optimizations turned on. sizeof inlcudes the  \0
-static char keypath[sizeof(LINK_KEY_PATH) + sizeof(LINK_KEY_PREFIX) + LINK_KEY_STRING_LEN + sizeof(LINK_KEY_FOR) + LINK_KEY_STRING_LEN + sizeof(LINK_KEY_SUFFIX) + 1];
 
-static char bd_addr_to_dash_str_buffer[6*3];  // 12-45-78-01-34-67\0
-static char * bd_addr_to_dash_str(bd_addr_t addr){
-    char * p = bd_addr_to_dash_str_buffer;
-    int i;
-    for (i = 0; i < 6 ; i++) {
-        *p++ = char_for_nibble((addr[i] >> 4) & 0x0F);
-        *p++ = char_for_nibble((addr[i] >> 0) & 0x0F);
-        *p++ = '-';
+static db_file_t db;
+static uint32_t  db_num_slots;
+static uint32_t  db_num_entries;
+static uint32_t  db_num_deleted;
+static uint32_t  db_recency;
+
+// at most 3/4 of the slots are in use, including deleted ones
+static uint32_t db_slots_for_entries(uint32_t num_entries){
+    uint32_t num_slots = 16;
+    while (num_slots * 3 < num_entries * 4 + 4) {
+        num_slots <<= 1;
     }
-    *--p = 0;
-    return (char *) bd_addr_to_dash_str_buffer;
+    return num_slots;
 }
 
-static char link_key_to_str_buffer[LINK_KEY_STR_LEN+1];  // 11223344556677889900112233445566\0
-static char *link_key_to_str(link_key_t link_key){
-    char * p = link_key_to_str_buffer;
+// FNV-1a over local and remote address
+static uint32_t db_hash(const uint8_t * local, const uint8_t * remote){
+    uint32_t hash = 2166136261u;
     int i;
-    for (i = 0; i < LINK_KEY_LEN ; i++) {
-        *p++ = char_for_nibble((link_key[i] >> 4) & 0x0F);
-        *p++ = char_for_nibble((link_key[i] >> 0) & 0x0F);
+    for (i = 0; i < 6; i++){
+        hash = (hash ^ local[i]) * 16777619;
+    }
+    for (i = 0; i < 6; i++){
+        hash = (hash ^ remote[i]) * 16777619;
+    }
+    return hash;
+}
+
+// file mapping
+
+#ifdef _WIN32
+
+// no mmap, file is read into memory and modified ranges are written back
+
+static int db_file_map(db_file_t * file, const char * path, uint32_t size){
+    memset(file, 0, sizeof(db_file_t));
+    file->file = fopen(path, "r+b");
+    if (file->file == NULL){
+        file->file = fopen(path, "w+b");
     }
-    *p = 0;
-    return (char *) link_key_to_str_buffer;
+    if (file->file == NULL) return 0;
+    fseek(file->file, 0, SEEK_END);
+    long file_size = ftell(file->file);
+    if (size == 0) {
+        size = (uint32_t) file_size;
+    }
+    if (size == 0) {
+        fclose(file->file);
+        return 0;
+    }
+    file->data = (uint8_t *) calloc(1, size);
+    if (file->data == NULL){
+        fclose(file->file);
+        return 0;
+    }
+    file->size = size;
+    fseek(file->file, 0, SEEK_SET);
+    if (fread(file->data, 1, size, file->file) < size) {
+        // extend file
+        fseek(file->file, 0, SEEK_SET);
+        fwrite(file->data, size, 1, file->file);
+        fflush(file->file);
+    }
+    return 1;
+}
+
+static void db_file_sync(db_file_t * file, uint32_t offset, uint32_t len){
+    fseek(file->file, offset, SEEK_SET);
+    fwrite(&file->data[offset], len, 1, file->file);
+    fflush(file->file);
+}
+
+static void db_file_unmap(db_file_t * file){
+    if (file->data == NULL) return;
+    free(file->data);
+    fclose(file->file);
+    file->data = NULL;
+}
+
+#else
+
+// @param size of file, 0 to use current size
+static int db_file_map(db_file_t * file, const char * path, uint32_t size){
+    memset(file, 0, sizeof(db_file_t));
+    file->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (file->fd < 0) return 0;
+    struct stat st;
+    if (fstat(file->fd, &st) != 0){
+        close(file->fd);
+        return 0;
+    }
+    if (size == 0){
+        size = (uint32_t) st.st_size;
+    }
+    if (size == 0 || (st.st_size != size && ftruncate(file->fd, size) != 0)){
+        close(file->fd);
+        return 0;
+    }
+    void * data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+    if (data == MAP_FAILED){
+        close(file->fd);
+        return 0;
+    }
+    file->data = (uint8_t *) data;
+    file->size = size;
+    return 1;
+}
+
+static void db_file_sync(db_file_t * file, uint32_t offset, uint32_t len){
+    uint32_t page_size = (uint32_t) sysconf(_SC_PAGESIZE);
+    uint32_t start = offset & ~(page_size - 1);
+    if (msync(&file->data[start], offset + len - start, MS_SYNC) != 0){
+        log_error("link key db: msync failed");
+    }
+}
+
+static void db_file_unmap(db_file_t * file){
+    if (file->data == NULL) return;
+    munmap(file->data, file->size);
+    close(file->fd);
+    file->data = NULL;
+}
+
+#endif
+
+// slots
+
+static inline uint8_t * db_slot(const db_file_t * file, uint32_t index){
+    return &file->data[DB_HEADER_SIZE + index * DB_SLOT_SIZE];
+}
+
+static inline uint32_t db_slot_offset(uint32_t index){
+    return DB_HEADER_SIZE + index * DB_SLOT_SIZE;
 }
 
-static char link_key_type_to_str_buffer[2];
-static char *link_key_type_to_str(link_key_type_t link_key){
-    snprintf(link_key_type_to_str_buffer, sizeof(link_key_type_to_str_buffer), "%d", link_key);
-    return (char *) link_key_type_to_str_buffer;
+static int db_slot_valid(const uint8_t * slot){
+    if (slot[DB_SLOT_POS_STATE] != DB_SLOT_VALID) return 0;
+    return little_endian_read_32(slot, DB_SLOT_POS_CRC) == btstack_crc32(&slot[DB_SLOT_POS_TYPE], DB_SLOT_CRC_LEN);
 }
 
+static void db_file_init_header(db_file_t * file, uint32_t num_slots){
+    memcpy(file->data, db_magic, sizeof(db_magic));
+    little_endian_store_32(file->data, 8, num_slots);
+    little_endian_store_32(file->data, 12, DB_SLOT_SIZE);
+}
+
+// @returns index of slot with valid entry for addresses or -1, CRC was checked by db_recover
+static int db_find_slot(const db_file_t * file, uint32_t num_slots, const uint8_t * local, const uint8_t * remote){
+    uint32_t mask = num_slots - 1;
+    uint32_t index = db_hash(local, remote) & mask;
+    uint32_t i;
+    for (i = 0; i < num_slots; i++){
+        const uint8_t * slot = db_slot(file, index);
+        switch (slot[DB_SLOT_POS_STATE]){
+            case DB_SLOT_EMPTY:
+                return -1;
+            case DB_SLOT_VALID:
+                if (memcmp(&slot[DB_SLOT_POS_REMOTE_ADDR], remote, 6) == 0
+                 && memcmp(&slot[DB_SLOT_POS_LOCAL_ADDR],  local,  6) == 0) return index;
+                break;
+            default:
+                break;
+        }
+        index = (index + 1) & mask;
+    }
+    return -1;
+}
+
+// @returns index of first empty or deleted slot in probe sequence or -1
+static int db_find_free_slot(const db_file_t * file, uint32_t num_slots, const uint8_t * local, const uint8_t * remote){
+    uint32_t mask = num_slots - 1;
+    uint32_t index = db_hash(local, remote) & mask;
+    uint32_t i;
+    for (i = 0; i < num_slots; i++){
+        if (db_slot(file, index)[DB_SLOT_POS_STATE] != DB_SLOT_VALID) return index;
+        index = (index + 1) & mask;
+    }
+    return -1;
+}
+
+static void db_slot_delete(uint32_t index){
+    db_slot(&db, index)[DB_SLOT_POS_STATE] = DB_SLOT_DELETED;
+    db_num_entries--;
+    db_num_deleted++;
+}
+
+// drop entries with invalid CRC and older duplicates left by an interrupted update
+static void db_recover(void){
+    db_num_entries = 0;
+    db_num_deleted = 0;
+    db_recency = 0;
+    uint32_t index;
+    for (index = 0; index < db_num_slots; index++){
+        uint8_t * slot = db_slot(&db, index);
+        switch (slot[DB_SLOT_POS_STATE]){
+            case DB_SLOT_EMPTY:
+                break;
+            case DB_SLOT_VALID:
+                if (db_slot_valid(slot)) {
+                    db_num_entries++;
+                    uint32_t recency = little_endian_read_32(slot, DB_SLOT_POS_RECENCY);
+                    if (recency > db_recency) {
+                        db_recency = recency;
+                    }
+                    break;
+                }
+                log_error("link key db: dropping corrupt slot %u", index);
+                slot[DB_SLOT_POS_STATE] = DB_SLOT_DELETED;
+                db_num_deleted++;
+                break;
+            default:
+                slot[DB_SLOT_POS_STATE] = DB_SLOT_DELETED;
+                db_num_deleted++;
+                break;
+        }
+    }
+    for (index = 0; index < db_num_slots; index++){
+        uint8_t * slot = db_slot(&db, index);
+        if (slot[DB_SLOT_POS_STATE] != DB_SLOT_VALID) continue;
+        int first = db_find_slot(&db, db_num_slots, &slot[DB_SLOT_POS_LOCAL_ADDR], &slot[DB_SLOT_POS_REMOTE_ADDR]);
+        if (first == (int) index) continue;
+        uint8_t * first_slot = db_slot(&db, first);
+        log_error("link key db: dropping duplicate entry for %s", bd_addr_to_str(&slot[DB_SLOT_POS_REMOTE_ADDR]));
+        if (little_endian_read_32(slot, DB_SLOT_POS_RECENCY) > little_endian_read_32(first_slot, DB_SLOT_POS_RECENCY)){
+            memcpy(first_slot, slot, DB_SLOT_SIZE);
+            db_file_sync(&db, db_slot_offset(first), DB_SLOT_SIZE);
+        }
+        db_slot_delete(index);
+    }
+    db_file_sync(&db, 0, db.size);
+}
+
+// copy valid entries into new file without deleted slots and replace db
+static void db_rebuild(uint32_t num_slots){
+    db_file_t new_db;
+    remove(LINK_KEY_DB_TMP_FILE);
+    if (!db_file_map(&new_db, LINK_KEY_DB_TMP_FILE, DB_HEADER_SIZE + num_slots * DB_SLOT_SIZE)){
+        log_error("link key db: cannot create %s", LINK_KEY_DB_TMP_FILE);
+        return;
+    }
+    db_file_init_header(&new_db, num_slots);
+    uint32_t index;
+    for (index = 0; index < db_num_slots; index++){
+        const uint8_t * slot = db_slot(&db, index);
+        if (slot[DB_SLOT_POS_STATE] != DB_SLOT_VALID) continue;
+        int new_index = db_find_free_slot(&new_db, num_slots, &slot[DB_SLOT_POS_LOCAL_ADDR], &slot[DB_SLOT_POS_REMOTE_ADDR]);
+        memcpy(db_slot(&new_db, new_index), slot, DB_SLOT_SIZE);
+    }
+    db_file_sync(&new_db, 0, new_db.size);
+    db_file_unmap(&new_db);
+    db_file_unmap(&db);
+#ifdef _WIN32
+    // rename does not replace existing files on Windows
+    remove(LINK_KEY_DB_FILE);
+#endif
+    if (rename(LINK_KEY_DB_TMP_FILE, LINK_KEY_DB_FILE) != 0){
+        log_error("link key db: cannot replace %s", LINK_KEY_DB_FILE);
+    }
+    if (!db_file_map(&db, LINK_KEY_DB_FILE, 0)) return;
+    db_num_slots   = little_endian_read_32(db.data, 8);
+    db_num_deleted = 0;
+}
+
+static int db_header_valid(void){
+    if (db.size < DB_HEADER_SIZE) return 0;
+    if (memcmp(db.data, db_magic, sizeof(db_magic)) != 0) return 0;
+    if (little_endian_read_32(db.data, 12) != DB_SLOT_SIZE) return 0;
+    uint32_t num_slots = little_endian_read_32(db.data, 8);
+    if (num_slots == 0 || (num_slots & (num_slots - 1)) != 0) return 0;
+    return db.size == DB_HEADER_SIZE + num_slots * DB_SLOT_SIZE;
+}
+
+// @returns 1 if db is mapped
+static int db_map(void){
+    if (db.data) return 1;
+    if (!db_file_map(&db, LINK_KEY_DB_FILE, 0) || !db_header_valid()){
+        db_file_unmap(&db);
+        uint32_t num_slots = db_slots_for_entries(MAX_NR_BTSTACK_LINK_KEY_DB_FS_ENTRIES);
+        remove(LINK_KEY_DB_FILE);
+        if (!db_file_map(&db, LINK_KEY_DB_FILE, DB_HEADER_SIZE + num_slots * DB_SLOT_SIZE)){
+            log_error("link key db: cannot create %s", LINK_KEY_DB_FILE);
+            return 0;
+        }
+        db_file_init_header(&db, num_slots);
+        db_file_sync(&db, 0, DB_HEADER_SIZE);
+    }
+    db_num_slots = little_endian_read_32(db.data, 8);
+    db_recover();
+    // resize if MAX_NR_BTSTACK_LINK_KEY_DB_FS_ENTRIES was changed
+    uint32_t num_slots = db_slots_for_entries(btstack_max(MAX_NR_BTSTACK_LINK_KEY_DB_FS_ENTRIES, db_num_entries));
+    if (num_slots != db_num_slots){
+        log_info("link key db: resize from %u to %u slots", db_num_slots, num_slots);
+        db_rebuild(num_slots);
+    }
+    return db.data != NULL;
+}
+
+static void db_evict_least_recently_used(void){
+    int lru_index = -1;
+    uint32_t lru_recency = 0;
+    uint32_t index;
+    for (index = 0; index < db_num_slots; index++){
+        const uint8_t * slot = db_slot(&db, index);
+        if (slot[DB_SLOT_POS_STATE] != DB_SLOT_VALID) continue;
+        uint32_t recency = little_endian_read_32(slot, DB_SLOT_POS_RECENCY);
+        if (lru_index >= 0 && recency >= lru_recency) continue;
+        lru_index = index;
+        lru_recency = recency;
+    }
+    if (lru_index < 0) return;
+    log_info("link key db: evict link key for %s", bd_addr_to_str(&db_slot(&db, lru_index)[DB_SLOT_POS_REMOTE_ADDR]));
+    db_slot_delete(lru_index);
+    db_file_sync(&db, db_slot_offset(lru_index), DB_SLOT_SIZE);
+}
+
+// link key files of earlier versions
+
 static int sscanf_link_key(char * addr_string, link_key_t link_key){
     unsigned int buffer[LINK_KEY_LEN];
 
@@ -120,74 +465,129 @@ static int sscanf_link_key(char * addr_string, link_key_t link_key){
     return 1;
 }
 
-static void set_path(bd_addr_t bd_addr){
-    strcpy(keypath, LINK_KEY_PATH);
-    strcat(keypath, LINK_KEY_PREFIX);
-    strcat(keypath, bd_addr_to_dash_str(local_addr));
-    strcat(keypath, LINK_KEY_FOR);
-    strcat(keypath, bd_addr_to_dash_str(bd_addr));
-    strcat(keypath, LINK_KEY_SUFFIX);
+static int read_legacy_link_key(const char * path, link_key_t link_key, link_key_type_t * link_key_type){
+    char link_key_str[LINK_KEY_STR_LEN + 2];
+
+    FILE * rFile = fopen(path,"r");
+    if (rFile == NULL) return 0;
+    size_t objects_read = fread(link_key_str, LINK_KEY_STR_LEN + 1, 1, rFile);
+    fclose(rFile);
+    if (objects_read != 1) return 0;
+
+    link_key_str[LINK_KEY_STR_LEN + 1] = 0;
+    int link_key_type_buffer;
+    if (sscanf(&link_key_str[LINK_KEY_STR_LEN], "%d", &link_key_type_buffer) != 1) return 0;
+    link_key_str[LINK_KEY_STR_LEN] = 0;
+    if (!sscanf_link_key(link_key_str, link_key)) return 0;
+    *link_key_type = (link_key_type_t) link_key_type_buffer;
+    return 1;
 }
 
-// Device info
+static void put_link_key(bd_addr_t bd_addr, link_key_t link_key, link_key_type_t link_key_type);
+
+static void import_legacy_link_keys(void){
+    char prefix[sizeof(LINK_KEY_PREFIX) + LINK_KEY_STRING_LEN + sizeof(LINK_KEY_FOR)];
+    strcpy(prefix, LINK_KEY_PREFIX);
+    strcat(prefix, bd_addr_to_str(local_addr));
+    strcat(prefix, LINK_KEY_FOR);
+    // bd_addr_to_str uses ':' as separator, file names use '-'
+    char * p;
+    for (p = prefix; *p; p++){
+        if (*p == ':') *p = '-';
+    }
+    size_t prefix_len = strlen(prefix);
+
+    DIR * dir = opendir(LINK_KEY_PATH[0] ? LINK_KEY_PATH : ".");
+    if (dir == NULL) return;
+    struct dirent * entry;
+    while ((entry = readdir(dir)) != NULL){
+        if (strlen(entry->d_name) != prefix_len + LINK_KEY_STRING_LEN + sizeof(LINK_KEY_SUFFIX) - 1) continue;
+        if (strncmp(entry->d_name, prefix, prefix_len) != 0) continue;
+        if (strcmp(&entry->d_name[prefix_len + LINK_KEY_STRING_LEN], LINK_KEY_SUFFIX) != 0) continue;
+        bd_addr_t addr;
+        if (!sscanf_bd_addr(&entry->d_name[prefix_len], addr)) continue;
+        char path[sizeof(LINK_KEY_PATH) + sizeof(prefix) + LINK_KEY_STRING_LEN + sizeof(LINK_KEY_SUFFIX)];
+        strcpy(path, LINK_KEY_PATH);
+        strcat(path, entry->d_name);
+        link_key_t link_key;
+        link_key_type_t link_key_type;
+        if (!read_legacy_link_key(path, link_key, &link_key_type)) continue;
+        log_info("link key db: import %s", path);
+        put_link_key(addr, link_key, link_key_type);
+        remove(path);
+    }
+    closedir(dir);
+}
+
+// btstack_link_key_db_t
+
 static void db_open(void){
+    db_map();
 }
 
 static void db_set_local_bd_addr(bd_addr_t bd_addr){
     memcpy(local_addr, bd_addr, 6);
+    if (!db_map()) return;
+    import_legacy_link_keys();
 }
 
 static void db_close(void){ 
+    db_file_unmap(&db);
 }
 
 static void put_link_key(bd_addr_t bd_addr, link_key_t link_key, link_key_type_t link_key_type){
-    set_path(bd_addr);
-    char * link_key_str = link_key_to_str(link_key);
-    char * link_key_type_str = link_key_type_to_str(link_key_type); 
+    if (!db_map()) return;
+    int old_index = db_find_slot(&db, db_num_slots, local_addr, bd_addr);
+    if (old_index < 0 && db_num_entries >= MAX_NR_BTSTACK_LINK_KEY_DB_FS_ENTRIES){
+        db_evict_least_recently_used();
+    }
+    // new entry is stored before old one is deleted
+    if ((db_num_entries + db_num_deleted + 2) * 4 > db_num_slots * 3){
+        db_rebuild(db_num_slots);
+        if (db.data == NULL) return;
+        old_index = db_find_slot(&db, db_num_slots, local_addr, bd_addr);
+    }
+    int index = db_find_free_slot(&db, db_num_slots, local_addr, bd_addr);
+    if (index < 0) return;
+
+    uint8_t * slot = db_slot(&db, index);
+    if (slot[DB_SLOT_POS_STATE] == DB_SLOT_DELETED){
+        db_num_deleted--;
+    }
+    memset(slot, 0, DB_SLOT_SIZE);
+    slot[DB_SLOT_POS_TYPE] = (uint8_t) link_key_type;
+    memcpy(&slot[DB_SLOT_POS_LOCAL_ADDR],  local_addr, 6);
+    memcpy(&slot[DB_SLOT_POS_REMOTE_ADDR], bd_addr, 6);
+    memcpy(&slot[DB_SLOT_POS_LINK_KEY],    link_key, LINK_KEY_LEN);
+    little_endian_store_32(slot, DB_SLOT_POS_RECENCY, ++db_recency);
+    little_endian_store_32(slot, DB_SLOT_POS_CRC, btstack_crc32(&slot[DB_SLOT_POS_TYPE], DB_SLOT_CRC_LEN));
+    slot[DB_SLOT_POS_STATE] = DB_SLOT_VALID;
+    db_file_sync(&db, db_slot_offset(index), DB_SLOT_SIZE);
+    db_num_entries++;
 
-    FILE * wFile = fopen(keypath,"w+");
-    fwrite(link_key_str, strlen(link_key_str), 1, wFile);
-    fwrite(link_key_type_str, strlen(link_key_type_str), 1, wFile);
-    fclose(wFile);
+    if (old_index < 0) return;
+    db_slot_delete(old_index);
+    db_file_sync(&db, db_slot_offset(old_index), DB_SLOT_SIZE);
 }
 
 static int get_link_key(bd_addr_t bd_addr, link_key_t link_key, link_key_type_t * link_key_type) {
-    set_path(bd_addr);
-    if (access(keypath, R_OK)) return 0;
-    
-    char link_key_str[LINK_KEY_STR_LEN + 1];
-    char link_key_type_str[2];
-
-    FILE * rFile = fopen(keypath,"r+");
-    size_t objects_read = fread(link_key_str, LINK_KEY_STR_LEN, 1, rFile );
-    if (objects_read == 1){
-        link_key_str[LINK_KEY_STR_LEN] = 0;
-        log_info("Found link key %s\n", link_key_str);
-        objects_read = fread(link_key_type_str, 1, 1, rFile );
-    }
-    fclose(rFile);
-    
-    if (objects_read != 1) return 0;
-    link_key_type_str[1] = 0;
-    log_info("Found link key type %s\n", link_key_type_str);
-    
-    int scan_result = sscanf_link_key(link_key_str, link_key);
-    if (scan_result == 0 ) return 0;
-
-    int link_key_type_buffer;
-    scan_result = sscanf( (char *) link_key_type_str, "%d", &link_key_type_buffer);
-    if (scan_result == 0 ) return 0;
-    *link_key_type = (link_key_type_t) link_key_type_buffer;
+    if (!db_map()) return 0;
+    int index = db_find_slot(&db, db_num_slots, local_addr, bd_addr);
+    if (index < 0) return 0;
+    uint8_t * slot = db_slot(&db, index);
+    memcpy(link_key, &slot[DB_SLOT_POS_LINK_KEY], LINK_KEY_LEN);
+    *link_key_type = (link_key_type_t) slot[DB_SLOT_POS_TYPE];
+    // recency is not covered by CRC and not synced explicitly
+    little_endian_store_32(slot, DB_SLOT_POS_RECENCY, ++db_recency);
     return 1;
 }
 
 static void delete_link_key(bd_addr_t bd_addr){
-    set_path(bd_addr);
-    if (access(keypath, R_OK)) return;
-
-    if(remove(keypath) != 0){
-        log_error("File %s could not be deleted.\n", keypath);
-    }
+    if (!db_map()) return;
+    int index = db_find_slot(&db, db_num_slots, local_addr, bd_addr);
+    if (index < 0) return;
+    db_slot_delete(index);
+    db_file_sync(&db, db_slot_offset(index), DB_SLOT_SIZE);
 }
 
 static const btstack_link_key_db_t btstack_link_key_db_fs = {
@@ -202,5 +602,3 @@ static const btstack_link_key_db_t btstack_link_key_db_fs = {
 const btstack_link_key_db_t * btstack_link_key_db_fs_instance(void){
     return &btstack_link_key_db_fs;
 }
-
-
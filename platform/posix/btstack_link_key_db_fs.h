@@ -45,7 +45,7 @@ extern "C" {
 #endif
 
 /*
- * @brief Get basic link key db implementation that stores link keys in /tmp
+ * @brief Get link key db implementation that stores all link keys in a single hash table file in LINK_KEY_PATH
  */
 const btstack_link_key_db_t * btstack_link_key_db_fs_instance(void);
 
@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define __BTSTACK_FILE__ "btstack_run_loop_epoll.c"
+
+/*
+ *  btstack_run_loop_epoll.c
+ *
+ *  Linux run loop based on epoll. In contrast to btstack_run_loop_posix.c, file descriptors 
+ *  are registered with the kernel when a data source gets added or its callbacks change, 
+ *  and only data sources that are ready get visited after a wakeup.
+ */
+
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_epoll.h"
+#include "btstack_linked_list.h"
+#include "btstack_timer_wheel.h"
+#include "btstack_debug.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// max number of ready data sources processed per epoll_wait
+#define EPOLL_MAX_EVENTS 64
+
+// private flag: data source has been added to the run loop
+#define DATA_SOURCE_EPOLL_ADDED (1 << 15)
+// private flag: fd of data source is registered with epoll for this data source
+#define DATA_SOURCE_EPOLL_REGISTERED (1 << 14)
+
+// the run loop
+static int epoll_fd = -1;
+static btstack_timer_wheel_t timers;
+// start time. tv_usec = 0
+static struct timeval init_tv;
+
+// events returned by last epoll_wait, entries get cleared if data source is removed during processing
+static struct epoll_event ready_events[EPOLL_MAX_EVENTS];
+static int num_ready_events;
+
+static uint32_t btstack_run_loop_epoll_events_for_flags(uint16_t flags){
+    uint32_t events = 0;
+    if (flags & DATA_SOURCE_CALLBACK_READ){
+        events |= EPOLLIN;
+    }
+    if (flags & DATA_SOURCE_CALLBACK_WRITE){
+        events |= EPOLLOUT;
+    }
+    return events;
+}
+
+// data source needs to be registered with epoll if it is part of the run loop and has read or write callbacks enabled
+static int btstack_run_loop_epoll_watched(btstack_data_source_t * ds, uint16_t flags){
+    if (ds->fd < 0) return 0;
+    if ((flags & DATA_SOURCE_EPOLL_ADDED) == 0) return 0;
+    return btstack_run_loop_epoll_events_for_flags(flags) != 0;
+}
+
+// sync epoll registration after ds->flags changed from old_flags
+static void btstack_run_loop_epoll_update(btstack_data_source_t * ds, uint16_t old_flags){
+    int was_registered = (ds->flags & DATA_SOURCE_EPOLL_REGISTERED) != 0;
+    int is_watched     = btstack_run_loop_epoll_watched(ds, ds->flags);
+    uint32_t old_events = btstack_run_loop_epoll_events_for_flags(old_flags);
+    uint32_t new_events = btstack_run_loop_epoll_events_for_flags(ds->flags);
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events   = new_events;
+    event.data.ptr = ds;
+
+    int op;
+    if (is_watched){
+        if (was_registered){
+            if (old_events == new_events) return;
+            op = EPOLL_CTL_MOD;
+        } else {
+            op = EPOLL_CTL_ADD;
+        }
+    } else {
+        if (!was_registered) return;
+        op = EPOLL_CTL_DEL;
+    }
+    
+    int res = epoll_ctl(epoll_fd, op, ds->fd, &event);
+    if (res && op == EPOLL_CTL_ADD && errno == EEXIST){
+        // fd is registered by another data source, which would not get dispatched anymore if we took it over
+        log_error("btstack_run_loop_epoll: fd %d already used by another data source, data source %p ignored", ds->fd, ds);
+        return;
+    }
+
+    // recover from stale registration, e.g. fd closed and re-opened without removing data source
+    if (res && op == EPOLL_CTL_MOD && errno == ENOENT){
+        res = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ds->fd, &event);
+    } else if (res && op == EPOLL_CTL_DEL && (errno == ENOENT || errno == EBADF)){
+        // fd already closed, which implicitly removes it from the epoll set
+        res = 0;
+    }
+    if (res){
+        log_error("btstack_run_loop_epoll: epoll_ctl op %u for fd %d failed, errno %d", op, ds->fd, errno);
+    }
+
+    // registration is owned by this data source until it gets deleted
+    if (op == EPOLL_CTL_DEL){
+        ds->flags &= ~DATA_SOURCE_EPOLL_REGISTERED;
+    } else if (res == 0){
+        ds->flags |= DATA_SOURCE_EPOLL_REGISTERED;
+    }
+}
+
+/**
+ * Add data_source to run_loop
+ */
+static void btstack_run_loop_epoll_add_data_source(btstack_data_source_t *ds){
+    // log_info("btstack_run_loop_epoll_add_data_source %x with fd %u\n", (int) ds, ds->fd);
+    uint16_t old_flags = ds->flags & ~DATA_SOURCE_EPOLL_ADDED;
+    ds->flags |= DATA_SOURCE_EPOLL_ADDED;
+    btstack_run_loop_epoll_update(ds, old_flags);
+}
+
+/**
+ * Remove data_source from run loop
+ */
+static int btstack_run_loop_epoll_remove_data_source(btstack_data_source_t *ds){
+    // log_info("btstack_run_loop_epoll_remove_data_source %x\n", (int) ds);
+    uint16_t old_flags = ds->flags;
+    if ((old_flags & DATA_SOURCE_EPOLL_ADDED) == 0) return 0;
+    ds->flags &= ~DATA_SOURCE_EPOLL_ADDED;
+    btstack_run_loop_epoll_update(ds, old_flags);
+
+    // drop pending events for this data source, it might get freed by the caller
+    int i;
+    for (i=0;i<num_ready_events;i++){
+        if (ready_events[i].data.ptr == ds){
+            ready_events[i].data.ptr = NULL;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Add timer to run_loop
+ */
+static void btstack_run_loop_epoll_add_timer(btstack_timer_source_t *ts){
+    btstack_timer_wheel_add(&timers, ts);
+}
+
+/**
+ * Remove timer from run loop
+ */
+static int btstack_run_loop_epoll_remove_timer(btstack_timer_source_t *ts){
+    return btstack_timer_wheel_remove(&timers, ts);
+}
+
+static void btstack_run_loop_epoll_dump_timer(void){
+    btstack_timer_wheel_dump(&timers);
+}
+
+static void btstack_run_loop_epoll_enable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callback_types){
+    uint16_t old_flags = ds->flags;
+    ds->flags |= callback_types;
+    btstack_run_loop_epoll_update(ds, old_flags);
+}
+
+static void btstack_run_loop_epoll_disable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callback_types){
+    uint16_t old_flags = ds->flags;
+    ds->flags &= ~callback_types;
+    btstack_run_loop_epoll_update(ds, old_flags);
+}
+
+/**
+ * @brief Queries the current time in ms since start
+ */
+static uint32_t btstack_run_loop_epoll_get_time_ms(void){
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    uint32_t time_ms = (uint32_t)((tv.tv_sec  - init_tv.tv_sec) * 1000) + (tv.tv_usec / 1000);
+    log_debug("btstack_run_loop_epoll_get_time_ms: %u <- %u / %u", time_ms, (int) tv.tv_sec, (int) tv.tv_usec);
+    return time_ms;
+}
+
+/**
+ * Execute run_loop
+ */
+static void btstack_run_loop_epoll_execute(void) {
+    btstack_timer_source_t *ts;
+    uint32_t now_ms;
+    int i;
+
+    while (1) {
+        // get next timeout
+        int timeout_ms = -1;
+        uint32_t next_timeout_ms;
+        if (btstack_timer_wheel_get_next_timeout(&timers, &next_timeout_ms)) {
+            now_ms = btstack_run_loop_epoll_get_time_ms();
+            int delta = next_timeout_ms - now_ms;
+            if (delta < 0){
+                delta = 0;
+            }
+            timeout_ms = delta;
+            log_debug("btstack_run_loop_execute next timeout in %u ms", delta);
+        }
+
+        // wait for ready FDs
+        int res = epoll_wait(epoll_fd, ready_events, EPOLL_MAX_EVENTS, timeout_ms);
+        num_ready_events = res < 0 ? 0 : res;
+
+        // keep timer wheel current, data source handlers might add timers
+        if (timeout_ms < 0){
+            btstack_timer_wheel_advance(&timers, btstack_run_loop_epoll_get_time_ms());
+        }
+
+        // process ready data sources. level-triggered, so data not consumed by a handler gets reported again
+        for (i=0;i<num_ready_events;i++){
+            uint32_t events = ready_events[i].events;
+            btstack_data_source_t *ds = (btstack_data_source_t*) ready_events[i].data.ptr;
+            if (!ds) continue;
+            // report hangup and errors as readable/writable as select does, the handler will see it on read/write
+            if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && (ds->flags & DATA_SOURCE_CALLBACK_READ)){
+                log_debug("btstack_run_loop_epoll_execute: process read ds %p with fd %u\n", ds, ds->fd);
+                ds->process(ds, DATA_SOURCE_CALLBACK_READ);
+            }
+            // data source removed by read handler?
+            if (ready_events[i].data.ptr == NULL) continue;
+            if ((events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) && (ds->flags & DATA_SOURCE_CALLBACK_WRITE)){
+                log_debug("btstack_run_loop_epoll_execute: process write ds %p with fd %u\n", ds, ds->fd);
+                ds->process(ds, DATA_SOURCE_CALLBACK_WRITE);
+            }
+        }
+        num_ready_events = 0;
+
+        // process timers
+        now_ms = btstack_run_loop_epoll_get_time_ms();
+        // timer is removed before processing it to allow handler to re-register with run loop
+        while ((ts = btstack_timer_wheel_get_expired(&timers, now_ms)) != NULL) {
+            log_debug("btstack_run_loop_epoll_execute: process timer %p\n", ts);
+            ts->process(ts);
+        }
+    }
+}
+
+// set timer
+static void btstack_run_loop_epoll_set_timer(btstack_timer_source_t *a, uint32_t timeout_in_ms){
+    uint32_t time_ms = btstack_run_loop_epoll_get_time_ms();
+    a->timeout = time_ms + timeout_in_ms;
+    log_debug("btstack_run_loop_epoll_set_timer to %u ms (now %u, timeout %u)", a->timeout, time_ms, timeout_in_ms);
+}
+
+static void btstack_run_loop_epoll_init(void){
+    num_ready_events = 0;
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0){
+        log_error("btstack_run_loop_epoll_init: epoll_create1 failed, errno %d", errno);
+    }
+    // just assume that we started at tv_usec == 0
+    gettimeofday(&init_tv, NULL);
+    init_tv.tv_usec = 0;
+    btstack_timer_wheel_init(&timers, btstack_run_loop_epoll_get_time_ms());
+    log_debug("btstack_run_loop_epoll_init at %u/%u", (int) init_tv.tv_sec, 0);
+}
+
+
+static const btstack_run_loop_t btstack_run_loop_epoll = {
+    &btstack_run_loop_epoll_init,
+    &btstack_run_loop_epoll_add_data_source,
+    &btstack_run_loop_epoll_remove_data_source,
+    &btstack_run_loop_epoll_enable_data_source_callbacks,
+    &btstack_run_loop_epoll_disable_data_source_callbacks,
+    &btstack_run_loop_epoll_set_timer,
+    &btstack_run_loop_epoll_add_timer,
+    &btstack_run_loop_epoll_remove_timer,
+    &btstack_run_loop_epoll_execute,
+    &btstack_run_loop_epoll_dump_timer,
+    &btstack_run_loop_epoll_get_time_ms,
+};
+
+/**
+ * Provide btstack_run_loop_epoll instance
+ */
+const btstack_run_loop_t * btstack_run_loop_epoll_get_instance(void){
+    return &btstack_run_loop_epoll;
+}
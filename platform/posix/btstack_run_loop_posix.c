@@ -46,6 +46,7 @@
 #include "btstack_run_loop.h"
 #include "btstack_run_loop_posix.h"
 #include "btstack_linked_list.h"
+#include "btstack_timer_wheel.h"
 #include "btstack_debug.h"
 
 #ifdef _WIN32
@@ -58,12 +59,10 @@
 #include <stdlib.h>
 #include <sys/time.h>
 
-static void btstack_run_loop_posix_dump_timer(void);
-
 // the run loop
 static btstack_linked_list_t data_sources;
 static int data_sources_modified;
-static btstack_linked_list_t timers;
+static btstack_timer_wheel_t timers;
 // start time. tv_usec = 0
 static struct timeval init_tv;
 
@@ -86,42 +85,21 @@ static int btstack_run_loop_posix_remove_data_source(btstack_data_source_t *ds){
 }
 
 /**
- * Add timer to run_loop (keep list sorted)
+ * Add timer to run_loop
  */
 static void btstack_run_loop_posix_add_timer(btstack_timer_source_t *ts){
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) &timers; it->next ; it = it->next){
-        btstack_timer_source_t * next = (btstack_timer_source_t *) it->next;
-        if (next == ts){
-            log_error( "btstack_run_loop_timer_add error: timer to add already in list!");
-            return;
-        }
-        if (next->timeout > ts->timeout) {
-            break;
-        }
-    }
-    ts->item.next = it->next;
-    it->next = (btstack_linked_item_t *) ts;
-    log_debug("Added timer %p at %u\n", ts, ts->timeout);
-    // btstack_run_loop_posix_dump_timer();
+    btstack_timer_wheel_add(&timers, ts);
 }
 
 /**
  * Remove timer from run loop
  */
 static int btstack_run_loop_posix_remove_timer(btstack_timer_source_t *ts){
-    // log_info("Removed timer %x at %u\n", (int) ts, (unsigned int) ts->timeout.tv_sec);
-    // btstack_run_loop_posix_dump_timer();
-    return btstack_linked_list_remove(&timers, (btstack_linked_item_t *) ts);
+    return btstack_timer_wheel_remove(&timers, ts);
 }
 
 static void btstack_run_loop_posix_dump_timer(void){
-    btstack_linked_item_t *it;
-    int i = 0;
-    for (it = (btstack_linked_item_t *) timers; it ; it = it->next){
-        btstack_timer_source_t *ts = (btstack_timer_source_t*) it;
-        log_info("timer %u, timeout %u\n", i, ts->timeout);
-    }
+    btstack_timer_wheel_dump(&timers);
 }
 
 static void btstack_run_loop_posix_enable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callback_types){
@@ -183,11 +161,11 @@ static void btstack_run_loop_posix_execute(void) {
         
         // get next timeout
         timeout = NULL;
-        if (timers) {
-            ts = (btstack_timer_source_t *) timers;
+        uint32_t next_timeout_ms;
+        if (btstack_timer_wheel_get_next_timeout(&timers, &next_timeout_ms)) {
             timeout = &tv;
             now_ms = btstack_run_loop_posix_get_time_ms();
-            int delta = ts->timeout - now_ms;
+            int delta = next_timeout_ms - now_ms;
             if (delta < 0){
                 delta = 0;
             }
@@ -198,7 +176,11 @@ static void btstack_run_loop_posix_execute(void) {
                 
         // wait for ready FDs
         select( highest_fd+1 , &descriptors_read, &descriptors_write, NULL, timeout);
-                
+
+        // keep timer wheel current, data source handlers might add timers
+        if (!timeout){
+            btstack_timer_wheel_advance(&timers, btstack_run_loop_posix_get_time_ms());
+        }
 
         data_sources_modified = 0;
         btstack_linked_list_iterator_init(&it, &data_sources);
@@ -218,13 +200,9 @@ static void btstack_run_loop_posix_execute(void) {
         
         // process timers
         now_ms = btstack_run_loop_posix_get_time_ms();
-        while (timers) {
-            ts = (btstack_timer_source_t *) timers;
-            if (ts->timeout > now_ms) break;
+        // timer is removed before processing it to allow handler to re-register with run loop
+        while ((ts = btstack_timer_wheel_get_expired(&timers, now_ms)) != NULL) {
             log_debug("btstack_run_loop_posix_execute: process timer %p\n", ts);
-            
-            // remove timer before processing it to allow handler to re-register with run loop
-            btstack_run_loop_posix_remove_timer(ts);
             ts->process(ts);
         }
     }
@@ -239,10 +217,10 @@ static void btstack_run_loop_posix_set_timer(btstack_timer_source_t *a, uint32_t
 
 static void btstack_run_loop_posix_init(void){
     data_sources = NULL;
-    timers = NULL;
     // just assume that we started at tv_usec == 0
     gettimeofday(&init_tv, NULL);
     init_tv.tv_usec = 0;
+    btstack_timer_wheel_init(&timers, btstack_run_loop_posix_get_time_ms());
     log_debug("btstack_run_loop_posix_init at %u/%u", (int) init_tv.tv_sec, 0);
 }
 
@@ -72,9 +72,13 @@ static const uint8_t * write_bytes_data;
 static uint16_t  read_bytes_len;
 static uint8_t * read_bytes_data;
 
+// streaming read: return after first read instead of waiting for read_bytes_len bytes
+static int       read_stream;
+
 // callbacks
 static void (*block_sent)(void);
 static void (*block_received)(void);
+static void (*stream_received)(uint16_t len);
 
 
 static int btstack_uart_posix_init(const btstack_uart_config_t * config){
@@ -133,6 +137,20 @@ static void btstack_uart_posix_process_read(btstack_data_source_t *ds) {
         log_info("h4_process: read took %u ms", end - start);
     }
     if (bytes_read < 0) return;
+
+    if (read_stream){
+        if (bytes_read == 0) return;
+        // keep read callback enabled as handler usually requests more data right away
+        read_bytes_len = 0;
+        read_stream = 0;
+        if (stream_received){
+            stream_received((uint16_t) bytes_read);
+        }
+        if (read_bytes_len == 0){
+            btstack_run_loop_disable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_READ);
+        }
+        return;
+    }
     
     read_bytes_len   -= bytes_read;
     read_bytes_data  += bytes_read;
@@ -324,6 +342,10 @@ static void btstack_uart_posix_set_block_sent( void (*block_handler)(void)){
     block_sent = block_handler;
 }
 
+static void btstack_uart_posix_set_stream_received( void (*stream_handler)(uint16_t len)){
+    stream_received = stream_handler;
+}
+
 static int btstack_uart_posix_set_parity(int parity){
 
     int fd = transport_data_source.fd;
@@ -358,12 +380,20 @@ static void btstack_uart_posix_send_block(const uint8_t *data, uint16_t size){
 static void btstack_uart_posix_receive_block(uint8_t *buffer, uint16_t len){
     read_bytes_data = buffer;
     read_bytes_len = len;
+    read_stream = 0;
     btstack_run_loop_enable_data_source_callbacks(&transport_data_source, DATA_SOURCE_CALLBACK_READ);
 
     // go
     // btstack_uart_posix_process_read(&transport_data_source);
 }
 
+static void btstack_uart_posix_receive_stream(uint8_t *buffer, uint16_t len){
+    read_bytes_data = buffer;
+    read_bytes_len = len;
+    read_stream = 1;
+    btstack_run_loop_enable_data_source_callbacks(&transport_data_source, DATA_SOURCE_CALLBACK_READ);
+}
+
 // static void btstack_uart_posix_set_sleep(uint8_t sleep){
 // }
 // static void btstack_uart_posix_set_csr_irq_handler( void (*csr_irq_handler)(void)){
@@ -382,6 +412,8 @@ static const btstack_uart_block_t btstack_uart_posix = {
     /* int (*get_supported_sleep_modes); */                           NULL,
     /* void (*set_sleep)(btstack_uart_sleep_mode_t sleep_mode); */    NULL,
     /* void (*set_wakeup_handler)(void (*handler)(void)); */          NULL,
+    /* void (*set_stream_received)(void (*handler)(uint16_t len)); */ &btstack_uart_posix_set_stream_received,
+    /* void (*receive_stream)(uint8_t *buffer, uint16_t len); */      &btstack_uart_posix_receive_stream,
 };
 
 const btstack_uart_block_t * btstack_uart_block_posix_instance(void){
@@ -39,11 +39,15 @@
  
 #include <stdio.h>
 #include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include "btstack_config.h"
 #include "btstack_debug.h"
 #include "ble/le_device_db.h"
 #include "ble/core.h"
+#include "btstack_util.h"
 
 // Central Device db implemenation using static memory
 typedef struct le_device_memory_db {
@@ -85,13 +89,47 @@ typedef struct le_device_memory_db {
 #endif
 #endif
 
-#define DB_PATH_TEMPLATE (LE_DEVICE_DB_PATH "btstack_at_%s_le_device_db.txt")
+// journal gets compacted into a snapshot of all devices when it grows beyond this size
+#ifndef LE_DEVICE_DB_FS_JOURNAL_MAX_SIZE
+#define LE_DEVICE_DB_FS_JOURNAL_MAX_SIZE 65536
+#endif
+
+#define DB_PATH_TEMPLATE        (LE_DEVICE_DB_PATH "btstack_at_%s_le_device_db.bin")
+#define DB_LEGACY_PATH_TEMPLATE (LE_DEVICE_DB_PATH "btstack_at_%s_le_device_db.txt")
+
+// Journal file format:
+// - header: 'B', 'T', 'L', 'E', version
+// - records: type, device index, payload len, payload, CRC-32 over type..payload (little endian)
+// Records are only appended and synced to disk before the update returns (not on Windows, where they are only flushed).
+// On read, the journal is replayed until the first incomplete or corrupt record. A damaged journal is then
+// replaced by a snapshot of the replayed state, so that later records are not appended after the damaged one.
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 5
+#define JOURNAL_RECORD_OVERHEAD 7
+
+#define JOURNAL_RECORD_DEVICE          1
+#define JOURNAL_RECORD_REMOVE          2
+#define JOURNAL_RECORD_REMOTE_COUNTER  3
+#define JOURNAL_RECORD_LOCAL_COUNTER   4
+
+// addr_type, addr, irk, ltk, ediv, rand, key_size, authenticated, authorized
+#define DEVICE_RECORD_BASE_SIZE   (1 + 6 + 16 + 16 + 2 + 8 + 1 + 1 + 1)
+// remote_csrk, remote_counter, local_csrk, local_counter
+#define DEVICE_RECORD_SIGNED_SIZE (16 + 4 + 16 + 4)
+#define DEVICE_RECORD_MAX_SIZE    (DEVICE_RECORD_BASE_SIZE + DEVICE_RECORD_SIGNED_SIZE)
+
+static const uint8_t journal_header[JOURNAL_HEADER_SIZE] = { 'B', 'T', 'L', 'E', JOURNAL_VERSION };
 
-const  char * csv_header = "# addr_type, addr, irk, ltk, ediv, rand[8], key_size, authenticated, authorized, remote_csrk, remote_counter, local_csrk, local_counter";
 static char db_path[sizeof(DB_PATH_TEMPLATE) - 2 + 17 + 1];
+static char db_legacy_path[sizeof(DB_LEGACY_PATH_TEMPLATE) - 2 + 17 + 1];
+static char db_tmp_path[sizeof(DB_PATH_TEMPLATE) - 2 + 17 + 4 + 1];
 
 static le_device_memory_db_t le_devices[LE_DEVICE_MEMORY_SIZE];
 
+// journal opened for appending, NULL until first update
+static FILE *   journal_file;
+static uint32_t journal_size;
+
 static char bd_addr_to_dash_str_buffer[6*3];  // 12-45-78-01-34-67\0
 static char * bd_addr_to_dash_str(bd_addr_t addr){
     char * p = bd_addr_to_dash_str_buffer;
@@ -105,70 +143,241 @@ static char * bd_addr_to_dash_str(bd_addr_t addr){
     return (char *) bd_addr_to_dash_str_buffer;
 }
 
-static inline void write_delimiter(FILE * wFile){
-    fwrite(", ", 1, 1, wFile);
+static int device_record_serialize(int index, uint8_t * buffer){
+    le_device_memory_db_t * device = &le_devices[index];
+    int pos = 0;
+    buffer[pos++] = device->addr_type;
+    memcpy(&buffer[pos], device->addr, 6);
+    pos += 6;
+    memcpy(&buffer[pos], device->irk, 16);
+    pos += 16;
+    memcpy(&buffer[pos], device->ltk, 16);
+    pos += 16;
+    little_endian_store_16(buffer, pos, device->ediv);
+    pos += 2;
+    memcpy(&buffer[pos], device->rand, 8);
+    pos += 8;
+    buffer[pos++] = device->key_size;
+    buffer[pos++] = device->authenticated;
+    buffer[pos++] = device->authorized;
+#ifdef ENABLE_LE_SIGNED_WRITE
+    memcpy(&buffer[pos], device->remote_csrk, 16);
+    pos += 16;
+    little_endian_store_32(buffer, pos, device->remote_counter);
+    pos += 4;
+    memcpy(&buffer[pos], device->local_csrk, 16);
+    pos += 16;
+    little_endian_store_32(buffer, pos, device->local_counter);
+    pos += 4;
+#endif
+    return pos;
+}
+
+static void device_record_deserialize(int index, const uint8_t * buffer, int len){
+    le_device_memory_db_t * device = &le_devices[index];
+    memset(device, 0, sizeof(le_device_memory_db_t));
+    int pos = 0;
+    device->addr_type = buffer[pos++];
+    memcpy(device->addr, &buffer[pos], 6);
+    pos += 6;
+    memcpy(device->irk, &buffer[pos], 16);
+    pos += 16;
+    memcpy(device->ltk, &buffer[pos], 16);
+    pos += 16;
+    device->ediv = little_endian_read_16(buffer, pos);
+    pos += 2;
+    memcpy(device->rand, &buffer[pos], 8);
+    pos += 8;
+    device->key_size      = buffer[pos++];
+    device->authenticated = buffer[pos++];
+    device->authorized    = buffer[pos++];
+#ifdef ENABLE_LE_SIGNED_WRITE
+    // signing information is missing if journal was written without ENABLE_LE_SIGNED_WRITE
+    if (len < DEVICE_RECORD_MAX_SIZE) return;
+    memcpy(device->remote_csrk, &buffer[pos], 16);
+    pos += 16;
+    device->remote_counter = little_endian_read_32(buffer, pos);
+    pos += 4;
+    memcpy(device->local_csrk, &buffer[pos], 16);
+    pos += 16;
+    device->local_counter = little_endian_read_32(buffer, pos);
+#else
+    UNUSED(len);
+#endif
+}
+
+// @returns record size
+static int journal_record_create(uint8_t * record, uint8_t type, int index, const uint8_t * payload, int payload_len){
+    record[0] = type;
+    record[1] = index;
+    record[2] = payload_len;
+    if (payload_len) memcpy(&record[3], payload, payload_len);
+    little_endian_store_32(record, 3 + payload_len, btstack_crc32(record, 3 + payload_len));
+    return JOURNAL_RECORD_OVERHEAD + payload_len;
 }
-static inline void write_hex_byte(FILE * wFile, uint8_t value){
-    char buffer[2];
-    buffer[0] = char_for_nibble(value >>   4);
-    buffer[1] = char_for_nibble(value & 0x0f);
-    fwrite(buffer, 2, 1, wFile);
+
+static int journal_write_device(FILE * wFile, int index){
+    uint8_t payload[DEVICE_RECORD_MAX_SIZE];
+    uint8_t record[JOURNAL_RECORD_OVERHEAD + DEVICE_RECORD_MAX_SIZE];
+    int payload_len = device_record_serialize(index, payload);
+    int record_len  = journal_record_create(record, JOURNAL_RECORD_DEVICE, index, payload, payload_len);
+    if (fwrite(record, record_len, 1, wFile) != 1) return 0;
+    return record_len;
 }
 
-static inline void write_str(FILE * wFile, const char * str){
-    fwrite(str, strlen(str), 1, wFile);
-    write_delimiter(wFile);
+static void journal_close(void){
+    if (journal_file == NULL) return;
+    fclose(journal_file);
+    journal_file = NULL;
 }
-static void write_hex(FILE * wFile, const uint8_t * value, int len){
+
+// write snapshot of all devices to temp file and replace journal with it
+static void journal_compact(void){
+    journal_close();
+    FILE * wFile = fopen(db_tmp_path, "wb");
+    if (wFile == NULL) {
+        log_error("le_device_db_fs: cannot create %s", db_tmp_path);
+        return;
+    }
+    uint32_t size = 0;
+    int ok = fwrite(journal_header, sizeof(journal_header), 1, wFile) == 1;
+    size += sizeof(journal_header);
     int i;
-    for (i = 0; i < len; i++){
-        write_hex_byte(wFile, value[i]);
+    for (i=0;i<LE_DEVICE_MEMORY_SIZE && ok;i++){
+        if (le_devices[i].addr_type == INVALID_ENTRY_ADDR_TYPE) continue;
+        int record_len = journal_write_device(wFile, i);
+        ok = record_len > 0;
+        size += record_len;
+    }
+    if (fflush(wFile) != 0) ok = 0;
+#ifndef _WIN32
+    if (fsync(fileno(wFile)) != 0) ok = 0;
+#endif
+    fclose(wFile);
+    if (!ok){
+        log_error("le_device_db_fs: writing snapshot failed");
+        remove(db_tmp_path);
+        return;
+    }
+#ifdef _WIN32
+    // rename does not replace existing files on Windows
+    remove(db_path);
+#endif
+    if (rename(db_tmp_path, db_path) != 0){
+        log_error("le_device_db_fs: cannot replace %s", db_path);
+        remove(db_tmp_path);
+        return;
+    }
+    journal_file = fopen(db_path, "ab");
+    journal_size = size;
+}
+
+static void journal_append(const uint8_t * record, int record_len){
+    if (journal_file == NULL || journal_size + record_len > LE_DEVICE_DB_FS_JOURNAL_MAX_SIZE){
+        // compaction stores current state including this update
+        journal_compact();
+        return;
     }
-    write_delimiter(wFile);
-}
-static void write_value(FILE * wFile, uint32_t value, int len){
-    switch (len){
-        case 4:
-            write_hex_byte(wFile, value >> 24);
-        case 3:
-            write_hex_byte(wFile, value >> 16);
-        case 2:
-            write_hex_byte(wFile, value >> 8);
-        case 1:
+    int ok = fwrite(record, record_len, 1, journal_file) == 1 && fflush(journal_file) == 0;
+#ifndef _WIN32
+    if (ok && fsync(fileno(journal_file)) != 0) ok = 0;
+#endif
+    if (!ok){
+        log_error("le_device_db_fs: append failed");
+        journal_compact();
+        return;
+    }
+    journal_size += record_len;
+}
+
+static void journal_append_device(int index){
+    uint8_t payload[DEVICE_RECORD_MAX_SIZE];
+    uint8_t record[JOURNAL_RECORD_OVERHEAD + DEVICE_RECORD_MAX_SIZE];
+    int payload_len = device_record_serialize(index, payload);
+    journal_append(record, journal_record_create(record, JOURNAL_RECORD_DEVICE, index, payload, payload_len));
+}
+
+static void journal_append_remove(int index){
+    uint8_t record[JOURNAL_RECORD_OVERHEAD];
+    journal_append(record, journal_record_create(record, JOURNAL_RECORD_REMOVE, index, NULL, 0));
+}
+
+#ifdef ENABLE_LE_SIGNED_WRITE
+static void journal_append_counter(uint8_t type, int index, uint32_t counter){
+    uint8_t payload[4];
+    uint8_t record[JOURNAL_RECORD_OVERHEAD + 4];
+    little_endian_store_32(payload, 0, counter);
+    journal_append(record, journal_record_create(record, type, index, payload, 4));
+}
+#endif
+
+static void journal_apply_record(uint8_t type, int index, const uint8_t * payload, int payload_len){
+    switch (type){
+        case JOURNAL_RECORD_DEVICE:
+            if (payload_len < DEVICE_RECORD_BASE_SIZE) break;
+            device_record_deserialize(index, payload, payload_len);
+            break;
+        case JOURNAL_RECORD_REMOVE:
+            le_devices[index].addr_type = INVALID_ENTRY_ADDR_TYPE;
+            break;
+#ifdef ENABLE_LE_SIGNED_WRITE
+        case JOURNAL_RECORD_REMOTE_COUNTER:
+            if (payload_len < 4) break;
+            le_devices[index].remote_counter = little_endian_read_32(payload, 0);
+            break;
+        case JOURNAL_RECORD_LOCAL_COUNTER:
+            if (payload_len < 4) break;
+            le_devices[index].local_counter = little_endian_read_32(payload, 0);
+            break;
+#endif
         default:
-            write_hex_byte(wFile, value);
+            break;
     }
-    write_delimiter(wFile);
 }
 
-static void le_device_db_store(void) {
+// @returns 1 if journal was replayed completely, 0 if it doesn't exist or is damaged
+static int journal_read(void){
+    FILE * rFile = fopen(db_path, "rb");
+    if (rFile == NULL) return 0;
+
+    uint8_t record[JOURNAL_RECORD_OVERHEAD + 255];
+    if (fread(record, JOURNAL_HEADER_SIZE, 1, rFile) != 1 || memcmp(record, journal_header, JOURNAL_HEADER_SIZE) != 0){
+        log_error("le_device_db_fs: %s is not a valid journal", db_path);
+        fclose(rFile);
+        return 0;
+    }
+
     int i;
-    // open file
-    FILE * wFile = fopen(db_path,"w+");
-    if (wFile == NULL) return;
-    fwrite(csv_header, strlen(csv_header), 1, wFile);
-    fwrite("\n", 1, 1, wFile);
     for (i=0;i<LE_DEVICE_MEMORY_SIZE;i++){
-        if (le_devices[i].addr_type == INVALID_ENTRY_ADDR_TYPE) continue;
-        write_value(wFile, le_devices[i].addr_type, 1);
-        write_str(wFile,   bd_addr_to_str(le_devices[i].addr));
-        write_hex(wFile,   le_devices[i].irk, 16);
-        write_hex(wFile,   le_devices[i].ltk, 16);
-        write_value(wFile, le_devices[i].ediv, 2);
-        write_hex(wFile,   le_devices[i].rand, 8);
-        write_value(wFile, le_devices[i].key_size, 1);
-        write_value(wFile, le_devices[i].authenticated, 1);
-        write_value(wFile, le_devices[i].authorized, 1);
-#ifdef ENABLE_LE_SIGNED_WRITE
-        write_hex(wFile,   le_devices[i].remote_csrk, 16);
-        write_value(wFile, le_devices[i].remote_counter, 2);
-        write_hex(wFile,   le_devices[i].local_csrk, 16);
-        write_value(wFile, le_devices[i].local_counter, 2);
-#endif
-        fwrite("\n", 1, 1, wFile);
+        le_devices[i].addr_type = INVALID_ENTRY_ADDR_TYPE;
     }
-    fclose(wFile);
+
+    int complete = 0;
+    int num_records = 0;
+    while (1){
+        // end of journal only if no byte of a further record was written
+        size_t header_len = fread(record, 1, 3, rFile);
+        if (header_len == 0 && feof(rFile)){
+            complete = 1;
+            break;
+        }
+        if (header_len != 3) break;
+        int payload_len = record[2];
+        if (fread(&record[3], payload_len + 4, 1, rFile) != 1) break;
+        if (little_endian_read_32(record, 3 + payload_len) != btstack_crc32(record, 3 + payload_len)) break;
+        if (record[1] >= LE_DEVICE_MEMORY_SIZE) break;
+        journal_apply_record(record[0], record[1], &record[3], payload_len);
+        num_records++;
+    }
+    fclose(rFile);
+    log_info("le_device_db_fs: replayed %u records", num_records);
+    if (!complete){
+        log_error("le_device_db_fs: ignoring incomplete or corrupt journal records after record %u", num_records);
+    }
+    return complete;
 }
+
+// read CSV file written by earlier versions
 static void read_delimiter(FILE * wFile){
     fgetc(wFile);
 }
@@ -200,10 +409,12 @@ static uint32_t read_value(FILE * wFile, int len){
     return res;
 }
 
-static void le_device_db_read(void){
+// @returns 1 if legacy file was read
+static int le_device_db_read_legacy(void){
     // open file
-    FILE * wFile = fopen(db_path,"r");
-    if (wFile == NULL) return;
+    FILE * wFile = fopen(db_legacy_path,"r");
+    if (wFile == NULL) return 0;
+    log_info("le_device_db_fs: migrating %s", db_legacy_path);
     // skip header
     while (1) {
         int c = fgetc(wFile);
@@ -233,6 +444,32 @@ static void le_device_db_read(void){
     }
 exit:
     fclose(wFile);
+    return 1;
+}
+
+static void le_device_db_set_path(const char * addr_str){
+    journal_close();
+    sprintf(db_path, DB_PATH_TEMPLATE, addr_str);
+    sprintf(db_legacy_path, DB_LEGACY_PATH_TEMPLATE, addr_str);
+    sprintf(db_tmp_path, "%s.tmp", db_path);
+}
+
+static void le_device_db_read(void){
+    if (journal_read()) {
+        journal_file = fopen(db_path, "ab");
+        if (journal_file == NULL) return;
+        fseek(journal_file, 0, SEEK_END);
+        journal_size = (uint32_t) ftell(journal_file);
+        return;
+    }
+    // journal damaged or not existing yet, try legacy CSV file and store current state as new snapshot
+    FILE * rFile = fopen(db_path, "rb");
+    if (rFile){
+        fclose(rFile);
+    } else if (!le_device_db_read_legacy()){
+        return;
+    }
+    journal_compact();
 }
 
 void le_device_db_init(void){
@@ -240,11 +477,11 @@ void le_device_db_init(void){
     for (i=0;i<LE_DEVICE_MEMORY_SIZE;i++){
         le_devices[i].addr_type = INVALID_ENTRY_ADDR_TYPE;
     }
-    sprintf(db_path, DB_PATH_TEMPLATE, "00-00-00-00-00-00");
+    le_device_db_set_path("00-00-00-00-00-00");
 }
 
 void le_device_db_set_local_bd_addr(bd_addr_t addr){
-    sprintf(db_path, DB_PATH_TEMPLATE, bd_addr_to_dash_str(addr));
+    le_device_db_set_path(bd_addr_to_dash_str(addr));
     log_info("le_device_db_fs: path %s", db_path);
     le_device_db_read();
     le_device_db_dump();
@@ -263,7 +500,7 @@ int le_device_db_count(void){
 // free device
 void le_device_db_remove(int index){
     le_devices[index].addr_type = INVALID_ENTRY_ADDR_TYPE;
-    le_device_db_store();
+    journal_append_remove(index);
 }
 
 int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
@@ -287,7 +524,7 @@ int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
 #ifdef ENABLE_LE_SIGNED_WRITE
     le_devices[index].remote_counter = 0; 
 #endif
-    le_device_db_store();
+    journal_append_device(index);
 
     return index;
 }
@@ -311,7 +548,7 @@ void le_device_db_encryption_set(int index, uint16_t ediv, uint8_t rand[8], sm_k
     device->authenticated = authenticated;
     device->authorized = authorized;
 
-    le_device_db_store();
+    journal_append_device(index);
 }
 
 void le_device_db_encryption_get(int index, uint16_t * ediv, uint8_t rand[8], sm_key_t ltk, int * key_size, int * authenticated, int * authorized){
@@ -344,7 +581,7 @@ void le_device_db_remote_csrk_set(int index, sm_key_t csrk){
     }
     if (csrk) memcpy(le_devices[index].remote_csrk, csrk, 16);
 
-    le_device_db_store();
+    journal_append_device(index);
 }
 
 void le_device_db_local_csrk_get(int index, sm_key_t csrk){
@@ -362,7 +599,7 @@ void le_device_db_local_csrk_set(int index, sm_key_t csrk){
     }
     if (csrk) memcpy(le_devices[index].local_csrk, csrk, 16);
 
-    le_device_db_store();
+    journal_append_device(index);
 }
 
 // query last used/seen signing counter
@@ -374,7 +611,7 @@ uint32_t le_device_db_remote_counter_get(int index){
 void le_device_db_remote_counter_set(int index, uint32_t counter){
     le_devices[index].remote_counter = counter;
 
-    le_device_db_store();
+    journal_append_counter(JOURNAL_RECORD_REMOTE_COUNTER, index, counter);
 }
 
 // query last used/seen signing counter
@@ -386,7 +623,7 @@ uint32_t le_device_db_local_counter_get(int index){
 void le_device_db_local_counter_set(int index, uint32_t counter){
     le_devices[index].local_counter = counter;
 
-    le_device_db_store();
+    journal_append_counter(JOURNAL_RECORD_LOCAL_COUNTER, index, counter);
 }
 #endif
 
@@ -49,6 +49,7 @@
 #include <stddef.h> // NULL
 
 #include "btstack_linked_list.h"
+#include "btstack_timer_wheel.h"
 #include "btstack_debug.h"
 #include "btstack_run_loop.h"
 #include "btstack_run_loop_wiced.h"
@@ -63,7 +64,7 @@ static const btstack_run_loop_t btstack_run_loop_wiced;
 static wiced_queue_t btstack_run_loop_queue;
 
 // the run loop
-static btstack_linked_list_t timers;
+static btstack_timer_wheel_t timers;
 
 static uint32_t btstack_run_loop_wiced_get_time_ms(void){
     wiced_time_t time;
@@ -77,39 +78,22 @@ static void btstack_run_loop_wiced_set_timer(btstack_timer_source_t *ts, uint32_
 }
 
 /**
- * Add timer to run_loop (keep list sorted)
+ * Add timer to run_loop
  */
 static void btstack_run_loop_wiced_add_timer(btstack_timer_source_t *ts){
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) &timers; it->next ; it = it->next){
-        // don't add timer that's already in there
-        if ((btstack_timer_source_t *) it->next == ts){
-            log_error( "btstack_run_loop_timer_add error: timer to add already in list!");
-            return;
-        }
-        if (ts->timeout < ((btstack_timer_source_t *) it->next)->timeout) {
-            break;
-        }
-    }
-    ts->item.next = it->next;
-    it->next = (btstack_linked_item_t *) ts;
+    btstack_timer_wheel_add(&timers, ts);
 }
 
 /**
  * Remove timer from run loop
  */
 static int btstack_run_loop_wiced_remove_timer(btstack_timer_source_t *ts){
-    return btstack_linked_list_remove(&timers, (btstack_linked_item_t *) ts);
+    return btstack_timer_wheel_remove(&timers, ts);
 }
 
 static void btstack_run_loop_wiced_dump_timer(void){
 #ifdef ENABLE_LOG_INFO 
-    btstack_linked_item_t *it;
-    int i = 0;
-    for (it = (btstack_linked_item_t *) timers; it ; it = it->next){
-        btstack_timer_source_t *ts = (btstack_timer_source_t*) it;
-        log_info("timer %u, timeout %u\n", i, (unsigned int) ts->timeout);
-    }
+    btstack_timer_wheel_dump(&timers);
 #endif
 }
 
@@ -128,17 +112,18 @@ static void btstack_run_loop_wiced_execute(void) {
     while (1) {
         // get next timeout
         uint32_t timeout_ms = WICED_NEVER_TIMEOUT;
-        if (timers) {
-            btstack_timer_source_t * ts = (btstack_timer_source_t *) timers;
-            uint32_t now = btstack_run_loop_wiced_get_time_ms();
-            if (ts->timeout < now){
-                // remove timer before processing it to allow handler to re-register with run loop
-                btstack_run_loop_wiced_remove_timer(ts);
-                // printf("RL: timer %p\n", ts->process);
-                ts->process(ts);
-                continue;
-            }
-            timeout_ms = ts->timeout - now;
+        uint32_t now = btstack_run_loop_wiced_get_time_ms();
+        // timer is removed before processing it to allow handler to re-register with run loop
+        btstack_timer_source_t * ts = btstack_timer_wheel_get_expired(&timers, now);
+        if (ts){
+            // printf("RL: timer %p\n", ts->process);
+            ts->process(ts);
+            continue;
+        }
+        uint32_t next_timeout;
+        if (btstack_timer_wheel_get_next_timeout(&timers, &next_timeout)){
+            int32_t delta = next_timeout - now;
+            timeout_ms = delta > 0 ? delta : 0;
         }
                 
         // pop function call
@@ -149,11 +134,16 @@ static void btstack_run_loop_wiced_execute(void) {
             // printf("RL: execute %p\n", message.fn);
             message.fn(message.arg);
         }
+
+        // keep timer wheel current, function calls might add timers
+        if (timeout_ms == WICED_NEVER_TIMEOUT){
+            btstack_timer_wheel_advance(&timers, btstack_run_loop_wiced_get_time_ms());
+        }
     }
 }
 
 static void btstack_run_loop_wiced_btstack_run_loop_init(void){
-    timers = NULL;
+    btstack_timer_wheel_init(&timers, btstack_run_loop_wiced_get_time_ms());
 
     // queue to receive events: up to 2 calls from transport, up to 3 for app
     wiced_rtos_init_queue(&btstack_run_loop_queue, "BTstack Run Loop", sizeof(function_call_t), 5);
@@ -377,6 +377,8 @@ static const btstack_uart_block_t btstack_uart_block_wiced = {
     /* int (*get_supported_sleep_modes); */                           NULL,
     /* void (*set_sleep)(btstack_uart_sleep_mode_t sleep_mode); */    NULL,
     /* void (*set_wakeup_handler)(void (*handler)(void)); */          NULL,
+    /* void (*set_stream_received)(void (*handler)(uint16_t len)); */ NULL,
+    /* void (*receive_stream)(uint8_t *buffer, uint16_t len); */      NULL,
 };
 
 const btstack_uart_block_t * btstack_uart_block_wiced_instance(void){
@@ -44,6 +44,7 @@
 #include "btstack_run_loop.h"
 #include "btstack_run_loop_windows.h"
 #include "btstack_linked_list.h"
+#include "btstack_timer_wheel.h"
 #include "btstack_debug.h"
 #include <Windows.h>
 
@@ -51,12 +52,10 @@
 #include <stdlib.h>
 #include <sys/time.h>
 
-static void btstack_run_loop_windows_dump_timer(void);
-
 // the run loop
 static btstack_linked_list_t data_sources;
 static int data_sources_modified;
-static btstack_linked_list_t timers;
+static btstack_timer_wheel_t timers;
 // start time. 
 static ULARGE_INTEGER start_time;
 
@@ -79,42 +78,21 @@ static int btstack_run_loop_windows_remove_data_source(btstack_data_source_t *ds
 }
 
 /**
- * Add timer to run_loop (keep list sorted)
+ * Add timer to run_loop
  */
 static void btstack_run_loop_windows_add_timer(btstack_timer_source_t *ts){
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) &timers; it->next ; it = it->next){
-        btstack_timer_source_t * next = (btstack_timer_source_t *) it->next;
-        if (next == ts){
-            log_error( "btstack_run_loop_timer_add error: timer to add already in list!");
-            return;
-        }
-        if (next->timeout > ts->timeout) {
-            break;
-        }
-    }
-    ts->item.next = it->next;
-    it->next = (btstack_linked_item_t *) ts;
-    log_debug("Added timer %p at %u\n", ts, ts->timeout);
-    // btstack_run_loop_windows_dump_timer();
+    btstack_timer_wheel_add(&timers, ts);
 }
 
 /**
  * Remove timer from run loop
  */
 static int btstack_run_loop_windows_remove_timer(btstack_timer_source_t *ts){
-    // log_info("Removed timer %x at %u\n", (int) ts, (unsigned int) ts->timeout.tv_sec);
-    // btstack_run_loop_windows_dump_timer();
-    return btstack_linked_list_remove(&timers, (btstack_linked_item_t *) ts);
+    return btstack_timer_wheel_remove(&timers, ts);
 }
 
 static void btstack_run_loop_windows_dump_timer(void){
-    btstack_linked_item_t *it;
-    int i = 0;
-    for (it = (btstack_linked_item_t *) timers; it ; it = it->next){
-        btstack_timer_source_t *ts = (btstack_timer_source_t*) it;
-        log_info("timer %u, timeout %u\n", i, ts->timeout);
-    }
+    btstack_timer_wheel_dump(&timers);
 }
 
 static void btstack_run_loop_windows_enable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callback_types){
@@ -168,13 +146,14 @@ static void btstack_run_loop_windows_execute(void) {
 
         // get next timeout
         uint32_t timeout_ms = INFINITE;
-        if (timers) {
-            ts = (btstack_timer_source_t *) timers;
+        uint32_t next_timeout_ms;
+        if (btstack_timer_wheel_get_next_timeout(&timers, &next_timeout_ms)) {
             uint32_t now_ms = btstack_run_loop_windows_get_time_ms();
-            timeout_ms = ts->timeout - now_ms;
-            if (timeout_ms < 0){
-                timeout_ms = 0;
+            int delta = next_timeout_ms - now_ms;
+            if (delta < 0){
+                delta = 0;
             }
+            timeout_ms = delta;
             log_debug("btstack_run_loop_execute next timeout in %u ms", timeout_ms);
         }
         
@@ -187,6 +166,11 @@ static void btstack_run_loop_windows_execute(void) {
             Sleep(timeout_ms);
             res = WAIT_TIMEOUT;
         }
+
+        // keep timer wheel current, data source handlers might add timers
+        if (timeout_ms == INFINITE){
+            btstack_timer_wheel_advance(&timers, btstack_run_loop_windows_get_time_ms());
+        }
         
         // process data source
         if (WAIT_OBJECT_0 <= res && res < (WAIT_OBJECT_0 + num_handles)){
@@ -210,13 +194,9 @@ static void btstack_run_loop_windows_execute(void) {
 
         // process timers
         uint32_t now_ms = btstack_run_loop_windows_get_time_ms();
-        while (timers) {
-            ts = (btstack_timer_source_t *) timers;
-            if (ts->timeout > now_ms) break;
+        // timer is removed before processing it to allow handler to re-register with run loop
+        while ((ts = btstack_timer_wheel_get_expired(&timers, now_ms)) != NULL) {
             log_debug("btstack_run_loop_windows_execute: process timer %p\n", ts);
-            
-            // remove timer before processing it to allow handler to re-register with run loop
-            btstack_run_loop_windows_remove_timer(ts);
             ts->process(ts);
         }
     }
@@ -231,7 +211,6 @@ static void btstack_run_loop_windows_set_timer(btstack_timer_source_t *a, uint32
 
 static void btstack_run_loop_windows_init(void){
     data_sources = NULL;
-    timers = NULL;
 
     // store start time
     FILETIME    file_time;
@@ -241,6 +220,8 @@ static void btstack_run_loop_windows_init(void){
     start_time.LowPart =  file_time.dwLowDateTime;
     start_time.HighPart = file_time.dwHighDateTime;
 
+    btstack_timer_wheel_init(&timers, btstack_run_loop_windows_get_time_ms());
+
     log_debug("btstack_run_loop_windows_init");
 }
 
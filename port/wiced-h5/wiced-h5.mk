@@ -44,6 +44,7 @@ $(NAME)_SOURCES += \
 	../../src/btstack_memory.c            \
 	../../src/btstack_memory_pool.c       \
 	../../src/btstack_run_loop.c          \
+	../../src/btstack_timer_wheel.c       \
 	../../src/btstack_util.c              \
 	../../src/btstack_slip.c              \
 	../../src/hci.c                       \
@@ -73,10 +73,24 @@ static uint16_t att_prepare_write_error_handle = 0x0000;
 
 static btstack_linked_list_t service_handlers;
 
+#ifdef MAX_NR_ATT_DB_INDEX_ENTRIES
+// offsets of attributes in handle order, and positions of attributes sorted by UUID16 and handle
+static uint16_t att_db_index_offsets[MAX_NR_ATT_DB_INDEX_ENTRIES];
+static uint16_t att_db_index_uuid16_positions[MAX_NR_ATT_DB_INDEX_ENTRIES];
+static uint16_t att_db_index_size;          // 0 if no index
+static uint16_t att_db_index_end_offset;    // offset of end marker
+static uint16_t att_db_index_first_handle;
+static int      att_db_index_contiguous;    // handles are first_handle, first_handle + 1, ...
+#endif
+
 // new java-style iterator
 typedef struct att_iterator {
     // private
     uint8_t const * att_ptr;
+#ifdef MAX_NR_ATT_DB_INDEX_ENTRIES
+    uint16_t uuid16_filter;                 // if set, only attributes with this UUID16 are returned
+    uint16_t uuid16_pos;                    // next position in att_db_index_uuid16_positions
+#endif
     // public
     uint16_t size;
     uint16_t flags;
@@ -88,13 +102,165 @@ typedef struct att_iterator {
 
 static void att_iterator_init(att_iterator_t *it){
     it->att_ptr = att_db;
+#ifdef MAX_NR_ATT_DB_INDEX_ENTRIES
+    it->uuid16_filter = 0;
+#endif
 }
 
 static int att_iterator_has_next(att_iterator_t *it){
     return it->att_ptr != NULL;
 }
 
+#ifdef MAX_NR_ATT_DB_INDEX_ENTRIES
+
+static uint16_t att_db_index_handle(uint16_t pos){
+    return little_endian_read_16(att_db, att_db_index_offsets[pos] + 4);
+}
+
+// UUID16 of attribute, 0 for UUID128 not based on Bluetooth Base UUID
+static uint16_t att_db_index_uuid16(uint16_t pos){
+    uint8_t const * att_ptr = &att_db[att_db_index_offsets[pos]];
+    if (little_endian_read_16(att_ptr, 2) & ATT_PROPERTY_UUID128){
+        if (!is_Bluetooth_Base_UUID(&att_ptr[6])) return 0;
+        return little_endian_read_16(att_ptr, 6 + 12);
+    }
+    return little_endian_read_16(att_ptr, 6);
+}
+
+// compare attributes at positions by UUID16, then handle
+static int att_db_index_uuid16_compare(uint16_t pos_a, uint16_t uuid16_b, uint16_t handle_b){
+    uint16_t uuid16_a = att_db_index_uuid16(pos_a);
+    if (uuid16_a != uuid16_b) return uuid16_a < uuid16_b ? -1 : 1;
+    uint16_t handle_a = att_db_index_handle(pos_a);
+    if (handle_a != handle_b) return handle_a < handle_b ? -1 : 1;
+    return 0;
+}
+
+static void att_db_index_build(void){
+    att_db_index_size = 0;
+    if (!att_db) return;
+
+    // collect offsets, give up if too many attributes or handles not ascending
+    uint16_t num_entries = 0;
+    uint32_t offset = 0;
+    uint16_t prev_handle = 0;
+    att_db_index_contiguous = 1;
+    while (1){
+        if (offset > 0xffff) return;
+        uint16_t size = little_endian_read_16(att_db, offset);
+        if (size == 0) break;
+        uint16_t handle = little_endian_read_16(att_db, offset + 4);
+        if (num_entries == MAX_NR_ATT_DB_INDEX_ENTRIES || handle <= prev_handle){
+            log_info("att_db_index: database not indexed, using linear search");
+            return;
+        }
+        if (num_entries && handle != prev_handle + 1){
+            att_db_index_contiguous = 0;
+        }
+        att_db_index_offsets[num_entries++] = offset;
+        prev_handle = handle;
+        offset += size;
+    }
+    att_db_index_end_offset = offset;
+    att_db_index_size = num_entries;
+    if (!num_entries) return;
+    att_db_index_first_handle = att_db_index_handle(0);
+
+    // insertion sort by UUID16, keeps handle order for same UUID16
+    uint16_t i;
+    for (i = 0; i < num_entries; i++){
+        uint16_t pos    = i;
+        uint16_t uuid16 = att_db_index_uuid16(pos);
+        uint16_t handle = att_db_index_handle(pos);
+        uint16_t j = i;
+        while (j > 0 && att_db_index_uuid16_compare(att_db_index_uuid16_positions[j-1], uuid16, handle) > 0){
+            att_db_index_uuid16_positions[j] = att_db_index_uuid16_positions[j-1];
+            j--;
+        }
+        att_db_index_uuid16_positions[j] = pos;
+    }
+    log_info("att_db_index: %u attributes, contiguous handles %u", num_entries, att_db_index_contiguous);
+}
+
+// position of first attribute with handle >= given handle, att_db_index_size if none
+static uint16_t att_db_index_lower_bound(uint16_t handle){
+    if (att_db_index_contiguous){
+        if (handle < att_db_index_first_handle) return 0;
+        uint32_t pos = handle - att_db_index_first_handle;
+        if (pos > att_db_index_size) return att_db_index_size;
+        return pos;
+    }
+    uint16_t low  = 0;
+    uint16_t high = att_db_index_size;
+    while (low < high){
+        uint16_t mid = (low + high) / 2;
+        if (att_db_index_handle(mid) < handle){
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static void att_iterator_init_at_position(att_iterator_t *it, uint16_t pos){
+    att_iterator_init(it);
+    if (pos < att_db_index_size){
+        it->att_ptr = &att_db[att_db_index_offsets[pos]];
+    } else {
+        it->att_ptr = &att_db[att_db_index_end_offset];
+    }
+}
+
+#endif
+
+// iterate over attributes with handle >= start_handle
+static void att_iterator_init_from_handle(att_iterator_t *it, uint16_t start_handle){
+#ifdef MAX_NR_ATT_DB_INDEX_ENTRIES
+    if (att_db_index_size){
+        att_iterator_init_at_position(it, att_db_index_lower_bound(start_handle));
+        return;
+    }
+#else
+    UNUSED(start_handle);
+#endif
+    att_iterator_init(it);
+}
+
+// iterate over attributes with handle >= start_handle, skipping attributes with other UUID16 if index is available
+static void att_iterator_init_for_uuid16(att_iterator_t *it, uint16_t start_handle, uint16_t uuid16){
+    att_iterator_init_from_handle(it, start_handle);
+#ifdef MAX_NR_ATT_DB_INDEX_ENTRIES
+    if (!att_db_index_size || !uuid16) return;
+    uint16_t low  = 0;
+    uint16_t high = att_db_index_size;
+    while (low < high){
+        uint16_t mid = (low + high) / 2;
+        if (att_db_index_uuid16_compare(att_db_index_uuid16_positions[mid], uuid16, start_handle) < 0){
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    it->uuid16_filter = uuid16;
+    it->uuid16_pos    = low;
+#else
+    UNUSED(uuid16);
+#endif
+}
+
 static void att_iterator_fetch_next(att_iterator_t *it){
+#ifdef MAX_NR_ATT_DB_INDEX_ENTRIES
+    if (it->uuid16_filter){
+        uint16_t pos = it->uuid16_pos < att_db_index_size ? att_db_index_uuid16_positions[it->uuid16_pos] : att_db_index_size;
+        if (pos < att_db_index_size && att_db_index_uuid16(pos) == it->uuid16_filter){
+            it->att_ptr = &att_db[att_db_index_offsets[pos]];
+            it->uuid16_pos++;
+        } else {
+            it->att_ptr = &att_db[att_db_index_end_offset];
+        }
+    }
+#endif
     it->size   = little_endian_read_16(it->att_ptr, 0);
     if (it->size == 0){
         it->flags = 0;
@@ -147,6 +313,15 @@ static int att_iterator_match_uuid(att_iterator_t *it, uint8_t *uuid, uint16_t u
 
 static int att_find_handle(att_iterator_t *it, uint16_t handle){
     if (handle == 0) return 0;
+#ifdef MAX_NR_ATT_DB_INDEX_ENTRIES
+    if (att_db_index_size){
+        uint16_t pos = att_db_index_lower_bound(handle);
+        if (pos == att_db_index_size || att_db_index_handle(pos) != handle) return 0;
+        att_iterator_init_at_position(it, pos);
+        att_iterator_fetch_next(it);
+        return 1;
+    }
+#endif
     att_iterator_init(it);
     while (att_iterator_has_next(it)){
         att_iterator_fetch_next(it);
@@ -219,6 +394,9 @@ static int att_copy_value(att_iterator_t *it, uint16_t offset, uint8_t * buffer,
 
 void att_set_db(uint8_t const * db){
     att_db = db;
+#ifdef MAX_NR_ATT_DB_INDEX_ENTRIES
+    att_db_index_build();
+#endif
 }
 
 void att_set_read_callback(att_read_callback_t callback){
@@ -363,7 +541,7 @@ static uint16_t handle_find_information_request2(att_connection_t * att_connecti
     uint16_t uuid_len = 0;
     
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_from_handle(&it, start_handle);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
         if (!it.handle) break;
@@ -445,7 +623,7 @@ static uint16_t handle_find_by_type_value_request2(att_connection_t * att_connec
     uint16_t prev_handle = 0;
     
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_from_handle(&it, start_handle);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
         
@@ -513,7 +691,7 @@ static uint16_t handle_read_by_type_request2(att_connection_t * att_connection,
     uint16_t pair_len = 0;
 
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_for_uuid16(&it, start_handle, uuid16_from_uuid(attribute_type_len, attribute_type));
     uint8_t error_code = 0;
     uint16_t first_matching_but_unreadable_handle = 0;
 
@@ -808,7 +986,7 @@ static uint16_t handle_read_by_group_type_request2(att_connection_t * att_connec
     uint16_t prev_handle = 0;
 
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_from_handle(&it, start_handle);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
         
@@ -1185,7 +1363,7 @@ int gatt_server_get_get_handle_range_for_service_with_uuid16(uint16_t uuid16, ui
 // returns 0 if not found
 uint16_t gatt_server_get_value_handle_for_characteristic_with_uuid16(uint16_t start_handle, uint16_t end_handle, uint16_t uuid16){
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_for_uuid16(&it, start_handle, uuid16);
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
         if (it.handle && it.handle < start_handle) continue;
@@ -1199,7 +1377,7 @@ uint16_t gatt_server_get_value_handle_for_characteristic_with_uuid16(uint16_t st
 // returns 0 if not found
 uint16_t gatt_server_get_client_configuration_handle_for_characteristic_with_uuid16(uint16_t start_handle, uint16_t end_handle, uint16_t uuid16){
     att_iterator_t it;
-    att_iterator_init(&it);
+    att_iterator_init_from_handle(&it, start_handle);
     int characteristic_found = 0;
     while (att_iterator_has_next(&it)){
         att_iterator_fetch_next(&it);
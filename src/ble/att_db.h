@@ -98,6 +98,8 @@ typedef struct att_service_handler {
 
 /*
  * @brief setup ATT database
+ * @note with MAX_NR_ATT_DB_INDEX_ENTRIES, an index by handle and UUID16 is built. If the database is modified
+ *       afterwards, e.g. with att_db_util, att_set_db needs to be called again
  */
 void att_set_db(uint8_t const * db);
 
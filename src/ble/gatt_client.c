@@ -46,6 +46,7 @@
 
 #include "att_dispatch.h"
 #include "ad_parser.h"
+#include "bluetooth_gatt.h"
 #include "ble/att_db.h"
 #include "ble/core.h"
 #include "ble/gatt_client.h"
@@ -55,6 +56,7 @@
 #include "btstack_event.h"
 #include "btstack_memory.h"
 #include "btstack_run_loop.h"
+#include "btstack_tlv.h"
 #include "btstack_util.h"
 #include "classic/sdp_util.h"
 #include "hci.h"
@@ -75,6 +77,17 @@ static void gatt_client_report_error_if_pending(gatt_client_t *peripheral, uint8
 static void att_signed_write_handle_cmac_result(uint8_t hash[8]);
 #endif
 
+#ifdef ENABLE_GATT_CLIENT_CACHE
+static const btstack_tlv_t * gatt_client_cache_tlv_impl;
+static void * gatt_client_cache_tlv_context;
+static void gatt_client_cache_record_service(gatt_client_t * peripheral, uint16_t start_group_handle, uint16_t end_group_handle, uint8_t * uuid128);
+static void gatt_client_cache_record_characteristic(gatt_client_t * peripheral, uint16_t start_handle, uint16_t value_handle, uint16_t end_handle, uint16_t properties, uint8_t * uuid128);
+static void gatt_client_cache_record_descriptor(gatt_client_t * peripheral, uint16_t descriptor_handle, uint8_t * uuid128);
+static void gatt_client_cache_query_complete(gatt_client_t * peripheral, uint8_t status);
+#endif
+
+static void gatt_client_run(void);
+
 static uint16_t peripheral_mtu(gatt_client_t *peripheral){
     if (peripheral->mtu > l2cap_max_le_mtu()){
         log_error("Peripheral mtu is not initialized");
@@ -153,6 +166,9 @@ static gatt_client_t * provide_context_for_conn_handle(hci_con_handle_t con_hand
     context->mtu = ATT_DEFAULT_MTU;
     context->mtu_state = SEND_MTU_EXCHANGE;
     context->gatt_client_state = P_READY;
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    context->cache.le_device_index = -1;
+#endif
     btstack_linked_list_add(&gatt_client_connections, (btstack_linked_item_t*)context);
 
     // skip mtu exchange for testing sm with pts
@@ -492,9 +508,34 @@ static void emit_gatt_complete_event(gatt_client_t * peripheral, uint8_t status)
     packet[1] = 3;
     little_endian_store_16(packet, 2, peripheral->con_handle);
     packet[4] = status;
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    gatt_client_cache_query_complete(peripheral, status);
+#endif
     emit_event_new(peripheral->callback, packet, sizeof(packet));
 }
 
+static void emit_gatt_write_stream_progress_event(gatt_client_t * peripheral){
+    // @format H244
+    uint8_t packet[14];
+    packet[0] = GATT_EVENT_WRITE_STREAM_PROGRESS;
+    packet[1] = sizeof(packet) - 2;
+    little_endian_store_16(packet, 2, peripheral->con_handle);
+    little_endian_store_16(packet, 4, peripheral->write_stream_value_handle);
+    little_endian_store_32(packet, 6, peripheral->write_stream_offset);
+    little_endian_store_32(packet, 10, peripheral->write_stream_length);
+    emit_event_new(peripheral->write_stream_callback, packet, sizeof(packet));
+}
+
+static void emit_gatt_write_stream_complete_event(gatt_client_t * peripheral, uint8_t status){
+    // @format H1
+    uint8_t packet[5];
+    packet[0] = GATT_EVENT_WRITE_STREAM_COMPLETE;
+    packet[1] = 3;
+    little_endian_store_16(packet, 2, peripheral->con_handle);
+    packet[4] = status;
+    emit_event_new(peripheral->write_stream_callback, packet, sizeof(packet));
+}
+
 static void emit_gatt_service_query_result_event(gatt_client_t * peripheral, uint16_t start_group_handle, uint16_t end_group_handle, uint8_t * uuid128){
     // @format HX
     uint8_t packet[24];
@@ -505,6 +546,9 @@ static void emit_gatt_service_query_result_event(gatt_client_t * peripheral, uin
     little_endian_store_16(packet, 4, start_group_handle);
     little_endian_store_16(packet, 6, end_group_handle);
     reverse_128(uuid128, &packet[8]);
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    gatt_client_cache_record_service(peripheral, start_group_handle, end_group_handle, uuid128);
+#endif
     emit_event_new(peripheral->callback, packet, sizeof(packet));
 }
 
@@ -536,6 +580,9 @@ static void emit_gatt_characteristic_query_result_event(gatt_client_t * peripher
     little_endian_store_16(packet, 8,  end_handle);
     little_endian_store_16(packet, 10, properties);
     reverse_128(uuid128, &packet[12]);
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    gatt_client_cache_record_characteristic(peripheral, start_handle, value_handle, end_handle, properties, uuid128);
+#endif
     emit_event_new(peripheral->callback, packet, sizeof(packet));
 }
 
@@ -549,10 +596,314 @@ static void emit_gatt_all_characteristic_descriptors_result_event(
     ///
     little_endian_store_16(packet, 4,  descriptor_handle);
     reverse_128(uuid128, &packet[6]);
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    gatt_client_cache_record_descriptor(peripheral, descriptor_handle, uuid128);
+#endif
     emit_event_new(peripheral->callback, packet, sizeof(packet));
 }
 ///
 
+#ifdef ENABLE_GATT_CLIENT_CACHE
+
+#define GATT_CLIENT_CACHE_ENTRY_SERVICE         1
+#define GATT_CLIENT_CACHE_ENTRY_CHARACTERISTIC  2
+#define GATT_CLIENT_CACHE_ENTRY_DESCRIPTOR      3
+
+// characteristics of service / descriptors of characteristic have been discovered
+#define GATT_CLIENT_CACHE_FLAG_COMPLETE         1
+
+// stored cache: identity address (6), address type (1), services complete (1), num entries (1), entries
+#define GATT_CLIENT_CACHE_STORAGE_HEADER_SIZE   9
+static uint8_t gatt_client_cache_storage[GATT_CLIENT_CACHE_STORAGE_HEADER_SIZE + MAX_NR_GATT_CLIENT_CACHE_ENTRIES * sizeof(gatt_client_cache_entry_t)];
+
+static btstack_timer_source_t gatt_client_cache_replay_timer;
+
+void gatt_client_set_cache_storage(const btstack_tlv_t * btstack_tlv_impl, void * btstack_tlv_context){
+    gatt_client_cache_tlv_impl = btstack_tlv_impl;
+    gatt_client_cache_tlv_context = btstack_tlv_context;
+}
+
+static uint32_t gatt_client_cache_tag_for_index(int le_device_index){
+    return ('G' << 24) | ('T' << 16) | ('C' << 8) | (uint8_t) le_device_index;
+}
+
+// bind cache to bonded device as soon as it is known and load stored cache
+static void gatt_client_cache_load(gatt_client_t * peripheral){
+    gatt_client_cache_t * cache = &peripheral->cache;
+    if (cache->le_device_index >= 0) return;
+    int le_device_index = sm_le_device_index(peripheral->con_handle);
+    if (le_device_index < 0) return;
+    cache->le_device_index = le_device_index;
+
+    // keep results of this connection, they are stored on disconnect
+    if (cache->num_entries) return;
+    if (!gatt_client_cache_tlv_impl) return;
+
+    uint32_t tag = gatt_client_cache_tag_for_index(le_device_index);
+    int size = gatt_client_cache_tlv_impl->get_tag(gatt_client_cache_tlv_context, tag, gatt_client_cache_storage, sizeof(gatt_client_cache_storage));
+    if (size < GATT_CLIENT_CACHE_STORAGE_HEADER_SIZE) return;
+
+    // ignore cache of previous device with same index
+    int addr_type;
+    bd_addr_t addr;
+    le_device_db_info(le_device_index, &addr_type, addr, NULL);
+    if (memcmp(addr, gatt_client_cache_storage, 6) != 0 || gatt_client_cache_storage[6] != addr_type) {
+        log_info("GATT cache: drop cache of previous device with index %u", le_device_index);
+        gatt_client_cache_tlv_impl->delete_tag(gatt_client_cache_tlv_context, tag);
+        return;
+    }
+    uint8_t num_entries = gatt_client_cache_storage[8];
+    if (num_entries > MAX_NR_GATT_CLIENT_CACHE_ENTRIES) return;
+    if (size != (int) (GATT_CLIENT_CACHE_STORAGE_HEADER_SIZE + num_entries * sizeof(gatt_client_cache_entry_t))) return;
+
+    cache->services_complete = gatt_client_cache_storage[7];
+    cache->num_entries = num_entries;
+    memcpy(cache->entries, &gatt_client_cache_storage[GATT_CLIENT_CACHE_STORAGE_HEADER_SIZE], num_entries * sizeof(gatt_client_cache_entry_t));
+    log_info("GATT cache: loaded %u entries for %s", num_entries, bd_addr_to_str(addr));
+}
+
+static void gatt_client_cache_store(gatt_client_t * peripheral){
+    gatt_client_cache_t * cache = &peripheral->cache;
+    if (!cache->dirty) return;
+    if (cache->le_device_index < 0) return;
+    if (!gatt_client_cache_tlv_impl) return;
+
+    int addr_type;
+    bd_addr_t addr;
+    le_device_db_info(cache->le_device_index, &addr_type, addr, NULL);
+    memcpy(gatt_client_cache_storage, addr, 6);
+    gatt_client_cache_storage[6] = addr_type;
+    gatt_client_cache_storage[7] = cache->services_complete;
+    gatt_client_cache_storage[8] = cache->num_entries;
+    memcpy(&gatt_client_cache_storage[GATT_CLIENT_CACHE_STORAGE_HEADER_SIZE], cache->entries, cache->num_entries * sizeof(gatt_client_cache_entry_t));
+
+    uint32_t tag = gatt_client_cache_tag_for_index(cache->le_device_index);
+    gatt_client_cache_tlv_impl->store_tag(gatt_client_cache_tlv_context, tag, gatt_client_cache_storage, 
+        GATT_CLIENT_CACHE_STORAGE_HEADER_SIZE + cache->num_entries * sizeof(gatt_client_cache_entry_t));
+    cache->dirty = 0;
+}
+
+static void gatt_client_cache_invalidate(gatt_client_t * peripheral){
+    gatt_client_cache_t * cache = &peripheral->cache;
+    log_info("GATT cache: invalidate, handle 0x%02x", peripheral->con_handle);
+    cache->services_complete = 0;
+    cache->num_entries = 0;
+    cache->dirty = 0;
+    peripheral->cache_query = GATT_CLIENT_CACHE_QUERY_NONE;
+    if (cache->le_device_index < 0) return;
+    if (!gatt_client_cache_tlv_impl) return;
+    gatt_client_cache_tlv_impl->delete_tag(gatt_client_cache_tlv_context, gatt_client_cache_tag_for_index(cache->le_device_index));
+}
+
+static gatt_client_cache_entry_t * gatt_client_cache_find(gatt_client_t * peripheral, uint8_t type, uint16_t start_handle, uint16_t end_handle){
+    int i;
+    for (i=0;i<peripheral->cache.num_entries;i++){
+        gatt_client_cache_entry_t * entry = &peripheral->cache.entries[i];
+        if (entry->type != type) continue;
+        if (entry->start_handle != start_handle) continue;
+        if (entry->end_handle != end_handle) continue;
+        return entry;
+    }
+    return NULL;
+}
+
+static gatt_client_cache_entry_t * gatt_client_cache_find_characteristic(gatt_client_t * peripheral, uint16_t value_handle, uint16_t end_handle){
+    int i;
+    for (i=0;i<peripheral->cache.num_entries;i++){
+        gatt_client_cache_entry_t * entry = &peripheral->cache.entries[i];
+        if (entry->type != GATT_CLIENT_CACHE_ENTRY_CHARACTERISTIC) continue;
+        if (entry->value_handle != value_handle) continue;
+        if (entry->end_handle != end_handle) continue;
+        return entry;
+    }
+    return NULL;
+}
+
+// insert sorted by start handle, replace entry with same start handle
+static void gatt_client_cache_add(gatt_client_t * peripheral, uint8_t type, uint16_t start_handle, uint16_t value_handle, uint16_t end_handle, uint16_t properties, uint8_t * uuid128){
+    gatt_client_cache_t * cache = &peripheral->cache;
+    int pos;
+    for (pos=0;pos<cache->num_entries;pos++){
+        if (cache->entries[pos].start_handle >= start_handle) break;
+    }
+    if (pos == cache->num_entries || cache->entries[pos].start_handle != start_handle){
+        if (cache->num_entries == MAX_NR_GATT_CLIENT_CACHE_ENTRIES){
+            // cache full, don't mark query as complete
+            log_info("GATT cache: full");
+            peripheral->cache_query = GATT_CLIENT_CACHE_QUERY_NONE;
+            return;
+        }
+        memmove(&cache->entries[pos+1], &cache->entries[pos], (cache->num_entries - pos) * sizeof(gatt_client_cache_entry_t));
+        cache->num_entries++;
+    }
+    gatt_client_cache_entry_t * entry = &cache->entries[pos];
+    entry->type = type;
+    entry->flags = 0;
+    entry->start_handle = start_handle;
+    entry->value_handle = value_handle;
+    entry->end_handle = end_handle;
+    entry->properties = properties;
+    memcpy(entry->uuid128, uuid128, 16);
+    cache->dirty = 1;
+}
+
+static void gatt_client_cache_record_service(gatt_client_t * peripheral, uint16_t start_group_handle, uint16_t end_group_handle, uint8_t * uuid128){
+    if (peripheral->cache_query != GATT_CLIENT_CACHE_QUERY_SERVICES) return;
+    gatt_client_cache_add(peripheral, GATT_CLIENT_CACHE_ENTRY_SERVICE, start_group_handle, 0, end_group_handle, 0, uuid128);
+}
+
+static void gatt_client_cache_record_characteristic(gatt_client_t * peripheral, uint16_t start_handle, uint16_t value_handle, uint16_t end_handle, uint16_t properties, uint8_t * uuid128){
+    if (peripheral->cache_query != GATT_CLIENT_CACHE_QUERY_CHARACTERISTICS) return;
+    gatt_client_cache_add(peripheral, GATT_CLIENT_CACHE_ENTRY_CHARACTERISTIC, start_handle, value_handle, end_handle, properties, uuid128);
+}
+
+static void gatt_client_cache_record_descriptor(gatt_client_t * peripheral, uint16_t descriptor_handle, uint8_t * uuid128){
+    if (peripheral->cache_query != GATT_CLIENT_CACHE_QUERY_DESCRIPTORS) return;
+    gatt_client_cache_add(peripheral, GATT_CLIENT_CACHE_ENTRY_DESCRIPTOR, descriptor_handle, 0, descriptor_handle, 0, uuid128);
+}
+
+static void gatt_client_cache_query_complete(gatt_client_t * peripheral, uint8_t status){
+    gatt_client_cache_query_t cache_query = peripheral->cache_query;
+    peripheral->cache_query = GATT_CLIENT_CACHE_QUERY_NONE;
+    if (status) return;
+
+    gatt_client_cache_entry_t * entry;
+    switch (cache_query){
+        case GATT_CLIENT_CACHE_QUERY_SERVICES:
+            peripheral->cache.services_complete = 1;
+            break;
+        case GATT_CLIENT_CACHE_QUERY_CHARACTERISTICS:
+            entry = gatt_client_cache_find(peripheral, GATT_CLIENT_CACHE_ENTRY_SERVICE, peripheral->cache_query_handle, peripheral->end_group_handle);
+            if (entry) entry->flags |= GATT_CLIENT_CACHE_FLAG_COMPLETE;
+            break;
+        case GATT_CLIENT_CACHE_QUERY_DESCRIPTORS:
+            entry = gatt_client_cache_find_characteristic(peripheral, peripheral->cache_query_handle, peripheral->end_group_handle);
+            if (entry) entry->flags |= GATT_CLIENT_CACHE_FLAG_COMPLETE;
+            break;
+        default:
+            return;
+    }
+    peripheral->cache.dirty = 1;
+}
+
+static void gatt_client_cache_replay_timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    gatt_client_run();
+}
+
+// results are emitted from the run loop, after the discover call has returned
+static void gatt_client_cache_replay_start(gatt_client_t * peripheral, gatt_client_state_t state){
+    peripheral->gatt_client_state = state;
+    btstack_run_loop_remove_timer(&gatt_client_cache_replay_timer);
+    btstack_run_loop_set_timer_handler(&gatt_client_cache_replay_timer, &gatt_client_cache_replay_timer_handler);
+    btstack_run_loop_set_timer(&gatt_client_cache_replay_timer, 0);
+    btstack_run_loop_add_timer(&gatt_client_cache_replay_timer);
+}
+
+// @returns 1 if services will be reported from cache, uuid128 NULL for all services
+static int gatt_client_cache_discover_services(gatt_client_t * peripheral, const uint8_t * uuid128){
+    gatt_client_cache_load(peripheral);
+    if (!peripheral->cache.services_complete) {
+        // record full discovery only
+        if (!uuid128){
+            peripheral->cache_query = GATT_CLIENT_CACHE_QUERY_SERVICES;
+        }
+        return 0;
+    }
+    peripheral->filter_with_uuid = uuid128 != NULL;
+    gatt_client_cache_replay_start(peripheral, P_W2_EMIT_CACHED_SERVICES);
+    return 1;
+}
+
+// @returns 1 if characteristics will be reported from cache, uuid128 NULL for all characteristics
+static int gatt_client_cache_discover_characteristics(gatt_client_t * peripheral, uint16_t start_handle, uint16_t end_handle, const uint8_t * uuid128){
+    gatt_client_cache_load(peripheral);
+    gatt_client_cache_entry_t * service = gatt_client_cache_find(peripheral, GATT_CLIENT_CACHE_ENTRY_SERVICE, start_handle, end_handle);
+    if (!service) return 0;
+    if ((service->flags & GATT_CLIENT_CACHE_FLAG_COMPLETE) == 0){
+        // record characteristics of known services only
+        if (!uuid128){
+            peripheral->cache_query = GATT_CLIENT_CACHE_QUERY_CHARACTERISTICS;
+            peripheral->cache_query_handle = start_handle;
+        }
+        return 0;
+    }
+    gatt_client_cache_replay_start(peripheral, P_W2_EMIT_CACHED_CHARACTERISTICS);
+    return 1;
+}
+
+// @returns 1 if descriptors will be reported from cache
+static int gatt_client_cache_discover_characteristic_descriptors(gatt_client_t * peripheral, gatt_client_characteristic_t * characteristic){
+    gatt_client_cache_load(peripheral);
+    gatt_client_cache_entry_t * cached_characteristic = gatt_client_cache_find_characteristic(peripheral, characteristic->value_handle, characteristic->end_handle);
+    if (!cached_characteristic) return 0;
+    if ((cached_characteristic->flags & GATT_CLIENT_CACHE_FLAG_COMPLETE) == 0){
+        peripheral->cache_query = GATT_CLIENT_CACHE_QUERY_DESCRIPTORS;
+        peripheral->cache_query_handle = characteristic->value_handle;
+        return 0;
+    }
+    gatt_client_cache_replay_start(peripheral, P_W2_EMIT_CACHED_CHARACTERISTIC_DESCRIPTORS);
+    return 1;
+}
+
+// emit cached results of pending discovery within start_group_handle..end_group_handle, @returns 1 if results have been reported
+static int gatt_client_cache_run_replay(gatt_client_t * peripheral){
+    uint8_t entry_type;
+    switch (peripheral->gatt_client_state){
+        case P_W2_EMIT_CACHED_SERVICES:
+            entry_type = GATT_CLIENT_CACHE_ENTRY_SERVICE;
+            break;
+        case P_W2_EMIT_CACHED_CHARACTERISTICS:
+            entry_type = GATT_CLIENT_CACHE_ENTRY_CHARACTERISTIC;
+            break;
+        case P_W2_EMIT_CACHED_CHARACTERISTIC_DESCRIPTORS:
+            entry_type = GATT_CLIENT_CACHE_ENTRY_DESCRIPTOR;
+            break;
+        default:
+            return 0;
+    }
+    int i;
+    for (i=0;i<peripheral->cache.num_entries;i++){
+        gatt_client_cache_entry_t * entry = &peripheral->cache.entries[i];
+        if (entry->type != entry_type) continue;
+        if (entry->start_handle < peripheral->start_group_handle || entry->start_handle > peripheral->end_group_handle) continue;
+        switch (entry_type){
+            case GATT_CLIENT_CACHE_ENTRY_SERVICE:
+                if (peripheral->filter_with_uuid && memcmp(entry->uuid128, peripheral->uuid128, 16) != 0) break;
+                emit_gatt_service_query_result_event(peripheral, entry->start_handle, entry->end_handle, entry->uuid128);
+                break;
+            case GATT_CLIENT_CACHE_ENTRY_CHARACTERISTIC:
+                if (peripheral->filter_with_uuid && memcmp(entry->uuid128, peripheral->uuid128, 16) != 0) break;
+                emit_gatt_characteristic_query_result_event(peripheral, entry->start_handle, entry->value_handle, entry->end_handle, entry->properties, entry->uuid128);
+                break;
+            default:
+                emit_gatt_all_characteristic_descriptors_result_event(peripheral, entry->start_handle, entry->uuid128);
+                break;
+        }
+    }
+    gatt_client_handle_transaction_complete(peripheral);
+    emit_gatt_complete_event(peripheral, 0);
+    return 1;
+}
+
+// Service Changed indication invalidates cache. Any indication does if the Service Changed characteristic is not cached.
+static void gatt_client_cache_handle_indication(gatt_client_t * peripheral, uint16_t value_handle){
+    gatt_client_cache_load(peripheral);
+    if (!peripheral->cache.num_entries) return;
+    uint8_t service_changed_uuid128[16];
+    uuid_add_bluetooth_prefix(service_changed_uuid128, ORG_BLUETOOTH_CHARACTERISTIC_GATT_SERVICE_CHANGED);
+    int i;
+    for (i=0;i<peripheral->cache.num_entries;i++){
+        gatt_client_cache_entry_t * entry = &peripheral->cache.entries[i];
+        if (entry->type != GATT_CLIENT_CACHE_ENTRY_CHARACTERISTIC) continue;
+        if (memcmp(entry->uuid128, service_changed_uuid128, 16) != 0) continue;
+        if (entry->value_handle != value_handle) return;
+        break;
+    }
+    gatt_client_cache_invalidate(peripheral);
+}
+#endif
+
 static void report_gatt_services(gatt_client_t * peripheral, uint8_t * packet,  uint16_t size){
     uint8_t attr_length = packet[1];
     uint8_t uuid_length = attr_length - 4;
@@ -801,16 +1152,21 @@ static int is_value_valid(gatt_client_t *peripheral, uint8_t *packet, uint16_t s
 }
 
 
-static void gatt_client_run(void){
+static void gatt_client_run_queries(void){
 
     btstack_linked_item_t *it;
     for (it = (btstack_linked_item_t *) gatt_client_connections; it ; it = it->next){
 
         gatt_client_t * peripheral = (gatt_client_t *) it;
 
+#ifdef ENABLE_GATT_CLIENT_CACHE
+        // cached results don't need an ATT request
+        if (gatt_client_cache_run_replay(peripheral)) continue;
+#endif
+
         if (!att_dispatch_client_can_send_now(peripheral->con_handle)) {
             att_dispatch_client_request_can_send_now_event(peripheral->con_handle);
-            return;
+            continue;
         }
 
         // log_info("- handle_peripheral_list, mtu state %u, client state %u", peripheral->mtu_state, peripheral->gatt_client_state);
@@ -1005,6 +1361,38 @@ static void gatt_client_run(void){
     
 }
 
+// Write Without Response commands of write streams use ACL buffers left by queries
+static void gatt_client_run_write_streams(void){
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) gatt_client_connections; it ; it = it->next){
+        gatt_client_t * peripheral = (gatt_client_t *) it;
+        if (!peripheral->write_stream_active) continue;
+        if (peripheral->mtu_state == SENT_MTU_EXCHANGE) continue;
+
+        uint16_t max_chunk_len = peripheral_mtu(peripheral) - 3;
+        uint32_t offset = peripheral->write_stream_offset;
+        while (peripheral->write_stream_offset < peripheral->write_stream_length && att_dispatch_client_can_send_now(peripheral->con_handle)){
+            uint16_t chunk_len = (uint16_t) btstack_min(max_chunk_len, peripheral->write_stream_length - peripheral->write_stream_offset);
+            att_write_request(ATT_WRITE_COMMAND, peripheral->con_handle, peripheral->write_stream_value_handle, chunk_len, (uint8_t *) &peripheral->write_stream_data[peripheral->write_stream_offset]);
+            peripheral->write_stream_offset += chunk_len;
+        }
+        if (peripheral->write_stream_offset != offset){
+            emit_gatt_write_stream_progress_event(peripheral);
+        }
+        if (peripheral->write_stream_offset < peripheral->write_stream_length){
+            att_dispatch_client_request_can_send_now_event(peripheral->con_handle);
+            continue;
+        }
+        peripheral->write_stream_active = 0;
+        emit_gatt_write_stream_complete_event(peripheral, 0);
+    }
+}
+
+static void gatt_client_run(void){
+    gatt_client_run_queries();
+    gatt_client_run_write_streams();
+}
+
 static void gatt_client_report_error_if_pending(gatt_client_t *peripheral, uint8_t error_code) {
     if (is_ready(peripheral)) return;
     gatt_client_handle_transaction_complete(peripheral);
@@ -1025,6 +1413,13 @@ static void gatt_client_hci_event_packet_handler(uint8_t packet_type, uint16_t c
             gatt_client_t * peripheral = get_gatt_client_context_for_handle(con_handle);
             if (!peripheral) break;
             gatt_client_report_error_if_pending(peripheral, ATT_ERROR_HCI_DISCONNECT_RECEIVED);
+            if (peripheral->write_stream_active){
+                peripheral->write_stream_active = 0;
+                emit_gatt_write_stream_complete_event(peripheral, ATT_ERROR_HCI_DISCONNECT_RECEIVED);
+            }
+#ifdef ENABLE_GATT_CLIENT_CACHE
+            gatt_client_cache_store(peripheral);
+#endif
             
             btstack_linked_list_remove(&gatt_client_connections, (btstack_linked_item_t *) peripheral);
             btstack_memory_gatt_client_free(peripheral);
@@ -1083,6 +1478,9 @@ static void gatt_client_att_packet_handler(uint8_t packet_type, uint16_t handle,
             }
             break;
         case ATT_HANDLE_VALUE_INDICATION:
+#ifdef ENABLE_GATT_CLIENT_CACHE
+            gatt_client_cache_handle_indication(peripheral, little_endian_read_16(packet,1));
+#endif
             report_gatt_indication(handle, little_endian_read_16(packet,1), &packet[3], size-3);
             peripheral->send_confirmation = 1;
             break;
@@ -1405,6 +1803,9 @@ uint8_t gatt_client_discover_primary_services(btstack_packet_handler_t callback,
     peripheral->end_group_handle   = 0xffff;
     peripheral->gatt_client_state = P_W2_SEND_SERVICE_QUERY;
     peripheral->uuid16 = 0;
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    if (gatt_client_cache_discover_services(peripheral, NULL)) return 0;
+#endif
     gatt_client_run();
     return 0;
 }
@@ -1422,6 +1823,9 @@ uint8_t gatt_client_discover_primary_services_by_uuid16(btstack_packet_handler_t
     peripheral->gatt_client_state = P_W2_SEND_SERVICE_WITH_UUID_QUERY;
     peripheral->uuid16 = uuid16;
     uuid_add_bluetooth_prefix((uint8_t*) &(peripheral->uuid128), peripheral->uuid16);
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    if (gatt_client_cache_discover_services(peripheral, peripheral->uuid128)) return 0;
+#endif
     gatt_client_run();
     return 0;
 }
@@ -1438,6 +1842,9 @@ uint8_t gatt_client_discover_primary_services_by_uuid128(btstack_packet_handler_
     peripheral->uuid16 = 0;
     memcpy(peripheral->uuid128, uuid128, 16);
     peripheral->gatt_client_state = P_W2_SEND_SERVICE_WITH_UUID_QUERY;
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    if (gatt_client_cache_discover_services(peripheral, peripheral->uuid128)) return 0;
+#endif
     gatt_client_run();
     return 0;
 }
@@ -1454,6 +1861,9 @@ uint8_t gatt_client_discover_characteristics_for_service(btstack_packet_handler_
     peripheral->filter_with_uuid = 0;
     peripheral->characteristic_start_handle = 0;
     peripheral->gatt_client_state = P_W2_SEND_ALL_CHARACTERISTICS_OF_SERVICE_QUERY;
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    if (gatt_client_cache_discover_characteristics(peripheral, service->start_group_handle, service->end_group_handle, NULL)) return 0;
+#endif
     gatt_client_run();
     return 0;
 }
@@ -1487,6 +1897,9 @@ uint8_t gatt_client_discover_characteristics_for_handle_range_by_uuid16(btstack_
     uuid_add_bluetooth_prefix((uint8_t*) &(peripheral->uuid128), uuid16);
     peripheral->characteristic_start_handle = 0;
     peripheral->gatt_client_state = P_W2_SEND_CHARACTERISTIC_WITH_UUID_QUERY;
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    if (gatt_client_cache_discover_characteristics(peripheral, start_handle, end_handle, peripheral->uuid128)) return 0;
+#endif
     
     gatt_client_run();
     return 0;
@@ -1506,6 +1919,9 @@ uint8_t gatt_client_discover_characteristics_for_handle_range_by_uuid128(btstack
     memcpy(peripheral->uuid128, uuid128, 16);
     peripheral->characteristic_start_handle = 0;
     peripheral->gatt_client_state = P_W2_SEND_CHARACTERISTIC_WITH_UUID_QUERY;
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    if (gatt_client_cache_discover_characteristics(peripheral, start_handle, end_handle, peripheral->uuid128)) return 0;
+#endif
     
     gatt_client_run();
     return 0;
@@ -1534,6 +1950,9 @@ uint8_t gatt_client_discover_characteristic_descriptors(btstack_packet_handler_t
     peripheral->start_group_handle = characteristic->value_handle + 1;
     peripheral->end_group_handle   = characteristic->end_handle;
     peripheral->gatt_client_state = P_W2_SEND_ALL_CHARACTERISTIC_DESCRIPTORS_QUERY;
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    if (gatt_client_cache_discover_characteristic_descriptors(peripheral, characteristic)) return 0;
+#endif
     
     gatt_client_run();
     return 0;
@@ -1643,6 +2062,29 @@ uint8_t gatt_client_write_value_of_characteristic_without_response(hci_con_handl
     return 0;
 }
 
+uint8_t gatt_client_write_stream_without_response(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t value_handle, uint32_t length, const uint8_t * data){
+    gatt_client_t * peripheral = provide_context_for_conn_handle(con_handle);
+
+    if (!peripheral) return BTSTACK_MEMORY_ALLOC_FAILED; 
+    if (peripheral->write_stream_active) return GATT_CLIENT_IN_WRONG_STATE;
+
+    peripheral->write_stream_callback = callback;
+    peripheral->write_stream_value_handle = value_handle;
+    peripheral->write_stream_data = data;
+    peripheral->write_stream_length = length;
+    peripheral->write_stream_offset = 0;
+    peripheral->write_stream_active = 1;
+    gatt_client_run();
+    return 0;
+}
+
+uint8_t gatt_client_write_stream_abort(hci_con_handle_t con_handle){
+    gatt_client_t * peripheral = get_gatt_client_context_for_handle(con_handle);
+    if (!peripheral || !peripheral->write_stream_active) return GATT_CLIENT_IN_WRONG_STATE;
+    peripheral->write_stream_active = 0;
+    return 0;
+}
+
 uint8_t gatt_client_write_value_of_characteristic(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t value_handle, uint16_t value_length, uint8_t * data){
     gatt_client_t * peripheral = provide_context_for_conn_handle_and_start_timer(con_handle);
     
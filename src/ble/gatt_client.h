@@ -40,6 +40,7 @@
 #define btstack_gatt_client_h
 
 #include "hci.h"
+#include "btstack_tlv.h"
 
 #if defined __cplusplus
 extern "C" {
@@ -120,6 +121,13 @@ typedef enum {
     P_W4_CMAC_RESULT,
     P_W2_SEND_SIGNED_WRITE,
     P_W4_SEND_SINGED_WRITE_DONE,
+
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    // discovery answered from cache, results are emitted by gatt_client_run
+    P_W2_EMIT_CACHED_SERVICES,
+    P_W2_EMIT_CACHED_CHARACTERISTICS,
+    P_W2_EMIT_CACHED_CHARACTERISTIC_DESCRIPTORS,
+#endif
 } gatt_client_state_t;
     
     
@@ -129,6 +137,40 @@ typedef enum{
     MTU_EXCHANGED
 } gatt_client_mtu_t;
 
+#ifdef ENABLE_GATT_CLIENT_CACHE
+
+// MAX_NR_GATT_CLIENT_CACHE_ENTRIES defines number of services, characteristics and descriptors cached per connection
+#ifndef MAX_NR_GATT_CLIENT_CACHE_ENTRIES
+#define MAX_NR_GATT_CLIENT_CACHE_ENTRIES 64
+#endif
+
+typedef enum {
+    GATT_CLIENT_CACHE_QUERY_NONE,
+    GATT_CLIENT_CACHE_QUERY_SERVICES,
+    GATT_CLIENT_CACHE_QUERY_CHARACTERISTICS,
+    GATT_CLIENT_CACHE_QUERY_DESCRIPTORS,
+} gatt_client_cache_query_t;
+
+// service, characteristic or descriptor found by discovery, sorted by start handle
+typedef struct {
+    uint8_t  type;
+    uint8_t  flags;          // characteristics of service / descriptors of characteristic complete
+    uint16_t start_handle;
+    uint16_t value_handle;
+    uint16_t end_handle;
+    uint16_t properties;
+    uint8_t  uuid128[16];
+} gatt_client_cache_entry_t;
+
+typedef struct {
+    int      le_device_index; // bonded device cache is stored for, -1 if not known yet
+    uint8_t  dirty;
+    uint8_t  services_complete;
+    uint8_t  num_entries;
+    gatt_client_cache_entry_t entries[MAX_NR_GATT_CLIENT_CACHE_ENTRIES];
+} gatt_client_cache_t;
+#endif
+
 typedef struct gatt_client{
     btstack_linked_item_t    item;
     // TODO: rename gatt_client_state -> state
@@ -175,6 +217,21 @@ typedef struct gatt_client{
     uint8_t  cmac[8];
 
     btstack_timer_source_t gc_timeout;
+
+    // write stream, sent as Write Without Response independent of current query
+    btstack_packet_handler_t write_stream_callback;
+    uint8_t         write_stream_active;
+    uint16_t        write_stream_value_handle;
+    const uint8_t * write_stream_data;
+    uint32_t        write_stream_length;
+    uint32_t        write_stream_offset;
+
+#ifdef ENABLE_GATT_CLIENT_CACHE
+    // discovery results of current query are recorded
+    gatt_client_cache_query_t cache_query;
+    uint16_t cache_query_handle;
+    gatt_client_cache_t cache;
+#endif
 } gatt_client_t;
 
 typedef struct gatt_client_notification {
@@ -213,6 +270,16 @@ typedef struct {
  */
 void gatt_client_init(void);
 
+/**
+ * @brief Use TLV to persist discovered services, characteristics and descriptors of bonded devices.
+ *        Requires ENABLE_GATT_CLIENT_CACHE. Discovery results are cached for each connection, stored on disconnect 
+ *        for bonded devices and reported without ATT requests on later connections until the device indicates 
+ *        Service Changed. Results from the cache are reported from the run loop after the discovery function returned.
+ * @param btstack_tlv_impl of btstack_tlv_t, NULL to only cache during a connection
+ * @param btstack_tlv_context
+ */
+void gatt_client_set_cache_storage(const btstack_tlv_t * btstack_tlv_impl, void * btstack_tlv_context);
+
 /** 
  * @brief MTU is available after the first query has completed. If status is equal to 0, it returns the real value, otherwise the default value of 23. 
  */
@@ -288,6 +355,26 @@ uint8_t gatt_client_read_multiple_characteristic_values(btstack_packet_handler_t
  */
 uint8_t gatt_client_write_value_of_characteristic_without_response(hci_con_handle_t con_handle, uint16_t characteristic_value_handle, uint16_t length, uint8_t  * data);
 
+/**
+ * @brief Writes data of arbitrary length to the characteristic value using Write Without Response commands of up to MTU - 3 bytes.
+ *        Commands are sent as long as the controller has free ACL buffers, independent of other queries on this connection.
+ *        GATT_EVENT_WRITE_STREAM_PROGRESS is emitted after each burst of commands and GATT_EVENT_WRITE_STREAM_COMPLETE after the last one.
+ * @param callback
+ * @param con_handle
+ * @param characteristic_value_handle
+ * @param length
+ * @param data is not copied, must stay valid until GATT_EVENT_WRITE_STREAM_COMPLETE
+ * @return 0 if ok, GATT_CLIENT_IN_WRONG_STATE if write stream is already active
+ */
+uint8_t gatt_client_write_stream_without_response(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint16_t characteristic_value_handle, uint32_t length, const uint8_t * data);
+
+/**
+ * @brief Stop active write stream without further events
+ * @param con_handle
+ * @return 0 if ok, GATT_CLIENT_IN_WRONG_STATE if no write stream is active
+ */
+uint8_t gatt_client_write_stream_abort(hci_con_handle_t con_handle);
+
 /** 
  * @brief Writes the authenticated characteristic value using the characteristic's value handle without an acknowledgment that the write was successfully performed.
  */
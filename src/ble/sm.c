@@ -101,6 +101,16 @@
 #define ENABLE_CMAC_ENGINE
 #endif
 
+// number of connections that can pair or re-encrypt at the same time
+#ifndef MAX_NR_SM_SETUP_CONTEXTS
+#define MAX_NR_SM_SETUP_CONTEXTS 1
+#endif
+
+// number of resolved private addresses remembered with their LE Device DB index, 0 disables the cache
+#ifndef MAX_NR_SM_RESOLVING_CACHE_ENTRIES
+#define MAX_NR_SM_RESOLVING_CACHE_ENTRIES 8
+#endif
+
 //
 // SM internal types and globals
 //
@@ -247,6 +257,17 @@ static void *    sm_address_resolution_context;
 static address_resolution_mode_t sm_address_resolution_mode;
 static btstack_linked_list_t sm_address_resolution_general_queue;
 
+#if MAX_NR_SM_RESOLVING_CACHE_ENTRIES > 0
+// recently resolved private addresses. the IRK is kept to detect changes in the LE Device DB
+typedef struct {
+    bd_addr_t address;
+    sm_key_t  irk;
+    int       le_db_index;
+} sm_resolving_cache_entry_t;
+static sm_resolving_cache_entry_t sm_resolving_cache[MAX_NR_SM_RESOLVING_CACHE_ENTRIES];
+static int                        sm_resolving_cache_next;
+#endif
+
 // aes128 crypto engine. store current sm_connection_t in sm_aes128_context
 static sm_aes128_state_t  sm_aes128_state;
 static void *             sm_aes128_context;
@@ -254,10 +275,13 @@ static void *             sm_aes128_context;
 // use aes128 provided by MCU - not needed usually
 #ifdef HAVE_AES128
 static uint8_t                aes128_result_flipped[16];
-static btstack_timer_source_t aes128_timer;
 void btstack_aes128_calc(uint8_t * key, uint8_t * plaintext, uint8_t * result);
 #endif
 
+// sm_run re-entrance guard
+static int sm_run_active;
+static int sm_run_requested;
+
 // random engine. store context (ususally sm_connection_t)
 static void * sm_random_context;
 
@@ -300,9 +324,6 @@ typedef struct sm_setup_context {
 
     btstack_timer_source_t sm_timeout;
 
-    // used in all phases
-    uint8_t   sm_pairing_failed_reason;
-
     // user response, (Phase 1 and/or 2)
     uint8_t   sm_user_response;
     uint8_t   sm_keypress_notification;
@@ -368,17 +389,53 @@ typedef struct sm_setup_context {
 
 } sm_setup_context_t;
 
-// 
-static sm_setup_context_t the_setup;
-static sm_setup_context_t * setup = &the_setup;
+// pool of setup contexts, each owned by at most one connection
+static sm_setup_context_t sm_setup_contexts[MAX_NR_SM_SETUP_CONTEXTS];
+static hci_con_handle_t   sm_setup_context_con_handles[MAX_NR_SM_SETUP_CONTEXTS];
+static int                sm_setup_context_next;    // round robin over active connections in sm_run
+
+// selected setup context
+static sm_setup_context_t * setup = &sm_setup_contexts[0];
 
-// active connection - the one for which the_setup is used for
+// active connection - the one for which the selected setup context is used for
 static uint16_t sm_active_connection_handle = HCI_CON_HANDLE_INVALID;
 
 // @returns 1 if oob data is available
 // stores oob data in provided 16 byte buffer if not null
 static int (*sm_get_oob_data)(uint8_t addres_type, bd_addr_t addr, uint8_t * oob_data) = NULL;
 
+static int sm_setup_context_index(hci_con_handle_t con_handle){
+    int i;
+    for (i=0;i<MAX_NR_SM_SETUP_CONTEXTS;i++){
+        if (sm_setup_context_con_handles[i] == con_handle) return i;
+    }
+    return -1;
+}
+
+// select setup context owned by con_handle, or a free one for HCI_CON_HANDLE_INVALID
+// @returns 0 if there is no such setup context
+static int sm_setup_select(hci_con_handle_t con_handle){
+    int index = sm_setup_context_index(con_handle);
+    if (index < 0) return 0;
+    setup = &sm_setup_contexts[index];
+    sm_active_connection_handle = con_handle;
+    return 1;
+}
+
+// select setup context of the next active connection
+static int sm_setup_select_next_active(void){
+    int i;
+    for (i=0;i<MAX_NR_SM_SETUP_CONTEXTS;i++){
+        int index = (sm_setup_context_next + i) % MAX_NR_SM_SETUP_CONTEXTS;
+        if (sm_setup_context_con_handles[index] == HCI_CON_HANDLE_INVALID) continue;
+        sm_setup_context_next = (index + 1) % MAX_NR_SM_SETUP_CONTEXTS;
+        setup = &sm_setup_contexts[index];
+        sm_active_connection_handle = sm_setup_context_con_handles[index];
+        return 1;
+    }
+    return 0;
+}
+
 // horizontal: initiator capabilities
 // vertial:    responder capabilities
 static const stk_generation_method_t stk_generation_method [5] [5] = {
@@ -520,15 +577,8 @@ static void sm_random_start(void * context){
     hci_send_cmd(&hci_le_rand);
 }
 
-#ifdef HAVE_AES128
-static void aes128_completed(btstack_timer_source_t * ts){
-    UNUSED(ts);
-    sm_handle_encryption_result(&aes128_result_flipped[0]);
-    sm_run();
-}
-#endif
-
 // pre: sm_aes128_state != SM_AES128_ACTIVE, hci_can_send_command == 1
+// pre: called from sm_run, software AES results are delivered by sm_run before it returns
 // context is made availabe to aes128 result handler by this
 static void sm_aes128_start(sm_key_t key, sm_key_t plaintext, void * context){
     sm_aes128_state = SM_AES128_ACTIVE;
@@ -546,11 +596,6 @@ static void sm_aes128_start(sm_key_t key, sm_key_t plaintext, void * context){
 
     // flip
     reverse_128(&result[0], &aes128_result_flipped[0]);
-
-    // deliver via timer
-    btstack_run_loop_set_timer_handler(&aes128_timer, &aes128_completed);
-    btstack_run_loop_set_timer(&aes128_timer, 0);    // no delay
-    btstack_run_loop_add_timer(&aes128_timer);
 #else
     sm_key_t key_flipped, plaintext_flipped;
     reverse_128(key, key_flipped);
@@ -771,11 +816,11 @@ static void sm_notify_client_index(uint8_t type, hci_con_handle_t con_handle, ui
     int identity_address_type;
     le_device_db_info(index, &identity_address_type, identity_address, NULL);
 
-    uint8_t event[19];
+    uint8_t event[20];
     sm_setup_event_base(event, sizeof(event), type, con_handle, addr_type, address);
     event[11] = identity_address_type;
     reverse_bd_addr(identity_address, &event[12]);
-    event[18] = index;
+    little_endian_store_16(event, 18, index);
     sm_dispatch_event(HCI_EVENT_PACKET, 0, event, sizeof(event));
 }
 
@@ -890,6 +935,59 @@ static void sm_address_resolution_start_lookup(uint8_t addr_type, hci_con_handle
     sm_notify_client_base(SM_EVENT_IDENTITY_RESOLVING_STARTED, con_handle, addr_type, addr);
 }
 
+#if MAX_NR_SM_RESOLVING_CACHE_ENTRIES > 0
+static void sm_resolving_cache_add(bd_addr_t address, sm_key_t irk, int le_db_index){
+    // reuse entry for same address, otherwise replace oldest one
+    sm_resolving_cache_entry_t * entry = NULL;
+    int i;
+    for (i=0;i<MAX_NR_SM_RESOLVING_CACHE_ENTRIES;i++){
+        if (memcmp(sm_resolving_cache[i].address, address, 6)) continue;
+        entry = &sm_resolving_cache[i];
+        break;
+    }
+    if (!entry){
+        entry = &sm_resolving_cache[sm_resolving_cache_next];
+        sm_resolving_cache_next = (sm_resolving_cache_next + 1) % MAX_NR_SM_RESOLVING_CACHE_ENTRIES;
+    }
+    memcpy(entry->address, address, 6);
+    memcpy(entry->irk, irk, 16);
+    entry->le_db_index = le_db_index;
+}
+
+// @returns LE Device DB index if address was resolved before and the entry still has the same IRK, -1 otherwise
+static int sm_resolving_cache_lookup(bd_addr_t address){
+    int i;
+    for (i=0;i<MAX_NR_SM_RESOLVING_CACHE_ENTRIES;i++){
+        sm_resolving_cache_entry_t * entry = &sm_resolving_cache[i];
+        if (entry->le_db_index < 0) continue;
+        if (memcmp(entry->address, address, 6)) continue;
+        int addr_type = BD_ADDR_TYPE_UNKNOWN;
+        sm_key_t irk;
+        if (entry->le_db_index < le_device_db_count()){
+            le_device_db_info(entry->le_db_index, &addr_type, NULL, irk);
+        }
+        if (addr_type > BD_ADDR_TYPE_LE_RANDOM || memcmp(entry->irk, irk, 16)){
+            // device was removed or re-bonded, invalidate stale entry
+            entry->le_db_index = -1;
+            continue;
+        }
+        return entry->le_db_index;
+    }
+    return -1;
+}
+#endif
+
+#ifdef HAVE_AES128
+// ah(irk, prand) == hash for the address under resolution, address = prand || hash
+static int sm_address_resolution_ah_matches(sm_key_t irk){
+    sm_key_t r_prime;
+    sm_key_t result;
+    sm_ah_r_prime(sm_address_resolution_address, r_prime);
+    btstack_aes128_calc(irk, r_prime, result);
+    return memcmp(&sm_address_resolution_address[3], &result[13], 3) == 0;
+}
+#endif
+
 int sm_address_resolution_lookup(uint8_t address_type, bd_addr_t address){
     // check if already in list
     btstack_linked_list_iterator_t it;
@@ -1162,11 +1260,11 @@ static int sm_key_distribution_all_received(sm_connection_t * sm_conn){
 }
 
 static void sm_done_for_handle(hci_con_handle_t con_handle){
-    if (sm_active_connection_handle == con_handle){
-        sm_timeout_stop();
-        sm_active_connection_handle = HCI_CON_HANDLE_INVALID;
-        log_info("sm: connection 0x%x released setup context", con_handle);
-    }
+    if (!sm_setup_select(con_handle)) return;
+    sm_timeout_stop();
+    sm_setup_context_con_handles[setup - sm_setup_contexts] = HCI_CON_HANDLE_INVALID;
+    sm_active_connection_handle = HCI_CON_HANDLE_INVALID;
+    log_info("sm: connection 0x%x released setup context", con_handle);
 }
 
 static int sm_key_distribution_flags_for_auth_req(void){
@@ -1366,9 +1464,12 @@ static void sm_key_distribution_handle_all_received(sm_connection_t * sm_conn){
         le_db_index = le_device_db_add(setup->sm_peer_addr_type, setup->sm_peer_address, setup->sm_peer_irk);
     }
 
-    sm_notify_client_index(SM_EVENT_IDENTITY_CREATED, sm_conn->sm_handle, setup->sm_peer_addr_type, setup->sm_peer_address, le_db_index);
+    if (le_db_index < 0){
+        log_error("sm: LE Device DB full, keys not stored");
+    }
 
     if (le_db_index >= 0){
+        sm_notify_client_index(SM_EVENT_IDENTITY_CREATED, sm_conn->sm_handle, setup->sm_peer_addr_type, setup->sm_peer_address, le_db_index);
         
 #ifdef ENABLE_LE_SIGNED_WRITE
         // store local CSRK
@@ -1409,7 +1510,7 @@ static void sm_key_distribution_handle_all_received(sm_connection_t * sm_conn){
 }
 
 static void sm_pairing_error(sm_connection_t * sm_conn, uint8_t reason){
-    setup->sm_pairing_failed_reason = reason;
+    sm_conn->sm_pairing_failed_reason = reason;
     sm_conn->sm_engine_state = SM_GENERAL_SEND_PAIRING_FAILED;
 }
 
@@ -1478,6 +1579,10 @@ static void sm_sc_cmac_done(uint8_t * hash){
 
     sm_connection_t * sm_conn = sm_cmac_connection;
     sm_cmac_connection = NULL;
+    if (!sm_setup_select(sm_conn->sm_handle)){
+        log_error("sm_sc_cmac_done: connection 0x%04x without setup context", sm_conn->sm_handle);
+        return;
+    }
     link_key_type_t link_key_type;
 
     switch (sm_conn->sm_engine_state){
@@ -1877,7 +1982,7 @@ static void sm_start_calculating_ltk_from_ediv_and_rand(sm_connection_t * sm_con
 }
 #endif
 
-static void sm_run(void){
+static void sm_run_once(void){
 
     btstack_linked_list_iterator_t it;    
 
@@ -2000,7 +2105,17 @@ static void sm_run(void){
     // -- Continue with CSRK device lookup by public or resolvable private address
     if (!sm_address_resolution_idle()){
         log_info("LE Device Lookup: device %u/%u", sm_address_resolution_test, le_device_db_count());
-        while (sm_address_resolution_test < le_device_db_count()){
+#if MAX_NR_SM_RESOLVING_CACHE_ENTRIES > 0
+        if (sm_address_resolution_test == 0 && sm_address_resolution_addr_type){
+            int cached_index = sm_resolving_cache_lookup(sm_address_resolution_address);
+            if (cached_index >= 0){
+                log_info("LE Device Lookup: found in resolving cache");
+                sm_address_resolution_test = cached_index;
+                sm_address_resolution_handle_event(ADDRESS_RESOLUTION_SUCEEDED);
+            }
+        }
+#endif
+        while (!sm_address_resolution_idle() && sm_address_resolution_test < le_device_db_count()){
             int addr_type;
             bd_addr_t addr;
             sm_key_t irk;
@@ -2018,6 +2133,19 @@ static void sm_run(void){
                 continue;
             }
 
+#ifdef HAVE_AES128
+            // software AES is synchronous: check all IRKs in a single pass
+            if (sm_address_resolution_ah_matches(irk)){
+                log_info("LE Device Lookup: matched resolvable private address");
+#if MAX_NR_SM_RESOLVING_CACHE_ENTRIES > 0
+                sm_resolving_cache_add(sm_address_resolution_address, irk, sm_address_resolution_test);
+#endif
+                sm_address_resolution_handle_event(ADDRESS_RESOLUTION_SUCEEDED);
+                break;
+            }
+            sm_address_resolution_test++;
+            continue;
+#else
             if (sm_aes128_state == SM_AES128_ACTIVE) break;
 
             log_info("LE Device Lookup: calculate AH");
@@ -2028,9 +2156,10 @@ static void sm_run(void){
             sm_address_resolution_ah_calculation_active = 1;
             sm_aes128_start(irk, r_prime, sm_address_resolution_context);   // keep context
             return;
+#endif
         }
 
-        if (sm_address_resolution_test >= le_device_db_count()){
+        if (!sm_address_resolution_idle() && sm_address_resolution_test >= le_device_db_count()){
             log_info("LE Device Lookup: not found");
             sm_address_resolution_handle_event(ADDRESS_RESOLUTION_FAILED);
         }
@@ -2038,7 +2167,7 @@ static void sm_run(void){
 
     // handle basic actions that don't requires the full context
     hci_connections_get_iterator(&it);
-    while((sm_active_connection_handle == HCI_CON_HANDLE_INVALID) && btstack_linked_list_iterator_has_next(&it)){
+    while((sm_setup_context_index(HCI_CON_HANDLE_INVALID) >= 0) && btstack_linked_list_iterator_has_next(&it)){
         hci_connection_t * hci_connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
         sm_connection_t  * sm_connection = &hci_connection->sm_connection;
         switch(sm_connection->sm_engine_state){
@@ -2069,14 +2198,18 @@ static void sm_run(void){
     // 
     // active connection handling
     // -- use loop to handle next connection if lock on setup context is released 
+    // -- visit each active connection once per run
 
+    int num_contexts_visited = 0;
     while (1) {
 
-        // Find connections that requires setup context and make active if no other is locked
+        // Find connections that requires setup context and make active while free setup contexts are available
         hci_connections_get_iterator(&it);
-        while((sm_active_connection_handle == HCI_CON_HANDLE_INVALID) && btstack_linked_list_iterator_has_next(&it)){
+        while(sm_setup_select(HCI_CON_HANDLE_INVALID) && btstack_linked_list_iterator_has_next(&it)){
             hci_connection_t * hci_connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
             sm_connection_t  * sm_connection = &hci_connection->sm_connection;
+            // - skip connections that already own a setup context
+            if (sm_setup_context_index(sm_connection->sm_handle) >= 0) continue;
             // - if no connection locked and we're ready/waiting for setup context, fetch it and start
             int done = 1;
             int err;
@@ -2095,6 +2228,21 @@ static void sm_run(void){
                     // don't lock sxetup context yet
                     done = 0;
                     break;
+#endif
+                case SM_GENERAL_SEND_PAIRING_FAILED:
+                    // PDU received in wrong state before setup context was locked, no need to lock it now
+                    if (l2cap_can_send_fixed_channel_packet_now(sm_connection->sm_handle, L2CAP_CID_SECURITY_MANAGER_PROTOCOL)){
+                        uint8_t buffer[2];
+                        buffer[0] = SM_CODE_PAIRING_FAILED;
+                        buffer[1] = sm_connection->sm_pairing_failed_reason;
+                        sm_connection->sm_engine_state = sm_connection->sm_role ? SM_RESPONDER_IDLE : SM_INITIATOR_CONNECTED;
+                        l2cap_send_connectionless(sm_connection->sm_handle, L2CAP_CID_SECURITY_MANAGER_PROTOCOL, (uint8_t*) buffer, sizeof(buffer));
+                    } else {
+                        l2cap_request_can_send_fix_channel_now_event(sm_connection->sm_handle, L2CAP_CID_SECURITY_MANAGER_PROTOCOL);
+                    }
+                    done = 0;
+                    break;
+#ifdef ENABLE_LE_PERIPHERAL
                 case SM_RESPONDER_PH1_PAIRING_REQUEST_RECEIVED:
                     sm_reset_setup();
                     sm_init_setup(sm_connection);
@@ -2102,8 +2250,7 @@ static void sm_run(void){
                     memcpy(&setup->sm_m_preq, &sm_connection->sm_m_preq, sizeof(sm_pairing_packet_t));
                     err = sm_stk_generation_init(sm_connection);
                     if (err){
-                        setup->sm_pairing_failed_reason = err;
-                        sm_connection->sm_engine_state = SM_GENERAL_SEND_PAIRING_FAILED;
+                        sm_pairing_error(sm_connection, err);
                         break;
                     }
                     sm_timeout_start(sm_connection);
@@ -2165,6 +2312,7 @@ static void sm_run(void){
             }
             if (done){
                 sm_active_connection_handle = sm_connection->sm_handle;
+                sm_setup_context_con_handles[setup - sm_setup_contexts] = sm_active_connection_handle;
                 log_info("sm: connection 0x%04x locked setup context as %s, state %u", sm_active_connection_handle, sm_connection->sm_role ? "responder" : "initiator", sm_connection->sm_engine_state);
             }
         }
@@ -2173,7 +2321,10 @@ static void sm_run(void){
         // active connection handling
         // 
 
-        if (sm_active_connection_handle == HCI_CON_HANDLE_INVALID) return;
+        // previous connection might have sent a command
+        if (!hci_can_send_command_packet_now()) return;
+
+        if (!sm_setup_select_next_active()) return;
 
         // assert that we could send a SM PDU - not needed for all of the following
         if (!l2cap_can_send_fixed_channel_packet_now(sm_active_connection_handle, L2CAP_CID_SECURITY_MANAGER_PROTOCOL)) {
@@ -2210,7 +2361,7 @@ static void sm_run(void){
             case SM_GENERAL_SEND_PAIRING_FAILED: {
                 uint8_t buffer[2];
                 buffer[0] = SM_CODE_PAIRING_FAILED;
-                buffer[1] = setup->sm_pairing_failed_reason;
+                buffer[1] = connection->sm_pairing_failed_reason;
                 connection->sm_engine_state = connection->sm_role ? SM_RESPONDER_IDLE : SM_INITIATOR_CONNECTED;
                 l2cap_send_connectionless(connection->sm_handle, L2CAP_CID_SECURITY_MANAGER_PROTOCOL, (uint8_t*) buffer, sizeof(buffer));
                 sm_done_for_handle(connection->sm_handle);
@@ -2653,11 +2804,36 @@ static void sm_run(void){
                 break;
         }
 
-        // check again if active connection was released
-        if (sm_active_connection_handle != HCI_CON_HANDLE_INVALID) break;
+        // check again if active connection was released, otherwise continue with next active connection
+        if (sm_active_connection_handle == HCI_CON_HANDLE_INVALID) continue;
+        num_contexts_visited++;
+        if (num_contexts_visited >= MAX_NR_SM_SETUP_CONTEXTS) break;
     }
 }
 
+// sm_run can get triggered while it's running, e.g. by an event handler calling sm_passkey_input or by
+// a CMAC done handler. Instead of nesting, another pass is requested.
+static void sm_run(void){
+    if (sm_run_active){
+        sm_run_requested = 1;
+        return;
+    }
+    sm_run_active = 1;
+    do {
+        sm_run_requested = 0;
+        sm_run_once();
+#ifdef HAVE_AES128
+        // software AES completes synchronously: deliver result and run again to let
+        // the same or other connections continue without a run loop iteration per AES block
+        if (sm_aes128_state == SM_AES128_ACTIVE){
+            sm_handle_encryption_result(&aes128_result_flipped[0]);
+            sm_run_requested = 1;
+        }
+#endif
+    } while (sm_run_requested);
+    sm_run_active = 0;
+}
+
 // note: aes engine is ready as we just got the aes result
 static void sm_handle_encryption_result(uint8_t * data){
 
@@ -2670,6 +2846,11 @@ static void sm_handle_encryption_result(uint8_t * data){
         reverse_24(data, hash);
         if (memcmp(&sm_address_resolution_address[3], hash, 3) == 0){
             log_info("LE Device Lookup: matched resolvable private address");
+#if MAX_NR_SM_RESOLVING_CACHE_ENTRIES > 0
+            sm_key_t irk;
+            le_device_db_info(sm_address_resolution_test, NULL, NULL, irk);
+            sm_resolving_cache_add(sm_address_resolution_address, irk, sm_address_resolution_test);
+#endif
             sm_address_resolution_handle_event(ADDRESS_RESOLUTION_SUCEEDED);
             return;
         }
@@ -2722,6 +2903,10 @@ static void sm_handle_encryption_result(uint8_t * data){
     // retrieve sm_connection provided to sm_aes128_start_encryption
     sm_connection_t * connection = (sm_connection_t*) sm_aes128_context;
     if (!connection) return;
+    if (!sm_setup_select(connection->sm_handle)){
+        log_error("sm_handle_encryption_result: connection 0x%04x without setup context", connection->sm_handle);
+        return;
+    }
     switch (connection->sm_engine_state){
         case SM_PH2_C1_W4_ENC_A:
         case SM_PH2_C1_W4_ENC_C:
@@ -2743,8 +2928,7 @@ static void sm_handle_encryption_result(uint8_t * data){
             reverse_128(data, peer_confirm_test);
             log_info_key("c1!", peer_confirm_test);
             if (memcmp(setup->sm_peer_confirm, peer_confirm_test, 16) != 0){
-                setup->sm_pairing_failed_reason = SM_REASON_CONFIRM_VALUE_FAILED;
-                connection->sm_engine_state = SM_GENERAL_SEND_PAIRING_FAILED;
+                sm_pairing_error(connection, SM_REASON_CONFIRM_VALUE_FAILED);
                 return;
             }
             if (IS_RESPONDER(connection->sm_role)){
@@ -2950,6 +3134,10 @@ static void sm_handle_random_result(uint8_t * data){
     // retrieve sm_connection provided to sm_random_start
     sm_connection_t * connection = (sm_connection_t *) sm_random_context;
     if (!connection) return;
+    if (!sm_setup_select(connection->sm_handle)){
+        log_error("sm_handle_random_result: connection 0x%04x without setup context", connection->sm_handle);
+        return;
+    }
     switch (connection->sm_engine_state){
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
         case SM_SC_W4_GET_RANDOM_A:
@@ -3183,6 +3371,10 @@ static void sm_event_packet_handler (uint8_t packet_type, uint16_t channel, uint
                             sm_done_for_handle(sm_conn->sm_handle);
                             break;                        
                         case SM_PH2_W4_CONNECTION_ENCRYPTED:
+                            if (!sm_setup_select(con_handle)){
+                                log_error("Encryption change: connection 0x%04x without setup context", con_handle);
+                                break;
+                            }
                             if (IS_RESPONDER(sm_conn->sm_role)){
                                 // slave
                                 if (setup->sm_use_secure_connections){
@@ -3346,6 +3538,7 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
 
     sm_connection_t * sm_conn = sm_get_connection_for_handle(con_handle);
     if (!sm_conn) return;
+    int have_setup = sm_setup_select(con_handle);
 
     if (packet[0] == SM_CODE_PAIRING_FAILED){
         sm_conn->sm_engine_state = sm_conn->sm_role ? SM_RESPONDER_IDLE : SM_INITIATOR_CONNECTED;
@@ -3367,6 +3560,22 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
         return;
     }
 
+    // only PDUs that start pairing are accepted without setup context
+    if (!have_setup){
+        switch (sm_conn->sm_engine_state){
+            case SM_GENERAL_TIMEOUT:
+            case SM_INITIATOR_CONNECTED:
+            case SM_RESPONDER_IDLE:
+            case SM_RESPONDER_SEND_SECURITY_REQUEST:
+            case SM_RESPONDER_PH1_W4_PAIRING_REQUEST:
+                break;
+            default:
+                log_error("sm_pdu_handler: pdu 0x%02x in state %u without setup context", packet[0], sm_conn->sm_engine_state);
+                sm_pdu_received_in_wrong_state(sm_conn);
+                return;
+        }
+    }
+
     switch (sm_conn->sm_engine_state){
         
         // a sm timeout requries a new physical connection
@@ -3409,8 +3618,7 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
             memcpy(&setup->sm_s_pres, packet, sizeof(sm_pairing_packet_t));
             err = sm_stk_generation_init(sm_conn);
             if (err){
-                setup->sm_pairing_failed_reason = err;
-                sm_conn->sm_engine_state = SM_GENERAL_SEND_PAIRING_FAILED;
+                sm_pairing_error(sm_conn, err);
                 break;
             }
 
@@ -3641,8 +3849,7 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
 
             // handle user cancel pairing?
             if (setup->sm_user_response == SM_USER_RESPONSE_DECLINE){
-                setup->sm_pairing_failed_reason = SM_REASON_PASSKEYT_ENTRY_FAILED;
-                sm_conn->sm_engine_state = SM_GENERAL_SEND_PAIRING_FAILED;
+                sm_pairing_error(sm_conn, SM_REASON_PASSKEYT_ENTRY_FAILED);
                 break;
             }
 
@@ -3812,9 +4019,19 @@ void sm_init(void){
     sm_address_resolution_ah_calculation_active = 0;
     sm_address_resolution_mode = ADDRESS_RESOLUTION_IDLE;
     sm_address_resolution_general_queue = NULL;
+#if MAX_NR_SM_RESOLVING_CACHE_ENTRIES > 0
+    for (i=0;i<MAX_NR_SM_RESOLVING_CACHE_ENTRIES;i++){
+        sm_resolving_cache[i].le_db_index = -1;
+    }
+    sm_resolving_cache_next = 0;
+#endif
     
     gap_random_adress_update_period = 15 * 60 * 1000L;
     sm_active_connection_handle = HCI_CON_HANDLE_INVALID;
+    for (i=0;i<MAX_NR_SM_SETUP_CONTEXTS;i++){
+        sm_setup_context_con_handles[i] = HCI_CON_HANDLE_INVALID;
+    }
+    sm_setup_context_next = 0;
 
     test_use_fixed_local_csrk = 0;
 
@@ -3997,6 +4214,7 @@ void sm_authorization_grant(hci_con_handle_t con_handle){
 void sm_bonding_decline(hci_con_handle_t con_handle){
     sm_connection_t * sm_conn = sm_get_connection_for_handle(con_handle);
     if (!sm_conn) return;     // wrong connection
+    if (!sm_setup_select(con_handle)) return;   // not pairing
     setup->sm_user_response = SM_USER_RESPONSE_DECLINE;
 
     if (sm_conn->sm_engine_state == SM_PH1_W4_USER_RESPONSE){
@@ -4021,6 +4239,7 @@ void sm_bonding_decline(hci_con_handle_t con_handle){
 void sm_just_works_confirm(hci_con_handle_t con_handle){
     sm_connection_t * sm_conn = sm_get_connection_for_handle(con_handle);
     if (!sm_conn) return;     // wrong connection
+    if (!sm_setup_select(con_handle)) return;   // not pairing
     setup->sm_user_response = SM_USER_RESPONSE_CONFIRM;
     if (sm_conn->sm_engine_state == SM_PH1_W4_USER_RESPONSE){
         if (setup->sm_use_secure_connections){
@@ -4047,6 +4266,7 @@ void sm_numeric_comparison_confirm(hci_con_handle_t con_handle){
 void sm_passkey_input(hci_con_handle_t con_handle, uint32_t passkey){
     sm_connection_t * sm_conn = sm_get_connection_for_handle(con_handle);
     if (!sm_conn) return;     // wrong connection
+    if (!sm_setup_select(con_handle)) return;   // not pairing
     sm_reset_tk();
     big_endian_store_32(setup->sm_tk, 12, passkey);
     setup->sm_user_response = SM_USER_RESPONSE_PASSKEY;
@@ -4066,6 +4286,7 @@ void sm_passkey_input(hci_con_handle_t con_handle, uint32_t passkey){
 void sm_keypress_notification(hci_con_handle_t con_handle, uint8_t action){
     sm_connection_t * sm_conn = sm_get_connection_for_handle(con_handle);
     if (!sm_conn) return;     // wrong connection
+    if (!sm_setup_select(con_handle)) return;   // not pairing
     if (action > SM_KEYPRESS_PASSKEY_ENTRY_COMPLETED) return;
     setup->sm_keypress_notification = action;
     sm_run();
@@ -708,6 +708,22 @@ typedef uint8_t sm_key_t[16];
  */    
 #define GATT_EVENT_MTU                                           0xAB
 
+/**
+ * @format H244
+ * @param handle
+ * @param value_handle
+ * @param bytes_sent
+ * @param total_length
+ */
+#define GATT_EVENT_WRITE_STREAM_PROGRESS                         0xAC
+
+/**
+ * @format H1
+ * @param handle
+ * @param status
+ */
+#define GATT_EVENT_WRITE_STREAM_COMPLETE                         0xAD
+
 /** 
  * @format H2
  * @param handle
@@ -2096,6 +2096,66 @@ static inline uint16_t gatt_event_mtu_get_MTU(const uint8_t * event){
 }
 #endif
 
+#ifdef ENABLE_BLE
+/**
+ * @brief Get field handle from event GATT_EVENT_WRITE_STREAM_PROGRESS
+ * @param event packet
+ * @return handle
+ * @note: btstack_type H
+ */
+static inline hci_con_handle_t gatt_event_write_stream_progress_get_handle(const uint8_t * event){
+    return little_endian_read_16(event, 2);
+}
+/**
+ * @brief Get field value_handle from event GATT_EVENT_WRITE_STREAM_PROGRESS
+ * @param event packet
+ * @return value_handle
+ * @note: btstack_type 2
+ */
+static inline uint16_t gatt_event_write_stream_progress_get_value_handle(const uint8_t * event){
+    return little_endian_read_16(event, 4);
+}
+/**
+ * @brief Get field bytes_sent from event GATT_EVENT_WRITE_STREAM_PROGRESS
+ * @param event packet
+ * @return bytes_sent
+ * @note: btstack_type 4
+ */
+static inline uint32_t gatt_event_write_stream_progress_get_bytes_sent(const uint8_t * event){
+    return little_endian_read_32(event, 6);
+}
+/**
+ * @brief Get field total_length from event GATT_EVENT_WRITE_STREAM_PROGRESS
+ * @param event packet
+ * @return total_length
+ * @note: btstack_type 4
+ */
+static inline uint32_t gatt_event_write_stream_progress_get_total_length(const uint8_t * event){
+    return little_endian_read_32(event, 10);
+}
+#endif
+
+#ifdef ENABLE_BLE
+/**
+ * @brief Get field handle from event GATT_EVENT_WRITE_STREAM_COMPLETE
+ * @param event packet
+ * @return handle
+ * @note: btstack_type H
+ */
+static inline hci_con_handle_t gatt_event_write_stream_complete_get_handle(const uint8_t * event){
+    return little_endian_read_16(event, 2);
+}
+/**
+ * @brief Get field status from event GATT_EVENT_WRITE_STREAM_COMPLETE
+ * @param event packet
+ * @return status
+ * @note: btstack_type 1
+ */
+static inline uint8_t gatt_event_write_stream_complete_get_status(const uint8_t * event){
+    return event[4];
+}
+#endif
+
 /**
  * @brief Get field handle from event ATT_EVENT_MTU_EXCHANGE_COMPLETE
  * @param event packet
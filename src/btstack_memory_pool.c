@@ -42,7 +42,9 @@
  *
  *  Fixed-size block allocation
  *
- *  Free blocks are kept in singly linked list
+ *  Free blocks are kept in singly linked list and carry a tag word that identifies them as free
+ *  for this pool. On free, a block without the tag is known to be in use, so double frees are
+ *  detected in O(1). The free list is only walked if the tag is found, as it might be user data.
  *
  */
 
@@ -53,47 +55,95 @@
 
 typedef struct node {
     struct node * next;
+    uintptr_t     tag;
 } node_t;
 
+#define BTSTACK_MEMORY_POOL_FREE_TAG 0x46524545
+
+static uintptr_t btstack_memory_pool_free_tag(btstack_memory_pool_t *pool){
+    return ((uintptr_t) pool) ^ BTSTACK_MEMORY_POOL_FREE_TAG;
+}
+
+static int btstack_memory_pool_block_is_free(btstack_memory_pool_t *pool, node_t * node){
+    if (node->tag != btstack_memory_pool_free_tag(pool)) return 0;
+    node_t * it;
+    for (it = (node_t *) pool->free_blocks; it ; it = it->next){
+        if (it == node) return 1;
+    }
+    return 0;
+}
+
+static void btstack_memory_pool_add_block(btstack_memory_pool_t *pool, node_t * node){
+    node->next  = (node_t *) pool->free_blocks;
+    node->tag   = btstack_memory_pool_free_tag(pool);
+    pool->free_blocks = node;
+}
+
 void btstack_memory_pool_create(btstack_memory_pool_t *pool, void * storage, int count, int block_size){
-    node_t *free_blocks = (node_t*) pool;
     char   *mem_ptr = (char *) storage;
     int i;
     
     // create singly linked list of all available blocks
-    free_blocks->next = NULL;
+    pool->free_blocks = NULL;
     for (i = 0 ; i < count ; i++){
-        btstack_memory_pool_free(pool, mem_ptr);
+        btstack_memory_pool_add_block(pool, (node_t *) mem_ptr);
         mem_ptr += block_size;
     }
+
+#ifdef ENABLE_MEMORY_POOL_STATISTICS
+    pool->statistics.blocks_in_use = 0;
+    pool->statistics.blocks_in_use_max = 0;
+    pool->statistics.allocation_failures = 0;
+    pool->statistics.double_frees = 0;
+#endif
 }
 
 void * btstack_memory_pool_get(btstack_memory_pool_t *pool){
-    node_t *free_blocks = (node_t*) pool;
-    
-    if (!free_blocks->next) return NULL;
+    node_t *node = (node_t *) pool->free_blocks;
+
+    if (!node) {
+#ifdef ENABLE_MEMORY_POOL_STATISTICS
+        pool->statistics.allocation_failures++;
+#endif
+        return NULL;
+    }
     
     // remove first
-    node_t *node      = free_blocks->next;
-    free_blocks->next = node->next;
-    
+    pool->free_blocks = node->next;
+    node->tag = 0;
+
+#ifdef ENABLE_MEMORY_POOL_STATISTICS
+    pool->statistics.blocks_in_use++;
+    if (pool->statistics.blocks_in_use > pool->statistics.blocks_in_use_max){
+        pool->statistics.blocks_in_use_max = pool->statistics.blocks_in_use;
+    }
+#endif
+
     return (void*) node;
 }
 
 void btstack_memory_pool_free(btstack_memory_pool_t *pool, void * block){
-    node_t *free_blocks = (node_t*) pool;
-    node_t *node        = (node_t*) block;
+    node_t *node = (node_t*) block;
 
     // raise error and abort if node already in list
-    node_t * it;
-    for (it = free_blocks->next; it ; it = it->next){
-        if (it == node) {
-            log_error("btstack_memory_pool_free: block %p freed twice for pool %p", block, pool);
-            return;
-        }
+    if (btstack_memory_pool_block_is_free(pool, node)){
+        log_error("btstack_memory_pool_free: block %p freed twice for pool %p", block, pool);
+#ifdef ENABLE_MEMORY_POOL_STATISTICS
+        pool->statistics.double_frees++;
+#endif
+        return;
     }
 
     // add block as node to list
-    node->next          = free_blocks->next;
-    free_blocks->next   = node;
+    btstack_memory_pool_add_block(pool, node);
+
+#ifdef ENABLE_MEMORY_POOL_STATISTICS
+    pool->statistics.blocks_in_use--;
+#endif
+}
+
+#ifdef ENABLE_MEMORY_POOL_STATISTICS
+const btstack_memory_pool_statistics_t * btstack_memory_pool_get_statistics(btstack_memory_pool_t *pool){
+    return &pool->statistics;
 }
+#endif
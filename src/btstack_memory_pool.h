@@ -40,20 +40,39 @@
  *
  *  @Brief Fixed-size block allocation
  *
- *  @Assumption block_size >= sizeof(void *)
+ *  @Assumption block_size >= 2 * sizeof(void *)
  *  @Assumption size of storage >= count * block_size
  *
- *  @Note minimal implementation, no error checking/handling
+ *  @Note minimal implementation, double frees are detected and ignored, no other error checking/handling
  */
 
 #ifndef __btstack_memory_pool_H
 #define __btstack_memory_pool_H
 
+#include "btstack_config.h"
+
+#include <stdint.h>
+
 #if defined __cplusplus
 extern "C" {
 #endif
 
-typedef void * btstack_memory_pool_t;
+#ifdef ENABLE_MEMORY_POOL_STATISTICS
+typedef struct {
+    uint16_t blocks_in_use;
+    uint16_t blocks_in_use_max;     // high-water mark
+    uint16_t allocation_failures;
+    uint16_t double_frees;
+} btstack_memory_pool_statistics_t;
+#endif
+
+typedef struct {
+    // singly linked list of free blocks
+    void * free_blocks;
+#ifdef ENABLE_MEMORY_POOL_STATISTICS
+    btstack_memory_pool_statistics_t statistics;
+#endif
+} btstack_memory_pool_t;
 
 // initialize memory pool with with given storage, block size and count
 void   btstack_memory_pool_create(btstack_memory_pool_t *pool, void * storage, int count, int block_size);
@@ -64,6 +83,11 @@ void * btstack_memory_pool_get(btstack_memory_pool_t *pool);
 // return previously reserved block to memory pool
 void   btstack_memory_pool_free(btstack_memory_pool_t *pool, void * block);
 
+#ifdef ENABLE_MEMORY_POOL_STATISTICS
+// get block usage and error counters of pool
+const btstack_memory_pool_statistics_t * btstack_memory_pool_get_statistics(btstack_memory_pool_t *pool);
+#endif
+
 #if defined __cplusplus
 }
 #endif
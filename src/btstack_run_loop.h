@@ -86,6 +86,8 @@ typedef struct btstack_data_source {
 
 typedef struct btstack_timer_source {
     btstack_linked_item_t item; 
+    // list head or next field of previous timer while timer is active, NULL otherwise (used by btstack_timer_wheel)
+    btstack_linked_item_t ** pprev;
     // timeout in system ticks (HAVE_EMBEDDED_TICK) or milliseconds (HAVE_EMBEDDED_TIME_MS)
     uint32_t timeout;
     // will be called when timer fired
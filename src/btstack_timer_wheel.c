@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define __BTSTACK_FILE__ "btstack_timer_wheel.c"
+
+/*
+ *  btstack_timer_wheel.c
+ *
+ *  Timers are kept in doubly linked lists, one per slot. A timer that expires less than 
+ *  16^(level+1) units after the current time is stored on that level in the slot given by 
+ *  the corresponding 4 bits of its timeout. When the wheel time reaches the start of a 
+ *  slot on a higher level, its timers are re-distributed to the lower levels. Timers on 
+ *  level 0 are moved to the expired list when the wheel time reaches their timeout.
+ */
+
+#include "btstack_timer_wheel.h"
+#include "btstack_debug.h"
+
+#include <stddef.h>
+
+#define SLOT_MASK (BTSTACK_TIMER_WHEEL_SLOTS - 1)
+
+static void btstack_timer_wheel_insert(btstack_linked_item_t ** head, btstack_timer_source_t * ts){
+    btstack_linked_item_t * next = *head;
+    ts->item.next = next;
+    if (next){
+        ((btstack_timer_source_t *) next)->pprev = &ts->item.next;
+    }
+    ts->pprev = head;
+    *head = (btstack_linked_item_t *) ts;
+}
+
+static void btstack_timer_wheel_append_expired(btstack_timer_wheel_t * wheel, btstack_timer_source_t * ts){
+    ts->item.next = NULL;
+    ts->pprev = wheel->expired_tail;
+    *wheel->expired_tail = (btstack_linked_item_t *) ts;
+    wheel->expired_tail = &ts->item.next;
+}
+
+void btstack_timer_wheel_init(btstack_timer_wheel_t * wheel, uint32_t now){
+    int level;
+    int slot;
+    wheel->now = now;
+    wheel->expired = NULL;
+    wheel->expired_tail = &wheel->expired;
+    for (level = 0; level < BTSTACK_TIMER_WHEEL_LEVELS; level++){
+        wheel->occupied[level] = 0;
+        for (slot = 0; slot < BTSTACK_TIMER_WHEEL_SLOTS; slot++){
+            wheel->slots[level][slot] = NULL;
+        }
+    }
+}
+
+static void btstack_timer_wheel_schedule(btstack_timer_wheel_t * wheel, btstack_timer_source_t * ts){
+    int32_t delta = (int32_t)(ts->timeout - wheel->now);
+    if (delta <= 0){
+        btstack_timer_wheel_append_expired(wheel, ts);
+        return;
+    }
+    int level = 0;
+    while (level < (BTSTACK_TIMER_WHEEL_LEVELS - 1) && ((uint32_t) delta >> ((level + 1) * BTSTACK_TIMER_WHEEL_SLOT_BITS))){
+        level++;
+    }
+    int slot = (ts->timeout >> (level * BTSTACK_TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK;
+    btstack_timer_wheel_insert(&wheel->slots[level][slot], ts);
+    wheel->occupied[level] |= 1 << slot;
+}
+
+void btstack_timer_wheel_add(btstack_timer_wheel_t * wheel, btstack_timer_source_t * ts){
+    if (ts->pprev){
+        log_error("btstack_timer_wheel_add error: timer to add already active!");
+        return;
+    }
+    btstack_timer_wheel_schedule(wheel, ts);
+    log_debug("Added timer %p at %u\n", ts, ts->timeout);
+}
+
+int btstack_timer_wheel_remove(btstack_timer_wheel_t * wheel, btstack_timer_source_t * ts){
+    btstack_linked_item_t ** pprev = ts->pprev;
+    if (!pprev) return 0;
+
+    btstack_linked_item_t * next = ts->item.next;
+    *pprev = next;
+    if (next){
+        ((btstack_timer_source_t *) next)->pprev = pprev;
+    } else if (wheel->expired_tail == &ts->item.next){
+        // last entry of expired list
+        wheel->expired_tail = pprev;
+    } else if (*pprev == NULL){
+        // slot became empty if pprev points to slot list head
+        btstack_linked_list_t * first_slot = &wheel->slots[0][0];
+        if (pprev >= first_slot && pprev < first_slot + (BTSTACK_TIMER_WHEEL_LEVELS * BTSTACK_TIMER_WHEEL_SLOTS)){
+            int index = pprev - first_slot;
+            wheel->occupied[index >> BTSTACK_TIMER_WHEEL_SLOT_BITS] &= ~(1 << (index & SLOT_MASK));
+        }
+    }
+    ts->item.next = NULL;
+    ts->pprev = NULL;
+    return 1;
+}
+
+int btstack_timer_wheel_empty(btstack_timer_wheel_t * wheel){
+    if (wheel->expired) return 0;
+    int level;
+    for (level = 0; level < BTSTACK_TIMER_WHEEL_LEVELS; level++){
+        if (wheel->occupied[level]) return 0;
+    }
+    return 1;
+}
+
+// time from wheel->now until next non-empty slot needs to be processed
+static int btstack_timer_wheel_next_event(btstack_timer_wheel_t * wheel, uint32_t * delta){
+    int found = 0;
+    uint32_t min_delta = 0;
+    int level;
+    for (level = 0; level < BTSTACK_TIMER_WHEEL_LEVELS; level++){
+        uint32_t occupied = wheel->occupied[level];
+        if (!occupied) continue;
+        int shift = level * BTSTACK_TIMER_WHEEL_SLOT_BITS;
+        uint32_t block = wheel->now >> shift;
+        int current = block & SLOT_MASK;
+        // find first occupied slot after the current one, all slots are ahead of current time
+        int distance;
+        for (distance = 1; distance <= BTSTACK_TIMER_WHEEL_SLOTS; distance++){
+            if (occupied & (1 << ((current + distance) & SLOT_MASK))) break;
+        }
+        uint32_t level_delta = ((block + distance) << shift) - wheel->now;
+        if (!found || level_delta < min_delta){
+            min_delta = level_delta;
+            found = 1;
+        }
+    }
+    *delta = min_delta;
+    return found;
+}
+
+// move all timers with timeout <= now to expired list
+void btstack_timer_wheel_advance(btstack_timer_wheel_t * wheel, uint32_t now){
+    while ((int32_t)(now - wheel->now) > 0){
+        uint32_t delta;
+        if (!btstack_timer_wheel_next_event(wheel, &delta) || delta > now - wheel->now){
+            wheel->now = now;
+            return;
+        }
+        wheel->now += delta;
+
+        // re-distribute slots starting at current time, from top to bottom
+        int level;
+        for (level = BTSTACK_TIMER_WHEEL_LEVELS - 1; level >= 0; level--){
+            int shift = level * BTSTACK_TIMER_WHEEL_SLOT_BITS;
+            if (level && (wheel->now & ((1u << shift) - 1))) continue;
+            int slot = (wheel->now >> shift) & SLOT_MASK;
+            btstack_timer_source_t * ts = (btstack_timer_source_t *) wheel->slots[level][slot];
+            wheel->slots[level][slot] = NULL;
+            wheel->occupied[level] &= ~(1 << slot);
+            while (ts){
+                btstack_timer_source_t * next = (btstack_timer_source_t *) ts->item.next;
+                btstack_timer_wheel_schedule(wheel, ts);
+                ts = next;
+            }
+        }
+    }
+}
+
+int btstack_timer_wheel_get_next_timeout(btstack_timer_wheel_t * wheel, uint32_t * timeout){
+    if (wheel->expired){
+        *timeout = wheel->now;
+        return 1;
+    }
+    uint32_t delta;
+    if (!btstack_timer_wheel_next_event(wheel, &delta)) return 0;
+    *timeout = wheel->now + delta;
+    return 1;
+}
+
+btstack_timer_source_t * btstack_timer_wheel_get_expired(btstack_timer_wheel_t * wheel, uint32_t now){
+    if (!wheel->expired){
+        btstack_timer_wheel_advance(wheel, now);
+    }
+    btstack_timer_source_t * ts = (btstack_timer_source_t *) wheel->expired;
+    if (!ts) return NULL;
+    btstack_timer_wheel_remove(wheel, ts);
+    return ts;
+}
+
+void btstack_timer_wheel_dump(btstack_timer_wheel_t * wheel){
+    btstack_linked_item_t *it;
+    int i = 0;
+    int level;
+    int slot;
+    for (it = wheel->expired; it ; it = it->next){
+        btstack_timer_source_t *ts = (btstack_timer_source_t*) it;
+        log_info("timer %u, timeout %u (expired)\n", i++, (unsigned int) ts->timeout);
+    }
+    for (level = 0; level < BTSTACK_TIMER_WHEEL_LEVELS; level++){
+        for (slot = 0; slot < BTSTACK_TIMER_WHEEL_SLOTS; slot++){
+            for (it = wheel->slots[level][slot]; it ; it = it->next){
+                btstack_timer_source_t *ts = (btstack_timer_source_t*) it;
+                log_info("timer %u, timeout %u (level %u, slot %u)\n", i++, (unsigned int) ts->timeout, level, slot);
+            }
+        }
+    }
+}
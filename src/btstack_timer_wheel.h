@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  btstack_timer_wheel.h
+ *
+ *  Hierarchical timer wheel used by the run loop implementations to manage timers.
+ *  Adding and removing a timer is O(1). Each timer gets moved to a lower level
+ *  at most once per level before it expires.
+ */
+
+#ifndef __BTSTACK_TIMER_WHEEL_H
+#define __BTSTACK_TIMER_WHEEL_H
+
+#include "btstack_run_loop.h"
+
+#include <stdint.h>
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+// 8 levels with 16 slots each cover the full 32-bit timeout range
+#define BTSTACK_TIMER_WHEEL_SLOT_BITS 4
+#define BTSTACK_TIMER_WHEEL_SLOTS     (1 << BTSTACK_TIMER_WHEEL_SLOT_BITS)
+#define BTSTACK_TIMER_WHEEL_LEVELS    (32 / BTSTACK_TIMER_WHEEL_SLOT_BITS)
+
+typedef struct {
+    // all timers with timeout <= now have been moved to the expired list
+    uint32_t now;
+    // expired timers in order of their timeout
+    btstack_linked_list_t    expired;
+    btstack_linked_item_t ** expired_tail;
+    // bitmap of non-empty slots per level
+    uint16_t occupied[BTSTACK_TIMER_WHEEL_LEVELS];
+    btstack_linked_list_t slots[BTSTACK_TIMER_WHEEL_LEVELS][BTSTACK_TIMER_WHEEL_SLOTS];
+} btstack_timer_wheel_t;
+
+/**
+ * @brief Init timer wheel
+ * @param wheel
+ * @param now current time in the unit used for timer timeouts
+ */
+void btstack_timer_wheel_init(btstack_timer_wheel_t * wheel, uint32_t now);
+
+/**
+ * @brief Add timer, timer->timeout has to be set
+ * @param wheel
+ * @param timer
+ * @note timeouts are compared as signed 32-bit difference, i.e. timeouts up to 2^31 - 1 ahead are supported
+ */
+void btstack_timer_wheel_add(btstack_timer_wheel_t * wheel, btstack_timer_source_t * timer);
+
+/**
+ * @brief Remove timer
+ * @param wheel
+ * @param timer
+ * @return 1 if timer was active
+ */
+int btstack_timer_wheel_remove(btstack_timer_wheel_t * wheel, btstack_timer_source_t * timer);
+
+/**
+ * @brief Check if there are active timers
+ * @param wheel
+ * @return 1 if no timers active
+ */
+int btstack_timer_wheel_empty(btstack_timer_wheel_t * wheel);
+
+/**
+ * @brief Get time when wheel has to be serviced next
+ * @param wheel
+ * @param timeout
+ * @return 0 if no timers active
+ * @note the returned timeout can be earlier than the earliest timer as timers get moved to lower 
+ *       levels on their way to expiration. btstack_timer_wheel_get_expired might return NULL then.
+ */
+int btstack_timer_wheel_get_next_timeout(btstack_timer_wheel_t * wheel, uint32_t * timeout);
+
+/**
+ * @brief Advance wheel time and move timers with timeout <= now to the list of expired timers
+ * @param wheel
+ * @param now
+ * @note wheel time has to be advanced at least every 2^31 units, e.g. after waiting without timeout
+ */
+void btstack_timer_wheel_advance(btstack_timer_wheel_t * wheel, uint32_t now);
+
+/**
+ * @brief Remove and return next timer with timeout <= now
+ * @param wheel
+ * @param now
+ * @return timer or NULL if no timer expired
+ */
+btstack_timer_source_t * btstack_timer_wheel_get_expired(btstack_timer_wheel_t * wheel, uint32_t now);
+
+/**
+ * @brief Log all active timers
+ * @param wheel
+ */
+void btstack_timer_wheel_dump(btstack_timer_wheel_t * wheel);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // __BTSTACK_TIMER_WHEEL_H
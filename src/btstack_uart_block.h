@@ -138,6 +138,20 @@ typedef struct {
      */
     void (*set_wakeup_handler)(void (*wakeup_handler)(void));
 
+    // support for streaming receive, optional
+
+    /**
+     * set callback for data received in streaming mode
+     * @param stream_handler called with number of bytes stored in buffer provided to receive_stream
+     */
+    void (*set_stream_received)(void (*stream_handler)(uint16_t len));
+
+    /**
+     * receive all data available, up to len bytes. stream handler is called as soon as at least one byte was received
+     * allows to receive multiple packets with a single read, use receive_block if NULL
+     */
+    void (*receive_stream)(uint8_t *buffer, uint16_t len);
+
 } btstack_uart_block_t;
 
 // common implementations
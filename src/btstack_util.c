@@ -353,4 +353,17 @@ uint32_t btstack_atoi(const char *str){
         val = (val * 10) + (uint8_t)(chr - '0');
         str++;
     }
-}
\ No newline at end of file
+}
+
+uint32_t btstack_crc32(const uint8_t * data, int len){
+    uint32_t crc = 0xffffffff;
+    int i;
+    for (i = 0; i < len; i++){
+        crc ^= data[i];
+        int bit;
+        for (bit = 0; bit < 8; bit++){
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
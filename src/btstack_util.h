@@ -253,6 +253,14 @@ int  uuid_has_bluetooth_prefix(const uint8_t * uuid128);
  */
 uint32_t btstack_atoi(const char *str);
 
+/**
+ * @brief Calculate CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320) e.g. to check records in persistent storage
+ * @param data
+ * @param len
+ * @return crc32
+ */
+uint32_t btstack_crc32(const uint8_t * data, int len);
+
 /* API_END */
 
 #if defined __cplusplus
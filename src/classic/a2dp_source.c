@@ -48,6 +48,7 @@
 #include "avdtp_util.h"
 #include "avdtp_source.h"
 #include "a2dp_source.h"
+#include "a2dp_source_pacing.h"
 
 #define AVDTP_MEDIA_PAYLOAD_HEADER_SIZE 12
 
@@ -60,7 +61,13 @@ static avdtp_stream_endpoint_context_t sc;
 static uint16_t avdtp_cid = 0;
 static int next_remote_sep_index_to_query = 0;
 
+static a2dp_source_pacing_t pacing;
+static btstack_timer_source_t pacing_timer;
+static uint8_t pacing_seid = 0;
+static int reserved_media_payload_size = 0;
+
 static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
+static void a2dp_source_pacing_stop(void);
 
 void a2dp_source_create_sdp_record(uint8_t * service, uint32_t service_record_handle, uint16_t supported_features, const char * service_name, const char * service_provider_name){
     uint8_t* attribute;
@@ -324,6 +331,7 @@ static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packe
                                             break;
                                         }
                                         case AVDTP_SI_SUSPEND:{
+                                            a2dp_source_pacing_stop();
                                             uint8_t event[6];
                                             int pos = 0;
                                             event[pos++] = HCI_EVENT_A2DP_META;
@@ -337,6 +345,7 @@ static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packe
                                         }
                                         case AVDTP_SI_ABORT:
                                         case AVDTP_SI_CLOSE:{
+                                            a2dp_source_pacing_stop();
                                             uint8_t event[6];
                                             int pos = 0;
                                             event[pos++] = HCI_EVENT_A2DP_META;
@@ -445,8 +454,15 @@ uint8_t a2dp_source_stream_endpoint_ready(uint8_t local_seid){
     return (stream_endpoint->state == AVDTP_STREAM_ENDPOINT_STREAMING);
 }
 
+btstack_sbc_encoder_state_t * a2dp_source_get_sbc_encoder_state(uint8_t local_seid){
+    if (!sc.local_stream_endpoint || avdtp_stream_endpoint_seid(sc.local_stream_endpoint) != local_seid){
+        log_error("No configured stream_endpoint with seid %d", local_seid);
+        return NULL;
+    }
+    return &sc.sbc_encoder_state;
+}
 
-static void a2dp_source_setup_media_header(uint8_t * media_packet, int size, int *offset, uint8_t marker, uint16_t sequence_number){
+static void a2dp_source_setup_media_header(uint8_t * media_packet, int size, int *offset, uint8_t marker, uint16_t sequence_number, uint32_t timestamp){
     if (size < AVDTP_MEDIA_PAYLOAD_HEADER_SIZE){
         log_error("small outgoing buffer");
         return;
@@ -458,7 +474,6 @@ static void a2dp_source_setup_media_header(uint8_t * media_packet, int size, int
     uint8_t  csrc_count = 0;
     uint8_t  payload_type = 0x60;
     // uint16_t sequence_number = stream_endpoint->sequence_number;
-    uint32_t timestamp = btstack_run_loop_get_time_ms();
     uint32_t ssrc = 0x11223344;
 
     // rtp header (min size 12B)
@@ -499,40 +514,141 @@ int a2dp_max_media_payload_size(uint8_t int_seid){
     return l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid) - AVDTP_MEDIA_PAYLOAD_HEADER_SIZE;
 }
 
-static void a2dp_source_copy_media_payload(uint8_t * media_packet, int size, int * offset, uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames){
-    if (size < num_bytes_to_copy + 1){
-        log_error("small outgoing buffer: buffer size %u, but need %u", size, num_bytes_to_copy + 1);
+static avdtp_stream_endpoint_t * a2dp_source_media_stream_endpoint_for_seid(uint8_t int_seid){
+    avdtp_stream_endpoint_t * stream_endpoint = avdtp_stream_endpoint_for_seid(int_seid, &a2dp_source_context);
+    if (!stream_endpoint) {
+        log_error("no stream_endpoint found for seid %d", int_seid);
+        return NULL;
+    }
+    if (stream_endpoint->l2cap_media_cid == 0){
+        log_error("no media cid found for seid %d", int_seid);
+        return NULL;
+    }
+    return stream_endpoint;
+}
+
+// request next media packet if due (e.g. to catch up after late timer), otherwise wait until it is
+static void a2dp_source_pacing_schedule_next_packet(void){
+    uint32_t timeout_ms = a2dp_source_pacing_next_packet_in_ms(&pacing, btstack_run_loop_get_time_ms());
+    if (timeout_ms == 0){
+        a2dp_source_stream_endpoint_request_can_send_now(pacing_seid);
         return;
     }
-    
-    int pos = *offset;
-    media_packet[pos++] = num_frames; // (fragmentation << 7) | (starting_packet << 6) | (last_packet << 5) | num_frames;
-    memcpy(media_packet + pos, storage, num_bytes_to_copy);
-    pos += num_bytes_to_copy;
-    *offset = pos;
+    btstack_run_loop_remove_timer(&pacing_timer);
+    btstack_run_loop_set_timer(&pacing_timer, timeout_ms);
+    btstack_run_loop_add_timer(&pacing_timer);
 }
 
-int a2dp_source_stream_send_media_payload(uint8_t int_seid, uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker){
-    avdtp_stream_endpoint_t * stream_endpoint = avdtp_stream_endpoint_for_seid(int_seid, &a2dp_source_context);
+static void a2dp_source_pacing_timeout_handler(btstack_timer_source_t * timer){
+    UNUSED(timer);
+    if (!pacing_seid) return;
+    a2dp_source_pacing_schedule_next_packet();
+}
+
+static void a2dp_source_pacing_stop(void){
+    pacing_seid = 0;
+    btstack_run_loop_remove_timer(&pacing_timer);
+}
+
+void a2dp_source_stream_start_pacing(uint8_t int_seid){
+    if (!sc.local_stream_endpoint || avdtp_stream_endpoint_seid(sc.local_stream_endpoint) != int_seid){
+        log_error("No configured stream_endpoint with seid %d", int_seid);
+        return;
+    }
+    avdtp_stream_endpoint_t * stream_endpoint = a2dp_source_media_stream_endpoint_for_seid(int_seid);
+    if (!stream_endpoint) return;
+
+    int max_payload_size = btstack_min(l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid), l2cap_max_mtu()) - AVDTP_MEDIA_PAYLOAD_HEADER_SIZE - 1;
+    a2dp_source_pacing_init(&pacing, sc.sampling_frequency, 
+        btstack_sbc_encoder_num_audio_frames(&sc.sbc_encoder_state), 
+        btstack_sbc_encoder_sbc_frame_length(&sc.sbc_encoder_state), 
+        max_payload_size);
+    a2dp_source_pacing_start(&pacing, btstack_run_loop_get_time_ms());
+    log_info("pacing seid %u: %u Hz, %u frames per packet", int_seid, sc.sampling_frequency, a2dp_source_pacing_frames_per_packet(&pacing));
+
+    a2dp_source_pacing_stop();
+    pacing_seid = int_seid;
+    btstack_run_loop_set_timer_handler(&pacing_timer, a2dp_source_pacing_timeout_handler);
+    a2dp_source_pacing_schedule_next_packet();
+}
+
+void a2dp_source_stream_stop_pacing(uint8_t int_seid){
+    if (pacing_seid != int_seid) return;
+    a2dp_source_pacing_stop();
+}
+
+void a2dp_source_stream_skip_media_packet(uint8_t int_seid){
+    if (pacing_seid != int_seid) return;
+    a2dp_source_pacing_schedule_next_packet();
+}
+
+int a2dp_source_stream_num_frames_to_send(uint8_t int_seid){
+    if (pacing_seid != int_seid) return 0;
+    uint32_t frames_due = a2dp_source_pacing_frames_due(&pacing, btstack_run_loop_get_time_ms());
+    return btstack_min(frames_due, a2dp_source_pacing_frames_per_packet(&pacing));
+}
+
+uint8_t * a2dp_source_stream_reserve_media_payload(uint8_t int_seid, int * max_payload_size){
+    avdtp_stream_endpoint_t * stream_endpoint = a2dp_source_media_stream_endpoint_for_seid(int_seid);
+    if (!stream_endpoint) return NULL;
+
+    if (!l2cap_can_send_packet_now(stream_endpoint->l2cap_media_cid)) return NULL;
+    if (!l2cap_reserve_packet_buffer()) return NULL;
+
+    // media header and SBC payload header (number of frames) are filled in when sending
+    int size = btstack_min(l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid), l2cap_max_mtu());
+    reserved_media_payload_size = size - AVDTP_MEDIA_PAYLOAD_HEADER_SIZE - 1;
+    *max_payload_size = reserved_media_payload_size;
+    return l2cap_get_outgoing_buffer() + AVDTP_MEDIA_PAYLOAD_HEADER_SIZE + 1;
+}
+
+int a2dp_source_stream_send_reserved_media_payload(uint8_t int_seid, int payload_size, uint8_t num_frames, uint8_t marker){
+    avdtp_stream_endpoint_t * stream_endpoint = a2dp_source_media_stream_endpoint_for_seid(int_seid);
     if (!stream_endpoint) {
-        log_error("no stream_endpoint found for seid %d", int_seid);
+        l2cap_release_packet_buffer();
         return 0;
     }
-
-    if (stream_endpoint->l2cap_media_cid == 0){
-        log_error("no media cid found for seid %d", int_seid);
+    int max_payload_size = reserved_media_payload_size;
+    reserved_media_payload_size = 0;
+    if (payload_size > max_payload_size){
+        log_error("payload size %u exceeds reserved media payload size %u", payload_size, max_payload_size);
+        l2cap_release_packet_buffer();
         return 0;
-    }        
+    }
+
+    // RTP timestamp from media clock if paced, otherwise from system time
+    int paced = (pacing_seid == int_seid);
+    if (paced){
+        a2dp_source_pacing_skip_late_frames(&pacing, btstack_run_loop_get_time_ms());
+    }
+    uint32_t timestamp = paced ? a2dp_source_pacing_rtp_timestamp(&pacing) : btstack_run_loop_get_time_ms();
 
     int size = l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid);
     int offset = 0;
-
-    l2cap_reserve_packet_buffer();
     uint8_t * media_packet = l2cap_get_outgoing_buffer();
-    //int size = l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid);
-    a2dp_source_setup_media_header(media_packet, size, &offset, marker, stream_endpoint->sequence_number);
-    a2dp_source_copy_media_payload(media_packet, size, &offset, storage, num_bytes_to_copy, num_frames);
+    a2dp_source_setup_media_header(media_packet, size, &offset, marker, stream_endpoint->sequence_number, timestamp);
+    media_packet[offset++] = num_frames; // (fragmentation << 7) | (starting_packet << 6) | (last_packet << 5) | num_frames;
+    offset += payload_size;
     stream_endpoint->sequence_number++;
     l2cap_send_prepared(stream_endpoint->l2cap_media_cid, offset);
+
+    if (paced){
+        a2dp_source_pacing_packet_sent(&pacing, num_frames);
+        a2dp_source_pacing_schedule_next_packet();
+    }
     return size;
 }
+
+int a2dp_source_stream_send_media_payload(uint8_t int_seid, uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker){
+    int max_payload_size;
+    uint8_t * payload = a2dp_source_stream_reserve_media_payload(int_seid, &max_payload_size);
+    if (!payload) return 0;
+
+    if (max_payload_size < num_bytes_to_copy){
+        log_error("small outgoing buffer: buffer size %u, but need %u", max_payload_size, num_bytes_to_copy);
+        l2cap_release_packet_buffer();
+        return 0;
+    }
+    memcpy(payload, storage, num_bytes_to_copy);
+    return a2dp_source_stream_send_reserved_media_payload(int_seid, num_bytes_to_copy, num_frames, marker);
+}
@@ -47,6 +47,7 @@
 #define __A2DP_SOURCE_H
 
 #include <stdint.h>
+#include "classic/btstack_sbc.h"
 
 #if defined __cplusplus
 extern "C" {
@@ -112,10 +113,60 @@ int 	a2dp_max_media_payload_size(uint8_t int_seid);
 
 uint8_t a2dp_source_stream_endpoint_ready(uint8_t local_seid);
 
+// SBC encoder configured for the stream, NULL if seid is not the configured stream endpoint
+btstack_sbc_encoder_state_t * a2dp_source_get_sbc_encoder_state(uint8_t local_seid);
+
 void 	a2dp_source_stream_endpoint_request_can_send_now(uint8_t local_seid);
 
 int  	a2dp_source_stream_send_media_payload(uint8_t int_seid, uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker);
 
+/**
+ * @brief Reserve outgoing buffer for a media packet and return its payload area, e.g. to encode SBC frames 
+ *        in place with btstack_sbc_encoder_process_data_to_buffer. Call on A2DP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW 
+ *        and follow up with a2dp_source_stream_send_reserved_media_payload.
+ * @param int_seid
+ * @param max_payload_size number of bytes available in payload area
+ * @return payload area or NULL if stream endpoint has no media channel or outgoing buffer is not available
+ */
+uint8_t * a2dp_source_stream_reserve_media_payload(uint8_t int_seid, int * max_payload_size);
+
+/**
+ * @brief Add media header to reserved media packet and send it
+ * @param int_seid
+ * @param payload_size number of bytes written to payload area
+ * @param num_frames number of SBC frames in payload
+ * @param marker
+ * @return 0 if stream endpoint not found or payload_size exceeds max_payload_size of reserved media payload
+ */
+int  	a2dp_source_stream_send_reserved_media_payload(uint8_t int_seid, int payload_size, uint8_t num_frames, uint8_t marker);
+
+/**
+ * @brief Start media clock for stream: emits A2DP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW whenever a media packet
+ *        filled with SBC frames is due. Media packets sent with a2dp_source_stream_send_reserved_media_payload
+ *        carry the RTP timestamp of the media clock. Call on A2DP_SUBEVENT_STREAM_STARTED, stopped on suspend and release.
+ * @param int_seid
+ */
+void    a2dp_source_stream_start_pacing(uint8_t int_seid);
+
+/**
+ * @brief Stop media clock for stream
+ * @param int_seid
+ */
+void    a2dp_source_stream_stop_pacing(uint8_t int_seid);
+
+/**
+ * @brief Get number of SBC frames to encode into next media packet
+ * @param int_seid
+ * @return number of frames, 0 if stream is not paced
+ */
+int     a2dp_source_stream_num_frames_to_send(uint8_t int_seid);
+
+/**
+ * @brief Wait for next media packet on media clock again if no media packet was sent on A2DP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW
+ * @param int_seid
+ */
+void    a2dp_source_stream_skip_media_packet(uint8_t int_seid);
+
 /* API_END */
 
 #if defined __cplusplus
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define __BTSTACK_FILE__ "a2dp_source_pacing.c"
+
+/*
+ * a2dp_source_pacing.c
+ *
+ */
+
+#include <stdint.h>
+
+#include "btstack_util.h"
+#include "classic/a2dp_source_pacing.h"
+
+// SBC payload header stores number of frames in 4 bits
+#define SBC_MAX_FRAMES_PER_PACKET 15
+
+#ifndef A2DP_SOURCE_PACING_MAX_PACKETS_BEHIND
+#define A2DP_SOURCE_PACING_MAX_PACKETS_BEHIND 4
+#endif
+
+void a2dp_source_pacing_init(a2dp_source_pacing_t * pacing, uint32_t sample_rate, uint16_t samples_per_frame, uint16_t sbc_frame_length, uint16_t max_payload_size){
+    pacing->sample_rate = sample_rate;
+    pacing->samples_per_frame = samples_per_frame;
+    int frames_per_packet = sbc_frame_length ? max_payload_size / sbc_frame_length : 0;
+    pacing->frames_per_packet = (uint8_t) btstack_max(1, btstack_min(frames_per_packet, SBC_MAX_FRAMES_PER_PACKET));
+    pacing->start_time_ms = 0;
+    pacing->frames_sent = 0;
+    pacing->frames_skipped = 0;
+}
+
+void a2dp_source_pacing_start(a2dp_source_pacing_t * pacing, uint32_t now_ms){
+    pacing->start_time_ms = now_ms;
+    pacing->frames_sent = 0;
+    pacing->frames_skipped = 0;
+}
+
+uint8_t a2dp_source_pacing_frames_per_packet(a2dp_source_pacing_t * pacing){
+    return pacing->frames_per_packet;
+}
+
+// SBC frames complete on media clock since start
+static uint32_t a2dp_source_pacing_frames_elapsed(a2dp_source_pacing_t * pacing, uint32_t now_ms){
+    uint32_t elapsed_ms = now_ms - pacing->start_time_ms;
+    uint64_t samples = ((uint64_t) elapsed_ms * pacing->sample_rate) / 1000;
+    return (uint32_t) (samples / pacing->samples_per_frame);
+}
+
+// SBC frames due without limit
+static uint32_t a2dp_source_pacing_frames_behind(a2dp_source_pacing_t * pacing, uint32_t now_ms){
+    uint32_t frames_elapsed = a2dp_source_pacing_frames_elapsed(pacing, now_ms);
+    uint32_t frames_handled = pacing->frames_sent + pacing->frames_skipped;
+    if (frames_elapsed <= frames_handled) return 0;
+    return frames_elapsed - frames_handled;
+}
+
+uint32_t a2dp_source_pacing_frames_due(a2dp_source_pacing_t * pacing, uint32_t now_ms){
+    uint32_t max_frames_due = A2DP_SOURCE_PACING_MAX_PACKETS_BEHIND * pacing->frames_per_packet;
+    return btstack_min(a2dp_source_pacing_frames_behind(pacing, now_ms), max_frames_due);
+}
+
+void a2dp_source_pacing_skip_late_frames(a2dp_source_pacing_t * pacing, uint32_t now_ms){
+    uint32_t frames_behind = a2dp_source_pacing_frames_behind(pacing, now_ms);
+    uint32_t max_frames_due = A2DP_SOURCE_PACING_MAX_PACKETS_BEHIND * pacing->frames_per_packet;
+    if (frames_behind <= max_frames_due) return;
+    pacing->frames_skipped += frames_behind - max_frames_due;
+}
+
+int a2dp_source_pacing_packet_due(a2dp_source_pacing_t * pacing, uint32_t now_ms){
+    return a2dp_source_pacing_frames_due(pacing, now_ms) >= pacing->frames_per_packet;
+}
+
+uint32_t a2dp_source_pacing_next_packet_in_ms(a2dp_source_pacing_t * pacing, uint32_t now_ms){
+    if (a2dp_source_pacing_packet_due(pacing, now_ms)) return 0;
+    // time at which last sample of next packet is available, rounded up
+    uint64_t frames_needed = pacing->frames_sent + pacing->frames_skipped + pacing->frames_per_packet;
+    uint64_t samples_needed = frames_needed * pacing->samples_per_frame;
+    uint32_t due_ms = (uint32_t) ((samples_needed * 1000 + pacing->sample_rate - 1) / pacing->sample_rate);
+    uint32_t elapsed_ms = now_ms - pacing->start_time_ms;
+    if (due_ms <= elapsed_ms) return 0;
+    return due_ms - elapsed_ms;
+}
+
+uint32_t a2dp_source_pacing_rtp_timestamp(a2dp_source_pacing_t * pacing){
+    return (pacing->frames_sent + pacing->frames_skipped) * pacing->samples_per_frame;
+}
+
+void a2dp_source_pacing_packet_sent(a2dp_source_pacing_t * pacing, uint8_t num_frames){
+    pacing->frames_sent += num_frames;
+}
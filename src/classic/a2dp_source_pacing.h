@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ * a2dp_source_pacing.h
+ *
+ * Media clock for A2DP Source: tells when the next media packet is due and how many SBC frames it carries
+ *
+ * The media clock counts SBC frames from the start of the stream based on sample rate and audio samples per 
+ * SBC frame. As the number of frames due is derived from the time since start, late timers do not accumulate
+ * drift: a late packet is followed by a packet that catches up.
+ */
+
+#ifndef __A2DP_SOURCE_PACING_H
+#define __A2DP_SOURCE_PACING_H
+
+#include <stdint.h>
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    // configuration
+    uint32_t sample_rate;
+    uint16_t samples_per_frame;
+    uint8_t  frames_per_packet;
+
+    // media clock
+    uint32_t start_time_ms;
+    uint32_t frames_sent;
+    uint32_t frames_skipped;
+} a2dp_source_pacing_t;
+
+/* API_START */
+
+/**
+ * @brief Init media clock
+ * @param pacing
+ * @param sample_rate in Hz
+ * @param samples_per_frame audio samples per SBC frame (blocks * subbands)
+ * @param sbc_frame_length in bytes
+ * @param max_payload_size of media packet without SBC payload header
+ */
+void a2dp_source_pacing_init(a2dp_source_pacing_t * pacing, uint32_t sample_rate, uint16_t samples_per_frame, uint16_t sbc_frame_length, uint16_t max_payload_size);
+
+/**
+ * @brief Start media clock 
+ * @param pacing
+ * @param now_ms
+ */
+void a2dp_source_pacing_start(a2dp_source_pacing_t * pacing, uint32_t now_ms);
+
+/**
+ * @brief Get number of SBC frames per media packet
+ * @param pacing
+ */
+uint8_t a2dp_source_pacing_frames_per_packet(a2dp_source_pacing_t * pacing);
+
+/**
+ * @brief Get number of SBC frames due but not sent yet, at most A2DP_SOURCE_PACING_MAX_PACKETS_BEHIND packets
+ * @param pacing
+ * @param now_ms
+ */
+uint32_t a2dp_source_pacing_frames_due(a2dp_source_pacing_t * pacing, uint32_t now_ms);
+
+/**
+ * @brief Skip frames if sending fell behind by more than A2DP_SOURCE_PACING_MAX_PACKETS_BEHIND packets, e.g. after a stall, 
+ *        so that the media clock skips ahead instead of bursting. Call before getting the RTP timestamp of the next media packet
+ * @param pacing
+ * @param now_ms
+ */
+void a2dp_source_pacing_skip_late_frames(a2dp_source_pacing_t * pacing, uint32_t now_ms);
+
+/**
+ * @brief Check if a full media packet is due
+ * @param pacing
+ * @param now_ms
+ */
+int a2dp_source_pacing_packet_due(a2dp_source_pacing_t * pacing, uint32_t now_ms);
+
+/**
+ * @brief Get time until next full media packet is due
+ * @param pacing
+ * @param now_ms
+ * @returns 0 if packet is already due
+ */
+uint32_t a2dp_source_pacing_next_packet_in_ms(a2dp_source_pacing_t * pacing, uint32_t now_ms);
+
+/**
+ * @brief Get RTP timestamp for next media packet in units of audio samples
+ * @param pacing
+ */
+uint32_t a2dp_source_pacing_rtp_timestamp(a2dp_source_pacing_t * pacing);
+
+/**
+ * @brief Advance media clock after media packet was sent
+ * @param pacing
+ * @param num_frames in media packet
+ */
+void a2dp_source_pacing_packet_sent(a2dp_source_pacing_t * pacing, uint8_t num_frames);
+
+/* API_END */
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // __A2DP_SOURCE_PACING_H
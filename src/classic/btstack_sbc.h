@@ -55,14 +55,38 @@ typedef enum{
     SBC_MODE_mSBC
 } btstack_sbc_mode_t;
 
+// size of the private codec context of a decoder / encoder instance
+#define BTSTACK_SBC_DECODER_STATE_SIZE 3328
+#define BTSTACK_SBC_ENCODER_STATE_SIZE 2688
+
+// opaque codec context, only accessed by the codec implementation which checks that its context fits
+typedef struct {
+    union {
+        uint64_t alignment;
+        uint8_t  storage[BTSTACK_SBC_DECODER_STATE_SIZE];
+    } opaque;
+} btstack_sbc_decoder_context_t;
+
+typedef struct {
+    union {
+        uint64_t alignment;
+        uint8_t  storage[BTSTACK_SBC_ENCODER_STATE_SIZE];
+    } opaque;
+} btstack_sbc_encoder_context_t;
+
+// each state owns its codec context, different states can be used from different threads
 typedef struct {
     void * context;
     void (*handle_pcm_data)(int16_t * data, int num_samples, int num_channels, int sample_rate, void * context);
     // private
-    void * decoder_state;
+    btstack_sbc_decoder_context_t decoder_context;
     btstack_sbc_plc_state_t plc_state;
     btstack_sbc_mode_t mode;
 
+    // testing only
+    int plc_enabled;
+    int corrupt_frame_period;
+
     // summary of processed good, bad and zero frames
     int good_frames_nr;
     int bad_frames_nr;
@@ -71,7 +95,7 @@ typedef struct {
 
 typedef struct {
     // private
-    void * encoder_state;
+    btstack_sbc_encoder_context_t encoder_context;
     btstack_sbc_mode_t mode;
 } btstack_sbc_encoder_state_t;
 
@@ -129,31 +153,49 @@ void btstack_sbc_encoder_init(btstack_sbc_encoder_state_t * state, btstack_sbc_m
 
 /**
  * @brief Encode PCM data
+ * @param state
  * @param buffer with samples in host endianess
  */
-void btstack_sbc_encoder_process_data(int16_t * input_buffer);
+void btstack_sbc_encoder_process_data(btstack_sbc_encoder_state_t * state, int16_t * input_buffer);
+
+/**
+ * @brief Encode PCM data directly into given buffer, e.g. the payload of a reserved media packet
+ * @param state
+ * @param buffer with samples in host endianess
+ * @param sbc_buffer with space for at least btstack_sbc_encoder_sbc_frame_length bytes
+ */
+void btstack_sbc_encoder_process_data_to_buffer(btstack_sbc_encoder_state_t * state, int16_t * input_buffer, uint8_t * sbc_buffer);
 
 /**
  * @brief Return SBC frame
+ * @param state
  */
-uint8_t * btstack_sbc_encoder_sbc_buffer(void);
+uint8_t * btstack_sbc_encoder_sbc_buffer(btstack_sbc_encoder_state_t * state);
 
 /**
  * @brief Return SBC frame length
+ * @param state
  */
-uint16_t  btstack_sbc_encoder_sbc_buffer_length(void);
+uint16_t  btstack_sbc_encoder_sbc_buffer_length(btstack_sbc_encoder_state_t * state);
+
+/**
+ * @brief Return length of SBC frames produced with current configuration, also before first frame was encoded
+ * @param state
+ */
+uint16_t  btstack_sbc_encoder_sbc_frame_length(btstack_sbc_encoder_state_t * state);
 
 /**
  * @brief Return number of audio frames required for one SBC packet
+ * @param state
  * @note  each audio frame contains 2 sample values in stereo modes
  */
-int  btstack_sbc_encoder_num_audio_frames(void);
+int  btstack_sbc_encoder_num_audio_frames(btstack_sbc_encoder_state_t * state);
 
 /* API_END */
 
 // testing only
-void btstack_sbc_decoder_test_disable_plc(void);
-void btstack_sbc_decoder_test_simulate_corrupt_frames(int period);
+void btstack_sbc_decoder_test_disable_plc(btstack_sbc_decoder_state_t * state);
+void btstack_sbc_decoder_test_simulate_corrupt_frames(btstack_sbc_decoder_state_t * state, int period);
 
 #if defined __cplusplus
 }
@@ -67,6 +67,7 @@
 // SBC decoder start
 #define DECODER_DATA_SIZE (SBC_MAX_CHANNELS*SBC_MAX_BLOCKS*SBC_MAX_BANDS * 4 + SBC_CODEC_MIN_FILTER_BUFFERS*SBC_MAX_BANDS*SBC_MAX_CHANNELS * 2)
 
+// stored in btstack_sbc_decoder_state_t->decoder_context
 typedef struct {
     OI_UINT32 bytes_in_frame_buffer;
     OI_CODEC_SBC_DECODER_CONTEXT decoder_context;
@@ -80,15 +81,15 @@ typedef struct {
     int search_new_sync_word;
     int sync_word_found;
     int first_good_frame_found; 
+    int corrupt_frame_count;
 } bludroid_decoder_state_t;
 
-static btstack_sbc_decoder_state_t * sbc_decoder_state_singleton = NULL;
-static bludroid_decoder_state_t bd_decoder_state;
+// compile error if BTSTACK_SBC_DECODER_STATE_SIZE is too small
+typedef char bludroid_decoder_state_size_check[(sizeof(bludroid_decoder_state_t) <= sizeof(btstack_sbc_decoder_context_t)) ? 1 : -1];
 
-// Testing only - START
-static int plc_enabled = 1;
-static int corrupt_frame_period = -1;
-// Testing - STOP
+static inline bludroid_decoder_state_t * bludroid_decoder_state(btstack_sbc_decoder_state_t * state){
+    return (bludroid_decoder_state_t *) &state->decoder_context.opaque;
+}
 
 // SBC decoder end 
 // *****************************************************************************
@@ -97,19 +98,22 @@ static int corrupt_frame_period = -1;
 // *****************************************************************************
 // SBC encoder start
 
+// stored in btstack_sbc_encoder_state_t->encoder_context
 typedef struct {
     SBC_ENC_PARAMS context;
     int num_data_bytes;
     uint8_t sbc_packet[1000];
 } bludroid_encoder_state_t;
 
-static btstack_sbc_encoder_state_t * sbc_encoder_state_singleton = NULL;
-static bludroid_encoder_state_t bd_encoder_state;
-
-// SBC encoder start
-// *****************************************************************************
+// compile error if BTSTACK_SBC_ENCODER_STATE_SIZE is too small
+typedef char bludroid_encoder_state_size_check[(sizeof(bludroid_encoder_state_t) <= sizeof(btstack_sbc_encoder_context_t)) ? 1 : -1];
 
+static inline bludroid_encoder_state_t * bludroid_encoder_state(btstack_sbc_encoder_state_t * state){
+    return (bludroid_encoder_state_t *) &state->encoder_context.opaque;
+}
 
+// SBC encoder end
+// *****************************************************************************
 
 // *****************************************************************************
 //
@@ -117,12 +121,12 @@ static bludroid_encoder_state_t bd_encoder_state;
 //
 // *****************************************************************************
 
-void btstack_sbc_decoder_test_disable_plc(void){
-    plc_enabled = 0;
+void btstack_sbc_decoder_test_disable_plc(btstack_sbc_decoder_state_t * state){
+    state->plc_enabled = 0;
 }
 
-void btstack_sbc_decoder_test_simulate_corrupt_frames(int period){
-    corrupt_frame_period = period;
+void btstack_sbc_decoder_test_simulate_corrupt_frames(btstack_sbc_decoder_state_t * state, int period){
+    state->corrupt_frame_period = period;
 }
 
 static int find_sequence_of_zeros(const OI_BYTE *frame_data, OI_UINT32 frame_bytes, int seq_length){
@@ -166,17 +170,17 @@ static int find_h2_syncword(const OI_BYTE *frame_data, OI_UINT32 frame_bytes){
 }
 
 int btstack_sbc_decoder_num_samples_per_frame(btstack_sbc_decoder_state_t * state){
-    bludroid_decoder_state_t * decoder_state = (bludroid_decoder_state_t *) state->decoder_state;
+    bludroid_decoder_state_t * decoder_state = bludroid_decoder_state(state);
     return decoder_state->decoder_context.common.frameInfo.nrof_blocks * decoder_state->decoder_context.common.frameInfo.nrof_subbands;
 }
 
 int btstack_sbc_decoder_num_channels(btstack_sbc_decoder_state_t * state){
-    bludroid_decoder_state_t * decoder_state = (bludroid_decoder_state_t *) state->decoder_state;
+    bludroid_decoder_state_t * decoder_state = bludroid_decoder_state(state);
     return decoder_state->decoder_context.common.frameInfo.nrof_channels;
 }
 
 int btstack_sbc_decoder_sample_rate(btstack_sbc_decoder_state_t * state){
-    bludroid_decoder_state_t * decoder_state = (bludroid_decoder_state_t *) state->decoder_state;
+    bludroid_decoder_state_t * decoder_state = bludroid_decoder_state(state);
     return decoder_state->decoder_context.common.frameInfo.frequency;
 }
 
@@ -187,17 +191,17 @@ void OI_AssertFail(const char* file, int line, const char* reason){
 #endif
 
 void btstack_sbc_decoder_init(btstack_sbc_decoder_state_t * state, btstack_sbc_mode_t mode, void (*callback)(int16_t * data, int num_samples, int num_channels, int sample_rate, void * context), void * context){
-    if (sbc_decoder_state_singleton && sbc_decoder_state_singleton != state ){
-        log_error("SBC decoder: different sbc decoder state is allready registered");
-    } 
+    memset(state, 0, sizeof(btstack_sbc_decoder_state_t));
+    bludroid_decoder_state_t * decoder_state = bludroid_decoder_state(state);
+
     OI_STATUS status = OI_STATUS_SUCCESS;
     switch (mode){
         case SBC_MODE_STANDARD:
             // note: we always request stereo output, even for mono input
-            status = OI_CODEC_SBC_DecoderReset(&(bd_decoder_state.decoder_context), bd_decoder_state.decoder_data, sizeof(bd_decoder_state.decoder_data), 2, 2, FALSE);
+            status = OI_CODEC_SBC_DecoderReset(&(decoder_state->decoder_context), decoder_state->decoder_data, sizeof(decoder_state->decoder_data), 2, 2, FALSE);
             break;
         case SBC_MODE_mSBC:
-            status = OI_CODEC_mSBC_DecoderReset(&(bd_decoder_state.decoder_context), bd_decoder_state.decoder_data, sizeof(bd_decoder_state.decoder_data));
+            status = OI_CODEC_mSBC_DecoderReset(&(decoder_state->decoder_context), decoder_state->decoder_data, sizeof(decoder_state->decoder_data));
             break;
         default:
             break;
@@ -207,23 +211,21 @@ void btstack_sbc_decoder_init(btstack_sbc_decoder_state_t * state, btstack_sbc_m
         log_error("SBC decoder: error during reset %d\n", status);
     }
     
-    sbc_decoder_state_singleton = state;
-    
-    bd_decoder_state.bytes_in_frame_buffer = 0;
-    bd_decoder_state.pcm_bytes = sizeof(bd_decoder_state.pcm_data);
-    bd_decoder_state.h2_sequence_nr = -1;
-    bd_decoder_state.sync_word_found = 0;
-    bd_decoder_state.search_new_sync_word = 0;
+    decoder_state->bytes_in_frame_buffer = 0;
+    decoder_state->pcm_bytes = sizeof(decoder_state->pcm_data);
+    decoder_state->h2_sequence_nr = -1;
+    decoder_state->sync_word_found = 0;
+    decoder_state->search_new_sync_word = 0;
     if (mode == SBC_MODE_mSBC){
-        bd_decoder_state.search_new_sync_word = 1;
+        decoder_state->search_new_sync_word = 1;
     }
-    bd_decoder_state.first_good_frame_found = 0;
+    decoder_state->first_good_frame_found = 0;
 
-    memset(state, 0, sizeof(btstack_sbc_decoder_state_t));
     state->handle_pcm_data = callback;
     state->mode = mode;
     state->context = context;
-    state->decoder_state = &bd_decoder_state;
+    state->plc_enabled = 1;
+    state->corrupt_frame_period = -1;
     btstack_sbc_plc_init(&state->plc_state);
 }
 
@@ -240,7 +242,7 @@ static void append_received_sbc_data(bludroid_decoder_state_t * state, uint8_t *
 
 
 static void btstack_sbc_decoder_process_sbc_data(btstack_sbc_decoder_state_t * state, int packet_status_flag, uint8_t * buffer, int size){
-    bludroid_decoder_state_t * decoder_state = (bludroid_decoder_state_t*)state->decoder_state;
+    bludroid_decoder_state_t * decoder_state = bludroid_decoder_state(state);
     int input_bytes_to_process = size;
 
     while (input_bytes_to_process){
@@ -255,14 +257,13 @@ static void btstack_sbc_decoder_process_sbc_data(btstack_sbc_decoder_state_t * s
         uint16_t bytes_processed = 0;
         const OI_BYTE *frame_data = decoder_state->frame_buffer;
 
-        static int frame_count = 0;
         while (1){
-            if (corrupt_frame_period > 0){
-               frame_count++;
+            if (state->corrupt_frame_period > 0){
+               decoder_state->corrupt_frame_count++;
 
-                if (frame_count % corrupt_frame_period == 0){
+                if (decoder_state->corrupt_frame_count % state->corrupt_frame_period == 0){
                     *(uint8_t*)&frame_data[5] = 0;
-                    frame_count = 0;
+                    decoder_state->corrupt_frame_count = 0;
                 }
             }
 
@@ -321,7 +322,7 @@ static void btstack_sbc_decoder_process_sbc_data(btstack_sbc_decoder_state_t * s
                     } else {
                         state->bad_frames_nr++;
                     }
-                    if (!plc_enabled) break;
+                    if (!state->plc_enabled) break;
                     break;
                 default:
                     log_info("Frame decode error: %d", status);
@@ -338,7 +339,7 @@ static void btstack_sbc_decoder_process_sbc_data(btstack_sbc_decoder_state_t * s
 
 static void btstack_sbc_decoder_process_msbc_data(btstack_sbc_decoder_state_t * state, int packet_status_flag, uint8_t * buffer, int size){
 
-    bludroid_decoder_state_t * decoder_state = (bludroid_decoder_state_t*)state->decoder_state;
+    bludroid_decoder_state_t * decoder_state = bludroid_decoder_state(state);
     int input_bytes_to_process = size;
     int msbc_frame_size = 57; 
 
@@ -367,13 +368,12 @@ static void btstack_sbc_decoder_process_msbc_data(btstack_sbc_decoder_state_t *
         uint16_t bytes_processed = 0;
         const OI_BYTE *frame_data = decoder_state->frame_buffer;
 
-        static int frame_count = 0;
-        if (corrupt_frame_period > 0){
-           frame_count++;
+        if (state->corrupt_frame_period > 0){
+           decoder_state->corrupt_frame_count++;
 
-            if (frame_count % corrupt_frame_period == 0){
+            if (decoder_state->corrupt_frame_count % state->corrupt_frame_period == 0){
                 *(uint8_t*)&frame_data[5] = 0;
-                frame_count = 0;
+                decoder_state->corrupt_frame_count = 0;
             }
         }
 
@@ -459,7 +459,7 @@ static void btstack_sbc_decoder_process_msbc_data(btstack_sbc_decoder_state_t *
                 }
                 if (decoder_state->h2_sequence_nr == 3) printf("\n");
 #endif
-                if (!plc_enabled) break;
+                if (!state->plc_enabled) break;
                 
                 frame_data = btstack_sbc_plc_zero_signal_frame();
 
@@ -505,60 +505,50 @@ void btstack_sbc_decoder_process_data(btstack_sbc_decoder_state_t * state, int p
 void btstack_sbc_encoder_init(btstack_sbc_encoder_state_t * state, btstack_sbc_mode_t mode, 
                         int blocks, int subbands, int allmethod, int sample_rate, int bitpool){
 
-    if (sbc_encoder_state_singleton && sbc_encoder_state_singleton != state ){
-        log_error("SBC encoder: different sbc decoder state is allready registered");
-    } 
-    
-    sbc_encoder_state_singleton = state;
-
-    if (!sbc_encoder_state_singleton){
-        log_error("SBC encoder init: sbc state is NULL");
-    }
+    memset(state, 0, sizeof(btstack_sbc_encoder_state_t));
+    bludroid_encoder_state_t * encoder_state = bludroid_encoder_state(state);
+    SBC_ENC_PARAMS * context = &encoder_state->context;
 
-    sbc_encoder_state_singleton->mode = mode;
+    state->mode = mode;
 
-    switch (sbc_encoder_state_singleton->mode){
+    switch (state->mode){
         case SBC_MODE_STANDARD:
-            bd_encoder_state.context.s16NumOfBlocks = blocks;                          
-            bd_encoder_state.context.s16NumOfSubBands = subbands;                       
-            bd_encoder_state.context.s16AllocationMethod = allmethod;                     
-            bd_encoder_state.context.s16BitPool = bitpool;  
-            bd_encoder_state.context.mSBCEnabled = 0;
-            bd_encoder_state.context.s16ChannelMode = SBC_STEREO;
-            bd_encoder_state.context.s16NumOfChannels = 2;
+            context->s16NumOfBlocks = blocks;                          
+            context->s16NumOfSubBands = subbands;                       
+            context->s16AllocationMethod = allmethod;                     
+            context->s16BitPool = bitpool;  
+            context->mSBCEnabled = 0;
+            context->s16ChannelMode = SBC_STEREO;
+            context->s16NumOfChannels = 2;
             
             switch(sample_rate){
-                case 16000: bd_encoder_state.context.s16SamplingFreq = SBC_sf16000; break;
-                case 32000: bd_encoder_state.context.s16SamplingFreq = SBC_sf32000; break;
-                case 44100: bd_encoder_state.context.s16SamplingFreq = SBC_sf44100; break;
-                case 48000: bd_encoder_state.context.s16SamplingFreq = SBC_sf48000; break;
-                default: bd_encoder_state.context.s16SamplingFreq = 0; break;
+                case 16000: context->s16SamplingFreq = SBC_sf16000; break;
+                case 32000: context->s16SamplingFreq = SBC_sf32000; break;
+                case 44100: context->s16SamplingFreq = SBC_sf44100; break;
+                case 48000: context->s16SamplingFreq = SBC_sf48000; break;
+                default: context->s16SamplingFreq = 0; break;
             }
             break;
         case SBC_MODE_mSBC:
-            bd_encoder_state.context.s16NumOfBlocks    = 15;
-            bd_encoder_state.context.s16NumOfSubBands  = 8;
-            bd_encoder_state.context.s16AllocationMethod = SBC_LOUDNESS;
-            bd_encoder_state.context.s16BitPool   = 26;
-            bd_encoder_state.context.s16ChannelMode = SBC_MONO;
-            bd_encoder_state.context.s16NumOfChannels = 1;
-            bd_encoder_state.context.mSBCEnabled = 1;
-            bd_encoder_state.context.s16SamplingFreq = SBC_sf16000;
+            context->s16NumOfBlocks    = 15;
+            context->s16NumOfSubBands  = 8;
+            context->s16AllocationMethod = SBC_LOUDNESS;
+            context->s16BitPool   = 26;
+            context->s16ChannelMode = SBC_MONO;
+            context->s16NumOfChannels = 1;
+            context->mSBCEnabled = 1;
+            context->s16SamplingFreq = SBC_sf16000;
             break;
     }
-    bd_encoder_state.context.pu8Packet = bd_encoder_state.sbc_packet;
+    context->pu8Packet = encoder_state->sbc_packet;
     
-    sbc_encoder_state_singleton->encoder_state = &bd_encoder_state;
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
     SBC_Encoder_Init(context);
 }
 
 
-void btstack_sbc_encoder_process_data(int16_t * input_buffer){
-    if (!sbc_encoder_state_singleton){
-        log_error("SBC encoder: sbc state is NULL, call btstack_sbc_encoder_init to initialize it");
-    }
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+void btstack_sbc_encoder_process_data(btstack_sbc_encoder_state_t * state, int16_t * input_buffer){
+    bludroid_encoder_state_t * encoder_state = bludroid_encoder_state(state);
+    SBC_ENC_PARAMS * context = &encoder_state->context;
     context->ps16PcmBuffer = input_buffer;
     if (context->mSBCEnabled){
         context->pu8Packet[0] = 0xad;
@@ -566,17 +556,48 @@ void btstack_sbc_encoder_process_data(int16_t * input_buffer){
     SBC_Encoder(context);
 }
 
-int btstack_sbc_encoder_num_audio_frames(void){
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+void btstack_sbc_encoder_process_data_to_buffer(btstack_sbc_encoder_state_t * state, int16_t * input_buffer, uint8_t * sbc_buffer){
+    bludroid_encoder_state_t * encoder_state = bludroid_encoder_state(state);
+    SBC_ENC_PARAMS * context = &encoder_state->context;
+    context->pu8Packet = sbc_buffer;
+    btstack_sbc_encoder_process_data(state, input_buffer);
+    context->pu8Packet = encoder_state->sbc_packet;
+}
+
+// frame length as defined in A2DP spec, 12.9 Calculation of Bit Rate and Frame Length
+uint16_t btstack_sbc_encoder_sbc_frame_length(btstack_sbc_encoder_state_t * state){
+    bludroid_encoder_state_t * encoder_state = bludroid_encoder_state(state);
+    SBC_ENC_PARAMS * context = &encoder_state->context;
+    int num_bits;
+    switch (context->s16ChannelMode){
+        case SBC_MONO:
+        case SBC_DUAL:
+            num_bits = context->s16NumOfBlocks * context->s16NumOfChannels * context->s16BitPool;
+            break;
+        case SBC_JOINT_STEREO:
+            num_bits = context->s16NumOfSubBands + context->s16NumOfBlocks * context->s16BitPool;
+            break;
+        default:
+            num_bits = context->s16NumOfBlocks * context->s16BitPool;
+            break;
+    }
+    return 4 + (4 * context->s16NumOfSubBands * context->s16NumOfChannels) / 8 + (num_bits + 7) / 8;
+}
+
+int btstack_sbc_encoder_num_audio_frames(btstack_sbc_encoder_state_t * state){
+    bludroid_encoder_state_t * encoder_state = bludroid_encoder_state(state);
+    SBC_ENC_PARAMS * context = &encoder_state->context;
     return context->s16NumOfSubBands * context->s16NumOfBlocks;
 }
 
-uint8_t * btstack_sbc_encoder_sbc_buffer(void){
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+uint8_t * btstack_sbc_encoder_sbc_buffer(btstack_sbc_encoder_state_t * state){
+    bludroid_encoder_state_t * encoder_state = bludroid_encoder_state(state);
+    SBC_ENC_PARAMS * context = &encoder_state->context;
     return context->pu8Packet;
 }
 
-uint16_t  btstack_sbc_encoder_sbc_buffer_length(void){
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+uint16_t  btstack_sbc_encoder_sbc_buffer_length(btstack_sbc_encoder_state_t * state){
+    bludroid_encoder_state_t * encoder_state = bludroid_encoder_state(state);
+    SBC_ENC_PARAMS * context = &encoder_state->context;
     return context->u16PacketLength;
 }
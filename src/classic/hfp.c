@@ -725,42 +725,105 @@ void hfp_handle_hci_event(uint8_t packet_type, uint16_t channel, uint8_t *packet
     }
 }
 
-// translates command string into hfp_command_t CMD
-static hfp_command_t parse_command(const char * line_buffer, int isHandsFree){
-    int offset = isHandsFree ? 0 : 2;
-
-    if (strncmp(line_buffer+offset, HFP_LIST_CURRENT_CALLS, strlen(HFP_LIST_CURRENT_CALLS)) == 0){
-        return HFP_CMD_LIST_CURRENT_CALLS;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_SUBSCRIBER_NUMBER_INFORMATION, strlen(HFP_SUBSCRIBER_NUMBER_INFORMATION)) == 0){
-        return HFP_CMD_GET_SUBSCRIBER_NUMBER_INFORMATION;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_PHONE_NUMBER_FOR_VOICE_TAG, strlen(HFP_PHONE_NUMBER_FOR_VOICE_TAG)) == 0){
-        if (isHandsFree) return HFP_CMD_AG_SENT_PHONE_NUMBER;
-        return HFP_CMD_HF_REQUEST_PHONE_NUMBER;
-    }
+typedef struct {
+    const char *  name;
+    uint16_t      name_len;
+    hfp_command_t ag_command;   // command as received by the AG, HFP_CMD_NONE if not expected
+    hfp_command_t hf_command;   // command as received by the HF, HFP_CMD_NONE if not expected
+} hfp_command_entry_t;
+
+#define HFP_COMMAND_ENTRY(name, ag_command, hf_command) { name, sizeof(name) - 1, ag_command, hf_command }
+
+// sorted by name, no name is a prefix of another one -> binary search finds the only possible match
+static const hfp_command_entry_t hfp_command_table[] = {
+    HFP_COMMAND_ENTRY(HFP_AVAILABLE_CODECS,                                  HFP_CMD_AVAILABLE_CODECS,                             HFP_CMD_AVAILABLE_CODECS),
+    HFP_COMMAND_ENTRY(HFP_TRIGGER_CODEC_CONNECTION_SETUP,                    HFP_CMD_TRIGGER_CODEC_CONNECTION_SETUP,               HFP_CMD_TRIGGER_CODEC_CONNECTION_SETUP),
+    HFP_COMMAND_ENTRY(HFP_CONFIRM_COMMON_CODEC,                              HFP_CMD_HF_CONFIRMED_CODEC,                           HFP_CMD_AG_SUGGESTED_CODEC),
+    HFP_COMMAND_ENTRY(HFP_UPDATE_ENABLE_STATUS_FOR_INDIVIDUAL_AG_INDICATORS, HFP_CMD_ENABLE_INDIVIDUAL_AG_INDICATOR_STATUS_UPDATE, HFP_CMD_ENABLE_INDIVIDUAL_AG_INDICATOR_STATUS_UPDATE),
+    HFP_COMMAND_ENTRY(HFP_TRANSFER_HF_INDICATOR_STATUS,                      HFP_CMD_HF_INDICATOR_STATUS,                          HFP_CMD_HF_INDICATOR_STATUS),
+    HFP_COMMAND_ENTRY(HFP_GENERIC_STATUS_INDICATOR,                          HFP_CMD_RETRIEVE_GENERIC_STATUS_INDICATORS,           HFP_CMD_SET_GENERIC_STATUS_INDICATOR_STATUS),
+    HFP_COMMAND_ENTRY(HFP_PHONE_NUMBER_FOR_VOICE_TAG,                        HFP_CMD_HF_REQUEST_PHONE_NUMBER,                      HFP_CMD_AG_SENT_PHONE_NUMBER),
+    HFP_COMMAND_ENTRY(HFP_REDIAL_LAST_NUMBER,                                HFP_CMD_REDIAL_LAST_NUMBER,                           HFP_CMD_REDIAL_LAST_NUMBER),
+    HFP_COMMAND_ENTRY(HFP_SUPPORTED_FEATURES,                                HFP_CMD_SUPPORTED_FEATURES,                           HFP_CMD_SUPPORTED_FEATURES),
+    HFP_COMMAND_ENTRY(HFP_CHANGE_IN_BAND_RING_TONE_SETTING,                  HFP_CMD_CHANGE_IN_BAND_RING_TONE_SETTING,             HFP_CMD_CHANGE_IN_BAND_RING_TONE_SETTING),
+    HFP_COMMAND_ENTRY(HFP_RESPONSE_AND_HOLD,                                 HFP_CMD_RESPONSE_AND_HOLD_STATUS,                     HFP_CMD_RESPONSE_AND_HOLD_STATUS),
+    HFP_COMMAND_ENTRY(HFP_ACTIVATE_VOICE_RECOGNITION,                        HFP_CMD_HF_ACTIVATE_VOICE_RECOGNITION,                HFP_CMD_AG_ACTIVATE_VOICE_RECOGNITION),
+    HFP_COMMAND_ENTRY(HFP_ENABLE_CALL_WAITING_NOTIFICATION,                  HFP_CMD_ENABLE_CALL_WAITING_NOTIFICATION,             HFP_CMD_AG_SENT_CALL_WAITING_NOTIFICATION_UPDATE),
+    HFP_COMMAND_ENTRY(HFP_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES,         HFP_CMD_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES,    HFP_CMD_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES),
+    HFP_COMMAND_ENTRY(HFP_HANG_UP_CALL,                                      HFP_CMD_HANG_UP_CALL,                                 HFP_CMD_HANG_UP_CALL),
+    HFP_COMMAND_ENTRY(HFP_TRANSFER_AG_INDICATOR_STATUS,                      HFP_CMD_TRANSFER_AG_INDICATOR_STATUS,                 HFP_CMD_TRANSFER_AG_INDICATOR_STATUS),
+    HFP_COMMAND_ENTRY(HFP_INDICATOR,                                         HFP_CMD_RETRIEVE_AG_INDICATORS,                       HFP_CMD_RETRIEVE_AG_INDICATORS),
+    HFP_COMMAND_ENTRY(HFP_LIST_CURRENT_CALLS,                                HFP_CMD_LIST_CURRENT_CALLS,                           HFP_CMD_LIST_CURRENT_CALLS),
+    HFP_COMMAND_ENTRY(HFP_ENABLE_CLIP,                                       HFP_CMD_ENABLE_CLIP,                                  HFP_CMD_AG_SENT_CLIP_INFORMATION),
+    HFP_COMMAND_ENTRY(HFP_EXTENDED_AUDIO_GATEWAY_ERROR,                      HFP_CMD_NONE,                                         HFP_CMD_EXTENDED_AUDIO_GATEWAY_ERROR),
+    HFP_COMMAND_ENTRY(HFP_ENABLE_EXTENDED_AUDIO_GATEWAY_ERROR,               HFP_CMD_ENABLE_EXTENDED_AUDIO_GATEWAY_ERROR,          HFP_CMD_NONE),
+    HFP_COMMAND_ENTRY(HFP_ENABLE_STATUS_UPDATE_FOR_AG_INDICATORS,            HFP_CMD_ENABLE_INDICATOR_STATUS_UPDATE,               HFP_CMD_ENABLE_INDICATOR_STATUS_UPDATE),
+    HFP_COMMAND_ENTRY(HFP_SUBSCRIBER_NUMBER_INFORMATION,                     HFP_CMD_GET_SUBSCRIBER_NUMBER_INFORMATION,            HFP_CMD_GET_SUBSCRIBER_NUMBER_INFORMATION),
+    HFP_COMMAND_ENTRY(HFP_QUERY_OPERATOR_SELECTION,                          HFP_CMD_QUERY_OPERATOR_SELECTION_NAME,                HFP_CMD_QUERY_OPERATOR_SELECTION_NAME),
+    HFP_COMMAND_ENTRY(HFP_TURN_OFF_EC_AND_NR,                                HFP_CMD_TURN_OFF_EC_AND_NR,                           HFP_CMD_TURN_OFF_EC_AND_NR),
+    HFP_COMMAND_ENTRY(HFP_SET_MICROPHONE_GAIN,                               HFP_CMD_SET_MICROPHONE_GAIN,                          HFP_CMD_SET_MICROPHONE_GAIN),
+    HFP_COMMAND_ENTRY(HFP_SET_SPEAKER_GAIN,                                  HFP_CMD_SET_SPEAKER_GAIN,                             HFP_CMD_SET_SPEAKER_GAIN),
+    HFP_COMMAND_ENTRY(HFP_TRANSMIT_DTMF_CODES,                               HFP_CMD_TRANSMIT_DTMF_CODES,                          HFP_CMD_TRANSMIT_DTMF_CODES),
+    HFP_COMMAND_ENTRY(HFP_ERROR,                                             HFP_CMD_ERROR,                                        HFP_CMD_ERROR),
+    HFP_COMMAND_ENTRY(HFP_OK,                                                HFP_CMD_NONE,                                         HFP_CMD_OK),
+    HFP_COMMAND_ENTRY(HFP_RING,                                              HFP_CMD_RING,                                         HFP_CMD_RING),
+};
 
-    if (strncmp(line_buffer+offset, HFP_TRANSMIT_DTMF_CODES, strlen(HFP_TRANSMIT_DTMF_CODES)) == 0){
-        return HFP_CMD_TRANSMIT_DTMF_CODES;
+static const hfp_command_entry_t * hfp_parser_lookup_command(const char * line){
+    int left  = 0;
+    int right = (int) (sizeof(hfp_command_table) / sizeof(hfp_command_entry_t)) - 1;
+    while (left <= right){
+        int middle = (left + right) / 2;
+        const hfp_command_entry_t * entry = &hfp_command_table[middle];
+        int res = strncmp(line, entry->name, entry->name_len);
+        if (res == 0) return entry;
+        if (res < 0){
+            right = middle - 1;
+        } else {
+            left = middle + 1;
+        }
     }
+    return NULL;
+}
 
-    if (strncmp(line_buffer+offset, HFP_SET_MICROPHONE_GAIN, strlen(HFP_SET_MICROPHONE_GAIN)) == 0){
-        return HFP_CMD_SET_MICROPHONE_GAIN;
+// refines command by the characters following the command name, e.g. "?" for read and "=?" for test command
+static hfp_command_t hfp_parser_resolve_command_suffix(hfp_command_t command, const char * suffix, int isHandsFree){
+    switch (command){
+        case HFP_CMD_RESPONSE_AND_HOLD_STATUS:
+            if (suffix[0] == '?') return HFP_CMD_RESPONSE_AND_HOLD_QUERY;
+            if (suffix[0] == '=') return HFP_CMD_RESPONSE_AND_HOLD_COMMAND;
+            return command;
+        case HFP_CMD_RETRIEVE_AG_INDICATORS:
+            if (suffix[0] == '?') return HFP_CMD_RETRIEVE_AG_INDICATORS_STATUS;
+            if (strncmp(suffix, "=?", 2) == 0) return command;
+            return HFP_CMD_UNKNOWN;
+        case HFP_CMD_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES:
+            if (isHandsFree) return command;
+            if (strncmp(suffix, "=?", 2) == 0) return command;
+            if (suffix[0] == '=') return HFP_CMD_CALL_HOLD;
+            return HFP_CMD_UNKNOWN;
+        case HFP_CMD_RETRIEVE_GENERIC_STATUS_INDICATORS:
+            if (strncmp(suffix, "=?", 2) == 0) return command;
+            if (suffix[0] == '=') return HFP_CMD_LIST_GENERIC_STATUS_INDICATORS;
+            return HFP_CMD_RETRIEVE_GENERIC_STATUS_INDICATORS_STATE;
+        case HFP_CMD_QUERY_OPERATOR_SELECTION_NAME:
+            if (suffix[0] == '=') return HFP_CMD_QUERY_OPERATOR_SELECTION_NAME_FORMAT;
+            return command;
+        default:
+            return command;
     }
+}
 
-    if (strncmp(line_buffer+offset, HFP_SET_SPEAKER_GAIN, strlen(HFP_SET_SPEAKER_GAIN)) == 0){
-        return HFP_CMD_SET_SPEAKER_GAIN;
-    }
-    
-    if (strncmp(line_buffer+offset, HFP_ACTIVATE_VOICE_RECOGNITION, strlen(HFP_ACTIVATE_VOICE_RECOGNITION)) == 0){
-        if (isHandsFree) return HFP_CMD_AG_ACTIVATE_VOICE_RECOGNITION;
-        return HFP_CMD_HF_ACTIVATE_VOICE_RECOGNITION;
-    }
+// translates command string into hfp_command_t CMD
+static hfp_command_t parse_command(const char * line_buffer, int isHandsFree){
+    int offset = isHandsFree ? 0 : 2;
 
-    if (strncmp(line_buffer+offset, HFP_TURN_OFF_EC_AND_NR, strlen(HFP_TURN_OFF_EC_AND_NR)) == 0){
-        return HFP_CMD_TURN_OFF_EC_AND_NR;
+    const hfp_command_entry_t * entry = hfp_parser_lookup_command(line_buffer+offset);
+    if (entry){
+        hfp_command_t command = isHandsFree ? entry->hf_command : entry->ag_command;
+        if (command != HFP_CMD_NONE){
+            return hfp_parser_resolve_command_suffix(command, line_buffer+offset+entry->name_len, isHandsFree);
+        }
     }
 
     if (strncmp(line_buffer, HFP_CALL_ANSWERED, strlen(HFP_CALL_ANSWERED)) == 0){
@@ -771,139 +834,6 @@ static hfp_command_t parse_command(const char * line_buffer, int isHandsFree){
         return HFP_CMD_CALL_PHONE_NUMBER;
     }
 
-    if (strncmp(line_buffer+offset, HFP_REDIAL_LAST_NUMBER, strlen(HFP_REDIAL_LAST_NUMBER)) == 0){
-        return HFP_CMD_REDIAL_LAST_NUMBER;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_CHANGE_IN_BAND_RING_TONE_SETTING, strlen(HFP_CHANGE_IN_BAND_RING_TONE_SETTING)) == 0){
-        return HFP_CMD_CHANGE_IN_BAND_RING_TONE_SETTING;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_HANG_UP_CALL, strlen(HFP_HANG_UP_CALL)) == 0){
-        return HFP_CMD_HANG_UP_CALL;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_ERROR, strlen(HFP_ERROR)) == 0){
-        return HFP_CMD_ERROR;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_RING, strlen(HFP_RING)) == 0){
-        return HFP_CMD_RING;
-    }
-
-    if (isHandsFree && strncmp(line_buffer+offset, HFP_OK, strlen(HFP_OK)) == 0){
-        return HFP_CMD_OK;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_SUPPORTED_FEATURES, strlen(HFP_SUPPORTED_FEATURES)) == 0){
-        return HFP_CMD_SUPPORTED_FEATURES;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_TRANSFER_HF_INDICATOR_STATUS, strlen(HFP_TRANSFER_HF_INDICATOR_STATUS)) == 0){
-        return HFP_CMD_HF_INDICATOR_STATUS;
-    }
-    
-    if (strncmp(line_buffer+offset, HFP_RESPONSE_AND_HOLD, strlen(HFP_RESPONSE_AND_HOLD)) == 0){
-        if (strncmp(line_buffer+strlen(HFP_RESPONSE_AND_HOLD)+offset, "?", 1) == 0){
-            return HFP_CMD_RESPONSE_AND_HOLD_QUERY;
-        }
-        if (strncmp(line_buffer+strlen(HFP_RESPONSE_AND_HOLD)+offset, "=", 1) == 0){
-            return HFP_CMD_RESPONSE_AND_HOLD_COMMAND;
-        }
-        return HFP_CMD_RESPONSE_AND_HOLD_STATUS;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_INDICATOR, strlen(HFP_INDICATOR)) == 0){
-        if (strncmp(line_buffer+strlen(HFP_INDICATOR)+offset, "?", 1) == 0){
-            return HFP_CMD_RETRIEVE_AG_INDICATORS_STATUS;
-        }
-
-        if (strncmp(line_buffer+strlen(HFP_INDICATOR)+offset, "=?", 2) == 0){
-            return HFP_CMD_RETRIEVE_AG_INDICATORS;
-        }
-    }
-
-    if (strncmp(line_buffer+offset, HFP_AVAILABLE_CODECS, strlen(HFP_AVAILABLE_CODECS)) == 0){
-        return HFP_CMD_AVAILABLE_CODECS;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_ENABLE_STATUS_UPDATE_FOR_AG_INDICATORS, strlen(HFP_ENABLE_STATUS_UPDATE_FOR_AG_INDICATORS)) == 0){
-        return HFP_CMD_ENABLE_INDICATOR_STATUS_UPDATE;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_ENABLE_CLIP, strlen(HFP_ENABLE_CLIP)) == 0){
-        if (isHandsFree) return HFP_CMD_AG_SENT_CLIP_INFORMATION;
-        return HFP_CMD_ENABLE_CLIP;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_ENABLE_CALL_WAITING_NOTIFICATION, strlen(HFP_ENABLE_CALL_WAITING_NOTIFICATION)) == 0){
-        if (isHandsFree) return HFP_CMD_AG_SENT_CALL_WAITING_NOTIFICATION_UPDATE;
-        return HFP_CMD_ENABLE_CALL_WAITING_NOTIFICATION;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES, strlen(HFP_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES)) == 0){
-        
-        if (isHandsFree) return HFP_CMD_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES;
-
-        if (strncmp(line_buffer+strlen(HFP_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES)+offset, "=?", 2) == 0){
-            return HFP_CMD_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES;
-        }
-        if (strncmp(line_buffer+strlen(HFP_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES)+offset, "=", 1) == 0){
-            return HFP_CMD_CALL_HOLD;    
-        }
-
-        return HFP_CMD_UNKNOWN;
-    } 
-
-    if (strncmp(line_buffer+offset, HFP_GENERIC_STATUS_INDICATOR, strlen(HFP_GENERIC_STATUS_INDICATOR)) == 0){
-        if (isHandsFree) {
-            return HFP_CMD_SET_GENERIC_STATUS_INDICATOR_STATUS;
-        }
-        if (strncmp(line_buffer+strlen(HFP_GENERIC_STATUS_INDICATOR)+offset, "=?", 2) == 0){
-            return HFP_CMD_RETRIEVE_GENERIC_STATUS_INDICATORS;
-        } 
-        if (strncmp(line_buffer+strlen(HFP_GENERIC_STATUS_INDICATOR)+offset, "=", 1) == 0){
-            return HFP_CMD_LIST_GENERIC_STATUS_INDICATORS;    
-        }
-        return HFP_CMD_RETRIEVE_GENERIC_STATUS_INDICATORS_STATE;
-    } 
-
-    if (strncmp(line_buffer+offset, HFP_UPDATE_ENABLE_STATUS_FOR_INDIVIDUAL_AG_INDICATORS, strlen(HFP_UPDATE_ENABLE_STATUS_FOR_INDIVIDUAL_AG_INDICATORS)) == 0){
-        return HFP_CMD_ENABLE_INDIVIDUAL_AG_INDICATOR_STATUS_UPDATE;
-    } 
-    
-
-    if (strncmp(line_buffer+offset, HFP_QUERY_OPERATOR_SELECTION, strlen(HFP_QUERY_OPERATOR_SELECTION)) == 0){
-        if (strncmp(line_buffer+strlen(HFP_QUERY_OPERATOR_SELECTION)+offset, "=", 1) == 0){
-            return HFP_CMD_QUERY_OPERATOR_SELECTION_NAME_FORMAT;
-        } 
-        return HFP_CMD_QUERY_OPERATOR_SELECTION_NAME;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_TRANSFER_AG_INDICATOR_STATUS, strlen(HFP_TRANSFER_AG_INDICATOR_STATUS)) == 0){
-        return HFP_CMD_TRANSFER_AG_INDICATOR_STATUS;
-    } 
-
-    if (isHandsFree && strncmp(line_buffer+offset, HFP_EXTENDED_AUDIO_GATEWAY_ERROR, strlen(HFP_EXTENDED_AUDIO_GATEWAY_ERROR)) == 0){
-        return HFP_CMD_EXTENDED_AUDIO_GATEWAY_ERROR;
-    }
-
-    if (!isHandsFree && strncmp(line_buffer+offset, HFP_ENABLE_EXTENDED_AUDIO_GATEWAY_ERROR, strlen(HFP_ENABLE_EXTENDED_AUDIO_GATEWAY_ERROR)) == 0){
-        return HFP_CMD_ENABLE_EXTENDED_AUDIO_GATEWAY_ERROR;
-    }
-
-    if (strncmp(line_buffer+offset, HFP_TRIGGER_CODEC_CONNECTION_SETUP, strlen(HFP_TRIGGER_CODEC_CONNECTION_SETUP)) == 0){
-        return HFP_CMD_TRIGGER_CODEC_CONNECTION_SETUP;
-    } 
-
-    if (strncmp(line_buffer+offset, HFP_CONFIRM_COMMON_CODEC, strlen(HFP_CONFIRM_COMMON_CODEC)) == 0){
-        if (isHandsFree){
-            return HFP_CMD_AG_SUGGESTED_CODEC;
-        } else {
-            return HFP_CMD_HF_CONFIRMED_CODEC;
-        }
-    } 
-    
     if (strncmp(line_buffer+offset, "AT+", 3) == 0){
         log_info("process unknown HF command %s \n", line_buffer);
         return HFP_CMD_UNKNOWN;
@@ -939,13 +869,15 @@ static int hfp_parser_is_end_of_header(uint8_t byte){
     return hfp_parser_is_end_of_line(byte) || byte == ':' || byte == '?';
 }
 
+static int hfp_parser_is_separator(uint8_t byte){
+    return  byte == ',' || byte == '\n'|| byte == '\r'||
+            byte == ')' || byte == '(' || byte == ':' || 
+            byte == '-' || byte == '"' ||  byte == '?'|| byte == '=';
+}
+
 static int hfp_parser_found_separator(hfp_connection_t * hfp_connection, uint8_t byte){
     if (hfp_connection->keep_byte == 1) return 1;
-
-    int found_separator =   byte == ',' || byte == '\n'|| byte == '\r'||
-                            byte == ')' || byte == '(' || byte == ':' || 
-                            byte == '-' || byte == '"' ||  byte == '?'|| byte == '=';
-    return found_separator;
+    return hfp_parser_is_separator(byte);
 }
 
 static void hfp_parser_next_state(hfp_connection_t * hfp_connection, uint8_t byte){
@@ -1146,6 +1078,36 @@ void hfp_parse(hfp_connection_t * hfp_connection, uint8_t byte, int isHandsFree)
     }
 }
 
+static int hfp_parser_is_dial_string(hfp_connection_t * hfp_connection){
+    return hfp_connection->line_buffer[0] == 'A' && hfp_connection->line_buffer[1] == 'T' && hfp_connection->line_buffer[2] == 'D';
+}
+
+// stores run of plain characters that hfp_parse would store unchanged into line buffer, returns number of bytes consumed
+static uint16_t hfp_parser_store_plain_bytes(hfp_connection_t * hfp_connection, const uint8_t * buffer, uint16_t size){
+    if (hfp_connection->keep_byte) return 0;
+
+    uint16_t pos = 0;
+    while (pos < size && hfp_connection->line_size < (HFP_MAX_INDICATOR_DESC_SIZE - 1)){
+        uint8_t byte = buffer[pos];
+        if (byte == ' ' || hfp_parser_is_separator(byte)) break;
+        // ATD<dial_string> is handled by hfp_parse
+        if (hfp_parser_is_dial_string(hfp_connection)) break;
+        hfp_connection->line_buffer[hfp_connection->line_size++] = byte;
+        hfp_connection->line_buffer[hfp_connection->line_size] = 0;
+        pos++;
+    }
+    return pos;
+}
+
+void hfp_parse_buffer(hfp_connection_t * hfp_connection, const uint8_t * buffer, uint16_t size, int isHandsFree){
+    uint16_t pos = 0;
+    while (pos < size){
+        pos += hfp_parser_store_plain_bytes(hfp_connection, &buffer[pos], size - pos);
+        if (pos == size) break;
+        hfp_parse(hfp_connection, buffer[pos++], isHandsFree);
+    }
+}
+
 static void parse_sequence(hfp_connection_t * hfp_connection){
     int value;
     switch (hfp_connection->command){
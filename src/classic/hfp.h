@@ -648,6 +648,7 @@ hfp_connection_t * get_hfp_connection_context_for_acl_handle(uint16_t handle);
 
 btstack_linked_list_t * hfp_get_connections(void);
 void hfp_parse(hfp_connection_t * connection, uint8_t byte, int isHandsFree);
+void hfp_parse_buffer(hfp_connection_t * connection, const uint8_t * buffer, uint16_t size, int isHandsFree);
 
 void hfp_establish_service_level_connection(bd_addr_t bd_addr, uint16_t service_uuid);
 void hfp_release_service_level_connection(hfp_connection_t * connection);
@@ -1830,10 +1830,7 @@ static void hfp_handle_rfcomm_data(uint8_t packet_type, uint16_t channel, uint8_
     log_info("HFP_RX %s", packet);
     packet[size-1] = last_char;
     
-    int pos;
-    for (pos = 0; pos < size ; pos++){
-        hfp_parse(hfp_connection, packet[pos], 0);
-    }
+    hfp_parse_buffer(hfp_connection, packet, size, 0);
     hfp_generic_status_indicator_t * indicator;
     int value;
     switch(hfp_connection->command){
@@ -998,10 +998,8 @@ static void hfp_handle_rfcomm_event(uint8_t packet_type, uint16_t channel, uint8
     log_info("HFP_RX %s", packet);
     packet[size-1] = last_char;
             
-    int pos, i, value;
-    for (pos = 0; pos < size ; pos++){
-        hfp_parse(hfp_connection, packet[pos], 1);
-    } 
+    int i, value;
+    hfp_parse_buffer(hfp_connection, packet, size, 1);
 
     switch (hfp_connection->command){
         case HFP_CMD_GET_SUBSCRIBER_NUMBER_INFORMATION:
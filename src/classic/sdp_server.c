@@ -116,6 +116,385 @@ uint32_t sdp_create_service_record_handle(void){
     return handle;
 }
 
+#ifdef MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES
+
+// MARK: SDP Server Index
+//
+// At registration, the normalized UUIDs of each record are added to an inverted index sorted by UUID,
+// and the offsets of its attribute values to an attribute index grouped by record. Service search patterns
+// are then evaluated without parsing the records, and attributes are copied using the stored offsets.
+// Records that don't fit into the index or have attribute IDs not in ascending order are parsed as before.
+
+#ifndef MAX_NR_SDP_SERVER_ATTRIBUTE_INDEX_ENTRIES
+#define MAX_NR_SDP_SERVER_ATTRIBUTE_INDEX_ENTRIES (2 * MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES)
+#endif
+
+// attribute ID lists with more ranges are handled by parsing the records
+#define SDP_SERVER_MAX_ATTRIBUTE_RANGES 8
+
+typedef struct {
+    uint8_t                 uuid128[16];
+    service_record_item_t * item;
+} sdp_server_uuid_index_entry_t;
+
+typedef struct {
+    uint16_t attribute_id;
+    uint16_t value_offset;
+} sdp_server_attribute_index_entry_t;
+
+typedef struct {
+    uint16_t first;
+    uint16_t last;
+} sdp_server_attribute_range_t;
+
+typedef struct {
+    uint8_t * buffer;
+    uint16_t  start_offset;
+    uint16_t  max_bytes;
+    uint16_t  used_bytes;
+} sdp_server_filter_context_t;
+
+static sdp_server_uuid_index_entry_t      sdp_server_uuid_index[MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES];
+static uint16_t                           sdp_server_uuid_index_size;
+static sdp_server_attribute_index_entry_t sdp_server_attribute_index[MAX_NR_SDP_SERVER_ATTRIBUTE_INDEX_ENTRIES];
+static uint16_t                           sdp_server_attribute_index_size;
+
+// attribute ID list of current request as sorted, disjoint ranges
+static sdp_server_attribute_range_t       sdp_server_attribute_ranges[SDP_SERVER_MAX_ATTRIBUTE_RANGES];
+static uint16_t                           sdp_server_num_attribute_ranges;
+static int                                sdp_server_attribute_ranges_valid;
+
+// position of first entry with UUID >= uuid128
+static uint16_t sdp_server_uuid_index_lower_bound(const uint8_t * uuid128){
+    uint16_t low  = 0;
+    uint16_t high = sdp_server_uuid_index_size;
+    while (low < high){
+        uint16_t mid = (low + high) / 2;
+        if (memcmp(sdp_server_uuid_index[mid].uuid128, uuid128, 16) < 0){
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int sdp_server_uuid_index_add(const uint8_t * uuid128, service_record_item_t * item){
+    uint16_t pos = sdp_server_uuid_index_lower_bound(uuid128);
+    while (pos < sdp_server_uuid_index_size && memcmp(sdp_server_uuid_index[pos].uuid128, uuid128, 16) == 0){
+        // UUID used multiple times in record
+        if (sdp_server_uuid_index[pos].item == item) return 1;
+        pos++;
+    }
+    if (sdp_server_uuid_index_size == MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES) return 0;
+    memmove(&sdp_server_uuid_index[pos + 1], &sdp_server_uuid_index[pos], (sdp_server_uuid_index_size - pos) * sizeof(sdp_server_uuid_index_entry_t));
+    memcpy(sdp_server_uuid_index[pos].uuid128, uuid128, 16);
+    sdp_server_uuid_index[pos].item = item;
+    sdp_server_uuid_index_size++;
+    return 1;
+}
+
+// add UUIDs of all nested data element sequences, see sdp_record_contains_UUID128
+static int sdp_server_uuid_index_add_sequence(uint8_t * element, service_record_item_t * item){
+    des_iterator_t it;
+    for (des_iterator_init(&it, element); des_iterator_has_more(&it); des_iterator_next(&it)){
+        uint8_t * child = des_iterator_get_element(&it);
+        uint8_t uuid128[16];
+        switch (des_iterator_get_type(&it)){
+            case DE_UUID:
+                if (!de_get_normalized_uuid(uuid128, child)) break;
+                if (!sdp_server_uuid_index_add(uuid128, item)) return 0;
+                break;
+            case DE_DES:
+                if (!sdp_server_uuid_index_add_sequence(child, item)) return 0;
+                break;
+            default:
+                break;
+        }
+    }
+    return 1;
+}
+
+static void sdp_server_uuid_index_remove(service_record_item_t * item){
+    uint16_t i;
+    uint16_t size = 0;
+    for (i = 0; i < sdp_server_uuid_index_size; i++){
+        if (sdp_server_uuid_index[i].item == item) continue;
+        sdp_server_uuid_index[size++] = sdp_server_uuid_index[i];
+    }
+    sdp_server_uuid_index_size = size;
+}
+
+// append attributes of record to attribute index, see sdp_attribute_list_traverse_sequence
+static int sdp_server_attribute_index_add(service_record_item_t * item){
+    item->attribute_index_start = sdp_server_attribute_index_size;
+    item->attribute_index_count = 0;
+    des_iterator_t it;
+    if (!des_iterator_init(&it, item->service_record)) return 0;
+    while (des_iterator_has_more(&it)){
+        uint8_t * id_element = des_iterator_get_element(&it);
+        if (des_iterator_get_type(&it) != DE_UINT || de_get_size_type(id_element) != DE_SIZE_16) break;
+        uint16_t attribute_id = big_endian_read_16(id_element, 1);
+        des_iterator_next(&it);
+        if (!des_iterator_has_more(&it)) break;
+        // lookup by attribute ID requires ascending order
+        if (item->attribute_index_count && attribute_id <= sdp_server_attribute_index[sdp_server_attribute_index_size - 1].attribute_id) return 0;
+        if (sdp_server_attribute_index_size == MAX_NR_SDP_SERVER_ATTRIBUTE_INDEX_ENTRIES) return 0;
+        sdp_server_attribute_index[sdp_server_attribute_index_size].attribute_id = attribute_id;
+        sdp_server_attribute_index[sdp_server_attribute_index_size].value_offset = it.pos;
+        sdp_server_attribute_index_size++;
+        item->attribute_index_count++;
+        des_iterator_next(&it);
+    }
+    return 1;
+}
+
+static void sdp_server_attribute_index_remove(service_record_item_t * item){
+    uint16_t start = item->attribute_index_start;
+    uint16_t count = item->attribute_index_count;
+    if (count == 0) return;
+    uint16_t end   = start + count;
+    memmove(&sdp_server_attribute_index[start], &sdp_server_attribute_index[end], (sdp_server_attribute_index_size - end) * sizeof(sdp_server_attribute_index_entry_t));
+    sdp_server_attribute_index_size -= count;
+    item->attribute_index_count = 0;
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) sdp_service_records; it ; it = it->next){
+        service_record_item_t * other = (service_record_item_t *) it;
+        if (other->attribute_index_start > start){
+            other->attribute_index_start -= count;
+        }
+    }
+}
+
+static void sdp_server_index_add_record(service_record_item_t * item){
+    item->indexed = 0;
+    if (sdp_server_uuid_index_add_sequence(item->service_record, item) && sdp_server_attribute_index_add(item)){
+        item->indexed = 1;
+        return;
+    }
+    log_info("sdp_server_index: record 0x%08x not indexed, using record parsing", (unsigned int) item->service_record_handle);
+    sdp_server_uuid_index_remove(item);
+    sdp_server_attribute_index_remove(item);
+}
+
+static void sdp_server_index_remove_record(service_record_item_t * item){
+    if (!item->indexed) return;
+    sdp_server_uuid_index_remove(item);
+    sdp_server_attribute_index_remove(item);
+    item->indexed = 0;
+}
+
+// evaluate service search pattern for all records, see sdp_record_matches_service_search_pattern
+static void sdp_server_index_match_service_search_pattern(uint8_t * serviceSearchPattern){
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) sdp_service_records; it ; it = it->next){
+        ((service_record_item_t *) it)->search_step = 0;
+    }
+    // records that contain the UUIDs of all previous steps advance to the next step
+    int      match = 1;
+    uint16_t step  = 0;
+    des_iterator_t des_it;
+    for (des_iterator_init(&des_it, serviceSearchPattern); des_iterator_has_more(&des_it); des_iterator_next(&des_it)){
+        uint8_t uuid128[16];
+        if (!de_get_normalized_uuid(uuid128, des_iterator_get_element(&des_it))){
+            match = 0;
+            break;
+        }
+        int advanced = 0;
+        uint16_t pos;
+        for (pos = sdp_server_uuid_index_lower_bound(uuid128); pos < sdp_server_uuid_index_size; pos++){
+            if (memcmp(sdp_server_uuid_index[pos].uuid128, uuid128, 16) != 0) break;
+            service_record_item_t * item = sdp_server_uuid_index[pos].item;
+            if (item->search_step != step) continue;
+            item->search_step++;
+            advanced = 1;
+        }
+        if (!advanced){
+            match = 0;
+            break;
+        }
+        step++;
+    }
+    for (it = (btstack_linked_item_t *) sdp_service_records; it ; it = it->next){
+        service_record_item_t * item = (service_record_item_t *) it;
+        if (item->indexed){
+            item->search_match = match && (item->search_step == step);
+        } else {
+            item->search_match = sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern);
+        }
+    }
+}
+
+// convert attribute ID list into sorted, disjoint ranges, see sdp_attribute_list_constains_id
+static void sdp_server_index_prepare_attribute_id_list(uint8_t * attributeIDList){
+    sdp_server_num_attribute_ranges = 0;
+    sdp_server_attribute_ranges_valid = 0;
+    des_iterator_t it;
+    for (des_iterator_init(&it, attributeIDList); des_iterator_has_more(&it); des_iterator_next(&it)){
+        if (des_iterator_get_type(&it) != DE_UINT) continue;
+        uint8_t * element = des_iterator_get_element(&it);
+        uint16_t first;
+        uint16_t last;
+        switch (de_get_size_type(element)){
+            case DE_SIZE_16:
+                first = big_endian_read_16(element, 1);
+                last  = first;
+                break;
+            case DE_SIZE_32:
+                first = big_endian_read_16(element, 1);
+                last  = big_endian_read_16(element, 3);
+                break;
+            default:
+                continue;
+        }
+        if (first > last) continue;
+        if (sdp_server_num_attribute_ranges == SDP_SERVER_MAX_ATTRIBUTE_RANGES) return;
+        // insert sorted by first attribute ID
+        uint16_t pos = sdp_server_num_attribute_ranges++;
+        while (pos > 0 && sdp_server_attribute_ranges[pos-1].first > first){
+            sdp_server_attribute_ranges[pos] = sdp_server_attribute_ranges[pos-1];
+            pos--;
+        }
+        sdp_server_attribute_ranges[pos].first = first;
+        sdp_server_attribute_ranges[pos].last  = last;
+    }
+    // merge overlapping ranges
+    uint16_t i;
+    uint16_t num_ranges = 0;
+    for (i = 0; i < sdp_server_num_attribute_ranges; i++){
+        if (num_ranges && sdp_server_attribute_ranges[i].first <= sdp_server_attribute_ranges[num_ranges-1].last){
+            if (sdp_server_attribute_ranges[i].last > sdp_server_attribute_ranges[num_ranges-1].last){
+                sdp_server_attribute_ranges[num_ranges-1].last = sdp_server_attribute_ranges[i].last;
+            }
+            continue;
+        }
+        sdp_server_attribute_ranges[num_ranges++] = sdp_server_attribute_ranges[i];
+    }
+    sdp_server_num_attribute_ranges = num_ranges;
+    sdp_server_attribute_ranges_valid = 1;
+}
+
+// position of first attribute of record with ID >= attribute_id
+static uint16_t sdp_server_attribute_index_lower_bound(service_record_item_t * item, uint16_t attribute_id){
+    uint16_t low  = item->attribute_index_start;
+    uint16_t high = item->attribute_index_start + item->attribute_index_count;
+    while (low < high){
+        uint16_t mid = (low + high) / 2;
+        if (sdp_server_attribute_index[mid].attribute_id < attribute_id){
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static uint16_t sdp_server_index_get_filtered_size(service_record_item_t * item){
+    uint16_t size = 0;
+    uint16_t end  = item->attribute_index_start + item->attribute_index_count;
+    uint16_t i;
+    for (i = 0; i < sdp_server_num_attribute_ranges; i++){
+        uint16_t pos;
+        for (pos = sdp_server_attribute_index_lower_bound(item, sdp_server_attribute_ranges[i].first); pos < end; pos++){
+            if (sdp_server_attribute_index[pos].attribute_id > sdp_server_attribute_ranges[i].last) break;
+            size += 3 + de_get_len(&item->service_record[sdp_server_attribute_index[pos].value_offset]);
+        }
+    }
+    return size;
+}
+
+// skip start offset, then copy up to max bytes. returns 1 if data was copied completely
+static int sdp_server_filter_append(sdp_server_filter_context_t * context, const uint8_t * data, uint16_t len){
+    if (context->start_offset >= len){
+        context->start_offset -= len;
+        return 1;
+    }
+    int complete = 1;
+    uint16_t copy_len = len - context->start_offset;
+    if (copy_len > context->max_bytes){
+        copy_len = context->max_bytes;
+        complete = 0;
+    }
+    memcpy(&context->buffer[context->used_bytes], &data[context->start_offset], copy_len);
+    context->used_bytes  += copy_len;
+    context->max_bytes   -= copy_len;
+    context->start_offset = 0;
+    return complete;
+}
+
+static int sdp_server_index_filter_attributes(service_record_item_t * item, uint16_t startOffset, uint16_t maxBytes, uint16_t *usedBytes, uint8_t *buffer){
+    sdp_server_filter_context_t context;
+    context.buffer       = buffer;
+    context.start_offset = startOffset;
+    context.max_bytes    = maxBytes;
+    context.used_bytes   = 0;
+    int complete = 1;
+    uint16_t end = item->attribute_index_start + item->attribute_index_count;
+    uint16_t i;
+    for (i = 0; complete && i < sdp_server_num_attribute_ranges; i++){
+        uint16_t pos;
+        for (pos = sdp_server_attribute_index_lower_bound(item, sdp_server_attribute_ranges[i].first); pos < end; pos++){
+            uint16_t attribute_id = sdp_server_attribute_index[pos].attribute_id;
+            if (attribute_id > sdp_server_attribute_ranges[i].last) break;
+            // { Attribute ID (Descriptor, big endian 16-bit ID), AttributeValue (data)}
+            uint8_t id_buffer[3];
+            de_store_descriptor_with_len(id_buffer, DE_UINT, DE_SIZE_16, 0);
+            big_endian_store_16(id_buffer, 1, attribute_id);
+            const uint8_t * attribute_value = &item->service_record[sdp_server_attribute_index[pos].value_offset];
+            complete = sdp_server_filter_append(&context, id_buffer, 3)
+                    && sdp_server_filter_append(&context, attribute_value, de_get_len(attribute_value));
+            if (!complete) break;
+        }
+    }
+    *usedBytes = context.used_bytes;
+    return complete;
+}
+
+#endif
+
+static void sdp_prepare_service_search_pattern(uint8_t * serviceSearchPattern){
+#ifdef MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES
+    sdp_server_index_match_service_search_pattern(serviceSearchPattern);
+#else
+    UNUSED(serviceSearchPattern);
+#endif
+}
+
+static int sdp_record_item_matches_service_search_pattern(service_record_item_t * item, uint8_t * serviceSearchPattern){
+#ifdef MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES
+    UNUSED(serviceSearchPattern);
+    return item->search_match;
+#else
+    return sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern);
+#endif
+}
+
+static void sdp_prepare_attribute_id_list(uint8_t * attributeIDList){
+#ifdef MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES
+    sdp_server_index_prepare_attribute_id_list(attributeIDList);
+#else
+    UNUSED(attributeIDList);
+#endif
+}
+
+static uint16_t sdp_get_filtered_size(service_record_item_t * item, uint8_t * attributeIDList){
+#ifdef MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES
+    if (item->indexed && sdp_server_attribute_ranges_valid){
+        return sdp_server_index_get_filtered_size(item);
+    }
+#endif
+    return spd_get_filtered_size(item->service_record, attributeIDList);
+}
+
+static int sdp_filter_attributes(service_record_item_t * item, uint8_t * attributeIDList, uint16_t startOffset, uint16_t maxBytes, uint16_t *usedBytes, uint8_t *buffer){
+#ifdef MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES
+    if (item->indexed && sdp_server_attribute_ranges_valid){
+        return sdp_server_index_filter_attributes(item, startOffset, maxBytes, usedBytes, buffer);
+    }
+#endif
+    return sdp_filter_attributes_in_attributeIDList(item->service_record, attributeIDList, startOffset, maxBytes, usedBytes, buffer);
+}
+
 /**
  * @brief Register Service Record with database using ServiceRecordHandle stored in record
  * @pre AttributeIDs are in ascending order
@@ -141,6 +520,10 @@ uint8_t sdp_register_service(const uint8_t * record){
     
     // add to linked list
     btstack_linked_list_add(&sdp_service_records, (btstack_linked_item_t *) newRecordItem);
+
+#ifdef MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES
+    sdp_server_index_add_record(newRecordItem);
+#endif
     
     return 0;
 }
@@ -152,6 +535,9 @@ void sdp_unregister_service(uint32_t service_record_handle){
     service_record_item_t * record_item = sdp_get_record_item_for_handle(service_record_handle);
     if (!record_item) return;
     btstack_linked_list_remove(&sdp_service_records, (btstack_linked_item_t *) record_item);
+#ifdef MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES
+    sdp_server_index_remove_record(record_item);
+#endif
 }
 
 // PDU
@@ -185,12 +571,14 @@ int sdp_handle_service_search_request(uint8_t * packet, uint16_t remote_mtu){
         continuation_index = big_endian_read_16(continuationState, 1);
     }
     
+    sdp_prepare_service_search_pattern(serviceSearchPattern);
+
     // get and limit total count
     btstack_linked_item_t *it;
     uint16_t total_service_count   = 0;
     for (it = (btstack_linked_item_t *) sdp_service_records; it ; it = it->next){
         service_record_item_t * item = (service_record_item_t *) it;
-        if (!sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern)) continue;
+        if (!sdp_record_item_matches_service_search_pattern(item, serviceSearchPattern)) continue;
         total_service_count++;
     }
     if (total_service_count > maximumServiceRecordCount){
@@ -205,7 +593,7 @@ int sdp_handle_service_search_request(uint8_t * packet, uint16_t remote_mtu){
     for (it = (btstack_linked_item_t *) sdp_service_records; it ; it = it->next, ++current_service_index){
         service_record_item_t * item = (service_record_item_t *) it;
 
-        if (!sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern)) continue;
+        if (!sdp_record_item_matches_service_search_pattern(item, serviceSearchPattern)) continue;
         matching_service_count++;
         
         if (current_service_index < continuation_index) continue;
@@ -265,6 +653,8 @@ int sdp_handle_service_attribute_request(uint8_t * packet, uint16_t remote_mtu){
         continuation_offset = big_endian_read_16(continuationState, 1);
     }
     
+    sdp_prepare_attribute_id_list(attributeIDList);
+
     // get service record
     service_record_item_t * item = sdp_get_record_item_for_handle(serviceRecordHandle);
     if (!item){
@@ -279,7 +669,7 @@ int sdp_handle_service_attribute_request(uint8_t * packet, uint16_t remote_mtu){
     if (continuation_offset == 0){
         
         // get size of this record
-        uint16_t filtered_attributes_size = spd_get_filtered_size(item->service_record, attributeIDList);
+        uint16_t filtered_attributes_size = sdp_get_filtered_size(item, attributeIDList);
         
         // store DES
         de_store_descriptor_with_len(&sdp_response_buffer[pos], DE_DES, DE_SIZE_VAR_16, filtered_attributes_size);
@@ -289,7 +679,7 @@ int sdp_handle_service_attribute_request(uint8_t * packet, uint16_t remote_mtu){
 
     // copy maximumAttributeByteCount from record
     uint16_t bytes_used;
-    int complete = sdp_filter_attributes_in_attributeIDList(item->service_record, attributeIDList, continuation_offset, maximumAttributeByteCount, &bytes_used, &sdp_response_buffer[pos]);
+    int complete = sdp_filter_attributes(item, attributeIDList, continuation_offset, maximumAttributeByteCount, &bytes_used, &sdp_response_buffer[pos]);
     pos += bytes_used;
     
     uint16_t attributeListByteCount = pos - 7;
@@ -318,10 +708,10 @@ static uint16_t sdp_get_size_for_service_search_attribute_response(uint8_t * ser
     for (it = (btstack_linked_item_t *) sdp_service_records; it ; it = it->next){
         service_record_item_t * item = (service_record_item_t *) it;
         
-        if (!sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern)) continue;
+        if (!sdp_record_item_matches_service_search_pattern(item, serviceSearchPattern)) continue;
         
         // for all service records that match
-        total_response_size += 3 + spd_get_filtered_size(item->service_record, attributeIDList);
+        total_response_size += 3 + sdp_get_filtered_size(item, attributeIDList);
     }
     return total_response_size;
 }
@@ -356,6 +746,9 @@ int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remot
         continuation_offset = big_endian_read_16(continuationState, 3);
     }
 
+    sdp_prepare_service_search_pattern(serviceSearchPattern);
+    sdp_prepare_attribute_id_list(attributeIDList);
+
     // log_info("--> sdp_handle_service_search_attribute_request, cont %u/%u, max %u", continuation_service_index, continuation_offset, maximumAttributeByteCount);
     
     // AttributeLists - starts at offset 7
@@ -379,12 +772,12 @@ int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remot
         service_record_item_t * item = (service_record_item_t *) it;
         
         if (current_service_index < continuation_service_index ) continue;
-        if (!sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern)) continue;
+        if (!sdp_record_item_matches_service_search_pattern(item, serviceSearchPattern)) continue;
 
         if (continuation_offset == 0){
             
             // get size of this record
-            uint16_t filtered_attributes_size = spd_get_filtered_size(item->service_record, attributeIDList);
+            uint16_t filtered_attributes_size = sdp_get_filtered_size(item, attributeIDList);
             
             // stop if complete record doesn't fits into response but we already have a partial response
             if ((filtered_attributes_size + 3 > maximumAttributeByteCount) && !first_answer) {
@@ -402,7 +795,7 @@ int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remot
     
         // copy maximumAttributeByteCount from record
         uint16_t bytes_used;
-        int complete = sdp_filter_attributes_in_attributeIDList(item->service_record, attributeIDList, continuation_offset, maximumAttributeByteCount, &bytes_used, &sdp_response_buffer[pos]);
+        int complete = sdp_filter_attributes(item, attributeIDList, continuation_offset, maximumAttributeByteCount, &bytes_used, &sdp_response_buffer[pos]);
         pos += bytes_used;
         maximumAttributeByteCount -= bytes_used;
         
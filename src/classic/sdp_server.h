@@ -52,6 +52,16 @@ typedef struct {
 
     uint32_t        service_record_handle;
     uint8_t *       service_record;
+
+#ifdef MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES
+    // attribute value offsets in sdp server index, valid if indexed
+    uint16_t        attribute_index_start;
+    uint16_t        attribute_index_count;
+    uint8_t         indexed;
+    // result of service search pattern evaluation for current request
+    uint8_t         search_match;
+    uint16_t        search_step;
+#endif
 } service_record_item_t;
 
 int sdp_handle_service_search_request(uint8_t * packet, uint16_t remote_mtu);
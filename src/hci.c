@@ -172,6 +172,115 @@ static hci_stack_t * hci_stack = NULL;
 static uint8_t disable_l2cap_timeouts = 0;
 #endif
 
+static int hci_connection_handle_hash(hci_con_handle_t con_handle){
+    return con_handle & (HCI_CONNECTION_HASH_SIZE - 1);
+}
+
+static int hci_connection_address_hash(const bd_addr_t addr, bd_addr_type_t addr_type){
+    uint32_t hash = addr_type;
+    int i;
+    for (i = 0; i < 6; i++){
+        hash = hash * 31 + addr[i];
+    }
+    return (hash ^ (hash >> 8)) & (HCI_CONNECTION_HASH_SIZE - 1);
+}
+
+static void hci_connection_add_to_handle_index(hci_connection_t * conn){
+    hci_connection_t ** bucket = &hci_stack->connections_by_handle[hci_connection_handle_hash(conn->con_handle)];
+    conn->next_for_handle = *bucket;
+    *bucket = conn;
+}
+
+static void hci_connection_add_to_address_index(hci_connection_t * conn){
+    hci_connection_t ** bucket = &hci_stack->connections_by_address[hci_connection_address_hash(conn->address, conn->address_type)];
+    conn->next_for_address = *bucket;
+    *bucket = conn;
+}
+
+static void hci_connection_remove_from_handle_index(hci_connection_t * conn){
+    hci_connection_t ** it;
+    for (it = &hci_stack->connections_by_handle[hci_connection_handle_hash(conn->con_handle)]; *it ; it = &(*it)->next_for_handle){
+        if (*it != conn) continue;
+        *it = conn->next_for_handle;
+        return;
+    }
+}
+
+static void hci_connection_remove_from_address_index(hci_connection_t * conn){
+    hci_connection_t ** it;
+    for (it = &hci_stack->connections_by_address[hci_connection_address_hash(conn->address, conn->address_type)]; *it ; it = &(*it)->next_for_address){
+        if (*it != conn) continue;
+        *it = conn->next_for_address;
+        return;
+    }
+}
+
+// update handle and handle index
+static void hci_connection_set_handle(hci_connection_t * conn, hci_con_handle_t con_handle){
+    hci_connection_remove_from_handle_index(conn);
+    conn->con_handle = con_handle;
+    hci_connection_add_to_handle_index(conn);
+}
+
+// compare running packet counters against sum over all connections
+static void hci_assert_packets_sent(void){
+#ifdef ENABLE_HCI_CONSISTENCY_CHECKS
+    unsigned int num_packets_sent_classic = 0;
+    unsigned int num_packets_sent_le = 0;
+    unsigned int num_sco_packets_sent = 0;
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) hci_stack->connections; it ; it = it->next){
+        hci_connection_t * connection = (hci_connection_t *) it;
+        if (connection->address_type == BD_ADDR_TYPE_CLASSIC){
+            num_packets_sent_classic += connection->num_acl_packets_sent;
+        } else {
+            num_packets_sent_le += connection->num_acl_packets_sent;
+        }
+        num_sco_packets_sent += connection->num_sco_packets_sent;
+    }
+    if (num_packets_sent_classic == hci_stack->acl_packets_sent_classic
+    &&  num_packets_sent_le      == hci_stack->acl_packets_sent_le
+    &&  num_sco_packets_sent     == hci_stack->sco_packets_sent) return;
+    log_error("ERROR: packets sent counters classic %u, le %u, sco %u - connections %u, %u, %u",
+        hci_stack->acl_packets_sent_classic, hci_stack->acl_packets_sent_le, hci_stack->sco_packets_sent,
+        num_packets_sent_classic, num_packets_sent_le, num_sco_packets_sent);
+    while(1);
+#endif
+}
+
+// update packets sent by connection and running counter for its controller buffer pool
+static void hci_connection_add_acl_packets_sent(hci_connection_t * connection, int num_packets){
+    connection->num_acl_packets_sent += num_packets;
+    if (connection->address_type == BD_ADDR_TYPE_CLASSIC){
+        hci_stack->acl_packets_sent_classic += num_packets;
+    } else {
+        hci_stack->acl_packets_sent_le += num_packets;
+    }
+    hci_assert_packets_sent();
+}
+
+#ifdef ENABLE_CLASSIC
+static void hci_connection_add_sco_packets_sent(hci_connection_t * connection, int num_packets){
+    connection->num_sco_packets_sent += num_packets;
+    hci_stack->sco_packets_sent += num_packets;
+    hci_assert_packets_sent();
+}
+#endif
+
+// remove connection from list and lookup tables, packets in flight are not tracked anymore
+static void hci_connection_remove(hci_connection_t * conn){
+    btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
+    hci_connection_remove_from_handle_index(conn);
+    hci_connection_remove_from_address_index(conn);
+    if (conn->address_type == BD_ADDR_TYPE_CLASSIC){
+        hci_stack->acl_packets_sent_classic -= conn->num_acl_packets_sent;
+    } else {
+        hci_stack->acl_packets_sent_le -= conn->num_acl_packets_sent;
+    }
+    hci_stack->sco_packets_sent -= conn->num_sco_packets_sent;
+    hci_assert_packets_sent();
+}
+
 /**
  * create connection for given address
  *
@@ -195,10 +304,14 @@ static hci_connection_t * create_connection_for_bd_addr_and_type(bd_addr_t addr,
 #endif
     conn->acl_recombination_length = 0;
     conn->acl_recombination_pos = 0;
+    conn->acl_recombination_packet = &conn->acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE];
+    conn->acl_recombination_size = 4 + HCI_ACL_BUFFER_SIZE;
     conn->num_acl_packets_sent = 0;
     conn->num_sco_packets_sent = 0;
     conn->le_con_parameter_update_state = CON_PARAMETER_UPDATE_NONE;
     btstack_linked_list_add(&hci_stack->connections, (btstack_linked_item_t *) conn);
+    hci_connection_add_to_handle_index(conn);
+    hci_connection_add_to_address_index(conn);
     return conn;
 }
 
@@ -237,10 +350,8 @@ void hci_connections_get_iterator(btstack_linked_list_iterator_t *it){
  * @return connection OR NULL, if not found
  */
 hci_connection_t * hci_connection_for_handle(hci_con_handle_t con_handle){
-    btstack_linked_list_iterator_t it;
-    btstack_linked_list_iterator_init(&it, &hci_stack->connections);
-    while (btstack_linked_list_iterator_has_next(&it)){
-        hci_connection_t * item = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
+    hci_connection_t * item;
+    for (item = hci_stack->connections_by_handle[hci_connection_handle_hash(con_handle)]; item ; item = item->next_for_handle){
         if ( item->con_handle == con_handle ) {
             return item;
         }
@@ -254,10 +365,8 @@ hci_connection_t * hci_connection_for_handle(hci_con_handle_t con_handle){
  * @return connection OR NULL, if not found
  */
 hci_connection_t * hci_connection_for_bd_addr_and_type(bd_addr_t  addr, bd_addr_type_t addr_type){
-    btstack_linked_list_iterator_t it;
-    btstack_linked_list_iterator_init(&it, &hci_stack->connections);
-    while (btstack_linked_list_iterator_has_next(&it)){
-        hci_connection_t * connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
+    hci_connection_t * connection;
+    for (connection = hci_stack->connections_by_address[hci_connection_address_hash(addr, addr_type)]; connection ; connection = connection->next_for_address){
         if (connection->address_type != addr_type)  continue;
         if (memcmp(addr, connection->address, 6) != 0) continue;
         return connection;   
@@ -367,18 +476,9 @@ static int nr_hci_connections(void){
 
 static int hci_number_free_acl_slots_for_connection_type(bd_addr_type_t address_type){
     
-    unsigned int num_packets_sent_classic = 0;
-    unsigned int num_packets_sent_le = 0;
+    unsigned int num_packets_sent_classic = hci_stack->acl_packets_sent_classic;
+    unsigned int num_packets_sent_le = hci_stack->acl_packets_sent_le;
 
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) hci_stack->connections; it ; it = it->next){
-        hci_connection_t * connection = (hci_connection_t *) it;
-        if (connection->address_type == BD_ADDR_TYPE_CLASSIC){
-            num_packets_sent_classic += connection->num_acl_packets_sent;
-        } else {
-            num_packets_sent_le += connection->num_acl_packets_sent;
-        }
-    }
     log_debug("ACL classic buffers: %u used of %u", num_packets_sent_classic, hci_stack->acl_packets_total_num);
     int free_slots_classic = hci_stack->acl_packets_total_num - num_packets_sent_classic;
     int free_slots_le = 0;
@@ -432,12 +532,7 @@ int hci_number_free_acl_slots_for_handle(hci_con_handle_t con_handle){
 
 #ifdef ENABLE_CLASSIC
 static int hci_number_free_sco_slots(void){
-    unsigned int num_sco_packets_sent  = 0;
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) hci_stack->connections; it ; it = it->next){
-        hci_connection_t * connection = (hci_connection_t *) it;
-        num_sco_packets_sent += connection->num_sco_packets_sent;
-    }
+    unsigned int num_sco_packets_sent  = hci_stack->sco_packets_sent;
     if (num_sco_packets_sent > hci_stack->sco_packets_total_num){
         log_info("hci_number_free_sco_slots:packets (%u) > total packets (%u)", num_sco_packets_sent, hci_stack->sco_packets_total_num);
         return 0;
@@ -447,17 +542,27 @@ static int hci_number_free_sco_slots(void){
 }
 #endif
 
+// assumption: synchronous implementations don't provide can_send_packet_now as they don't keep the buffer after the call
+static int hci_transport_synchronous(void){
+    return hci_stack->hci_transport->can_send_packet_now == NULL;
+}
+
+static int hci_transport_can_send_packet_now(uint8_t packet_type){
+    // check for async hci transport implementations
+    if (!hci_stack->hci_transport->can_send_packet_now) return 1;
+    return hci_stack->hci_transport->can_send_packet_now(packet_type);
+}
+
+// prepared packets are queued while the transport is busy with earlier ones
+static int hci_transport_can_send_prepared_packet_now(uint8_t packet_type){
+    if (hci_stack->hci_outgoing_queue_len) return 1;
+    return hci_transport_can_send_packet_now(packet_type);
+}
+
 // only used to send HCI Host Number Completed Packets
 static int hci_can_send_comand_packet_transport(void){
     if (hci_stack->hci_packet_buffer_reserved) return 0;
-
-    // check for async hci transport implementations
-    if (hci_stack->hci_transport->can_send_packet_now){
-        if (!hci_stack->hci_transport->can_send_packet_now(HCI_COMMAND_DATA_PACKET)){
-            return 0;
-        }
-    }
-    return 1;
+    return hci_transport_can_send_prepared_packet_now(HCI_COMMAND_DATA_PACKET);
 }
 
 // new functions replacing hci_can_send_packet_now[_using_packet_buffer]
@@ -466,15 +571,23 @@ int hci_can_send_command_packet_now(void){
     return hci_stack->num_cmd_packets > 0;
 }
 
-static int hci_transport_can_send_prepared_packet_now(uint8_t packet_type){
-    // check for async hci transport implementations
-    if (!hci_stack->hci_transport->can_send_packet_now) return 1;
-    return hci_stack->hci_transport->can_send_packet_now(packet_type);
+// queued ACL packets that have not been passed to the transport yet and will need a controller buffer
+static int hci_number_queued_acl_packets(void){
+    int num_packets = 0;
+    int i;
+    for (i = 0; i < hci_stack->hci_outgoing_queue_len; i++){
+        int index = (hci_stack->hci_outgoing_queue_head + i) % MAX_NR_HCI_OUTGOING_PACKET_BUFFERS;
+        if (hci_stack->hci_outgoing_queue[index].packet_type != HCI_ACL_DATA_PACKET) continue;
+        // fragments of queue head are counted when sent
+        if (i == 0 && (hci_stack->hci_outgoing_packet_in_transport || hci_stack->acl_fragmentation_total_size)) continue;
+        num_packets++;
+    }
+    return num_packets;
 }
 
 static int hci_can_send_prepared_acl_packet_for_address_type(bd_addr_type_t address_type){
     if (!hci_transport_can_send_prepared_packet_now(HCI_ACL_DATA_PACKET)) return 0;
-    return hci_number_free_acl_slots_for_connection_type(address_type) > 0;
+    return hci_number_free_acl_slots_for_connection_type(address_type) > hci_number_queued_acl_packets();
 }
 
 int hci_can_send_acl_le_packet_now(void){
@@ -484,7 +597,7 @@ int hci_can_send_acl_le_packet_now(void){
 
 int hci_can_send_prepared_acl_packet_now(hci_con_handle_t con_handle) {
     if (!hci_transport_can_send_prepared_packet_now(HCI_ACL_DATA_PACKET)) return 0;
-    return hci_number_free_acl_slots_for_handle(con_handle) > 0;
+    return hci_number_free_acl_slots_for_handle(con_handle) > hci_number_queued_acl_packets();
 }
 
 int hci_can_send_acl_packet_now(hci_con_handle_t con_handle){
@@ -492,6 +605,11 @@ int hci_can_send_acl_packet_now(hci_con_handle_t con_handle){
     return hci_can_send_prepared_acl_packet_now(con_handle);
 }
 
+static int hci_can_send_acl_fragment_now(hci_con_handle_t con_handle){
+    if (!hci_transport_can_send_packet_now(HCI_ACL_DATA_PACKET)) return 0;
+    return hci_number_free_acl_slots_for_handle(con_handle) > 0;
+}
+
 #ifdef ENABLE_CLASSIC
 int hci_can_send_acl_classic_packet_now(void){
     if (hci_stack->hci_packet_buffer_reserved) return 0;
@@ -531,15 +649,63 @@ int hci_reserve_packet_buffer(void){
 }
 
 void hci_release_packet_buffer(void){
+    // stays reserved until the transport returns a queued buffer
+    if (hci_stack->hci_packet_buffer_queued) return;
     hci_stack->hci_packet_buffer_reserved = 0;
 }
 
-// assumption: synchronous implementations don't provide can_send_packet_now as they don't keep the buffer after the call
-static int hci_transport_synchronous(void){
-    return hci_stack->hci_transport->can_send_packet_now == NULL;
+static void hci_outgoing_queue_reset(void){
+    btstack_memory_pool_create(&hci_stack->hci_packet_buffer_pool, hci_stack->hci_packet_buffer_storage,
+        MAX_NR_HCI_OUTGOING_PACKET_BUFFERS, sizeof(hci_stack->hci_packet_buffer_storage[0]));
+    uint8_t * block = (uint8_t *) btstack_memory_pool_get(&hci_stack->hci_packet_buffer_pool);
+    hci_stack->hci_packet_buffer = &block[HCI_OUTGOING_PRE_BUFFER_SIZE];
+    hci_stack->hci_packet_buffer_reserved = 0;
+    hci_stack->hci_packet_buffer_queued = 0;
+    hci_stack->hci_outgoing_queue_head = 0;
+    hci_stack->hci_outgoing_queue_len = 0;
+    hci_stack->hci_outgoing_packet_in_transport = 0;
+    hci_stack->hci_outgoing_queue_running = 0;
+    hci_stack->acl_fragmentation_pos = 0;
+    hci_stack->acl_fragmentation_total_size = 0;
+}
+
+// pre: hci_packet_buffer reserved and prepared. queues it and provides next buffer if available
+static void hci_outgoing_queue_add(uint8_t packet_type, uint16_t size){
+    int index = (hci_stack->hci_outgoing_queue_head + hci_stack->hci_outgoing_queue_len) % MAX_NR_HCI_OUTGOING_PACKET_BUFFERS;
+    hci_outgoing_packet_t * outgoing_packet = &hci_stack->hci_outgoing_queue[index];
+    outgoing_packet->packet      = hci_stack->hci_packet_buffer;
+    outgoing_packet->size        = size;
+    outgoing_packet->packet_type = packet_type;
+    hci_stack->hci_outgoing_queue_len++;
+
+    uint8_t * block = (uint8_t *) btstack_memory_pool_get(&hci_stack->hci_packet_buffer_pool);
+    if (!block){
+        hci_stack->hci_packet_buffer_queued = 1;
+        return;
+    }
+    hci_stack->hci_packet_buffer = &block[HCI_OUTGOING_PRE_BUFFER_SIZE];
+    hci_stack->hci_packet_buffer_reserved = 0;
 }
 
-static int hci_send_acl_packet_fragments(hci_connection_t *connection){
+// transport is done with queue head, return buffer
+static void hci_outgoing_queue_remove_head(void){
+    hci_outgoing_packet_t * outgoing_packet = &hci_stack->hci_outgoing_queue[hci_stack->hci_outgoing_queue_head];
+    hci_stack->hci_outgoing_queue_head = (hci_stack->hci_outgoing_queue_head + 1) % MAX_NR_HCI_OUTGOING_PACKET_BUFFERS;
+    hci_stack->hci_outgoing_queue_len--;
+    hci_stack->hci_outgoing_packet_in_transport = 0;
+
+    if (hci_stack->hci_packet_buffer_queued){
+        // all buffers were in use, hand this one to upper layers
+        hci_stack->hci_packet_buffer = outgoing_packet->packet;
+        hci_stack->hci_packet_buffer_queued = 0;
+        hci_stack->hci_packet_buffer_reserved = 0;
+        return;
+    }
+    btstack_memory_pool_free(&hci_stack->hci_packet_buffer_pool, outgoing_packet->packet - HCI_OUTGOING_PRE_BUFFER_SIZE);
+}
+
+// pre: fragmentation of queue head started
+static int hci_send_acl_packet_fragments(hci_connection_t *connection, uint8_t * acl_packet){
 
     // log_info("hci_send_acl_packet_fragments  %u/%u (con 0x%04x)", hci_stack->acl_fragmentation_pos, hci_stack->acl_fragmentation_total_size, connection->con_handle);
 
@@ -573,16 +739,16 @@ static int hci_send_acl_packet_fragments(hci_connection_t *connection){
 
         // copy handle_and_flags if not first fragment and update packet boundary flags to be 01 (continuing fragmnent)
         if (acl_header_pos > 0){
-            uint16_t handle_and_flags = little_endian_read_16(hci_stack->hci_packet_buffer, 0);
+            uint16_t handle_and_flags = little_endian_read_16(acl_packet, 0);
             handle_and_flags = (handle_and_flags & 0xcfff) | (1 << 12);
-            little_endian_store_16(hci_stack->hci_packet_buffer, acl_header_pos, handle_and_flags);
+            little_endian_store_16(acl_packet, acl_header_pos, handle_and_flags);
         }
 
         // update header len
-        little_endian_store_16(hci_stack->hci_packet_buffer, acl_header_pos + 2, current_acl_data_packet_length);
+        little_endian_store_16(acl_packet, acl_header_pos + 2, current_acl_data_packet_length);
 
         // count packet
-        connection->num_acl_packets_sent++;
+        hci_connection_add_acl_packets_sent(connection, 1);
         log_debug("hci_send_acl_packet_fragments loop before send (more fragments %d)", more_fragments);
 
         // update state for next fragment (if any) as "transport done" might be sent during send_packet already
@@ -596,30 +762,75 @@ static int hci_send_acl_packet_fragments(hci_connection_t *connection){
         }
 
         // send packet
-        uint8_t * packet = &hci_stack->hci_packet_buffer[acl_header_pos];
+        uint8_t * packet = &acl_packet[acl_header_pos];
         const int size = current_acl_data_packet_length + 4;
         hci_dump_packet(HCI_ACL_DATA_PACKET, 0, packet, size);
+        hci_stack->hci_outgoing_packet_in_transport = 1;
         err = hci_stack->hci_transport->send_packet(HCI_ACL_DATA_PACKET, packet, size);
 
         log_debug("hci_send_acl_packet_fragments loop after send (more fragments %d)", more_fragments);
 
-        // done yet?
-        if (!more_fragments) break;
+        // done yet? fragments are dropped if connection was closed during send_packet
+        if (!more_fragments || !hci_stack->acl_fragmentation_total_size) break;
 
         // can send more?
-        if (!hci_can_send_prepared_acl_packet_now(connection->con_handle)) return err;
+        if (!hci_can_send_acl_fragment_now(connection->con_handle)) return err;
     }
 
     log_debug("hci_send_acl_packet_fragments loop over");
 
-    // release buffer now for synchronous transport
-    if (hci_transport_synchronous()){
-        hci_release_packet_buffer();
+    return err;
+}
+
+// send queued packets in order, ACL packets are fragmented as needed
+static int hci_outgoing_queue_run(void){
+    // transport might report packet sent during send_packet, outer call continues with next packet
+    if (hci_stack->hci_outgoing_queue_running) return 0;
+    hci_stack->hci_outgoing_queue_running = 1;
+    int err = 0;
+    while (hci_stack->hci_outgoing_queue_len && !hci_stack->hci_outgoing_packet_in_transport){
+        hci_outgoing_packet_t * outgoing_packet = &hci_stack->hci_outgoing_queue[hci_stack->hci_outgoing_queue_head];
+        uint8_t packet_type = outgoing_packet->packet_type;
+
+        if (packet_type == HCI_ACL_DATA_PACKET){
+            hci_con_handle_t con_handle = READ_ACL_CONNECTION_HANDLE(outgoing_packet->packet);
+            hci_connection_t *connection = hci_connection_for_handle(con_handle);
+            if (!connection) {
+                // connection gone -> discard packet or further fragments
+                log_info("hci_outgoing_queue_run: ACL packet for handle 0x%04x without connection -> discard", con_handle);
+                hci_stack->acl_fragmentation_total_size = 0;
+                hci_stack->acl_fragmentation_pos = 0;
+                hci_outgoing_queue_remove_head();
+                continue;
+            }
+            if (!hci_can_send_acl_fragment_now(con_handle)) break;
+            if (!hci_stack->acl_fragmentation_total_size){
+                // setup data
+                hci_stack->acl_fragmentation_total_size = outgoing_packet->size;
+                hci_stack->acl_fragmentation_pos = 4;   // start of L2CAP packet
+            }
+            err = hci_send_acl_packet_fragments(connection, outgoing_packet->packet);
+        } else {
+            if (!hci_transport_can_send_packet_now(packet_type)) break;
+            hci_dump_packet(packet_type, 0, outgoing_packet->packet, outgoing_packet->size);
+            hci_stack->hci_outgoing_packet_in_transport = 1;
+            err = hci_stack->hci_transport->send_packet(packet_type, outgoing_packet->packet, outgoing_packet->size);
+        }
+
+        // asynchronous transport keeps the buffer until HCI_EVENT_TRANSPORT_PACKET_SENT, which can be received during send_packet
+        if (!hci_transport_synchronous()) continue;
+
+        // release buffer now for synchronous transport, unless there are further fragments
+        hci_stack->hci_outgoing_packet_in_transport = 0;
+        if (hci_stack->acl_fragmentation_total_size) continue;
+        hci_outgoing_queue_remove_head();
+        if (packet_type == HCI_COMMAND_DATA_PACKET) continue;
+
         // notify upper stack that it might be possible to send again
         uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
         hci_emit_event(&event[0], sizeof(event), 0);  // don't dump
     }
-
+    hci_stack->hci_outgoing_queue_running = 0;
     return err;
 }
 
@@ -656,11 +867,8 @@ int hci_send_acl_packet_buffer(int size){
 
     // hci_dump_packet( HCI_ACL_DATA_PACKET, 0, packet, size);
 
-    // setup data
-    hci_stack->acl_fragmentation_total_size = size;
-    hci_stack->acl_fragmentation_pos = 4;   // start of L2CAP packet
-
-    return hci_send_acl_packet_fragments(connection);
+    hci_outgoing_queue_add(HCI_ACL_DATA_PACKET, size);
+    return hci_outgoing_queue_run();
 }
 
 #ifdef ENABLE_CLASSIC
@@ -694,20 +902,11 @@ int hci_send_sco_packet_buffer(int size){
             hci_release_packet_buffer();
             return 0;
         }
-        connection->num_sco_packets_sent++;
+        hci_connection_add_sco_packets_sent(connection, 1);
     }
 
-    hci_dump_packet( HCI_SCO_DATA_PACKET, 0, packet, size);
-    int err = hci_stack->hci_transport->send_packet(HCI_SCO_DATA_PACKET, packet, size);
-
-    if (hci_transport_synchronous()){
-        hci_release_packet_buffer();
-        // notify upper stack that it might be possible to send again
-        uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
-        hci_emit_event(&event[0], sizeof(event), 0);    // don't dump
-    }
-
-    return err;
+    hci_outgoing_queue_add(HCI_SCO_DATA_PACKET, size);
+    return hci_outgoing_queue_run();
 }
 #endif
 
@@ -753,15 +952,15 @@ static void acl_handler(uint8_t *packet, int size){
                 log_error( "ACL Cont Fragment but no first fragment for handle 0x%02x", con_handle);
                 return;
             }
-            if (conn->acl_recombination_pos + acl_length > 4 + HCI_ACL_BUFFER_SIZE){
+            if (conn->acl_recombination_pos + acl_length > conn->acl_recombination_size){
                 log_error( "ACL Cont Fragment to large: combined packet %u > buffer size %u for handle 0x%02x",
-                    conn->acl_recombination_pos + acl_length, 4 + HCI_ACL_BUFFER_SIZE, con_handle);
+                    conn->acl_recombination_pos + acl_length, conn->acl_recombination_size, con_handle);
                 conn->acl_recombination_pos = 0;
                 return;
             }
 
             // append fragment payload (header already stored)
-            memcpy(&conn->acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + conn->acl_recombination_pos], &packet[4], acl_length );
+            memcpy(&conn->acl_recombination_packet[conn->acl_recombination_pos], &packet[4], acl_length );
             conn->acl_recombination_pos += acl_length;
             
             // log_error( "ACL Cont Fragment: acl_len %u, combined_len %u, l2cap_len %u", acl_length,
@@ -769,7 +968,7 @@ static void acl_handler(uint8_t *packet, int size){
             
             // forward complete L2CAP packet if complete. 
             if (conn->acl_recombination_pos >= conn->acl_recombination_length + 4 + 4){ // pos already incl. ACL header
-                hci_emit_acl_packet(&conn->acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE], conn->acl_recombination_pos);
+                hci_emit_acl_packet(conn->acl_recombination_packet, conn->acl_recombination_pos);
                 // reset recombination buffer
                 conn->acl_recombination_length = 0;
                 conn->acl_recombination_pos = 0;
@@ -795,17 +994,31 @@ static void acl_handler(uint8_t *packet, int size){
                 hci_emit_acl_packet(packet, acl_length + 4);
             } else {
 
-                if (acl_length > HCI_ACL_BUFFER_SIZE){
+                // recombine into buffer provided by upper layer if possible
+                uint32_t packet_size = 4 + 4 + l2cap_length;
+                uint8_t * buffer = NULL;
+                if (hci_stack->acl_recombination_buffer_handler && acl_length >= 4 && packet_size <= 0xffff){
+                    buffer = (*hci_stack->acl_recombination_buffer_handler)(con_handle, READ_L2CAP_CHANNEL_ID(packet), packet_size);
+                }
+                if (buffer){
+                    conn->acl_recombination_packet = buffer;
+                    conn->acl_recombination_size   = packet_size;
+                } else {
+                    conn->acl_recombination_packet = &conn->acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE];
+                    conn->acl_recombination_size   = 4 + HCI_ACL_BUFFER_SIZE;
+                }
+
+                if (4 + acl_length > conn->acl_recombination_size){
                     log_error( "ACL First Fragment to large: fragment %u > buffer size %u for handle 0x%02x",
-                        4 + acl_length, 4 + HCI_ACL_BUFFER_SIZE, con_handle);
+                        4 + acl_length, conn->acl_recombination_size, con_handle);
                     return;
                 }
 
                 // store first fragment and tweak acl length for complete package
-                memcpy(&conn->acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE], packet, acl_length + 4);
+                memcpy(conn->acl_recombination_packet, packet, acl_length + 4);
                 conn->acl_recombination_pos    = acl_length + 4;
                 conn->acl_recombination_length = l2cap_length;
-                little_endian_store_16(conn->acl_recombination_buffer, HCI_INCOMING_PRE_BUFFER_SIZE + 2, l2cap_length +4);
+                little_endian_store_16(conn->acl_recombination_packet, 2, l2cap_length +4);
             }
             break;
             
@@ -830,7 +1043,7 @@ static void hci_shutdown_connection(hci_connection_t *conn){
 
     btstack_run_loop_remove_timer(&conn->timeout);
     
-    btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
+    hci_connection_remove(conn);
     btstack_memory_hci_connection_free( conn );
     
     // now it's gone
@@ -1798,19 +2011,19 @@ static void event_handler(uint8_t *packet, int size){
                 if (conn->address_type == BD_ADDR_TYPE_SCO){
 #ifdef ENABLE_CLASSIC
                     if (conn->num_sco_packets_sent >= num_packets){
-                        conn->num_sco_packets_sent -= num_packets;
+                        hci_connection_add_sco_packets_sent(conn, -num_packets);
                     } else {
                         log_error("hci_number_completed_packets, more sco slots freed then sent.");
-                        conn->num_sco_packets_sent = 0;
+                        hci_connection_add_sco_packets_sent(conn, -conn->num_sco_packets_sent);
                     }
                     hci_notify_if_sco_can_send_now();
 #endif
                 } else {
                     if (conn->num_acl_packets_sent >= num_packets){
-                        conn->num_acl_packets_sent -= num_packets;
+                        hci_connection_add_acl_packets_sent(conn, -num_packets);
                     } else {
                         log_error("hci_number_completed_packets, more acl slots freed then sent.");
-                        conn->num_acl_packets_sent = 0;
+                        hci_connection_add_acl_packets_sent(conn, -conn->num_acl_packets_sent);
                     }
                 }
                 // log_info("hci_number_completed_packet %u processed for handle %u, outstanding %u", num_packets, handle, conn->num_acl_packets_sent);
@@ -1865,7 +2078,7 @@ static void event_handler(uint8_t *packet, int size){
             if (conn) {
                 if (!packet[2]){
                     conn->state = OPEN;
-                    conn->con_handle = little_endian_read_16(packet, 3);
+                    hci_connection_set_handle(conn, little_endian_read_16(packet, 3));
                     conn->bonding_flags |= BONDING_REQUEST_REMOTE_FEATURES;
 
                     // restart timer
@@ -1882,7 +2095,7 @@ static void event_handler(uint8_t *packet, int size){
                     memcpy(&bd_address, conn->address, 6);
 
                     // connection failed, remove entry
-                    btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
+                    hci_connection_remove(conn);
                     btstack_memory_hci_connection_free( conn );
                     
                     // notify client if dedicated bonding
@@ -1914,7 +2127,7 @@ static void event_handler(uint8_t *packet, int size){
                 break;
             }
             conn->state = OPEN;
-            conn->con_handle = little_endian_read_16(packet, 3);            
+            hci_connection_set_handle(conn, little_endian_read_16(packet, 3));
 
 #ifdef ENABLE_SCO_OVER_HCI
             // update SCO
@@ -2049,10 +2262,14 @@ static void event_handler(uint8_t *packet, int size){
             handle = little_endian_read_16(packet, 3);
             // drop outgoing ACL fragments if it is for closed connection
             if (hci_stack->acl_fragmentation_total_size > 0) {
-                if (handle == READ_ACL_CONNECTION_HANDLE(hci_stack->hci_packet_buffer)){
+                if (handle == READ_ACL_CONNECTION_HANDLE(hci_stack->hci_outgoing_queue[hci_stack->hci_outgoing_queue_head].packet)){
                     log_info("hci: drop fragmented ACL data for closed connection");
                      hci_stack->acl_fragmentation_total_size = 0;
                      hci_stack->acl_fragmentation_pos = 0;
+                     // release buffer now if transport isn't using it
+                     if (!hci_stack->hci_outgoing_packet_in_transport){
+                         hci_outgoing_queue_remove_head();
+                     }
                 }
             }
 
@@ -2096,9 +2313,17 @@ static void event_handler(uint8_t *packet, int size){
                 log_error("Synchronous HCI Transport shouldn't send HCI_EVENT_TRANSPORT_PACKET_SENT");
                 return; // instead of break: to avoid re-entering hci_run()
             }
-            if (hci_stack->acl_fragmentation_total_size) break;
-            hci_release_packet_buffer();
-            
+            if (hci_stack->hci_outgoing_packet_in_transport){
+                hci_stack->hci_outgoing_packet_in_transport = 0;
+                // release packet buffer if there are no further fragments
+                if (!hci_stack->acl_fragmentation_total_size){
+                    hci_outgoing_queue_remove_head();
+                }
+            }
+
+            // keep transport busy with next fragment or queued packet
+            hci_outgoing_queue_run();
+
             // L2CAP receives this event via the hci_emit_event below
 
 #ifdef ENABLE_CLASSIC
@@ -2148,7 +2373,7 @@ static void event_handler(uint8_t *packet, int size){
                         hci_stack->le_connecting_state = LE_CONNECTING_IDLE;
                         // remove entry
                         if (conn){
-                            btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
+                            hci_connection_remove(conn);
                             btstack_memory_hci_connection_free( conn );
                         }
                         break;
@@ -2179,7 +2404,7 @@ static void event_handler(uint8_t *packet, int size){
                     
                     conn->state = OPEN;
                     conn->role  = packet[6];
-                    conn->con_handle = little_endian_read_16(packet, 4);
+                    hci_connection_set_handle(conn, little_endian_read_16(packet, 4));
                     
                     // TODO: store - role, peer address type, conn_interval, conn_latency, supervision timeout, master clock
 
@@ -2289,6 +2514,20 @@ void hci_register_acl_packet_handler(btstack_packet_handler_t handler){
     hci_stack->acl_packet_handler = handler;
 }
 
+void hci_register_acl_recombination_buffer_handler(hci_acl_recombination_buffer_handler_t handler){
+    hci_stack->acl_recombination_buffer_handler = handler;
+}
+
+void hci_release_acl_recombination_buffer(hci_con_handle_t con_handle, uint8_t * buffer){
+    hci_connection_t * conn = hci_connection_for_handle(con_handle);
+    if (!conn) return;
+    if (conn->acl_recombination_packet != buffer) return;
+    conn->acl_recombination_packet = &conn->acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE];
+    conn->acl_recombination_size   = 4 + HCI_ACL_BUFFER_SIZE;
+    conn->acl_recombination_length = 0;
+    conn->acl_recombination_pos    = 0;
+}
+
 #ifdef ENABLE_CLASSIC
 /**
  * @brief Registers a packet handler for SCO data. Used for HSP and HFP profiles.
@@ -2301,6 +2540,11 @@ void hci_register_sco_packet_handler(btstack_packet_handler_t handler){
 static void hci_state_reset(void){
     // no connections yet
     hci_stack->connections = NULL;
+    memset(hci_stack->connections_by_handle, 0, sizeof(hci_stack->connections_by_handle));
+    memset(hci_stack->connections_by_address, 0, sizeof(hci_stack->connections_by_address));
+    hci_stack->acl_packets_sent_classic = 0;
+    hci_stack->acl_packets_sent_le = 0;
+    hci_stack->sco_packets_sent = 0;
 
     // keep discoverable/connectable as this has been requested by the client(s)
     // hci_stack->discoverable = 0;
@@ -2308,8 +2552,8 @@ static void hci_state_reset(void){
     // hci_stack->bondable = 1;
     // hci_stack->own_addr_type = 0;
 
-    // buffer is free
-    hci_stack->hci_packet_buffer_reserved = 0;
+    // buffers are free
+    hci_outgoing_queue_reset();
 
     // no pending cmds
     hci_stack->decline_reason = 0;
@@ -2375,8 +2619,8 @@ void hci_init(const hci_transport_t *transport, const void *config){
     // reference to used config
     hci_stack->config = config;
     
-    // setup pointer for outgoing packet buffer
-    hci_stack->hci_packet_buffer = &hci_stack->hci_packet_buffer_data[HCI_OUTGOING_PRE_BUFFER_SIZE];
+    // setup pool of outgoing packet buffers
+    hci_outgoing_queue_reset();
 
     // max acl payload size defined in config.h
     hci_stack->acl_data_packet_length = HCI_ACL_PAYLOAD_SIZE;
@@ -2578,7 +2822,7 @@ static int hci_power_control_wake(void){
 static void hci_power_transition_to_initializing(void){
     // set up state machine
     hci_stack->num_cmd_packets = 1; // assume that one cmd can be sent
-    hci_stack->hci_packet_buffer_reserved = 0;
+    hci_outgoing_queue_reset();
     hci_stack->state = HCI_STATE_INITIALIZING;
     hci_stack->substate = HCI_INIT_SEND_RESET;
 }
@@ -2788,13 +3032,8 @@ static void hci_host_num_completed_packets(void){
 
     hci_stack->host_completed_packets = 0;
 
-    hci_dump_packet(HCI_COMMAND_DATA_PACKET, 0, packet, size);
-    hci_stack->hci_transport->send_packet(HCI_COMMAND_DATA_PACKET, packet, size);
-
-    // release packet buffer for synchronous transport implementations    
-    if (hci_transport_synchronous()){
-        hci_stack->hci_packet_buffer_reserved = 0;
-    }
+    hci_outgoing_queue_add(HCI_COMMAND_DATA_PACKET, size);
+    hci_outgoing_queue_run();
 }
 #endif
 
@@ -2803,22 +3042,8 @@ static void hci_run(void){
     // log_info("hci_run: entered");
     btstack_linked_item_t * it;
 
-    // send continuation fragments first, as they block the prepared packet buffer
-    if (hci_stack->acl_fragmentation_total_size > 0) {
-        hci_con_handle_t con_handle = READ_ACL_CONNECTION_HANDLE(hci_stack->hci_packet_buffer);
-        hci_connection_t *connection = hci_connection_for_handle(con_handle);
-        if (connection) {
-            if (hci_can_send_prepared_acl_packet_now(con_handle)){
-                hci_send_acl_packet_fragments(connection);
-                return;
-            }
-        } else {
-            // connection gone -> discard further fragments
-            log_info("hci_run: fragmented ACL packet no connection -> discard fragment");
-            hci_stack->acl_fragmentation_total_size = 0;
-            hci_stack->acl_fragmentation_pos = 0;
-        }
-    }
+    // send queued packets and continuation fragments first, as they block packet buffers
+    hci_outgoing_queue_run();
 
 #ifdef ENABLE_HCI_CONTROLLER_TO_HOST_FLOW_CONTROL
     // send host num completed packets next as they don't require num_cmd_packets > 0
@@ -3445,15 +3670,19 @@ int hci_send_cmd_packet(uint8_t *packet, int size){
 
     hci_stack->num_cmd_packets--;
 
-    hci_dump_packet(HCI_COMMAND_DATA_PACKET, 0, packet, size);
-    int err = hci_stack->hci_transport->send_packet(HCI_COMMAND_DATA_PACKET, packet, size);
-
-    // release packet buffer for synchronous transport implementations    
-    if (hci_transport_synchronous() && (packet == hci_stack->hci_packet_buffer)){
-        hci_stack->hci_packet_buffer_reserved = 0;
+    // copy command into free packet buffer if needed
+    if (packet != hci_stack->hci_packet_buffer || hci_stack->hci_packet_buffer_queued){
+        if (hci_stack->hci_packet_buffer_reserved){
+            // no free packet buffer, send directly
+            hci_dump_packet(HCI_COMMAND_DATA_PACKET, 0, packet, size);
+            return hci_stack->hci_transport->send_packet(HCI_COMMAND_DATA_PACKET, packet, size);
+        }
+        memcpy(hci_stack->hci_packet_buffer, packet, size);
     }
 
-    return err;
+    hci_stack->hci_packet_buffer_reserved = 1;
+    hci_outgoing_queue_add(HCI_COMMAND_DATA_PACKET, size);
+    return hci_outgoing_queue_run();
 }
 
 // disconnect because of security block
@@ -3973,7 +4202,7 @@ uint8_t gap_connect_cancel(void){
         case SEND_CREATE_CONNECTION:
             // skip sending create connection and emit event instead
             hci_emit_le_connection_complete(conn->address_type, conn->address, 0, ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER);
-            btstack_linked_list_remove(&hci_stack->connections, (btstack_linked_item_t *) conn);
+            hci_connection_remove(conn);
             btstack_memory_hci_connection_free( conn );
             break;            
         case SENT_CREATE_CONNECTION:
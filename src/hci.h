@@ -50,6 +50,7 @@
 #include "btstack_chipset.h"
 #include "btstack_control.h"
 #include "btstack_linked_list.h"
+#include "btstack_memory_pool.h"
 #include "btstack_util.h"
 #include "classic/btstack_link_key_db.h"
 #include "hci_cmd.h"
@@ -115,6 +116,22 @@ extern "C" {
 #define HCI_OUTGOING_PRE_BUFFER_SIZE 1
 #endif
 
+// number of buckets in connection lookup tables for handle and address, power of two
+#ifndef HCI_CONNECTION_HASH_SIZE
+#define HCI_CONNECTION_HASH_SIZE 16
+#endif
+#if (HCI_CONNECTION_HASH_SIZE & (HCI_CONNECTION_HASH_SIZE - 1)) != 0
+#error HCI_CONNECTION_HASH_SIZE must be a power of two
+#endif
+
+// number of outgoing packet buffers, more than one allows upper layers to prepare the next packet while the transport is busy
+#ifndef MAX_NR_HCI_OUTGOING_PACKET_BUFFERS
+#define MAX_NR_HCI_OUTGOING_PACKET_BUFFERS 1
+#endif
+
+// outgoing packet buffers incl. pre-buffer, rounded up to pointer size as required by btstack_memory_pool
+#define HCI_OUTGOING_PACKET_BUFFER_WORDS ((HCI_OUTGOING_PRE_BUFFER_SIZE + HCI_PACKET_BUFFER_SIZE + sizeof(void *) - 1) / sizeof(void *))
+
 // BNEP may uncompress the IP Header by 16 bytes
 #ifndef HCI_INCOMING_PRE_BUFFER_SIZE
 #ifdef ENABLE_CLASSIC
@@ -403,6 +420,7 @@ typedef struct sm_connection {
     uint8_t                  sm_connection_authenticated;   // [0..1]
     uint8_t                  sm_actual_encryption_key_size;
     sm_pairing_packet_t      sm_m_preq;  // only used during c1
+    uint8_t                  sm_pairing_failed_reason;
     authorization_state_t    sm_connection_authorization_state;
     uint16_t                 sm_local_ediv;
     uint8_t                  sm_local_rand[8];
@@ -446,10 +464,23 @@ typedef struct {
 
 #endif
 
+/**
+ * @brief Provides buffer for a fragmented ACL packet
+ * @param con_handle
+ * @param cid of L2CAP packet
+ * @param size of complete ACL packet incl. ACL and L2CAP header
+ * @returns buffer of at least size bytes or NULL to use recombination buffer of connection
+ */
+typedef uint8_t * (*hci_acl_recombination_buffer_handler_t)(hci_con_handle_t con_handle, uint16_t cid, uint16_t size);
+
 //
-typedef struct {
+typedef struct hci_connection {
     // linked list - assert: first field
     btstack_linked_item_t    item;
+
+    // next connection in handle and address lookup table buckets
+    struct hci_connection * next_for_handle;
+    struct hci_connection * next_for_address;
     
     // remote side
     bd_addr_t address;
@@ -490,6 +521,9 @@ typedef struct {
     uint8_t  acl_recombination_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + 4 + HCI_ACL_BUFFER_SIZE];
     uint16_t acl_recombination_pos;
     uint16_t acl_recombination_length;
+    // ACL Header + ACL payload, either in acl_recombination_buffer or provided by upper layer
+    uint8_t * acl_recombination_packet;
+    uint16_t  acl_recombination_size;
     
     // number packets sent to controller
     uint8_t num_acl_packets_sent;
@@ -646,6 +680,13 @@ typedef struct {
     uint8_t        state;   
 } whitelist_entry_t;
 
+// outgoing packet waiting for or in transport
+typedef struct {
+    uint8_t * packet;
+    uint16_t  size;
+    uint8_t   packet_type;
+} hci_outgoing_packet_t;
+
 /**
  * main data structure
  */
@@ -665,10 +706,16 @@ typedef struct {
 
     // list of existing baseband connections
     btstack_linked_list_t     connections;
+    // connections indexed by handle and by address, chained via next_for_handle / next_for_address
+    hci_connection_t        * connections_by_handle[HCI_CONNECTION_HASH_SIZE];
+    hci_connection_t        * connections_by_address[HCI_CONNECTION_HASH_SIZE];
 
     /* callback to L2CAP layer */
     btstack_packet_handler_t acl_packet_handler;
 
+    /* callback to L2CAP layer for buffers to recombine fragmented packets */
+    hci_acl_recombination_buffer_handler_t acl_recombination_buffer_handler;
+
     /* callback for SCO data */
     btstack_packet_handler_t sco_packet_handler;
 
@@ -689,15 +736,31 @@ typedef struct {
     uint8_t            ssp_auto_accept;
     inquiry_mode_t     inquiry_mode;
 
-    // single buffer for HCI packet assembly + additional prebuffer for H4 drivers
+    // buffer for HCI packet assembly + additional prebuffer for H4 drivers, taken from pool of outgoing packet buffers
     uint8_t   * hci_packet_buffer;
-    uint8_t   hci_packet_buffer_data[HCI_OUTGOING_PRE_BUFFER_SIZE + HCI_PACKET_BUFFER_SIZE];
     uint8_t   hci_packet_buffer_reserved;
+    // all buffers are queued, hci_packet_buffer is reserved until the transport returns one
+    uint8_t   hci_packet_buffer_queued;
+    btstack_memory_pool_t hci_packet_buffer_pool;
+    void    * hci_packet_buffer_storage[MAX_NR_HCI_OUTGOING_PACKET_BUFFERS][HCI_OUTGOING_PACKET_BUFFER_WORDS];
+
+    // prepared packets, head is sent first and released on HCI_EVENT_TRANSPORT_PACKET_SENT
+    hci_outgoing_packet_t hci_outgoing_queue[MAX_NR_HCI_OUTGOING_PACKET_BUFFERS];
+    uint8_t   hci_outgoing_queue_head;
+    uint8_t   hci_outgoing_queue_len;
+    uint8_t   hci_outgoing_packet_in_transport;
+    uint8_t   hci_outgoing_queue_running;
+
+    // fragmentation of queue head
     uint16_t  acl_fragmentation_pos;
     uint16_t  acl_fragmentation_total_size;
      
     /* host to controller flow control */
     uint8_t  num_cmd_packets;
+    // packets sent and not completed yet, sum of num_acl_packets_sent / num_sco_packets_sent over connections
+    uint16_t acl_packets_sent_classic;
+    uint16_t acl_packets_sent_le;
+    uint16_t sco_packets_sent;
     uint8_t  acl_packets_total_num;
     uint16_t acl_data_packet_length;
     uint8_t  sco_packets_total_num;
@@ -913,6 +976,17 @@ void hci_add_event_handler(btstack_packet_callback_registration_t * callback_han
  */
 void hci_register_acl_packet_handler(btstack_packet_handler_t handler);
 
+/**
+ * @brief Registers handler that provides buffer to recombine fragmented ACL packet directly into,
+ *        instead of the connection's recombination buffer. Used by L2CAP
+ */
+void hci_register_acl_recombination_buffer_handler(hci_acl_recombination_buffer_handler_t handler);
+
+/**
+ * @brief Drop partially recombined ACL packet if it is stored in given buffer, e.g. when buffer is not valid anymore
+ */
+void hci_release_acl_recombination_buffer(hci_con_handle_t con_handle, uint8_t * buffer);
+
 /**
  * @brief Registers a packet handler for SCO data. Used for HSP and HFP profiles.
  */
@@ -57,6 +57,7 @@
 #include "hci_cmd.h"
 #include "btstack_run_loop.h"
 #include <stdio.h>
+#include <string.h>
 
 #ifdef HAVE_POSIX_FILE_IO
 #include <fcntl.h>        // open
@@ -88,36 +89,60 @@ typedef struct {
 pktlog_hdr;
 #define PKTLOG_HDR_SIZE 13
 
+// interval to write buffered packets to file
+#ifndef HCI_DUMP_FLUSH_INTERVAL_MS
+#define HCI_DUMP_FLUSH_INTERVAL_MS 100
+#endif
+
 static int dump_file = -1;
 #ifdef HAVE_POSIX_FILE_IO
 static int dump_format;
-static uint8_t header_bluez[HCIDUMP_HDR_SIZE];
-static uint8_t header_packetlogger[PKTLOG_HDR_SIZE];
 static char time_string[40];
 static int  max_nr_packets = -1;
 static int  nr_packets = 0;
 static char log_message_buffer[256];
+static char dump_file_name[256];
+static uint32_t dump_file_size;
+static uint32_t max_file_size;
+static int      max_nr_files = 1;
+#ifdef HCI_DUMP_BUFFER_SIZE
+// packets are stored in ring buffer and written to file by timer
+static uint8_t  dump_buffer[HCI_DUMP_BUFFER_SIZE];
+static uint32_t dump_buffer_pos;
+static uint32_t dump_buffer_len;
+static int      dump_buffer_flush_timer_active;
+static btstack_timer_source_t dump_buffer_flush_timer;
+static uint32_t nr_packets_dropped;
+static uint32_t nr_packets_dropped_reported;
+#endif
 #endif
 
 // levels: debug, info, error
 static int log_level_enabled[3] = { 1, 1, 1};
 
+#ifdef HAVE_POSIX_FILE_IO
+static void hci_dump_open_file(void){
+    int oflags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef _WIN32
+    oflags |= O_BINARY;
+#endif
+
+    dump_file = open(dump_file_name, oflags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH );
+    if (dump_file < 0){
+        printf("hci_dump_open: failed to open file %s\n", dump_file_name);
+    }
+    dump_file_size = 0;
+}
+#endif
+
 void hci_dump_open(const char *filename, hci_dump_format_t format){
 #ifdef HAVE_POSIX_FILE_IO
     dump_format = format;
     if (dump_format == HCI_DUMP_STDOUT) {
         dump_file = fileno(stdout);
     } else {
-
-        int oflags = O_WRONLY | O_CREAT | O_TRUNC;
-#ifdef _WIN32
-        oflags |= O_BINARY;
-#endif
-
-        dump_file = open(filename, oflags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH );
-        if (dump_file < 0){
-            printf("hci_dump_open: failed to open file %s\n", filename);
-        }
+        snprintf(dump_file_name, sizeof(dump_file_name), "%s", filename);
+        hci_dump_open_file();
     }
 #else
     UNUSED(filename);
@@ -131,6 +156,11 @@ void hci_dump_open(const char *filename, hci_dump_format_t format){
 void hci_dump_set_max_packets(int packets){
     max_nr_packets = packets;
 }
+
+void hci_dump_set_max_file_size(uint32_t max_size, int max_files){
+    max_file_size = max_size;
+    max_nr_files  = max_files > 0 ? max_files : 1;
+}
 #endif
 
 static void printf_packet(uint8_t packet_type, uint8_t in, uint8_t * packet, uint16_t len){
@@ -193,82 +223,179 @@ static void printf_timestamp(void){
 #endif
 }
 
-void hci_dump_packet(uint8_t packet_type, uint8_t in, uint8_t *packet, uint16_t len) {    
-
-    if (dump_file < 0) return; // not activated yet
-
 #ifdef HAVE_POSIX_FILE_IO
 
-    // don't grow bigger than max_nr_packets
-    if (dump_format != HCI_DUMP_STDOUT && max_nr_packets > 0){
-        if (nr_packets >= max_nr_packets){
-            lseek(dump_file, 0, SEEK_SET);
-            ftruncate(dump_file, 0);
-            nr_packets = 0;
-        }
-        nr_packets++;
-    }
-    
-    // get time
+// returns size of header, 0 if packet type is not supported by file format
+static int hci_dump_setup_header(uint8_t * header, uint8_t packet_type, uint8_t in, uint16_t len){
     struct timeval curr_time;
     gettimeofday(&curr_time, NULL);
 
     switch (dump_format){
-        case HCI_DUMP_STDOUT: {
-            printf_timestamp();
-            printf_packet(packet_type, in, packet, len);
-            break;
-        }
-            
         case HCI_DUMP_BLUEZ:
-            little_endian_store_16( header_bluez, 0, 1 + len);
-            header_bluez[2] = in;
-            header_bluez[3] = 0;
-            little_endian_store_32( header_bluez, 4, (uint32_t) curr_time.tv_sec);
-            little_endian_store_32( header_bluez, 8,            curr_time.tv_usec);
-            header_bluez[12] = packet_type;
-            write (dump_file, header_bluez, HCIDUMP_HDR_SIZE);
-            write (dump_file, packet, len );
-            break;
-            
+            little_endian_store_16( header, 0, 1 + len);
+            header[2] = in;
+            header[3] = 0;
+            little_endian_store_32( header, 4, (uint32_t) curr_time.tv_sec);
+            little_endian_store_32( header, 8,            curr_time.tv_usec);
+            header[12] = packet_type;
+            return HCIDUMP_HDR_SIZE;
+
         case HCI_DUMP_PACKETLOGGER:
-            big_endian_store_32( header_packetlogger, 0, PKTLOG_HDR_SIZE - 4 + len);
-            big_endian_store_32( header_packetlogger, 4,  (uint32_t) curr_time.tv_sec);
-            big_endian_store_32( header_packetlogger, 8, curr_time.tv_usec);
+            big_endian_store_32( header, 0, PKTLOG_HDR_SIZE - 4 + len);
+            big_endian_store_32( header, 4,  (uint32_t) curr_time.tv_sec);
+            big_endian_store_32( header, 8, curr_time.tv_usec);
             switch (packet_type){
                 case HCI_COMMAND_DATA_PACKET:
-                    header_packetlogger[12] = 0x00;
+                    header[12] = 0x00;
                     break;
                 case HCI_ACL_DATA_PACKET:
                     if (in) {
-                        header_packetlogger[12] = 0x03;
+                        header[12] = 0x03;
                     } else {
-                        header_packetlogger[12] = 0x02;
+                        header[12] = 0x02;
                     }
                     break;
                 case HCI_SCO_DATA_PACKET:
                     if (in) {
-                        header_packetlogger[12] = 0x09;
+                        header[12] = 0x09;
                     } else {
-                        header_packetlogger[12] = 0x08;
+                        header[12] = 0x08;
                     }
                     break;
                 case HCI_EVENT_PACKET:
-                    header_packetlogger[12] = 0x01;
+                    header[12] = 0x01;
                     break;
                 case LOG_MESSAGE_PACKET:
-                    header_packetlogger[12] = 0xfc;
+                    header[12] = 0xfc;
                     break;
                 default:
-                    return;
+                    return 0;
             }
-            write (dump_file, &header_packetlogger, PKTLOG_HDR_SIZE);
-            write (dump_file, packet, len );
-            break;
-            
+            return PKTLOG_HDR_SIZE;
+
         default:
-            break;
+            return 0;
+    }
+}
+
+#ifdef HCI_DUMP_BUFFER_SIZE
+
+static void hci_dump_buffer_flush_timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    dump_buffer_flush_timer_active = 0;
+    hci_dump_flush();
+}
+
+static void hci_dump_buffer_store(const uint8_t * data, uint32_t len){
+    uint32_t pos = (dump_buffer_pos + dump_buffer_len) % HCI_DUMP_BUFFER_SIZE;
+    uint32_t bytes_to_end = HCI_DUMP_BUFFER_SIZE - pos;
+    if (len > bytes_to_end){
+        memcpy(&dump_buffer[pos], data, bytes_to_end);
+        memcpy(dump_buffer, &data[bytes_to_end], len - bytes_to_end);
+    } else {
+        memcpy(&dump_buffer[pos], data, len);
+    }
+    dump_buffer_len += len;
+}
+
+#endif
+
+// close current file and continue in new one, up to max_nr_files - 1 previous files are kept as filename.1, filename.2, ...
+static void hci_dump_start_new_file(void){
+    hci_dump_flush();
+    if (max_nr_files == 1){
+        lseek(dump_file, 0, SEEK_SET);
+        ftruncate(dump_file, 0);
+        dump_file_size = 0;
+        return;
+    }
+    close(dump_file);
+    char old_name[sizeof(dump_file_name) + 12];
+    char new_name[sizeof(dump_file_name) + 12];
+    int i;
+    for (i = max_nr_files - 1; i > 0; i--){
+        if (i == 1){
+            snprintf(old_name, sizeof(old_name), "%s", dump_file_name);
+        } else {
+            snprintf(old_name, sizeof(old_name), "%s.%u", dump_file_name, i - 1);
+        }
+        snprintf(new_name, sizeof(new_name), "%s.%u", dump_file_name, i);
+        remove(new_name);
+        rename(old_name, new_name);
+    }
+    hci_dump_open_file();
+}
+
+static void hci_dump_file_packet(uint8_t packet_type, uint8_t in, uint8_t *packet, uint16_t len){
+
+    uint8_t header[PKTLOG_HDR_SIZE];
+    int header_len = hci_dump_setup_header(header, packet_type, in, len);
+    if (!header_len) return;
+    uint32_t record_len = header_len + len;
+
+#ifdef HCI_DUMP_BUFFER_SIZE
+    // report dropped packets in log before next packet
+    if (nr_packets_dropped != nr_packets_dropped_reported){
+        char message[40];
+        int message_len = snprintf(message, sizeof(message), "hci_dump: %u packets dropped", nr_packets_dropped - nr_packets_dropped_reported);
+        if (PKTLOG_HDR_SIZE + message_len + record_len <= HCI_DUMP_BUFFER_SIZE - dump_buffer_len){
+            nr_packets_dropped_reported = nr_packets_dropped;
+            hci_dump_file_packet(LOG_MESSAGE_PACKET, 0, (uint8_t *) message, message_len);
+        }
+    }
+    // drop packet if buffer is full
+    if (record_len > HCI_DUMP_BUFFER_SIZE - dump_buffer_len){
+        nr_packets_dropped++;
+        return;
+    }
+#endif
+
+    // don't grow bigger than max_nr_packets
+    if (max_nr_packets > 0){
+        if (nr_packets >= max_nr_packets){
+            hci_dump_start_new_file();
+            nr_packets = 0;
+        }
+        nr_packets++;
+    }
+
+    // don't grow bigger than max_file_size
+    if (max_file_size && dump_file_size && dump_file_size + record_len > max_file_size){
+        hci_dump_start_new_file();
+    }
+    dump_file_size += record_len;
+
+#ifdef HCI_DUMP_BUFFER_SIZE
+    hci_dump_buffer_store(header, header_len);
+    hci_dump_buffer_store(packet, len);
+    if (!dump_buffer_flush_timer_active){
+        // set flag first, as setting the timer might log
+        dump_buffer_flush_timer_active = 1;
+        btstack_run_loop_set_timer_handler(&dump_buffer_flush_timer, &hci_dump_buffer_flush_timer_handler);
+        btstack_run_loop_set_timer(&dump_buffer_flush_timer, HCI_DUMP_FLUSH_INTERVAL_MS);
+        btstack_run_loop_add_timer(&dump_buffer_flush_timer);
     }
+#else
+    write (dump_file, header, header_len);
+    write (dump_file, packet, len );
+#endif
+}
+#endif
+
+void hci_dump_packet(uint8_t packet_type, uint8_t in, uint8_t *packet, uint16_t len) {    
+
+    if (dump_file < 0) return; // not activated yet
+
+#ifdef HAVE_POSIX_FILE_IO
+
+    if (dump_format == HCI_DUMP_STDOUT){
+        printf_timestamp();
+        printf_packet(packet_type, in, packet, len);
+        return;
+    }
+
+    hci_dump_file_packet(packet_type, in, packet, len);
+
 #else
 
     printf_timestamp();
@@ -277,6 +404,26 @@ void hci_dump_packet(uint8_t packet_type, uint8_t in, uint8_t *packet, uint16_t
 #endif
 }
 
+void hci_dump_flush(void){
+#if defined(HAVE_POSIX_FILE_IO) && defined(HCI_DUMP_BUFFER_SIZE)
+    // write at most two parts, before and after end of ring buffer
+    while (dump_buffer_len){
+        uint32_t len = btstack_min(dump_buffer_len, HCI_DUMP_BUFFER_SIZE - dump_buffer_pos);
+        write (dump_file, &dump_buffer[dump_buffer_pos], len);
+        dump_buffer_pos = (dump_buffer_pos + len) % HCI_DUMP_BUFFER_SIZE;
+        dump_buffer_len -= len;
+    }
+#endif
+}
+
+uint32_t hci_dump_get_nr_packets_dropped(void){
+#if defined(HAVE_POSIX_FILE_IO) && defined(HCI_DUMP_BUFFER_SIZE)
+    return nr_packets_dropped;
+#else
+    return 0;
+#endif
+}
+
 static int hci_dump_log_level_active(int log_level){
     if (log_level < 0) return 0;
     if (log_level > LOG_LEVEL_ERROR) return 0;
@@ -321,6 +468,13 @@ void hci_dump_log_P(int log_level, PGM_P format, ...){
 
 void hci_dump_close(void){
 #ifdef HAVE_POSIX_FILE_IO
+    hci_dump_flush();
+#ifdef HCI_DUMP_BUFFER_SIZE
+    if (dump_buffer_flush_timer_active){
+        btstack_run_loop_remove_timer(&dump_buffer_flush_timer);
+        dump_buffer_flush_timer_active = 0;
+    }
+#endif
     close(dump_file);
 #endif
     dump_file = -1;
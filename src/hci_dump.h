@@ -79,6 +79,14 @@ void hci_dump_open(const char *filename, hci_dump_format_t format);
  */
 void hci_dump_set_max_packets(int packets); // -1 for unlimited
 
+/*
+ * @brief Start new file when max_size would be exceeded. Up to max_files - 1 previous files are kept
+ *        as filename.1 (newest), filename.2, ... With max_files = 1, the file is truncated instead.
+ * @param max_size in bytes, 0 for unlimited
+ * @param max_files
+ */
+void hci_dump_set_max_file_size(uint32_t max_size, int max_files);
+
 /*
  * @brief 
  */
@@ -98,6 +106,17 @@ __attribute__ ((format (__printf__, 2, 3)));
  */
 void hci_dump_enable_log_level(int log_level, int enable);
 
+/*
+ * @brief Write buffered packets to file. With HCI_DUMP_BUFFER_SIZE, packets are stored in a buffer of this size
+ *        and written every HCI_DUMP_FLUSH_INTERVAL_MS by a run loop timer
+ */
+void hci_dump_flush(void);
+
+/*
+ * @brief Number of packets that have been dropped as the buffer was full
+ */
+uint32_t hci_dump_get_nr_packets_dropped(void);
+
 /*
  * @brief 
  */
@@ -46,6 +46,7 @@
  */
 
 #include <inttypes.h>
+#include <string.h>
 
 #include "btstack_config.h"
 
@@ -147,6 +148,12 @@ static int read_pos;
 static uint8_t hci_packet_with_pre_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + 1 + HCI_PACKET_BUFFER_SIZE]; // packet type + max(acl header + acl payload, event header + event data)
 static uint8_t * hci_packet = &hci_packet_with_pre_buffer[HCI_INCOMING_PRE_BUFFER_SIZE];
 
+// streaming receive: received data in hci_packet[0..stream_len), next packet starts at stream_pos
+#define H4_STREAM_BUFFER_SIZE (1 + HCI_PACKET_BUFFER_SIZE)
+static int      stream_mode;
+static uint16_t stream_pos;
+static uint16_t stream_len;
+
 #ifdef ENABLE_CC256X_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
 static const uint8_t local_version_event_prefix[] = { 0x04, 0x0e, 0x0c, 0x01, 0x01, 0x10};
 static const uint8_t baud_rate_command_prefix[]   = { 0x01, 0x36, 0xff, 0x04};
@@ -169,7 +176,16 @@ static void hci_transport_h4_reset_statemachine(void){
     bytes_to_read = 1;
 }
 
+static void hci_transport_h4_reset_stream(void){
+    stream_pos = 0;
+    stream_len = 0;
+}
+
 static void hci_transport_h4_trigger_next_read(void){
+    if (stream_mode){
+        btstack_uart->receive_stream(&hci_packet[stream_len], H4_STREAM_BUFFER_SIZE - stream_len);
+        return;
+    }
     // log_info("hci_transport_h4_trigger_next_read: %u bytes", bytes_to_read);
     btstack_uart->receive_block(&hci_packet[read_pos], bytes_to_read);  
 }
@@ -264,6 +280,84 @@ static void hci_transport_h4_block_read(void){
     hci_transport_h4_trigger_next_read();
 }
 
+static uint16_t hci_transport_h4_header_size(uint8_t packet_type){
+    switch (packet_type){
+        case HCI_EVENT_PACKET:
+            return HCI_EVENT_HEADER_SIZE;
+        case HCI_ACL_DATA_PACKET:
+            return HCI_ACL_HEADER_SIZE;
+        case HCI_SCO_DATA_PACKET:
+            return HCI_SCO_HEADER_SIZE;
+        default:
+            return 0;
+    }
+}
+
+static uint16_t hci_transport_h4_payload_size(const uint8_t * packet){
+    switch (packet[0]){
+        case HCI_EVENT_PACKET:
+            return packet[2];
+        case HCI_ACL_DATA_PACKET:
+            return little_endian_read_16(packet, 3);
+        default:
+            return packet[3];
+    }
+}
+
+// parse all complete packets in stream buffer, packets are delivered in place
+static void hci_transport_h4_stream_received(uint16_t len){
+    stream_len += len;
+    while (stream_pos < stream_len){
+        uint8_t * packet   = &hci_packet[stream_pos];
+        uint16_t available = stream_len - stream_pos;
+        uint16_t header_size = hci_transport_h4_header_size(packet[0]);
+        if (header_size == 0){
+            stream_pos++;
+#ifdef ENABLE_EHCILL
+            switch (packet[0]){
+                case EHCILL_GO_TO_SLEEP_IND:
+                case EHCILL_GO_TO_SLEEP_ACK:
+                case EHCILL_WAKE_UP_IND:
+                case EHCILL_WAKE_UP_ACK:
+                    hci_transport_h4_ehcill_handle_command(packet[0]);
+                    continue;
+                default:
+                    break;
+            }
+#endif
+            log_error("hci_transport_h4: invalid packet type 0x%02x", packet[0]);
+            continue;
+        }
+        uint16_t packet_size = 1 + header_size;
+        if (available >= packet_size){
+            packet_size += hci_transport_h4_payload_size(packet);
+            if (packet_size > H4_STREAM_BUFFER_SIZE){
+                log_error("hci_transport_h4: invalid packet len %u - only space for %u", packet_size, H4_STREAM_BUFFER_SIZE);
+                // drop header
+                stream_pos += 1 + header_size;
+                continue;
+            }
+        }
+        if (packet_size > available){
+            // move partial packet to start of buffer if it does not fit
+            if (stream_pos + packet_size > H4_STREAM_BUFFER_SIZE){
+                memmove(hci_packet, packet, available);
+                stream_pos = 0;
+                stream_len = available;
+            }
+            break;
+        }
+        stream_pos += packet_size;
+        packet_handler(packet[0], &packet[1], packet_size - 1);
+        // stop if transport was closed or re-opened by packet handler
+        if (stream_len == 0) return;
+    }
+    if (stream_pos == stream_len){
+        hci_transport_h4_reset_stream();
+    }
+    hci_transport_h4_trigger_next_read();
+}
+
 static void hci_transport_h4_block_sent(void){
     switch (tx_state){
         case TX_W4_PACKET_SENT:
@@ -355,6 +449,15 @@ static void hci_transport_h4_init(const void * transport_config){
     btstack_uart->init(&uart_config);
     btstack_uart->set_block_received(&hci_transport_h4_block_read);
     btstack_uart->set_block_sent(&hci_transport_h4_block_sent);
+
+    // receive multiple packets per read if supported by UART driver
+    stream_mode = 0;
+#ifndef ENABLE_CC256X_BAUDRATE_CHANGE_FLOWCONTROL_BUG_WORKAROUND
+    if (btstack_uart->receive_stream && btstack_uart->set_stream_received){
+        btstack_uart->set_stream_received(&hci_transport_h4_stream_received);
+        stream_mode = 1;
+    }
+#endif
 }
 
 static int hci_transport_h4_open(void){
@@ -363,6 +466,7 @@ static int hci_transport_h4_open(void){
         return res;
     }
     hci_transport_h4_reset_statemachine();
+    hci_transport_h4_reset_stream();
     hci_transport_h4_trigger_next_read();
 
     tx_state = TX_IDLE;
@@ -374,6 +478,7 @@ static int hci_transport_h4_open(void){
 }
 
 static int hci_transport_h4_close(void){
+    hci_transport_h4_reset_stream();
     return btstack_uart->close();
 }
 
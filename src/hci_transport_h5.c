@@ -94,6 +94,9 @@ typedef enum {
 // max size of write requests
 #define LINK_SLIP_TX_CHUNK_LEN 64
 
+// max size of read requests in streaming mode
+#define LINK_SLIP_RX_CHUNK_LEN 256
+
 // ---
 static const uint8_t link_control_sync[] =   { 0x01, 0x7e};
 static const uint8_t link_control_sync_response[] = { 0x02, 0x7d};
@@ -729,18 +732,37 @@ static void hci_transport_link_update_resend_timeout(uint32_t baudrate){
 
 static uint8_t hci_transport_link_read_byte;
 
-static void hci_transport_h5_read_next_byte(void){
-    btstack_uart->receive_block(&hci_transport_link_read_byte, 1);    
+// incoming data if UART driver supports streaming receive
+static uint8_t hci_transport_link_read_buffer[LINK_SLIP_RX_CHUNK_LEN];
+
+static void hci_transport_h5_read_next_chunk(void){
+    if (btstack_uart->receive_stream){
+        btstack_uart->receive_stream(hci_transport_link_read_buffer, sizeof(hci_transport_link_read_buffer));
+    } else {
+        btstack_uart->receive_block(&hci_transport_link_read_byte, 1);    
+    }
 }
 
-static void hci_transport_h5_block_received(){
-    btstack_slip_decoder_process(hci_transport_link_read_byte);
+static void hci_transport_h5_process_byte(uint8_t data){
+    btstack_slip_decoder_process(data);
     uint16_t frame_size = btstack_slip_decoder_frame_size();
     if (frame_size) {
         hci_transport_h5_process_frame(frame_size);
         hci_transport_slip_init();
     }
-    hci_transport_h5_read_next_byte();
+}
+
+static void hci_transport_h5_block_received(){
+    hci_transport_h5_process_byte(hci_transport_link_read_byte);
+    hci_transport_h5_read_next_chunk();
+}
+
+static void hci_transport_h5_stream_received(uint16_t len){
+    uint16_t pos;
+    for (pos = 0; pos < len; pos++){
+        hci_transport_h5_process_byte(hci_transport_link_read_buffer[pos]);
+    }
+    hci_transport_h5_read_next_chunk();
 }
 
 static void hci_transport_h5_block_sent(void){
@@ -790,6 +812,9 @@ static void hci_transport_h5_init(const void * transport_config){
     btstack_uart->init(&uart_config);
     btstack_uart->set_block_received(&hci_transport_h5_block_received);
     btstack_uart->set_block_sent(&hci_transport_h5_block_sent);
+    if (btstack_uart->set_stream_received){
+        btstack_uart->set_stream_received(&hci_transport_h5_stream_received);
+    }
 }
 
 static int hci_transport_h5_open(void){
@@ -827,7 +852,7 @@ static int hci_transport_h5_open(void){
     hci_transport_link_init();
 
     // start receiving
-    hci_transport_h5_read_next_byte();
+    hci_transport_h5_read_next_chunk();
 
     return 0;
 }
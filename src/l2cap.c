@@ -100,6 +100,7 @@ static void l2cap_emit_channel_opened(l2cap_channel_t *channel, uint8_t status);
 static void l2cap_emit_channel_closed(l2cap_channel_t *channel);
 static void l2cap_emit_incoming_connection(l2cap_channel_t *channel);
 static int  l2cap_channel_ready_for_open(l2cap_channel_t *channel);
+static uint8_t * l2cap_acl_recombination_buffer_handler(hci_con_handle_t con_handle, uint16_t cid, uint16_t size);
 #endif
 #ifdef ENABLE_LE_DATA_CHANNELS
 static void l2cap_emit_le_channel_opened(l2cap_channel_t *channel, uint8_t status);
@@ -119,6 +120,10 @@ typedef struct l2cap_fixed_channel {
 static btstack_linked_list_t l2cap_channels;
 static btstack_linked_list_t l2cap_services;
 static uint8_t require_security_level2_for_outgoing_sdp;
+static const l2cap_scheduler_t * l2cap_scheduler;
+// weighted round robin: channel that has the turn and number of can send now events left in its turn
+static uint16_t l2cap_scheduler_wrr_local_cid;
+static uint8_t  l2cap_scheduler_wrr_quota;
 #endif
 
 #ifdef ENABLE_LE_DATA_CHANNELS
@@ -175,6 +180,7 @@ void l2cap_init(void){
     l2cap_channels = NULL;
     l2cap_services = NULL;
     require_security_level2_for_outgoing_sdp = 0;
+    l2cap_set_scheduler(NULL);
 #endif
 
 #ifdef ENABLE_LE_DATA_CHANNELS
@@ -195,6 +201,10 @@ void l2cap_init(void){
 
     hci_register_acl_packet_handler(&l2cap_acl_handler);
 
+#ifdef ENABLE_CLASSIC
+    hci_register_acl_recombination_buffer_handler(&l2cap_acl_recombination_buffer_handler);
+#endif
+
 #ifdef ENABLE_CLASSIC
     gap_connectable_control(0); // no services yet
 #endif
@@ -371,6 +381,109 @@ void l2cap_request_can_send_now_event(uint16_t local_cid){
     l2cap_notify_channel_can_send();
 }
 
+uint8_t l2cap_set_receive_buffer(uint16_t local_cid, uint8_t * buffer, uint16_t size){
+    l2cap_channel_t *channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+    if (channel->receive_buffer){
+        hci_release_acl_recombination_buffer(channel->con_handle, channel->receive_buffer);
+    }
+    channel->receive_buffer = NULL;
+    channel->receive_buffer_size = 0;
+    if (!buffer) return 0;
+    if (size <= HCI_INCOMING_PRE_BUFFER_SIZE + COMPLETE_L2CAP_HEADER) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    // reserve headroom in front of packet, like the connection's recombination buffer
+    channel->receive_buffer = &buffer[HCI_INCOMING_PRE_BUFFER_SIZE];
+    channel->receive_buffer_size = size - HCI_INCOMING_PRE_BUFFER_SIZE;
+    // announce larger MTU if not configured yet
+    if (channel->receive_buffer_size > COMPLETE_L2CAP_HEADER + channel->local_mtu && (channel->state_var & L2CAP_CHANNEL_STATE_VAR_SENT_CONF_REQ) == 0){
+        channel->local_mtu = channel->receive_buffer_size - COMPLETE_L2CAP_HEADER;
+    }
+    return 0;
+}
+
+static uint8_t * l2cap_acl_recombination_buffer_handler(hci_con_handle_t con_handle, uint16_t cid, uint16_t size){
+    l2cap_channel_t *channel = l2cap_get_channel_for_local_cid(cid);
+    if (!channel) return NULL;
+    if (channel->con_handle != con_handle) return NULL;
+    if (size > channel->receive_buffer_size) return NULL;
+    return channel->receive_buffer;
+}
+
+uint8_t l2cap_set_channel_weight(uint16_t local_cid, uint8_t weight){
+    l2cap_channel_t *channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+    if (weight == 0) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    channel->weight = weight;
+    return 0;
+}
+
+uint8_t l2cap_set_channel_priority(uint16_t local_cid, l2cap_channel_priority_t priority){
+    l2cap_channel_t *channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+    channel->priority = priority;
+    return 0;
+}
+
+static int l2cap_channel_ready_to_send(l2cap_channel_t * channel){
+    if (!channel->waiting_for_can_send_now) return 0;
+    return hci_can_send_acl_packet_now(channel->con_handle);
+}
+
+static l2cap_channel_t * l2cap_scheduler_wrr_next_channel(btstack_linked_list_t * channels){
+    btstack_linked_item_t * it;
+    l2cap_channel_t * current = NULL;
+
+    // high priority channels first, in list order
+    for (it = *channels; it ; it = it->next){
+        l2cap_channel_t * channel = (l2cap_channel_t *) it;
+        if (channel->local_cid == l2cap_scheduler_wrr_local_cid){
+            current = channel;
+        }
+        if (channel->priority != L2CAP_CHANNEL_PRIORITY_HIGH) continue;
+        if (l2cap_channel_ready_to_send(channel)) return channel;
+    }
+
+    // channel with the turn can send until its quota is used up
+    if (current && l2cap_scheduler_wrr_quota && l2cap_channel_ready_to_send(current)){
+        l2cap_scheduler_wrr_quota--;
+        return current;
+    }
+
+    // pass turn to next channel ready to send, starting after current one and wrapping around
+    btstack_linked_item_t * start = current ? current->item.next : *channels;
+    int pass;
+    for (pass = 0; pass < 2; pass++){
+        btstack_linked_item_t * from = pass ? *channels : start;
+        btstack_linked_item_t * to   = pass ? start     : NULL;
+        for (it = from; it != to; it = it->next){
+            l2cap_channel_t * channel = (l2cap_channel_t *) it;
+            if (channel->priority == L2CAP_CHANNEL_PRIORITY_HIGH) continue;
+            if (!l2cap_channel_ready_to_send(channel)) continue;
+            l2cap_scheduler_wrr_local_cid = channel->local_cid;
+            l2cap_scheduler_wrr_quota = channel->weight - 1;
+            return channel;
+        }
+    }
+    return NULL;
+}
+
+static const l2cap_scheduler_t l2cap_scheduler_wrr = {
+    /* l2cap_channel_t * (*next_channel)(btstack_linked_list_t * channels); */ &l2cap_scheduler_wrr_next_channel,
+};
+
+const l2cap_scheduler_t * l2cap_scheduler_weighted_round_robin_get_instance(void){
+    return &l2cap_scheduler_wrr;
+}
+
+void l2cap_set_scheduler(const l2cap_scheduler_t * scheduler){
+    if (!scheduler){
+        scheduler = l2cap_scheduler_weighted_round_robin_get_instance();
+    }
+    l2cap_scheduler = scheduler;
+    l2cap_scheduler_wrr_local_cid = 0;
+    l2cap_scheduler_wrr_quota = 0;
+}
+
 int  l2cap_can_send_packet_now(uint16_t local_cid){
     l2cap_channel_t *channel = l2cap_get_channel_for_local_cid(local_cid);
     if (!channel) return 0;
@@ -943,6 +1056,7 @@ static l2cap_channel_t * l2cap_create_channel_entry(btstack_packet_handler_t pac
     channel->local_mtu  = local_mtu;
     channel->remote_mtu = L2CAP_MINIMAL_MTU;
     channel->required_security_level = security_level;
+    channel->weight = 1;
 
     // 
     channel->local_cid = l2cap_next_local_cid();
@@ -1055,12 +1169,11 @@ static void l2cap_handle_connection_success_for_addr(bd_addr_t address, hci_con_
 static void l2cap_notify_channel_can_send(void){
 
 #ifdef ENABLE_CLASSIC
-    btstack_linked_list_iterator_t it;
-    btstack_linked_list_iterator_init(&it, &l2cap_channels);
-    while (btstack_linked_list_iterator_has_next(&it)){
-        l2cap_channel_t * channel = (l2cap_channel_t *) btstack_linked_list_iterator_next(&it);
-        if (!channel->waiting_for_can_send_now) continue;
-        if (!hci_can_send_acl_packet_now(channel->con_handle)) continue;
+    // let scheduler pick the channels, bounded in case a channel requests again without sending
+    int num_events = btstack_linked_list_count(&l2cap_channels);
+    while (num_events--){
+        l2cap_channel_t * channel = (*l2cap_scheduler->next_channel)(&l2cap_channels);
+        if (!channel) break;
         channel->waiting_for_can_send_now = 0;
         l2cap_emit_can_send_now(channel->packet_handler, channel->local_cid);
     }
@@ -1985,6 +2098,9 @@ void l2cap_register_fixed_channel(btstack_packet_handler_t the_packet_handler, u
 // finalize closed channel - l2cap_handle_disconnect_request & DISCONNECTION_RESPONSE
 void l2cap_finialize_channel_close(l2cap_channel_t * channel){
     channel->state = L2CAP_STATE_CLOSED;
+    if (channel->receive_buffer){
+        hci_release_acl_recombination_buffer(channel->con_handle, channel->receive_buffer);
+    }
     l2cap_emit_channel_closed(channel);
     // discard channel
     l2cap_stop_rtx(channel);
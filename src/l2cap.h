@@ -149,6 +149,14 @@ typedef struct {
     uint8_t   reason; // used in decline internal
     uint8_t   waiting_for_can_send_now;
 
+    // ACL scheduler
+    uint8_t   priority;         // l2cap_channel_priority_t
+    uint8_t   weight;           // can send now events per round
+
+    // Classic: buffer to receive fragmented packets in, incl. ACL and L2CAP header, after HCI_INCOMING_PRE_BUFFER_SIZE
+    uint8_t * receive_buffer;
+    uint16_t  receive_buffer_size;
+
     // LE Data Channels
 
     // incoming SDU
@@ -205,7 +213,19 @@ typedef struct l2cap_signaling_response {
     uint16_t cid;  // source cid for CONNECTION REQUEST
     uint16_t data; // infoType for INFORMATION REQUEST, result for CONNECTION REQUEST and COMMAND UNKNOWN
 } l2cap_signaling_response_t;
-    
+
+typedef enum {
+    L2CAP_CHANNEL_PRIORITY_NORMAL = 0,
+    L2CAP_CHANNEL_PRIORITY_HIGH,        // served before all normal channels, e.g. control channels next to SCO or media streams
+} l2cap_channel_priority_t;
+
+// ACL scheduler: decides which channel waiting for can send now gets the next free controller buffer
+typedef struct {
+    // returns channel from list of l2cap_channel_t with waiting_for_can_send_now set and
+    // hci_can_send_acl_packet_now(con_handle) true, or NULL if there is none
+    l2cap_channel_t * (*next_channel)(btstack_linked_list_t * channels);
+} l2cap_scheduler_t;
+
 
 void l2cap_register_fixed_channel(btstack_packet_handler_t packet_handler, uint16_t channel_id);
 int  l2cap_can_send_fixed_channel_packet_now(hci_con_handle_t con_handle, uint16_t channel_id);
@@ -301,6 +321,47 @@ int  l2cap_can_send_packet_now(uint16_t local_cid);
  */
 void l2cap_request_can_send_now_event(uint16_t local_cid);
 
+/**
+ * @brief Provide buffer to receive packets of a channel. Fragmented packets are recombined directly into it, so
+ *        packets larger than HCI_ACL_PAYLOAD_SIZE can be received. The data passed to the packet handler
+ *        is then located in this buffer. The first HCI_INCOMING_PRE_BUFFER_SIZE bytes are reserved, so that
+ *        packet handlers can prepend headers in place. If set before the channel is configured, the local MTU is
+ *        raised to size - HCI_INCOMING_PRE_BUFFER_SIZE - 8. Buffer needs to stay valid until channel is closed
+ *        or another buffer is set.
+ * @param local_cid
+ * @param buffer for HCI_INCOMING_PRE_BUFFER_SIZE, ACL header (4), L2CAP header (4), and payload, NULL to remove
+ * @param size of buffer
+ * @return status
+ */
+uint8_t l2cap_set_receive_buffer(uint16_t local_cid, uint8_t * buffer, uint16_t size);
+
+/**
+ * @brief Set number of L2CAP_EVENT_CAN_SEND_NOW a channel gets per round when several channels are waiting to send. Default: 1
+ * @param local_cid
+ * @param weight 1..255
+ * @return status
+ */
+uint8_t l2cap_set_channel_weight(uint16_t local_cid, uint8_t weight);
+
+/**
+ * @brief Set scheduling priority of channel. Channels with L2CAP_CHANNEL_PRIORITY_HIGH can send before all others
+ * @param local_cid
+ * @param priority
+ * @return status
+ */
+uint8_t l2cap_set_channel_priority(uint16_t local_cid, l2cap_channel_priority_t priority);
+
+/**
+ * @brief Replace scheduler that hands out L2CAP_EVENT_CAN_SEND_NOW to waiting channels
+ * @param scheduler, NULL for default weighted round robin scheduler
+ */
+void l2cap_set_scheduler(const l2cap_scheduler_t * scheduler);
+
+/**
+ * @brief Get weighted round robin scheduler, used by default
+ */
+const l2cap_scheduler_t * l2cap_scheduler_weighted_round_robin_get_instance(void);
+
 /** 
  * @brief Reserve outgoing buffer
  */
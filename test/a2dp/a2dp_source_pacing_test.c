@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+#include "btstack_util.h"
+#include "classic/a2dp_source_pacing.h"
+
+// 44.1 kHz, 16 blocks, 8 subbands, stereo, bitpool 53 -> 119 bytes per SBC frame
+#define SAMPLE_RATE         44100
+#define SAMPLES_PER_FRAME   128
+#define SBC_FRAME_LENGTH    119
+// L2CAP MTU 895 - 12 bytes media header - 1 byte SBC payload header
+#define MAX_PAYLOAD_SIZE    882
+
+// simulated run loop
+static uint32_t sim_time_ms;
+static uint32_t sim_random_state;
+
+static uint32_t sim_random(uint32_t max){
+    // xorshift32, fixed seed for reproducible runs
+    sim_random_state ^= sim_random_state << 13;
+    sim_random_state ^= sim_random_state >> 17;
+    sim_random_state ^= sim_random_state << 5;
+    return sim_random_state % (max + 1);
+}
+
+typedef struct {
+    uint32_t num_packets;
+    uint32_t num_frames;
+    uint32_t max_jitter_ms;
+    uint32_t sum_jitter_ms;
+    uint32_t rtp_errors;
+} sim_stats_t;
+
+// stream for duration_ms: timer fires up to timer_jitter_ms late, can send now arrives up to can_send_delay_ms late
+// mirrors timer / can send now handling in a2dp_source.c
+static void sim_stream(a2dp_source_pacing_t * pacing, uint32_t duration_ms, uint32_t timer_jitter_ms, uint32_t can_send_delay_ms, sim_stats_t * stats){
+    uint32_t end_ms = sim_time_ms + duration_ms;
+    while (sim_time_ms < end_ms){
+        uint32_t timeout_ms = a2dp_source_pacing_next_packet_in_ms(pacing, sim_time_ms);
+        if (timeout_ms){
+            sim_time_ms += timeout_ms + sim_random(timer_jitter_ms);
+            continue;
+        }
+        sim_time_ms += sim_random(can_send_delay_ms);
+
+        uint32_t frames_due = a2dp_source_pacing_frames_due(pacing, sim_time_ms);
+        uint8_t  num_frames = (uint8_t) btstack_min(frames_due, a2dp_source_pacing_frames_per_packet(pacing));
+        a2dp_source_pacing_skip_late_frames(pacing, sim_time_ms);
+        uint32_t rtp_timestamp = a2dp_source_pacing_rtp_timestamp(pacing);
+
+        // ideal send time: last sample of packet available
+        uint32_t ideal_ms = pacing->start_time_ms + (uint32_t) (((uint64_t) (rtp_timestamp + num_frames * SAMPLES_PER_FRAME) * 1000 + SAMPLE_RATE - 1) / SAMPLE_RATE);
+        uint32_t jitter_ms = sim_time_ms > ideal_ms ? sim_time_ms - ideal_ms : 0;
+
+        a2dp_source_pacing_packet_sent(pacing, num_frames);
+        if (a2dp_source_pacing_rtp_timestamp(pacing) != rtp_timestamp + num_frames * SAMPLES_PER_FRAME){
+            stats->rtp_errors++;
+        }
+
+        stats->num_packets++;
+        stats->num_frames += num_frames;
+        stats->sum_jitter_ms += jitter_ms;
+        if (jitter_ms > stats->max_jitter_ms){
+            stats->max_jitter_ms = jitter_ms;
+        }
+    }
+}
+
+static void sim_report(const char * name, a2dp_source_pacing_t * pacing, sim_stats_t * stats){
+    printf("%s: %u packets, avg jitter %.2f ms, max jitter %u ms, fill efficiency %.1f%%\n", name,
+        stats->num_packets, (double) stats->sum_jitter_ms / stats->num_packets, stats->max_jitter_ms, 
+        100.0 * stats->num_frames / (stats->num_packets * a2dp_source_pacing_frames_per_packet(pacing)));
+}
+
+TEST_GROUP(A2DPSourcePacing){
+    a2dp_source_pacing_t pacing;
+    sim_stats_t stats;
+
+    void setup(void){
+        sim_time_ms = 1000;
+        sim_random_state = 0x12345678;
+        memset(&stats, 0, sizeof(stats));
+        a2dp_source_pacing_init(&pacing, SAMPLE_RATE, SAMPLES_PER_FRAME, SBC_FRAME_LENGTH, MAX_PAYLOAD_SIZE);
+        a2dp_source_pacing_start(&pacing, sim_time_ms);
+    }
+};
+
+TEST(A2DPSourcePacing, FramesPerPacket){
+    CHECK_EQUAL(7, a2dp_source_pacing_frames_per_packet(&pacing));
+    // SBC payload header limits packet to 15 frames
+    a2dp_source_pacing_init(&pacing, SAMPLE_RATE, SAMPLES_PER_FRAME, SBC_FRAME_LENGTH, 4000);
+    CHECK_EQUAL(15, a2dp_source_pacing_frames_per_packet(&pacing));
+    // at least one frame
+    a2dp_source_pacing_init(&pacing, SAMPLE_RATE, SAMPLES_PER_FRAME, SBC_FRAME_LENGTH, 100);
+    CHECK_EQUAL(1, a2dp_source_pacing_frames_per_packet(&pacing));
+}
+
+TEST(A2DPSourcePacing, MediaClock){
+    // 7 frames * 128 samples @ 44.1 kHz = 20.3 ms
+    CHECK_EQUAL(0, a2dp_source_pacing_frames_due(&pacing, sim_time_ms));
+    CHECK_EQUAL(21, a2dp_source_pacing_next_packet_in_ms(&pacing, sim_time_ms));
+    CHECK_EQUAL(6, a2dp_source_pacing_frames_due(&pacing, sim_time_ms + 20));
+    CHECK_EQUAL(0, a2dp_source_pacing_packet_due(&pacing, sim_time_ms + 20));
+    CHECK_EQUAL(7, a2dp_source_pacing_frames_due(&pacing, sim_time_ms + 21));
+    CHECK_EQUAL(1, a2dp_source_pacing_packet_due(&pacing, sim_time_ms + 21));
+    CHECK_EQUAL(0, a2dp_source_pacing_next_packet_in_ms(&pacing, sim_time_ms + 21));
+
+    a2dp_source_pacing_packet_sent(&pacing, 7);
+    CHECK_EQUAL(7 * SAMPLES_PER_FRAME, a2dp_source_pacing_rtp_timestamp(&pacing));
+    CHECK_EQUAL(0, a2dp_source_pacing_frames_due(&pacing, sim_time_ms + 21));
+    CHECK_EQUAL(20, a2dp_source_pacing_next_packet_in_ms(&pacing, sim_time_ms + 21));
+}
+
+TEST(A2DPSourcePacing, ClockWrap){
+    sim_time_ms = 0xfffffff0;
+    a2dp_source_pacing_start(&pacing, sim_time_ms);
+    CHECK_EQUAL(7, a2dp_source_pacing_frames_due(&pacing, sim_time_ms + 21));
+}
+
+TEST(A2DPSourcePacing, SimulatedClockNoJitter){
+    sim_stream(&pacing, 10000, 0, 0, &stats);
+    sim_report("no jitter", &pacing, &stats);
+    CHECK_EQUAL(0, stats.rtp_errors);
+    CHECK_EQUAL(0, stats.max_jitter_ms);
+    CHECK_EQUAL(stats.num_packets * 7, stats.num_frames);
+}
+
+TEST(A2DPSourcePacing, SimulatedClockWithJitter){
+    sim_stream(&pacing, 10000, 8, 3, &stats);
+    sim_report("timer jitter 8 ms", &pacing, &stats);
+    CHECK_EQUAL(0, stats.rtp_errors);
+    // late timers are not accumulated
+    CHECK(stats.max_jitter_ms <= 8 + 3);
+    CHECK_EQUAL(stats.num_packets * 7, stats.num_frames);
+    // media clock does not drift: all frames due have been sent but less than one packet
+    uint32_t frames_due = a2dp_source_pacing_frames_due(&pacing, sim_time_ms);
+    CHECK(frames_due < 7);
+    CHECK_EQUAL((uint32_t) ((uint64_t) (sim_time_ms - 1000) * SAMPLE_RATE / 1000 / SAMPLES_PER_FRAME), stats.num_frames + frames_due);
+}
+
+TEST(A2DPSourcePacing, SimulatedStall){
+    sim_stream(&pacing, 1000, 2, 1, &stats);
+    uint32_t rtp_timestamp = a2dp_source_pacing_rtp_timestamp(&pacing);
+    uint32_t num_packets = stats.num_packets;
+
+    // no packets sent for 500 ms, catch up with at most 4 packets back-to-back
+    sim_time_ms += 500;
+    CHECK_EQUAL(4 * 7, a2dp_source_pacing_frames_due(&pacing, sim_time_ms));
+    // query does not change media clock, frames are skipped when sending
+    CHECK_EQUAL(rtp_timestamp, a2dp_source_pacing_rtp_timestamp(&pacing));
+    a2dp_source_pacing_skip_late_frames(&pacing, sim_time_ms);
+    CHECK_EQUAL(4 * 7, a2dp_source_pacing_frames_due(&pacing, sim_time_ms));
+    CHECK(a2dp_source_pacing_rtp_timestamp(&pacing) > rtp_timestamp + 400 * SAMPLE_RATE / 1000);
+
+    sim_stream(&pacing, 1000, 2, 1, &stats);
+    sim_report("stall 500 ms", &pacing, &stats);
+    CHECK_EQUAL(0, stats.rtp_errors);
+    CHECK(stats.num_packets > num_packets);
+    CHECK_EQUAL(stats.num_packets * 7, stats.num_frames);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
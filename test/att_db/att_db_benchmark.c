@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  att_db_benchmark.c
+ *
+ *  Builds a database with NUM_SERVICES services of NUM_CHARACTERISTICS notifiable characteristics each,
+ *  about 500 attributes in total, and measures the time per ATT request for reads, writes, and the
+ *  requests used for discovery. Handles are chosen pseudo-randomly with a fixed seed. A checksum over
+ *  all responses is printed to compare builds with and without MAX_NR_ATT_DB_INDEX_ENTRIES.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ble/att_db.h"
+#include "ble/att_db_util.h"
+#include "bluetooth.h"
+#include "btstack_util.h"
+
+#define DEFAULT_NUM_REQUESTS    100000
+#define NUM_SERVICES            20
+#define NUM_CHARACTERISTICS     8
+#define SERVICE_UUID16_BASE     0xff00
+#define CHARACTERISTIC_UUID16_BASE 0x2b00
+#define MTU                     23
+
+typedef struct {
+    const char * name;
+    uint16_t (*setup_request)(uint8_t * request);
+} benchmark_request_t;
+
+static int num_requests = DEFAULT_NUM_REQUESTS;
+static uint32_t random_state;
+static uint16_t num_attributes;
+static uint16_t service_start_handles[NUM_SERVICES + 1];
+static uint16_t value_handles[NUM_SERVICES * NUM_CHARACTERISTICS];
+static att_connection_t att_connection;
+static uint32_t checksum;
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t random_next(uint32_t range){
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 8) % range;
+}
+
+static uint16_t read_callback(hci_con_handle_t con_handle, uint16_t attribute_handle, uint16_t offset, uint8_t * buffer, uint16_t buffer_size){
+    UNUSED(con_handle);
+    UNUSED(offset);
+    uint8_t value[2];
+    little_endian_store_16(value, 0, attribute_handle);
+    if (!buffer) return sizeof(value);
+    uint16_t len = btstack_min(buffer_size, sizeof(value));
+    memcpy(buffer, value, len);
+    return len;
+}
+
+static int write_callback(hci_con_handle_t con_handle, uint16_t attribute_handle, uint16_t transaction_mode, uint16_t offset, uint8_t *buffer, uint16_t buffer_size){
+    UNUSED(con_handle);
+    UNUSED(attribute_handle);
+    UNUSED(transaction_mode);
+    UNUSED(offset);
+    UNUSED(buffer);
+    UNUSED(buffer_size);
+    return 0;
+}
+
+static void setup_db(void){
+    att_db_util_init();
+    int i, j;
+    for (i = 0; i < NUM_SERVICES; i++){
+        uint8_t value[8];
+        memset(value, i, sizeof(value));
+        att_db_util_add_service_uuid16(SERVICE_UUID16_BASE + i);
+        for (j = 0; j < NUM_CHARACTERISTICS; j++){
+            value_handles[i * NUM_CHARACTERISTICS + j] = att_db_util_add_characteristic_uuid16(CHARACTERISTIC_UUID16_BASE + i * NUM_CHARACTERISTICS + j,
+                ATT_PROPERTY_READ | ATT_PROPERTY_WRITE | ATT_PROPERTY_NOTIFY, value, sizeof(value));
+        }
+    }
+    // each service: declaration, and declaration, value, and client configuration per characteristic
+    num_attributes = NUM_SERVICES * (1 + 3 * NUM_CHARACTERISTICS);
+    for (i = 0; i <= NUM_SERVICES; i++){
+        service_start_handles[i] = 1 + i * (1 + 3 * NUM_CHARACTERISTICS);
+    }
+    att_set_db(att_db_util_get_address());
+    att_set_read_callback(&read_callback);
+    att_set_write_callback(&write_callback);
+
+    memset(&att_connection, 0, sizeof(att_connection));
+    att_connection.mtu     = MTU;
+    att_connection.max_mtu = MTU;
+}
+
+static uint16_t random_value_handle(void){
+    return value_handles[random_next(NUM_SERVICES * NUM_CHARACTERISTICS)];
+}
+
+static uint16_t setup_read(uint8_t * request){
+    request[0] = ATT_READ_REQUEST;
+    little_endian_store_16(request, 1, random_value_handle());
+    return 3;
+}
+
+static uint16_t setup_read_multiple(uint8_t * request){
+    request[0] = ATT_READ_MULTIPLE_REQUEST;
+    int i;
+    for (i = 0; i < 4; i++){
+        little_endian_store_16(request, 1 + 2 * i, random_value_handle());
+    }
+    return 9;
+}
+
+static uint16_t setup_write(uint8_t * request){
+    // client characteristic configuration follows value
+    request[0] = ATT_WRITE_REQUEST;
+    little_endian_store_16(request, 1, random_value_handle() + 1);
+    little_endian_store_16(request, 3, 1);
+    return 5;
+}
+
+static uint16_t setup_find_information(uint8_t * request){
+    request[0] = ATT_FIND_INFORMATION_REQUEST;
+    little_endian_store_16(request, 1, 1 + random_next(num_attributes));
+    little_endian_store_16(request, 3, 0xffff);
+    return 5;
+}
+
+// characteristic discovery within service
+static uint16_t setup_read_by_type_characteristics(uint8_t * request){
+    uint32_t service = random_next(NUM_SERVICES);
+    request[0] = ATT_READ_BY_TYPE_REQUEST;
+    little_endian_store_16(request, 1, service_start_handles[service]);
+    little_endian_store_16(request, 3, service_start_handles[service + 1] - 1);
+    little_endian_store_16(request, 5, GATT_CHARACTERISTICS_UUID);
+    return 7;
+}
+
+// read using characteristic uuid over complete database
+static uint16_t setup_read_by_type_uuid(uint8_t * request){
+    request[0] = ATT_READ_BY_TYPE_REQUEST;
+    little_endian_store_16(request, 1, 0x0001);
+    little_endian_store_16(request, 3, 0xffff);
+    little_endian_store_16(request, 5, CHARACTERISTIC_UUID16_BASE + random_next(NUM_SERVICES * NUM_CHARACTERISTICS));
+    return 7;
+}
+
+// primary service discovery, continued from random service
+static uint16_t setup_read_by_group_type(uint8_t * request){
+    request[0] = ATT_READ_BY_GROUP_TYPE_REQUEST;
+    little_endian_store_16(request, 1, service_start_handles[random_next(NUM_SERVICES)]);
+    little_endian_store_16(request, 3, 0xffff);
+    little_endian_store_16(request, 5, GATT_PRIMARY_SERVICE_UUID);
+    return 7;
+}
+
+// primary service discovery by service uuid
+static uint16_t setup_find_by_type_value(uint8_t * request){
+    request[0] = ATT_FIND_BY_TYPE_VALUE_REQUEST;
+    little_endian_store_16(request, 1, 0x0001);
+    little_endian_store_16(request, 3, 0xffff);
+    little_endian_store_16(request, 5, GATT_PRIMARY_SERVICE_UUID);
+    little_endian_store_16(request, 7, SERVICE_UUID16_BASE + random_next(NUM_SERVICES));
+    return 9;
+}
+
+static const benchmark_request_t requests[] = {
+    { "read",                              &setup_read },
+    { "read multiple (4 handles)",         &setup_read_multiple },
+    { "write",                             &setup_write },
+    { "find information",                  &setup_find_information },
+    { "read by type, characteristics",     &setup_read_by_type_characteristics },
+    { "read by type, uuid",                &setup_read_by_type_uuid },
+    { "read by group type",                &setup_read_by_group_type },
+    { "find by type value",                &setup_find_by_type_value },
+};
+
+static void run(const benchmark_request_t * benchmark_request){
+    uint8_t request[32];
+    uint8_t response[MTU];
+    random_state = 1;
+    uint64_t start_ns = benchmark_time_ns();
+    int i;
+    for (i = 0; i < num_requests; i++){
+        uint16_t request_len  = (*benchmark_request->setup_request)(request);
+        uint16_t response_len = att_handle_request(&att_connection, request, request_len, response);
+        // FNV-1a
+        uint16_t j;
+        for (j = 0; j < response_len; j++){
+            checksum = (checksum ^ response[j]) * 16777619;
+        }
+    }
+    uint64_t duration_ns = benchmark_time_ns() - start_ns;
+    printf("%-35s %8.1f ns/request\n", benchmark_request->name, (double) duration_ns / num_requests);
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_requests = atoi(argv[1]);
+    }
+
+    setup_db();
+
+#ifdef MAX_NR_ATT_DB_INDEX_ENTRIES
+    printf("%u attributes, indexed\n", num_attributes);
+#else
+    printf("%u attributes, linear search\n", num_attributes);
+#endif
+
+    checksum = 2166136261u;
+    unsigned int i;
+    for (i = 0; i < sizeof(requests) / sizeof(benchmark_request_t); i++){
+        run(&requests[i]);
+    }
+    printf("checksum %08x\n", checksum);
+    return 0;
+}
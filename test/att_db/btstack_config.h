@@ -0,0 +1,22 @@
+//
+// btstack_config.h for att_db benchmark
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_POSIX_TIME
+#define HAVE_POSIX_FILE_IO
+
+// BTstack features that can be enabled
+#define ENABLE_BLE
+#define ENABLE_LOG_ERROR
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 52
+
+// MAX_NR_ATT_DB_INDEX_ENTRIES is set by Makefile
+
+#endif
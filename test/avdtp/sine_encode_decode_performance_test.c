@@ -42,6 +42,8 @@
 #include <portaudio.h>
 
 #include "btstack_sbc.h"
+#include "sbc_encoder.h"
+#include "sbc_enc_func_declare.h"
 #include "avdtp.h"
 #include "avdtp_source.h"
 #include "btstack_stdin.h"
@@ -70,6 +72,16 @@ static btstack_sbc_mode_t mode = SBC_MODE_STANDARD;
 static btstack_sbc_encoder_state_t sbc_encoder_state;
 static btstack_sbc_decoder_state_t sbc_decoder_state;
 
+static const struct {
+    int implementation;
+    const char * name;
+} analysis_implementations[] = {
+    { SBC_ANALYSIS_SCALAR, "scalar" },
+    { SBC_ANALYSIS_SSE2,   "SSE2"   },
+    { SBC_ANALYSIS_AVX2,   "AVX2"   },
+    { SBC_ANALYSIS_NEON,   "NEON"   },
+};
+
 static void handle_pcm_data(int16_t * data, int num_samples, int num_channels, int sample_rate, void * context){
     UNUSED(sample_rate);
     UNUSED(context);
@@ -102,11 +114,29 @@ static void fill_sine_frame(void *userData, int num_samples_to_write){
     }
 }
 
+// encode num_frames with the given analysis filter implementation, returns hash of SBC output
+static uint32_t encode_frames(int num_frames, uint32_t * encoding_time){
+    uint32_t hash = 2166136261u;
+    int i, j;
+    sin_data.left_phase = sin_data.right_phase = 0;
+    btstack_sbc_encoder_init(&sbc_encoder_state, SBC_MODE_STANDARD, 16, 8, 2, 44100, 53);
+    uint32_t timestamp_start = btstack_run_loop_get_time_ms();
+    for (i=0; i<num_frames; i++){
+        fill_sine_frame(&sin_data, 128);
+        btstack_sbc_encoder_process_data(&sbc_encoder_state, (int16_t *) pcm_frame);
+        uint8_t * sbc_frame = btstack_sbc_encoder_sbc_buffer(&sbc_encoder_state);
+        for (j=0; j<btstack_sbc_encoder_sbc_buffer_length(&sbc_encoder_state); j++){
+            hash = (hash ^ sbc_frame[j]) * 16777619u;
+        }
+    }
+    *encoding_time = btstack_run_loop_get_time_ms() - timestamp_start;
+    return hash;
+}
+
 int btstack_main(int argc, const char * argv[]);
 int btstack_main(int argc, const char * argv[]){
     (void) argc;
     (void) argv;
-    btstack_sbc_encoder_init(&sbc_encoder_state, SBC_MODE_STANDARD, 16, 8, 2, 44100, 53);
                     
     /* initialise sinusoidal wavetable */
     int i;
@@ -115,24 +145,45 @@ int btstack_main(int argc, const char * argv[]){
     }
     sin_data.left_phase = sin_data.right_phase = 0;
     
-    btstack_sbc_decoder_init(&sbc_decoder_state, mode, handle_pcm_data, NULL);
-    int num_frames = 10000;
+    int num_frames = 100000;
     uint32_t timestamp_start;
     uint32_t encoding_time = 0;
     uint32_t decoding_time = 0;
+
+    // encoding speed per analysis filter implementation, output has to match the scalar one
+    uint32_t scalar_hash = 0;
+    for (i=0; i < (int) (sizeof(analysis_implementations) / sizeof(analysis_implementations[0])); i++){
+        const char * name = analysis_implementations[i].name;
+        if (!SbcAnalysisSetImplementation(analysis_implementations[i].implementation)){
+            printf("%-6s: not supported\n", name);
+            continue;
+        }
+        uint32_t hash = encode_frames(num_frames, &encoding_time);
+        if (analysis_implementations[i].implementation == SBC_ANALYSIS_SCALAR){
+            scalar_hash = hash;
+        }
+        printf("%-6s: %d frames encoded in %dms, %u frames/s, %s\n", name, num_frames, encoding_time,
+            encoding_time ? (unsigned int) (num_frames * 1000u / encoding_time) : 0,
+            hash == scalar_hash ? "bit-exact" : "MISMATCH");
+    }
+    SbcAnalysisSetImplementation(SBC_ANALYSIS_AUTO);
+
+    btstack_sbc_encoder_init(&sbc_encoder_state, SBC_MODE_STANDARD, 16, 8, 2, 44100, 53);
+    btstack_sbc_decoder_init(&sbc_decoder_state, mode, handle_pcm_data, NULL);
+    sin_data.left_phase = sin_data.right_phase = 0;
     
     timestamp_start = btstack_run_loop_get_time_ms();
     for (i=0; i<num_frames; i++){
         fill_sine_frame(&sin_data, 128);
-        btstack_sbc_encoder_process_data((int16_t *) pcm_frame);
+        btstack_sbc_encoder_process_data(&sbc_encoder_state, (int16_t *) pcm_frame);
     }
     encoding_time = btstack_run_loop_get_time_ms() - timestamp_start;
 
     timestamp_start = btstack_run_loop_get_time_ms();
     for (i=0; i<num_frames; i++){
         fill_sine_frame(&sin_data, 128);
-        btstack_sbc_encoder_process_data((int16_t *) pcm_frame);
-        btstack_sbc_decoder_process_data(&sbc_decoder_state, 0, btstack_sbc_encoder_sbc_buffer(), btstack_sbc_encoder_sbc_buffer_length());
+        btstack_sbc_encoder_process_data(&sbc_encoder_state, (int16_t *) pcm_frame);
+        btstack_sbc_decoder_process_data(&sbc_decoder_state, 0, btstack_sbc_encoder_sbc_buffer(&sbc_encoder_state), btstack_sbc_encoder_sbc_buffer_length(&sbc_encoder_state));
     }
     decoding_time =  btstack_run_loop_get_time_ms() - timestamp_start - encoding_time;
 
@@ -124,8 +124,8 @@ int btstack_main(int argc, const char * argv[]){
 
     for (i=0; i<3500; i++){
         fill_sine_frame(&sin_data, 128);
-        btstack_sbc_encoder_process_data((int16_t *) pcm_frame);
-        btstack_sbc_decoder_process_data(&state, 0, btstack_sbc_encoder_sbc_buffer(), btstack_sbc_encoder_sbc_buffer_length());
+        btstack_sbc_encoder_process_data(&sbc_encoder_state, (int16_t *) pcm_frame);
+        btstack_sbc_decoder_process_data(&state, 0, btstack_sbc_encoder_sbc_buffer(&sbc_encoder_state), btstack_sbc_encoder_sbc_buffer_length(&sbc_encoder_state));
 
     }
     wav_writer_close();
@@ -32,6 +32,7 @@
 #define MAX_NR_BNEP_SERVICES 0
 #define MAX_NR_BNEP_CHANNELS 0
 #define MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES  2
+#define MAX_NR_BTSTACK_LINK_KEY_DB_FS_ENTRIES 16384
 #define MAX_NR_HFP_CONNECTIONS 0
 #define MAX_NR_WHITELIST_ENTRIES 0
 #define MAX_NR_SM_LOOKUP_ENTRIES 0
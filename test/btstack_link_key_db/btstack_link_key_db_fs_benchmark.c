@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  btstack_link_key_db_fs_benchmark.c
+ *
+ *  Stores NUM_KEYS link keys and measures the time to look up stored keys in pseudo-random order, as done for every
+ *  Link Key Request during connection setup, as well as lookups of unknown devices. A checksum over all keys read
+ *  is printed.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_debug.h"
+#include "btstack_link_key_db_fs.h"
+#include "btstack_util.h"
+#include "hci_dump.h"
+
+#define NUM_KEYS 10000
+
+static bd_addr_t local_addr = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x23 };
+
+static int num_keys = NUM_KEYS;
+static uint32_t random_state;
+static uint32_t checksum;
+
+uint32_t btstack_run_loop_get_time_ms(void) { return 0; }
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t random_next(uint32_t range){
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 8) % range;
+}
+
+static void update_checksum(const uint8_t * data, uint16_t len){
+    uint16_t i;
+    for (i = 0; i < len; i++){
+        checksum = (checksum ^ data[i]) * 16777619;
+    }
+}
+
+static void addr_for_key(int i, bd_addr_t addr){
+    addr[0] = 0x00;
+    addr[1] = 0x1B;
+    addr[2] = 0xDC;
+    addr[3] = (uint8_t) (i >> 16);
+    addr[4] = (uint8_t) (i >> 8);
+    addr[5] = (uint8_t) i;
+}
+
+// @returns number of keys found
+static int lookup_keys(const btstack_link_key_db_t * db, int offset){
+    int num_found = 0;
+    int i;
+    for (i = 0; i < num_keys; i++){
+        bd_addr_t addr;
+        link_key_t link_key;
+        link_key_type_t link_key_type;
+        addr_for_key(offset + random_next(num_keys), addr);
+        if (!db->get_link_key(addr, link_key, &link_key_type)) continue;
+        update_checksum(link_key, sizeof(link_key));
+        num_found++;
+    }
+    return num_found;
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_keys = atoi(argv[1]);
+    }
+
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+    hci_dump_enable_log_level(LOG_LEVEL_ERROR, 0);
+
+    const btstack_link_key_db_t * db = btstack_link_key_db_fs_instance();
+    remove("/tmp/btstack_link_key_db.bin");
+    db->open();
+    db->set_local_bd_addr(local_addr);
+
+    uint64_t start_ns = benchmark_time_ns();
+    int i;
+    for (i = 0; i < num_keys; i++){
+        bd_addr_t addr;
+        link_key_t link_key;
+        addr_for_key(i, addr);
+        memset(link_key, 0, sizeof(link_key));
+        little_endian_store_32(link_key, 0, i * 2654435761u);
+        db->put_link_key(addr, link_key, COMBINATION_KEY);
+    }
+    uint64_t duration_ns = benchmark_time_ns() - start_ns;
+    printf("%u link keys\n", num_keys);
+    printf("%-20s %9.1f ns/key\n", "put", (double) duration_ns / num_keys);
+
+    checksum = 2166136261u;
+    random_state = 1;
+    start_ns = benchmark_time_ns();
+    int num_found = lookup_keys(db, 0);
+    duration_ns = benchmark_time_ns() - start_ns;
+    printf("%-20s %9.1f ns/lookup, %u found\n", "get stored key", (double) duration_ns / num_keys, num_found);
+
+    start_ns = benchmark_time_ns();
+    num_found = lookup_keys(db, num_keys);
+    duration_ns = benchmark_time_ns() - start_ns;
+    printf("%-20s %9.1f ns/lookup, %u found\n", "get unknown device", (double) duration_ns / num_keys, num_found);
+
+    db->close();
+    remove("/tmp/btstack_link_key_db.bin");
+    printf("checksum %08x\n", checksum);
+    return 0;
+}
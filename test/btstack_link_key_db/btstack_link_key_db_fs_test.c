@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/CommandLineTestRunner.h"
 
@@ -12,12 +13,28 @@
 
 extern "C" uint32_t btstack_run_loop_get_time_ms(void) { return 0; }
 
+#define LINK_KEY_DB_FILE "/tmp/btstack_link_key_db.bin"
+
+static const btstack_link_key_db_t * db;
+
+static bd_addr_t local_addr = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x42 };
+
+static void reopen(void){
+    db->close();
+    db->open();
+    db->set_local_bd_addr(local_addr);
+}
+
 TEST_GROUP(RemoteDeviceDB){
     bd_addr_t bd_addr;
     link_key_t link_key;
     link_key_type_t link_key_type;
 
     void setup(void){
+        db = btstack_link_key_db_fs_instance();
+        db->close();
+        remove(LINK_KEY_DB_FILE);
+        reopen();
         bd_addr_t addr_1 = {0x00, 0x01, 0x02, 0x03, 0x04, 0x01 };
         bd_addr_copy(bd_addr, addr_1); 
 
@@ -25,7 +42,29 @@ TEST_GROUP(RemoteDeviceDB){
         sprintf((char*)link_key, "%d", 100);
     }
     
-    void teardown(void){}
+    void teardown(void){
+        db->close();
+        remove(LINK_KEY_DB_FILE);
+    }
+
+    void put_key(int i){
+        bd_addr_t addr = { 0x00, 0x1B, 0xDC, 0x00, (uint8_t) (i >> 8), (uint8_t) i };
+        link_key_t key;
+        memset(key, i, 16);
+        db->put_link_key(addr, key, link_key_type);
+    }
+
+    int get_key(int i){
+        bd_addr_t addr = { 0x00, 0x1B, 0xDC, 0x00, (uint8_t) (i >> 8), (uint8_t) i };
+        link_key_t key;
+        link_key_t test_key;
+        link_key_type_t test_link_key_type;
+        memset(key, i, 16);
+        if (!db->get_link_key(addr, test_key, &test_link_key_type)) return 0;
+        CHECK_EQUAL(link_key_type, test_link_key_type);
+        MEMCMP_EQUAL(key, test_key, 16);
+        return 1;
+    }
 };
 
 
@@ -45,6 +84,98 @@ TEST(RemoteDeviceDB, SinglePutGetDeleteKey){
     CHECK(btstack_link_key_db_fs_instance()->get_link_key(bd_addr, test_link_key, &test_link_key_type) == 0);
 }
 
+TEST(RemoteDeviceDB, PersistAcrossClose){
+    link_key_t test_link_key;
+    link_key_type_t test_link_key_type;
+    db->put_link_key(bd_addr, link_key, link_key_type);
+    reopen();
+    CHECK(db->get_link_key(bd_addr, test_link_key, &test_link_key_type) == 1);
+    MEMCMP_EQUAL(link_key, test_link_key, 16);
+    CHECK_EQUAL(link_key_type, test_link_key_type);
+}
+
+TEST(RemoteDeviceDB, LocalAddressIsPartOfKey){
+    link_key_t test_link_key;
+    link_key_type_t test_link_key_type;
+    bd_addr_t other_local_addr = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x43 };
+    db->put_link_key(bd_addr, link_key, link_key_type);
+    db->set_local_bd_addr(other_local_addr);
+    CHECK(db->get_link_key(bd_addr, test_link_key, &test_link_key_type) == 0);
+    db->set_local_bd_addr(local_addr);
+    CHECK(db->get_link_key(bd_addr, test_link_key, &test_link_key_type) == 1);
+}
+
+TEST(RemoteDeviceDB, UpdateReplacesKey){
+    link_key_t test_link_key;
+    link_key_type_t test_link_key_type;
+    link_key_t new_link_key;
+    memset(new_link_key, 0x55, 16);
+    db->put_link_key(bd_addr, link_key, link_key_type);
+    db->put_link_key(bd_addr, new_link_key, link_key_type);
+    reopen();
+    CHECK(db->get_link_key(bd_addr, test_link_key, &test_link_key_type) == 1);
+    MEMCMP_EQUAL(new_link_key, test_link_key, 16);
+    db->delete_link_key(bd_addr);
+    CHECK(db->get_link_key(bd_addr, test_link_key, &test_link_key_type) == 0);
+}
+
+TEST(RemoteDeviceDB, EvictLeastRecentlyUsed){
+    int i;
+    for (i = 0; i < MAX_NR_BTSTACK_LINK_KEY_DB_FS_ENTRIES; i++){
+        put_key(i);
+    }
+    // first key used recently, second key is least recently used
+    CHECK(get_key(0) == 1);
+    put_key(MAX_NR_BTSTACK_LINK_KEY_DB_FS_ENTRIES);
+    reopen();
+    CHECK(get_key(0) == 1);
+    CHECK(get_key(1) == 0);
+    for (i = 2; i <= MAX_NR_BTSTACK_LINK_KEY_DB_FS_ENTRIES; i++){
+        CHECK(get_key(i) == 1);
+    }
+}
+
+TEST(RemoteDeviceDB, CorruptEntryDropped){
+    link_key_t test_link_key;
+    link_key_type_t test_link_key_type;
+    db->put_link_key(bd_addr, link_key, link_key_type);
+    put_key(1);
+    db->close();
+
+    // flip bit in stored link key
+    struct stat st;
+    CHECK(stat(LINK_KEY_DB_FILE, &st) == 0);
+    uint8_t * data = (uint8_t *) malloc(st.st_size);
+    FILE * file = fopen(LINK_KEY_DB_FILE, "r+b");
+    CHECK(fread(data, st.st_size, 1, file) == 1);
+    uint8_t * pos = (uint8_t *) memmem(data, st.st_size, link_key, 16);
+    CHECK(pos != NULL);
+    fseek(file, pos - data, SEEK_SET);
+    fputc(pos[0] ^ 0x01, file);
+    fclose(file);
+    free(data);
+
+    reopen();
+    CHECK(db->get_link_key(bd_addr, test_link_key, &test_link_key_type) == 0);
+    CHECK(get_key(1) == 1);
+}
+
+TEST(RemoteDeviceDB, ImportLegacyFiles){
+    link_key_t test_link_key;
+    link_key_type_t test_link_key_type;
+    const char * path = "/tmp/btstack_at_00-00-00-00-10-42_link_key_for_00-01-02-03-04-01.txt";
+    FILE * file = fopen(path, "w");
+    CHECK(file != NULL);
+    fprintf(file, "00112233445566778899AABBCCDDEEFF4");
+    fclose(file);
+    reopen();
+    CHECK(db->get_link_key(bd_addr, test_link_key, &test_link_key_type) == 1);
+    CHECK_EQUAL(4, test_link_key_type);
+    CHECK_EQUAL(0x00, test_link_key[0]);
+    CHECK_EQUAL(0xFF, test_link_key[15]);
+    file = fopen(path, "r");
+    CHECK(file == NULL);
+}
 
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
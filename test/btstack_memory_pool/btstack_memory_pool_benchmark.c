@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  btstack_memory_pool_benchmark.c
+ *
+ *  Measures alloc/free pairs for pool sizes from 8 to 4096 blocks with half of the blocks in use.
+ *  For reference, each free is also preceded by a walk of the free list, as done for double free
+ *  detection before free blocks were tagged.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "btstack_memory_pool.h"
+
+#define DEFAULT_NUM_PAIRS   1000000
+#define BLOCK_SIZE          64
+#define MIN_POOL_SIZE       8
+#define MAX_POOL_SIZE       4096
+
+typedef struct block {
+    struct block * next;
+} block_t;
+
+static int num_pairs = DEFAULT_NUM_PAIRS;
+static void * volatile sink;
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// free list walk as done by btstack_memory_pool_free before
+static int free_list_contains(btstack_memory_pool_t * pool, void * block){
+    block_t * it;
+    for (it = (block_t *) pool->free_blocks; it ; it = it->next){
+        if (it == block) return 1;
+    }
+    return 0;
+}
+
+static uint64_t measure(btstack_memory_pool_t * pool, int walk_free_list){
+    uint64_t start_ns = benchmark_time_ns();
+    int i;
+    for (i = 0; i < num_pairs; i++){
+        void * block = btstack_memory_pool_get(pool);
+        sink = block;
+        if (walk_free_list && free_list_contains(pool, block)) break;
+        btstack_memory_pool_free(pool, block);
+    }
+    return benchmark_time_ns() - start_ns;
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_pairs = atoi(argv[1]);
+    }
+
+    printf("%u alloc/free pairs, half of the blocks in use\n", num_pairs);
+    printf("pool size   tagged   list walk\n");
+    int pool_size;
+    for (pool_size = MIN_POOL_SIZE; pool_size <= MAX_POOL_SIZE; pool_size *= 2){
+        uint8_t * storage = (uint8_t *) malloc(pool_size * BLOCK_SIZE);
+        btstack_memory_pool_t pool;
+        btstack_memory_pool_create(&pool, storage, pool_size, BLOCK_SIZE);
+        int i;
+        for (i = 0; i < pool_size / 2; i++){
+            btstack_memory_pool_get(&pool);
+        }
+
+        uint64_t tagged_ns = measure(&pool, 0);
+        uint64_t walk_ns   = measure(&pool, 1);
+
+        const btstack_memory_pool_statistics_t * statistics = btstack_memory_pool_get_statistics(&pool);
+        if (statistics->double_frees || statistics->blocks_in_use != pool_size / 2){
+            fprintf(stderr, "pool size %u: %u blocks in use, %u double frees\n", pool_size, statistics->blocks_in_use, statistics->double_frees);
+            return 1;
+        }
+        printf("%9u %6.1f ns %8.1f ns\n", pool_size, (double) tagged_ns / num_pairs, (double) walk_ns / num_pairs);
+        free(storage);
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "btstack_memory_pool.h"
+#include "hci_dump.h"
+
+#define NUM_BLOCKS 8
+#define BLOCK_SIZE 32
+
+static btstack_memory_pool_t pool;
+static uint8_t storage[NUM_BLOCKS * BLOCK_SIZE];
+
+TEST_GROUP(MemoryPool){
+    void setup(void){
+        hci_dump_enable_log_level(LOG_LEVEL_ERROR, 0);
+        btstack_memory_pool_create(&pool, storage, NUM_BLOCKS, BLOCK_SIZE);
+    }
+};
+
+TEST(MemoryPool, GetAll){
+    void * blocks[NUM_BLOCKS];
+    int i;
+    for (i = 0; i < NUM_BLOCKS; i++){
+        blocks[i] = btstack_memory_pool_get(&pool);
+        CHECK(blocks[i] != NULL);
+        CHECK((uint8_t *) blocks[i] >= storage);
+        CHECK((uint8_t *) blocks[i] < &storage[sizeof(storage)]);
+    }
+    POINTERS_EQUAL(NULL, btstack_memory_pool_get(&pool));
+    for (i = 0; i < NUM_BLOCKS; i++){
+        btstack_memory_pool_free(&pool, blocks[i]);
+    }
+    for (i = 0; i < NUM_BLOCKS; i++){
+        CHECK(btstack_memory_pool_get(&pool) != NULL);
+    }
+}
+
+TEST(MemoryPool, DoubleFree){
+    void * block = btstack_memory_pool_get(&pool);
+    btstack_memory_pool_free(&pool, block);
+    btstack_memory_pool_free(&pool, block);
+    // block must only be handed out once
+    int count = 0;
+    void * got;
+    while ((got = btstack_memory_pool_get(&pool)) != NULL){
+        if (got == block) count++;
+    }
+    CHECK_EQUAL(1, count);
+    CHECK_EQUAL(1, btstack_memory_pool_get_statistics(&pool)->double_frees);
+}
+
+TEST(MemoryPool, BlockInUseLooksFree){
+    // user data that matches the free tag must not prevent a valid free
+    void * block = btstack_memory_pool_get(&pool);
+    void * other = btstack_memory_pool_get(&pool);
+    btstack_memory_pool_free(&pool, other);
+    memcpy(block, other, BLOCK_SIZE);
+    btstack_memory_pool_free(&pool, block);
+    CHECK_EQUAL(0, btstack_memory_pool_get_statistics(&pool)->double_frees);
+    CHECK_EQUAL(0, btstack_memory_pool_get_statistics(&pool)->blocks_in_use);
+}
+
+TEST(MemoryPool, Statistics){
+    void * blocks[NUM_BLOCKS];
+    int i;
+    for (i = 0; i < 5; i++){
+        blocks[i] = btstack_memory_pool_get(&pool);
+    }
+    for (i = 0; i < 3; i++){
+        btstack_memory_pool_free(&pool, blocks[i]);
+    }
+    const btstack_memory_pool_statistics_t * statistics = btstack_memory_pool_get_statistics(&pool);
+    CHECK_EQUAL(2, statistics->blocks_in_use);
+    CHECK_EQUAL(5, statistics->blocks_in_use_max);
+    CHECK_EQUAL(0, statistics->allocation_failures);
+    for (i = 0; i < NUM_BLOCKS; i++){
+        btstack_memory_pool_get(&pool);
+    }
+    CHECK_EQUAL(NUM_BLOCKS, statistics->blocks_in_use);
+    CHECK_EQUAL(NUM_BLOCKS, statistics->blocks_in_use_max);
+    CHECK_EQUAL(2, statistics->allocation_failures);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,353 @@
+
+// *****************************************************************************
+//
+// test GATT client cache: discovery of bonded device is answered from cache
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_tlv.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "ble/gatt_client.h"
+#include "ble/att_db.h"
+#include "ble/le_device_db.h"
+#include "bluetooth_gatt.h"
+#include "profile.h"
+
+void mock_simulate_disconnected(void);
+void mock_simulate_disconnected_handle(uint16_t con_handle);
+void mock_simulate_indication(uint16_t value_handle, const uint8_t * value, uint16_t value_len);
+void mock_simulate_le_device_index(int index);
+int  mock_att_requests_sent(void);
+void mock_execute_run_loop(void);
+
+static uint16_t gatt_client_handle = 0x40;
+static uint16_t gatt_client_handle_2 = 0x41;
+
+// minimal TLV in RAM
+#define TLV_MAX_TAGS 4
+#define TLV_MAX_SIZE 4096
+static struct {
+    uint32_t tag;
+    uint32_t size;
+    uint8_t  data[TLV_MAX_SIZE];
+} tlv_entries[TLV_MAX_TAGS];
+
+static int tlv_get_tag(void * context, uint32_t tag, uint8_t * buffer, uint32_t buffer_size){
+    int i;
+    for (i=0;i<TLV_MAX_TAGS;i++){
+        if (tlv_entries[i].tag != tag) continue;
+        uint32_t size = btstack_min(tlv_entries[i].size, buffer_size);
+        memcpy(buffer, tlv_entries[i].data, size);
+        return size;
+    }
+    return 0;
+}
+
+static void tlv_delete_tag(void * context, uint32_t tag){
+    int i;
+    for (i=0;i<TLV_MAX_TAGS;i++){
+        if (tlv_entries[i].tag != tag) continue;
+        tlv_entries[i].tag = 0;
+    }
+}
+
+static void tlv_store_tag(void * context, uint32_t tag, const uint8_t * data, uint32_t data_size){
+    tlv_delete_tag(context, tag);
+    int i;
+    for (i=0;i<TLV_MAX_TAGS;i++){
+        if (tlv_entries[i].tag) continue;
+        CHECK(data_size <= TLV_MAX_SIZE);
+        tlv_entries[i].tag = tag;
+        tlv_entries[i].size = data_size;
+        memcpy(tlv_entries[i].data, data, data_size);
+        return;
+    }
+}
+
+static int tlv_num_tags(void){
+    int i;
+    int num_tags = 0;
+    for (i=0;i<TLV_MAX_TAGS;i++){
+        if (tlv_entries[i].tag) num_tags++;
+    }
+    return num_tags;
+}
+
+static const btstack_tlv_t tlv_impl = {
+    &tlv_get_tag,
+    &tlv_store_tag,
+    &tlv_delete_tag,
+};
+
+// discovery results
+#define MAX_RESULTS 50
+static gatt_client_service_t services[MAX_RESULTS];
+static gatt_client_characteristic_t characteristics[MAX_RESULTS];
+static gatt_client_characteristic_descriptor_t descriptors[MAX_RESULTS];
+static int num_services;
+static int num_characteristics;
+static int num_descriptors;
+static int gatt_query_complete;
+static uint32_t results_hash;
+
+static void hash_result(const uint8_t * data, int size){
+    int i;
+    for (i=0;i<size;i++){
+        results_hash = (results_hash ^ data[i]) * 16777619u;
+    }
+}
+
+static void handle_gatt_client_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (packet[0]){
+        case GATT_EVENT_QUERY_COMPLETE:
+            CHECK_EQUAL(0, packet[4]);
+            gatt_query_complete = 1;
+            break;
+        case GATT_EVENT_SERVICE_QUERY_RESULT:
+            CHECK(num_services < MAX_RESULTS);
+            memset(&services[num_services], 0, sizeof(gatt_client_service_t));
+            gatt_client_deserialize_service(packet, 4, &services[num_services++]);
+            hash_result(packet, size);
+            break;
+        case GATT_EVENT_CHARACTERISTIC_QUERY_RESULT:
+            CHECK(num_characteristics < MAX_RESULTS);
+            memset(&characteristics[num_characteristics], 0, sizeof(gatt_client_characteristic_t));
+            gatt_client_deserialize_characteristic(packet, 4, &characteristics[num_characteristics++]);
+            hash_result(packet, size);
+            break;
+        case GATT_EVENT_ALL_CHARACTERISTIC_DESCRIPTORS_QUERY_RESULT:
+            CHECK(num_descriptors < MAX_RESULTS);
+            memset(&descriptors[num_descriptors], 0, sizeof(gatt_client_characteristic_descriptor_t));
+            gatt_client_deserialize_characteristic_descriptor(packet, 4, &descriptors[num_descriptors++]);
+            hash_result(packet, size);
+            break;
+        default:
+            break;
+    }
+}
+
+// query complete events per connection
+static int num_queries_complete_handle_1;
+static int num_queries_complete_handle_2;
+
+static void handle_gatt_client_event_count_complete(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (packet[0] != GATT_EVENT_QUERY_COMPLETE) return;
+    CHECK_EQUAL(0, packet[4]);
+    uint16_t con_handle = little_endian_read_16(packet, 2);
+    if (con_handle == gatt_client_handle)   num_queries_complete_handle_1++;
+    if (con_handle == gatt_client_handle_2) num_queries_complete_handle_2++;
+}
+
+static void start_query(void){
+    gatt_query_complete = 0;
+}
+
+static void check_query_complete(uint8_t status){
+    CHECK_EQUAL(0, status);
+    // results from cache are reported from the run loop
+    mock_execute_run_loop();
+    CHECK_EQUAL(1, gatt_query_complete);
+}
+
+// discover all services, characteristics and descriptors, @returns number of ATT requests
+static int discover_all(void){
+    int att_requests = mock_att_requests_sent();
+    num_services = 0;
+    num_characteristics = 0;
+    num_descriptors = 0;
+    results_hash = 2166136261u;
+
+    start_query();
+    check_query_complete(gatt_client_discover_primary_services(handle_gatt_client_event, gatt_client_handle));
+    int num_primary_services = num_services;
+    int i;
+    for (i=0;i<num_primary_services;i++){
+        int first_characteristic = num_characteristics;
+        start_query();
+        check_query_complete(gatt_client_discover_characteristics_for_service(handle_gatt_client_event, gatt_client_handle, &services[i]));
+        int j;
+        for (j=first_characteristic;j<num_characteristics;j++){
+            start_query();
+            check_query_complete(gatt_client_discover_characteristic_descriptors(handle_gatt_client_event, gatt_client_handle, &characteristics[j]));
+        }
+    }
+    return mock_att_requests_sent() - att_requests;
+}
+
+static uint16_t service_changed_value_handle(void){
+    int i;
+    for (i=0;i<num_characteristics;i++){
+        if (characteristics[i].uuid16 == ORG_BLUETOOTH_CHARACTERISTIC_GATT_SERVICE_CHANGED) return characteristics[i].value_handle;
+    }
+    return 0;
+}
+
+static bd_addr_t device_a = { 0x00, 0x1B, 0xDC, 0x01, 0x02, 0x03 };
+static bd_addr_t device_b = { 0x00, 0x1B, 0xDC, 0x04, 0x05, 0x06 };
+static sm_key_t irk;
+
+TEST_GROUP(GATTClientCache){
+    int le_device_index;
+
+    void setup(void){
+        memset(tlv_entries, 0, sizeof(tlv_entries));
+        le_device_db_init();
+        le_device_index = le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, device_a, irk);
+        mock_simulate_le_device_index(le_device_index);
+        gatt_client_set_cache_storage(&tlv_impl, NULL);
+    }
+
+    void teardown(void){
+        mock_simulate_disconnected();
+        mock_simulate_disconnected_handle(gatt_client_handle_2);
+        mock_simulate_le_device_index(-1);
+    }
+};
+
+TEST(GATTClientCache, ReconnectBondedDevice){
+    int att_requests_uncached = discover_all();
+    CHECK(att_requests_uncached > 0);
+    CHECK(num_services > 0);
+    CHECK(num_characteristics > 0);
+    CHECK(num_descriptors > 0);
+    uint32_t uncached_hash = results_hash;
+    int uncached_num_services = num_services;
+    int uncached_num_characteristics = num_characteristics;
+    int uncached_num_descriptors = num_descriptors;
+
+    mock_simulate_disconnected();
+    CHECK_EQUAL(1, tlv_num_tags());
+
+    int att_requests_cached = discover_all();
+    printf("GATT discovery: %u services, %u characteristics, %u descriptors, ATT round trips %u uncached, %u cached, %u saved\n",
+        num_services, num_characteristics, num_descriptors, att_requests_uncached, att_requests_cached, att_requests_uncached - att_requests_cached);
+    CHECK_EQUAL(0, att_requests_cached);
+    CHECK_EQUAL(uncached_num_services, num_services);
+    CHECK_EQUAL(uncached_num_characteristics, num_characteristics);
+    CHECK_EQUAL(uncached_num_descriptors, num_descriptors);
+    CHECK_EQUAL(uncached_hash, results_hash);
+}
+
+TEST(GATTClientCache, DiscoverServiceByUUID){
+    discover_all();
+    mock_simulate_disconnected();
+
+    int att_requests = mock_att_requests_sent();
+    num_services = 0;
+    start_query();
+    check_query_complete(gatt_client_discover_primary_services_by_uuid16(handle_gatt_client_event, gatt_client_handle, 0xffff));
+    CHECK_EQUAL(2, num_services);
+    CHECK_EQUAL(0xffff, services[0].uuid16);
+
+    num_characteristics = 0;
+    start_query();
+    check_query_complete(gatt_client_discover_characteristics_for_service_by_uuid16(handle_gatt_client_event, gatt_client_handle, &services[0], 0xfffe));
+    CHECK_EQUAL(1, num_characteristics);
+    CHECK_EQUAL(0xfffe, characteristics[0].uuid16);
+    CHECK_EQUAL(0, mock_att_requests_sent() - att_requests);
+}
+
+TEST(GATTClientCache, UnbondedDeviceCachedDuringConnection){
+    mock_simulate_le_device_index(-1);
+    CHECK(discover_all() > 0);
+    CHECK_EQUAL(0, discover_all());
+    mock_simulate_disconnected();
+    CHECK_EQUAL(0, tlv_num_tags());
+    CHECK(discover_all() > 0);
+}
+
+TEST(GATTClientCache, ServiceChangedInvalidatesCache){
+    discover_all();
+    mock_simulate_disconnected();
+    CHECK_EQUAL(0, discover_all());
+
+    uint16_t value_handle = service_changed_value_handle();
+    CHECK(value_handle != 0);
+    uint8_t affected_range[] = { 0x01, 0x00, 0xff, 0xff };
+    mock_simulate_indication(value_handle, affected_range, sizeof(affected_range));
+    CHECK_EQUAL(0, tlv_num_tags());
+
+    CHECK(discover_all() > 0);
+    mock_simulate_disconnected();
+    CHECK_EQUAL(1, tlv_num_tags());
+}
+
+TEST(GATTClientCache, CachedResultsReportedAfterCallReturns){
+    discover_all();
+    mock_simulate_disconnected();
+
+    num_services = 0;
+    start_query();
+    CHECK_EQUAL(0, gatt_client_discover_primary_services(handle_gatt_client_event, gatt_client_handle));
+    CHECK_EQUAL(0, gatt_query_complete);
+    CHECK_EQUAL(0, num_services);
+    CHECK_EQUAL(GATT_CLIENT_IN_WRONG_STATE, gatt_client_discover_primary_services(handle_gatt_client_event, gatt_client_handle));
+    mock_execute_run_loop();
+    CHECK_EQUAL(1, gatt_query_complete);
+    CHECK(num_services > 0);
+}
+
+TEST(GATTClientCache, CachedResultsReportedForAllConnections){
+    discover_all();
+    mock_simulate_disconnected();
+
+    // both connections start a cached discovery in the same run loop iteration
+    num_queries_complete_handle_1 = 0;
+    num_queries_complete_handle_2 = 0;
+    CHECK_EQUAL(0, gatt_client_discover_primary_services(handle_gatt_client_event_count_complete, gatt_client_handle));
+    CHECK_EQUAL(0, gatt_client_discover_primary_services(handle_gatt_client_event_count_complete, gatt_client_handle_2));
+    mock_execute_run_loop();
+    CHECK_EQUAL(1, num_queries_complete_handle_1);
+    CHECK_EQUAL(1, num_queries_complete_handle_2);
+}
+
+TEST(GATTClientCache, OtherIndicationKeepsCache){
+    discover_all();
+    mock_simulate_disconnected();
+
+    uint8_t value[] = { 0x01 };
+    mock_simulate_indication(service_changed_value_handle() + 2, value, sizeof(value));
+    CHECK_EQUAL(1, tlv_num_tags());
+    CHECK_EQUAL(0, discover_all());
+}
+
+TEST(GATTClientCache, AnyIndicationInvalidatesCacheWithoutServiceChanged){
+    // cache primary services only
+    start_query();
+    check_query_complete(gatt_client_discover_primary_services(handle_gatt_client_event, gatt_client_handle));
+    mock_simulate_disconnected();
+    CHECK_EQUAL(1, tlv_num_tags());
+
+    uint8_t value[] = { 0x01 };
+    mock_simulate_indication(0x0010, value, sizeof(value));
+    CHECK_EQUAL(0, tlv_num_tags());
+}
+
+TEST(GATTClientCache, OtherDeviceWithSameIndex){
+    discover_all();
+    mock_simulate_disconnected();
+
+    // bond of device A replaced by device B
+    le_device_db_remove(le_device_index);
+    CHECK_EQUAL(le_device_index, le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, device_b, irk));
+    CHECK(discover_all() > 0);
+}
+
+int main (int argc, const char * argv[]){
+    att_set_db(profile_data);
+    gatt_client_init();
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,228 @@
+// *****************************************************************************
+//
+// test GATT client write stream: Write Without Response commands fill all free ACL buffers
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "ble/gatt_client.h"
+#include "ble/att_db.h"
+#include "profile.h"
+
+void mock_simulate_disconnected(void);
+void mock_simulate_acl_buffers(int num_buffers);
+void mock_simulate_number_of_completed_packets(int num_packets);
+void mock_set_write_command_handler(void (*handler)(uint16_t attribute_handle, const uint8_t * value, uint16_t value_len));
+int  mock_att_requests_sent(void);
+
+static uint16_t gatt_client_handle = 0x40;
+static const uint16_t value_handle = ATT_CHARACTERISTIC_FFFD_01_VALUE_HANDLE;
+
+#define MAX_STREAM_SIZE 65536
+static uint8_t  stream_data[MAX_STREAM_SIZE];
+static uint8_t  received_data[MAX_STREAM_SIZE];
+static uint32_t received_len;
+static int      num_write_commands;
+
+static int      stream_complete;
+static uint8_t  stream_status;
+static int      num_progress_events;
+static uint32_t progress_bytes_sent;
+
+static int      read_complete;
+static int      num_read_results;
+
+static void handle_write_command(uint16_t attribute_handle, const uint8_t * value, uint16_t value_len){
+    CHECK_EQUAL(value_handle, attribute_handle);
+    CHECK(value_len <= ATT_DEFAULT_MTU - 3);
+    CHECK(received_len + value_len <= MAX_STREAM_SIZE);
+    memcpy(&received_data[received_len], value, value_len);
+    received_len += value_len;
+    num_write_commands++;
+}
+
+static void handle_write_stream_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (packet[0]){
+        case GATT_EVENT_WRITE_STREAM_PROGRESS:
+            CHECK_EQUAL(value_handle, little_endian_read_16(packet, 4));
+            // progress is reported after commands have been sent
+            CHECK_EQUAL(received_len, little_endian_read_32(packet, 6));
+            CHECK(little_endian_read_32(packet, 6) > progress_bytes_sent);
+            progress_bytes_sent = little_endian_read_32(packet, 6);
+            num_progress_events++;
+            break;
+        case GATT_EVENT_WRITE_STREAM_COMPLETE:
+            CHECK_EQUAL(gatt_client_handle, little_endian_read_16(packet, 2));
+            stream_status = packet[4];
+            stream_complete = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+static void handle_read_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (packet[0]){
+        case GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT:
+            num_read_results++;
+            break;
+        case GATT_EVENT_QUERY_COMPLETE:
+            CHECK_EQUAL(0, packet[4]);
+            read_complete = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+static void start_stream(uint32_t len){
+    uint32_t i;
+    for (i=0;i<len;i++){
+        stream_data[i] = (uint8_t) (i * 7 + (i >> 8));
+    }
+    received_len = 0;
+    num_write_commands = 0;
+    stream_complete = 0;
+    stream_status = 0xff;
+    num_progress_events = 0;
+    progress_bytes_sent = 0;
+    CHECK_EQUAL(0, gatt_client_write_stream_without_response(&handle_write_stream_event, gatt_client_handle, value_handle, len, stream_data));
+}
+
+// complete all packets sent in each connection event until stream is complete, @returns number of connection events
+static int run_connection_events(int num_buffers){
+    int num_connection_events = 0;
+    while (!stream_complete){
+        CHECK(num_connection_events < MAX_STREAM_SIZE);
+        num_connection_events++;
+        mock_simulate_number_of_completed_packets(num_buffers);
+    }
+    return num_connection_events;
+}
+
+static void check_stream_received(uint32_t len){
+    CHECK_EQUAL(1, stream_complete);
+    CHECK_EQUAL(0, stream_status);
+    CHECK_EQUAL(len, received_len);
+    CHECK_EQUAL(len, progress_bytes_sent);
+    MEMCMP_EQUAL(stream_data, received_data, len);
+}
+
+static uint64_t time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+TEST_GROUP(GATTClientWriteStream){
+    void setup(void){
+        mock_set_write_command_handler(&handle_write_command);
+        // MTU exchange and read with unlimited buffers
+        mock_simulate_acl_buffers(-1);
+        read_complete = 0;
+        CHECK_EQUAL(0, gatt_client_read_value_of_characteristic_using_value_handle(&handle_read_event, gatt_client_handle, ATT_CHARACTERISTIC_GATT_SERVICE_CHANGED_01_VALUE_HANDLE));
+        CHECK_EQUAL(1, read_complete);
+    }
+
+    void teardown(void){
+        mock_simulate_acl_buffers(-1);
+        mock_simulate_disconnected();
+        mock_set_write_command_handler(NULL);
+    }
+};
+
+TEST(GATTClientWriteStream, FillsAllBuffers){
+    const int num_buffers = 4;
+    const uint32_t len = 1000;
+    mock_simulate_acl_buffers(num_buffers);
+    start_stream(len);
+    // commands sent right away
+    CHECK_EQUAL(num_buffers, num_write_commands);
+    CHECK_EQUAL(1, num_progress_events);
+
+    int num_connection_events = run_connection_events(num_buffers);
+    int expected_commands = (len + ATT_DEFAULT_MTU - 4) / (ATT_DEFAULT_MTU - 3);
+    CHECK_EQUAL(expected_commands, num_write_commands);
+    CHECK_EQUAL((expected_commands - 1) / num_buffers, num_connection_events);
+    CHECK_EQUAL(1 + num_connection_events, num_progress_events);
+    check_stream_received(len);
+}
+
+TEST(GATTClientWriteStream, Throughput){
+    const int num_buffers = 8;
+    const uint32_t len = MAX_STREAM_SIZE;
+    mock_simulate_acl_buffers(num_buffers);
+    uint64_t start_ns = time_ns();
+    start_stream(len);
+    int num_connection_events = run_connection_events(num_buffers);
+    uint64_t duration_ns = time_ns() - start_ns;
+    check_stream_received(len);
+
+    printf("GATT write stream: %u bytes in %u Write Commands, %u ACL buffers, %u connection events, %.1f commands per event, %.1f ns per command\n",
+        (unsigned int) len, num_write_commands, num_buffers, num_connection_events + 1, (double) num_write_commands / (num_connection_events + 1), (double) duration_ns / num_write_commands);
+    // every connection event uses all buffers
+    CHECK_EQUAL((num_write_commands - 1) / num_buffers, num_connection_events);
+}
+
+TEST(GATTClientWriteStream, QueryDuringStream){
+    const int num_buffers = 2;
+    const uint32_t len = 400;
+    mock_simulate_acl_buffers(num_buffers);
+    start_stream(len);
+    mock_simulate_number_of_completed_packets(num_buffers);
+
+    // read query is sent before next commands of stream, response arrives immediately with mock
+    read_complete = 0;
+    num_read_results = 0;
+    CHECK_EQUAL(0, gatt_client_read_value_of_characteristic_using_value_handle(&handle_read_event, gatt_client_handle, ATT_CHARACTERISTIC_GATT_SERVICE_CHANGED_01_VALUE_HANDLE));
+    CHECK_EQUAL(0, read_complete);
+    uint32_t received_before_read = received_len;
+    mock_simulate_number_of_completed_packets(num_buffers);
+    CHECK_EQUAL(1, read_complete);
+    CHECK_EQUAL(1, num_read_results);
+    // read request used one of the buffers
+    CHECK_EQUAL(received_before_read + (num_buffers - 1) * (ATT_DEFAULT_MTU - 3), received_len);
+
+    run_connection_events(num_buffers);
+    check_stream_received(len);
+}
+
+TEST(GATTClientWriteStream, SecondStreamAndAbort){
+    mock_simulate_acl_buffers(1);
+    start_stream(100);
+    CHECK_EQUAL(GATT_CLIENT_IN_WRONG_STATE, gatt_client_write_stream_without_response(&handle_write_stream_event, gatt_client_handle, value_handle, 100, stream_data));
+    CHECK_EQUAL(0, gatt_client_write_stream_abort(gatt_client_handle));
+    CHECK_EQUAL(GATT_CLIENT_IN_WRONG_STATE, gatt_client_write_stream_abort(gatt_client_handle));
+    int commands = num_write_commands;
+    mock_simulate_number_of_completed_packets(1);
+    CHECK_EQUAL(commands, num_write_commands);
+    CHECK_EQUAL(0, stream_complete);
+}
+
+TEST(GATTClientWriteStream, Disconnect){
+    mock_simulate_acl_buffers(1);
+    start_stream(100);
+    mock_simulate_disconnected();
+    CHECK_EQUAL(1, stream_complete);
+    CHECK_EQUAL(ATT_ERROR_HCI_DISCONNECT_RECEIVED, stream_status);
+}
+
+int main (int argc, const char * argv[]){
+    att_set_db(profile_data);
+    gatt_client_init();
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
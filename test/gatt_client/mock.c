@@ -15,9 +15,16 @@ static btstack_packet_handler_t att_packet_handler;
 static void (*registered_hci_event_handler) (uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size) = NULL;
 
 static btstack_linked_list_t     connections;
+static btstack_linked_list_t     timers;
 static const uint16_t max_mtu = 23;
 static uint8_t  l2cap_stack_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + 8 + max_mtu];	// pre buffer + HCI Header + L2CAP header
 uint16_t gatt_client_handle = 0x40;
+static int le_device_index = -1;
+static int att_requests_sent;
+// number of free controller ACL buffers, -1 for unlimited
+static int acl_buffers_free = -1;
+static int can_send_now_requested;
+static void (*write_command_handler)(uint16_t attribute_handle, const uint8_t * value, uint16_t value_len);
 
 uint16_t get_gatt_client_handle(void){
 	return gatt_client_handle;
@@ -38,6 +45,48 @@ void mock_simulate_connected(void){
 	registered_hci_event_handler(HCI_EVENT_PACKET, 0, (uint8_t *)&packet, sizeof(packet));
 }
 
+void mock_simulate_disconnected_handle(uint16_t con_handle){
+	uint8_t packet[] = {HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0, (uint8_t) (con_handle & 0xff), (uint8_t) (con_handle >> 8), 0x13};
+	registered_hci_event_handler(HCI_EVENT_PACKET, 0, (uint8_t *)&packet, sizeof(packet));
+}
+
+void mock_simulate_disconnected(void){
+	mock_simulate_disconnected_handle(gatt_client_handle);
+}
+
+void mock_simulate_indication(uint16_t value_handle, const uint8_t * value, uint16_t value_len){
+	uint8_t packet[3 + 20];
+	packet[0] = ATT_HANDLE_VALUE_INDICATION;
+	little_endian_store_16(packet, 1, value_handle);
+	memcpy(&packet[3], value, value_len);
+	att_packet_handler(ATT_DATA_PACKET, gatt_client_handle, &packet[0], 3 + value_len);
+}
+
+void mock_simulate_le_device_index(int index){
+	le_device_index = index;
+}
+
+int mock_att_requests_sent(void){
+	return att_requests_sent;
+}
+
+void mock_simulate_acl_buffers(int num_buffers){
+	acl_buffers_free = num_buffers;
+	can_send_now_requested = 0;
+}
+
+void mock_simulate_number_of_completed_packets(int num_packets){
+	acl_buffers_free += num_packets;
+	if (!can_send_now_requested) return;
+	can_send_now_requested = 0;
+	uint8_t event[] = { L2CAP_EVENT_CAN_SEND_NOW, 2, 1, 0};
+	att_packet_handler(HCI_EVENT_PACKET, 0, (uint8_t*)event, sizeof(event));
+}
+
+void mock_set_write_command_handler(void (*handler)(uint16_t attribute_handle, const uint8_t * value, uint16_t value_len)){
+	write_command_handler = handler;
+}
+
 void mock_simulate_scan_response(void){
 	uint8_t packet[] = {0xE2, 0x13, 0xE2, 0x01, 0x34, 0xB1, 0xF7, 0xD1, 0x77, 0x9B, 0xCC, 0x09, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
 	registered_hci_event_handler(HCI_EVENT_PACKET, 0, (uint8_t *)&packet, sizeof(packet));
@@ -99,10 +148,14 @@ int l2cap_reserve_packet_buffer(void){
 }
 
 int l2cap_can_send_fixed_channel_packet_now(uint16_t handle, uint16_t channel_id){
-	return 1;
+	return acl_buffers_free != 0;
 }
 
 void l2cap_request_can_send_fix_channel_now_event(uint16_t handle, uint16_t channel_id){
+	if (acl_buffers_free == 0){
+		can_send_now_requested = 1;
+		return;
+	}
 	uint8_t event[] = { L2CAP_EVENT_CAN_SEND_NOW, 2, 1, 0};
 	att_packet_handler(HCI_EVENT_PACKET, 0, (uint8_t*)event, sizeof(event));
 }
@@ -111,6 +164,14 @@ int l2cap_send_prepared_connectionless(uint16_t handle, uint16_t cid, uint16_t l
 	att_connection_t att_connection;
 	att_init_connection(&att_connection);
 	uint8_t response[max_mtu];
+	att_requests_sent++;
+	if (acl_buffers_free > 0){
+		acl_buffers_free--;
+	}
+	uint8_t * request = l2cap_get_outgoing_buffer();
+	if (request[0] == ATT_WRITE_COMMAND && write_command_handler){
+		(*write_command_handler)(little_endian_read_16(request, 1), &request[3], len - 3);
+	}
 	uint16_t response_len = att_handle_request(&att_connection, l2cap_get_outgoing_buffer(), len, &response[0]);
 	if (response_len){
 		att_packet_handler(ATT_DATA_PACKET, gatt_client_handle, &response[0], response_len);
@@ -125,22 +186,39 @@ void sm_cmac_signed_write_start(const sm_key_t key, uint8_t opcode, uint16_t att
 	//sm_notify_client(SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED, sm_central_device_addr_type, sm_central_device_address, 0, sm_central_device_matched);      
 }
 int sm_le_device_index(uint16_t handle ){
-	return -1;
+	return le_device_index;
 }
 
 void btstack_run_loop_set_timer(btstack_timer_source_t *a, uint32_t timeout_in_ms){
+	a->timeout = timeout_in_ms;
 }
 
 // Set callback that will be executed when timer expires.
 void btstack_run_loop_set_timer_handler(btstack_timer_source_t *ts, void (*process)(btstack_timer_source_t *_ts)){
+	ts->process = process;
 }
 
 // Add/Remove timer source.
 void btstack_run_loop_add_timer(btstack_timer_source_t *timer){
+	btstack_linked_list_remove(&timers, (btstack_linked_item_t *) timer);
+	btstack_linked_list_add_tail(&timers, (btstack_linked_item_t *) timer);
 }
 
 int  btstack_run_loop_remove_timer(btstack_timer_source_t *timer){
-	return 1;
+	return btstack_linked_list_remove(&timers, (btstack_linked_item_t *) timer);
+}
+
+// fire timers without timeout, e.g. to emit results that are reported from the run loop
+void mock_execute_run_loop(void){
+	btstack_linked_item_t * it = timers;
+	while (it){
+		btstack_timer_source_t * ts = (btstack_timer_source_t *) it;
+		it = it->next;
+		if (ts->timeout != 0) continue;
+		btstack_linked_list_remove(&timers, (btstack_linked_item_t *) ts);
+		ts->process(ts);
+		it = timers;
+	}
 }
 
 // todo:
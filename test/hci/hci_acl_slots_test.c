@@ -0,0 +1,441 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "btstack_defines.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "hci_transport.h"
+
+// fuzzes send / number of completed packets / disconnect sequences and compares free controller
+// buffers reported by hci.c against a model
+
+#define CONTROLLER_ACL_PACKETS      8
+#define CONTROLLER_LE_ACL_PACKETS   5
+#define CONTROLLER_SCO_PACKETS      4
+#define NUM_CONNECTIONS             6
+#define NUM_STEPS                   20000
+
+typedef enum {
+    CONNECTION_CLASSIC,
+    CONNECTION_LE,
+    CONNECTION_SCO,
+} connection_type_t;
+
+typedef struct {
+    connection_type_t type;
+    int               connected;
+    hci_con_handle_t  con_handle;
+    bd_addr_t         address;
+    int               num_packets_sent;
+} test_connection_t;
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+static int      command_pending;
+static uint16_t command_opcode;
+static uint8_t  controller_le_acl_packets;
+static test_connection_t connections[NUM_CONNECTIONS];
+static hci_con_handle_t  next_con_handle;
+static uint32_t random_state;
+
+static uint32_t test_random(void){
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 16;
+}
+
+// dummy synchronous transport
+
+static int dummy_transport_open(void){
+    return 0;
+}
+
+static int dummy_transport_close(void){
+    return 0;
+}
+
+static void dummy_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int dummy_transport_send_packet(uint8_t packet_type, uint8_t *packet, int size){
+    UNUSED(size);
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    command_pending = 1;
+    command_opcode  = little_endian_read_16(packet, 0);
+    return 0;
+}
+
+static const hci_transport_t dummy_transport = {
+    /* const char * name; */                                        "Dummy",
+    /* void   (*init) (const void *transport_config); */            NULL,
+    /* int    (*open)(void); */                                     &dummy_transport_open,
+    /* int    (*close)(void); */                                    &dummy_transport_close,
+    /* void   (*register_packet_handler)(void (*handler)(...); */   &dummy_transport_register_packet_handler,
+    /* int    (*can_send_packet_now)(uint8_t packet_type); */       NULL,
+    /* int    (*send_packet)(...); */                               &dummy_transport_send_packet,
+    /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+    /* void   (*reset_link)(void); */                               NULL,
+    /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+// asynchronous transport with ring of ASYNC_TRANSPORT_SLOTS outgoing ACL buffers that reports packets as sent
+// while send_packet is called
+
+#define ASYNC_TRANSPORT_SLOTS   4
+#define ASYNC_RX_BUFFER_SIZE    10000
+
+static int      async_transport_slots_used;
+static int      async_transport_max_slots_used;
+static int      async_fragments_in_controller;
+static uint8_t  async_rx_buffer[ASYNC_RX_BUFFER_SIZE];
+static int      async_rx_len;
+
+static int async_transport_can_send_packet_now(uint8_t packet_type){
+    if (packet_type != HCI_ACL_DATA_PACKET) return 1;
+    return async_transport_slots_used < ASYNC_TRANSPORT_SLOTS;
+}
+
+static int async_transport_send_packet(uint8_t packet_type, uint8_t *packet, int size){
+    if (packet_type == HCI_ACL_DATA_PACKET){
+        CHECK(async_transport_slots_used < ASYNC_TRANSPORT_SLOTS);
+        uint16_t len = little_endian_read_16(packet, 2);
+        CHECK_EQUAL(size, len + 4);
+        CHECK(async_rx_len + len <= ASYNC_RX_BUFFER_SIZE);
+        memcpy(&async_rx_buffer[async_rx_len], &packet[4], len);
+        async_rx_len += len;
+        async_transport_slots_used++;
+        if (async_transport_slots_used > async_transport_max_slots_used){
+            async_transport_max_slots_used = async_transport_slots_used;
+        }
+        async_fragments_in_controller++;
+    } else {
+        dummy_transport_send_packet(packet_type, packet, size);
+    }
+    // packet was copied, buffer can be reused
+    uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
+    (*hci_packet_handler)(HCI_EVENT_PACKET, event, sizeof(event));
+    return 0;
+}
+
+static void async_transport_complete_transfers(void){
+    async_transport_slots_used = 0;
+    uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
+    (*hci_packet_handler)(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static const hci_transport_t async_transport = {
+    /* const char * name; */                                        "Async",
+    /* void   (*init) (const void *transport_config); */            NULL,
+    /* int    (*open)(void); */                                     &dummy_transport_open,
+    /* int    (*close)(void); */                                    &dummy_transport_close,
+    /* void   (*register_packet_handler)(void (*handler)(...); */   &dummy_transport_register_packet_handler,
+    /* int    (*can_send_packet_now)(uint8_t packet_type); */       &async_transport_can_send_packet_now,
+    /* int    (*send_packet)(...); */                               &async_transport_send_packet,
+    /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+    /* void   (*reset_link)(void); */                               NULL,
+    /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+// controller
+
+static void controller_command_complete(uint16_t opcode){
+    uint8_t event[6 + 64];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    if (opcode == hci_read_local_supported_commands.opcode){
+        // Read Buffer Size supported: octet 14, bit 7
+        event[6 + 14] = 0x80;
+    }
+    if (opcode == hci_read_local_supported_features.opcode){
+        // LE supported: byte 4, bit 6
+        event[6 + 4] = 0x40;
+    }
+    if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 100);
+        event[8] = 60;
+        little_endian_store_16(event, 9, CONTROLLER_ACL_PACKETS);
+        little_endian_store_16(event, 11, CONTROLLER_SCO_PACKETS);
+    }
+    if (opcode == hci_le_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, controller_le_acl_packets ? 27 : 0);
+        event[8] = controller_le_acl_packets;
+    }
+    (*hci_packet_handler)(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_connect(test_connection_t * connection){
+    uint8_t event[21];
+    memset(event, 0, sizeof(event));
+    connection->con_handle = next_con_handle++;
+    connection->connected  = 1;
+    connection->num_packets_sent = 0;
+    switch (connection->type){
+        case CONNECTION_CLASSIC:
+            event[0] = HCI_EVENT_CONNECTION_REQUEST;
+            event[1] = 10;
+            reverse_bd_addr(connection->address, &event[2]);
+            event[11] = 1;
+            (*hci_packet_handler)(HCI_EVENT_PACKET, event, 12);
+            event[0] = HCI_EVENT_CONNECTION_COMPLETE;
+            event[1] = 11;
+            event[2] = 0;
+            little_endian_store_16(event, 3, connection->con_handle);
+            reverse_bd_addr(connection->address, &event[5]);
+            event[11] = 1;
+            event[12] = 0;
+            (*hci_packet_handler)(HCI_EVENT_PACKET, event, 13);
+            break;
+        case CONNECTION_LE:
+            event[0] = HCI_EVENT_LE_META;
+            event[1] = 19;
+            event[2] = HCI_SUBEVENT_LE_CONNECTION_COMPLETE;
+            little_endian_store_16(event, 4, connection->con_handle);
+            event[6] = HCI_ROLE_SLAVE;
+            event[7] = BD_ADDR_TYPE_LE_PUBLIC;
+            reverse_bd_addr(connection->address, &event[8]);
+            (*hci_packet_handler)(HCI_EVENT_PACKET, event, 21);
+            break;
+        case CONNECTION_SCO:
+            event[0] = HCI_EVENT_SYNCHRONOUS_CONNECTION_COMPLETE;
+            event[1] = 17;
+            little_endian_store_16(event, 3, connection->con_handle);
+            reverse_bd_addr(connection->address, &event[5]);
+            (*hci_packet_handler)(HCI_EVENT_PACKET, event, 19);
+            break;
+    }
+}
+
+static void controller_disconnect(test_connection_t * connection){
+    uint8_t event[6] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0, 0, 0, 0x13 };
+    little_endian_store_16(event, 3, connection->con_handle);
+    connection->connected = 0;
+    connection->num_packets_sent = 0;
+    (*hci_packet_handler)(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_complete_packets(test_connection_t * connection, int num_packets){
+    uint8_t event[7] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1 };
+    little_endian_store_16(event, 3, connection->con_handle);
+    little_endian_store_16(event, 5, num_packets);
+    if (num_packets > connection->num_packets_sent){
+        connection->num_packets_sent = 0;
+    } else {
+        connection->num_packets_sent -= num_packets;
+    }
+    (*hci_packet_handler)(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// model
+
+static int packets_sent(connection_type_t type){
+    int num_packets = 0;
+    int i;
+    for (i = 0; i < NUM_CONNECTIONS; i++){
+        if (!connections[i].connected) continue;
+        if (connections[i].type != type) continue;
+        num_packets += connections[i].num_packets_sent;
+    }
+    return num_packets;
+}
+
+static int expected_free_slots(connection_type_t type){
+    switch (type){
+        case CONNECTION_SCO:
+            return CONTROLLER_SCO_PACKETS - packets_sent(CONNECTION_SCO);
+        case CONNECTION_LE:
+            if (controller_le_acl_packets){
+                return controller_le_acl_packets - packets_sent(CONNECTION_LE);
+            }
+            return CONTROLLER_ACL_PACKETS - packets_sent(CONNECTION_CLASSIC) - packets_sent(CONNECTION_LE);
+        default:
+            if (controller_le_acl_packets){
+                return CONTROLLER_ACL_PACKETS - packets_sent(CONNECTION_CLASSIC);
+            }
+            return CONTROLLER_ACL_PACKETS - packets_sent(CONNECTION_CLASSIC) - packets_sent(CONNECTION_LE);
+    }
+}
+
+static void check_free_slots(void){
+    int i;
+    for (i = 0; i < NUM_CONNECTIONS; i++){
+        test_connection_t * connection = &connections[i];
+        if (!connection->connected) continue;
+        int expected = expected_free_slots(connection->type);
+        if (connection->type == CONNECTION_SCO){
+            CHECK_EQUAL(expected > 0, hci_can_send_sco_packet_now());
+        } else {
+            CHECK_EQUAL(expected, hci_number_free_acl_slots_for_handle(connection->con_handle));
+            CHECK_EQUAL(expected > 0, hci_can_send_acl_packet_now(connection->con_handle));
+        }
+    }
+}
+
+static void send_packet(test_connection_t * connection){
+    hci_reserve_packet_buffer();
+    uint8_t * packet = hci_get_outgoing_packet_buffer();
+    little_endian_store_16(packet, 0, connection->con_handle | 0x2000);
+    if (connection->type == CONNECTION_SCO){
+        packet[2] = 3;
+        CHECK_EQUAL(0, hci_send_sco_packet_buffer(6));
+    } else {
+        little_endian_store_16(packet, 2, 8);
+        little_endian_store_16(packet, 4, 4);
+        little_endian_store_16(packet, 6, 0x0040);
+        CHECK_EQUAL(0, hci_send_acl_packet_buffer(12));
+    }
+    connection->num_packets_sent++;
+}
+
+static void fuzz(uint32_t seed){
+    random_state = seed;
+    int step;
+    for (step = 0; step < NUM_STEPS; step++){
+        test_connection_t * connection = &connections[test_random() % NUM_CONNECTIONS];
+        if (!connection->connected){
+            controller_connect(connection);
+            check_free_slots();
+            continue;
+        }
+        uint32_t action = test_random() % 100;
+        if (action < 50){
+            if (expected_free_slots(connection->type) > 0){
+                send_packet(connection);
+            }
+        } else if (action < 90){
+            if (connection->num_packets_sent){
+                controller_complete_packets(connection, 1 + test_random() % connection->num_packets_sent);
+            }
+        } else if (action < 92){
+            // controller reports more packets than sent
+            controller_complete_packets(connection, connection->num_packets_sent + 1);
+        } else {
+            controller_disconnect(connection);
+        }
+        check_free_slots();
+    }
+}
+
+static void setup_connections(void){
+    next_con_handle = 0x0040;
+    command_pending = 0;
+    memset(connections, 0, sizeof(connections));
+    int i;
+    for (i = 0; i < NUM_CONNECTIONS; i++){
+        connections[i].type = (connection_type_t) (i % 3);
+        bd_addr_t address = { 0x00, 0x1b, 0xdc, 0x07, 0x00, 0x00 };
+        address[5] = i;
+        memcpy(connections[i].address, address, 6);
+    }
+}
+
+static void power_on(void){
+    hci_power_control(HCI_POWER_ON);
+    int i;
+    for (i = 0; i < 100 && hci_get_state() != HCI_STATE_WORKING; i++){
+        if (!command_pending) break;
+        command_pending = 0;
+        controller_command_complete(command_opcode);
+    }
+    CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+    controller_command_complete(hci_write_synchronous_flow_control_enable.opcode);
+}
+
+TEST_GROUP(HciAclSlots){
+    void setup(void){
+        btstack_memory_init();
+        hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+        hci_dump_enable_log_level(LOG_LEVEL_ERROR, 0);
+        hci_init(&dummy_transport, NULL);
+        setup_connections();
+    }
+};
+
+TEST(HciAclSlots, SharedLeBuffers){
+    controller_le_acl_packets = 0;
+    power_on();
+    fuzz(1);
+    fuzz(2);
+}
+
+TEST(HciAclSlots, SeparateLeBuffers){
+    controller_le_acl_packets = CONTROLLER_LE_ACL_PACKETS;
+    power_on();
+    fuzz(3);
+    fuzz(4);
+}
+
+TEST_GROUP(HciAsyncTransport){
+    void setup(void){
+        btstack_memory_init();
+        hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+        hci_dump_enable_log_level(LOG_LEVEL_ERROR, 0);
+        hci_init(&async_transport, NULL);
+        setup_connections();
+        async_transport_slots_used = 0;
+        async_transport_max_slots_used = 0;
+        async_fragments_in_controller = 0;
+        async_rx_len = 0;
+        controller_le_acl_packets = 0;
+        power_on();
+    }
+};
+
+// ACL packets are fragmented into controller buffers of 100 bytes, all fragments are delivered in order
+TEST(HciAsyncTransport, PacketSentDuringSend){
+    const int num_packets = 20;
+    const int payload_len = 246;
+    uint8_t expected[num_packets * payload_len];
+    test_connection_t * connection = &connections[0];
+    controller_connect(connection);
+    int num_sent = 0;
+    int step;
+    for (step = 0; step < 1000 && (num_sent < num_packets || async_fragments_in_controller); step++){
+        if (num_sent < num_packets && hci_can_send_acl_packet_now(connection->con_handle)){
+            hci_reserve_packet_buffer();
+            uint8_t * packet = hci_get_outgoing_packet_buffer();
+            little_endian_store_16(packet, 0, connection->con_handle | 0x2000);
+            little_endian_store_16(packet, 2, payload_len);
+            int i;
+            for (i = 0; i < payload_len; i++){
+                packet[4 + i] = (uint8_t) (num_sent * 7 + i);
+            }
+            memcpy(&expected[num_sent * payload_len], &packet[4], payload_len);
+            CHECK_EQUAL(0, hci_send_acl_packet_buffer(4 + payload_len));
+            num_sent++;
+            continue;
+        }
+        if (async_transport_slots_used == ASYNC_TRANSPORT_SLOTS){
+            async_transport_complete_transfers();
+            continue;
+        }
+        if (async_fragments_in_controller){
+            // next fragments are sent while completion is processed
+            int num_fragments = async_fragments_in_controller;
+            async_fragments_in_controller = 0;
+            connection->num_packets_sent = num_fragments;
+            controller_complete_packets(connection, num_fragments);
+            continue;
+        }
+        async_transport_complete_transfers();
+    }
+    CHECK_EQUAL(num_packets, num_sent);
+    CHECK_EQUAL(0, async_fragments_in_controller);
+    CHECK_EQUAL(num_packets * payload_len, async_rx_len);
+    MEMCMP_EQUAL(expected, async_rx_buffer, async_rx_len);
+    // several fragments in transport at the same time
+    CHECK_EQUAL(ASYNC_TRANSPORT_SLOTS, async_transport_max_slots_used);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
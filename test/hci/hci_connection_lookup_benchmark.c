@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  hci_connection_lookup_benchmark.c
+ *
+ *  Routes ACL packets across NUM_CONNECTIONS classic connections through hci.c and measures
+ *  the time per packet. HCI is set up with a dummy transport that accepts all commands,
+ *  connections are created by injecting Connection Request and Connection Complete events.
+ *  For reference, the same handle lookups are done by scanning the connection list.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_defines.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "hci_transport.h"
+
+#define DEFAULT_NUM_PACKETS 1000000
+#define NUM_CONNECTIONS     32
+#define ACL_PAYLOAD_LEN     27
+
+static int num_packets = DEFAULT_NUM_PACKETS;
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+static hci_con_handle_t con_handles[NUM_CONNECTIONS];
+static int      num_routed;
+static uint32_t routed_checksum;
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// dummy transport
+
+static int dummy_transport_open(void){
+    return 0;
+}
+
+static int dummy_transport_close(void){
+    return 0;
+}
+
+static void dummy_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int dummy_transport_send_packet(uint8_t packet_type, uint8_t *packet, int size){
+    UNUSED(packet_type);
+    UNUSED(packet);
+    UNUSED(size);
+    return 0;
+}
+
+static const hci_transport_t dummy_transport = {
+    /* const char * name; */                                        "Dummy",
+    /* void   (*init) (const void *transport_config); */            NULL,
+    /* int    (*open)(void); */                                     &dummy_transport_open,
+    /* int    (*close)(void); */                                    &dummy_transport_close,
+    /* void   (*register_packet_handler)(void (*handler)(...); */   &dummy_transport_register_packet_handler,
+    /* int    (*can_send_packet_now)(uint8_t packet_type); */       NULL,
+    /* int    (*send_packet)(...); */                               &dummy_transport_send_packet,
+    /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+    /* void   (*reset_link)(void); */                               NULL,
+    /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL, 
+};
+
+// host
+
+static void acl_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    if (packet_type != HCI_ACL_DATA_PACKET) return;
+    num_routed++;
+    routed_checksum += READ_ACL_CONNECTION_HANDLE(packet) + size;
+}
+
+static void create_connection(int index){
+    bd_addr_t address = { 0x00, 0x1b, 0xdc, 0x07, 0x00, 0x00 };
+    address[5] = (uint8_t) index;
+    con_handles[index] = 0x0040 + index * 3;
+
+    // Connection Request: address, class of device, ACL link
+    uint8_t request[12];
+    request[0] = HCI_EVENT_CONNECTION_REQUEST;
+    request[1] = sizeof(request) - 2;
+    reverse_bd_addr(address, &request[2]);
+    memset(&request[8], 0, 3);
+    request[11] = 1;
+    (*hci_packet_handler)(HCI_EVENT_PACKET, request, sizeof(request));
+
+    // Connection Complete: status, handle, address, ACL link, no encryption
+    uint8_t complete[13];
+    complete[0] = HCI_EVENT_CONNECTION_COMPLETE;
+    complete[1] = sizeof(complete) - 2;
+    complete[2] = 0;
+    little_endian_store_16(complete, 3, con_handles[index]);
+    reverse_bd_addr(address, &complete[5]);
+    complete[11] = 1;
+    complete[12] = 0;
+    (*hci_packet_handler)(HCI_EVENT_PACKET, complete, sizeof(complete));
+
+    if (!hci_connection_for_handle(con_handles[index])){
+        fprintf(stderr, "connection %u not created\n", index);
+        exit(1);
+    }
+}
+
+static hci_connection_t * connection_for_handle_by_scan(hci_con_handle_t con_handle){
+    btstack_linked_list_iterator_t it;
+    hci_connections_get_iterator(&it);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        hci_connection_t * connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
+        if (connection->con_handle == con_handle) return connection;
+    }
+    return NULL;
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_packets = atoi(argv[1]);
+    }
+
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+    hci_init(&dummy_transport, NULL);
+    hci_register_acl_packet_handler(&acl_packet_handler);
+
+    int i;
+    for (i = 0; i < NUM_CONNECTIONS; i++){
+        create_connection(i);
+    }
+
+    // complete L2CAP packets, first automatically flushable
+    static uint8_t packets[NUM_CONNECTIONS][HCI_ACL_HEADER_SIZE + ACL_PAYLOAD_LEN];
+    for (i = 0; i < NUM_CONNECTIONS; i++){
+        little_endian_store_16(packets[i], 0, con_handles[i] | 0x2000);
+        little_endian_store_16(packets[i], 2, ACL_PAYLOAD_LEN);
+        little_endian_store_16(packets[i], 4, ACL_PAYLOAD_LEN - 4);
+        little_endian_store_16(packets[i], 6, 0x0040);
+    }
+
+    // pseudo-random connection order
+    uint32_t seed = 1;
+    uint8_t * order = (uint8_t *) malloc(num_packets);
+    for (i = 0; i < num_packets; i++){
+        seed = seed * 1103515245 + 12345;
+        order[i] = (seed >> 16) % NUM_CONNECTIONS;
+    }
+
+    uint64_t start_ns = benchmark_time_ns();
+    for (i = 0; i < num_packets; i++){
+        uint8_t * packet = packets[order[i]];
+        (*hci_packet_handler)(HCI_ACL_DATA_PACKET, packet, HCI_ACL_HEADER_SIZE + ACL_PAYLOAD_LEN);
+    }
+    uint64_t route_ns = benchmark_time_ns() - start_ns;
+    if (num_routed != num_packets){
+        fprintf(stderr, "routed %u of %u packets\n", num_routed, num_packets);
+        return 1;
+    }
+
+    // handle and address lookups alone
+    uint32_t checksum = 0;
+    start_ns = benchmark_time_ns();
+    for (i = 0; i < num_packets; i++){
+        checksum += hci_connection_for_handle(con_handles[order[i]])->con_handle;
+    }
+    uint64_t handle_ns = benchmark_time_ns() - start_ns;
+
+    start_ns = benchmark_time_ns();
+    for (i = 0; i < num_packets; i++){
+        bd_addr_t address = { 0x00, 0x1b, 0xdc, 0x07, 0x00, 0x00 };
+        address[5] = order[i];
+        checksum += hci_connection_for_bd_addr_and_type(address, BD_ADDR_TYPE_CLASSIC)->con_handle;
+    }
+    uint64_t address_ns = benchmark_time_ns() - start_ns;
+
+    start_ns = benchmark_time_ns();
+    for (i = 0; i < num_packets; i++){
+        checksum += connection_for_handle_by_scan(con_handles[order[i]])->con_handle;
+    }
+    uint64_t scan_ns = benchmark_time_ns() - start_ns;
+
+    printf("%u ACL packets across %u connections (checksum %08x)\n", num_packets, NUM_CONNECTIONS, routed_checksum ^ checksum);
+    printf("route ACL packet:         %6.1f ns/packet\n", (double) route_ns / num_packets);
+    printf("lookup by handle:         %6.1f ns/lookup\n", (double) handle_ns / num_packets);
+    printf("lookup by address:        %6.1f ns/lookup\n", (double) address_ns / num_packets);
+    printf("lookup by list scan:      %6.1f ns/lookup\n", (double) scan_ns / num_packets);
+    free(order);
+    return 0;
+}
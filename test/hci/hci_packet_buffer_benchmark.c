@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  hci_packet_buffer_benchmark.c
+ *
+ *  Measures link utilization for a bulk ACL transfer with MAX_NR_HCI_OUTGOING_PACKET_BUFFERS
+ *  outgoing packet buffers. The H4 transport talks to a fake controller on a pseudo terminal.
+ *  The UART driver is wrapped to report a sent block only after its time on the wire, like a DMA
+ *  driver at BENCHMARK_UART_BAUDRATE, and the application spends BENCHMARK_PREPARE_US on each
+ *  packet before it passes it to HCI. With a single buffer, the UART is idle while the next packet
+ *  is prepared. With multiple buffers, the next packet is prepared while the UART is busy.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack_defines.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_uart_block.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "hci_transport.h"
+
+#define DEFAULT_NUM_PACKETS         200
+#define BENCHMARK_ACL_PAYLOAD_LEN   1021
+#define BENCHMARK_UART_BAUDRATE     921600
+#define BENCHMARK_PREPARE_US        3000
+#define CONTROLLER_NUM_ACL_PACKETS  8
+
+static int num_packets = DEFAULT_NUM_PACKETS;
+
+// host
+static btstack_uart_block_t   uart_driver;
+static hci_transport_config_uart_t transport_config;
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static void (*uart_block_sent)(void);
+static btstack_timer_source_t uart_wire_timer;
+static int      uart_wire_pending;
+static int      uart_write_pending;
+static uint64_t uart_wire_done_us;
+static uint64_t uart_wire_busy_us;
+static hci_con_handle_t con_handle = HCI_CON_HANDLE_INVALID;
+static int      create_connection;
+static int      num_sent;
+static int      num_completed;
+static uint64_t start_us;
+
+static uint64_t benchmark_time_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// fake controller
+
+static void controller_send(int fd, const uint8_t * data, int len){
+    int pos = 0;
+    while (pos < len){
+        int res = write(fd, &data[pos], len - pos);
+        if (res > 0) {
+            pos += res;
+        } else if (res < 0 && errno != EAGAIN && errno != EINTR){
+            fprintf(stderr, "controller: write failed, errno %d\n", errno);
+            exit(1);
+        } else {
+            usleep(100);
+        }
+    }
+}
+
+static void controller_handle_command(int fd, const uint8_t * command){
+    uint16_t opcode = little_endian_read_16(command, 0);
+    uint8_t event[4 + HCI_EVENT_PAYLOAD_SIZE];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_PACKET;
+    if (opcode == hci_create_connection.opcode){
+        // command status
+        event[1] = HCI_EVENT_COMMAND_STATUS;
+        event[2] = 4;
+        event[4] = 1;
+        little_endian_store_16(event, 5, opcode);
+        controller_send(fd, event, 7);
+        // connection complete: status, handle, address, ACL link, no encryption
+        event[1] = HCI_EVENT_CONNECTION_COMPLETE;
+        event[2] = 11;
+        event[3] = 0;
+        little_endian_store_16(event, 4, 0x0001);
+        memcpy(&event[6], &command[3], 6);
+        event[12] = 1;
+        event[13] = 0;
+        controller_send(fd, event, 14);
+        return;
+    }
+    // command complete with zeroed return parameters
+    event[1] = HCI_EVENT_COMMAND_COMPLETE;
+    event[2] = 3 + 1 + 64;
+    event[3] = 1;
+    little_endian_store_16(event, 4, opcode);
+    if (opcode == hci_read_local_supported_commands.opcode){
+        // Read Buffer Size supported: octet 14, bit 7
+        event[7 + 14] = 0x80;
+    }
+    if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 7, BENCHMARK_ACL_PAYLOAD_LEN);
+        little_endian_store_16(event, 10, CONTROLLER_NUM_ACL_PACKETS);
+    }
+    controller_send(fd, event, 3 + event[2]);
+}
+
+static void controller_run(int fd){
+    uint8_t buffer[1 + HCI_ACL_HEADER_SIZE + HCI_ACL_PAYLOAD_SIZE];
+    int len = 0;
+    while (1){
+        // read packet type and header, then payload
+        int header_size = 0;
+        int payload_size = 0;
+        if (len > 0){
+            header_size = buffer[0] == HCI_ACL_DATA_PACKET ? HCI_ACL_HEADER_SIZE : 3;
+            if (len >= 1 + header_size){
+                payload_size = buffer[0] == HCI_ACL_DATA_PACKET ? little_endian_read_16(buffer, 3) : buffer[3];
+            }
+        }
+        int needed = len == 0 ? 1 : (len < 1 + header_size ? 1 + header_size : 1 + header_size + payload_size);
+        if (len < needed){
+            int res = read(fd, &buffer[len], needed - len);
+            if (res > 0) {
+                len += res;
+            } else if (res == 0 || errno == EIO){
+                exit(0);
+            } else if (errno != EAGAIN && errno != EINTR){
+                fprintf(stderr, "controller: read failed, errno %d\n", errno);
+                exit(1);
+            } else {
+                usleep(100);
+            }
+            continue;
+        }
+        switch (buffer[0]){
+            case HCI_COMMAND_DATA_PACKET:
+                controller_handle_command(fd, &buffer[1]);
+                break;
+            case HCI_ACL_DATA_PACKET: {
+                // ACL packets leave the controller buffer right away
+                uint8_t event[] = { HCI_EVENT_PACKET, HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 1, 0};
+                little_endian_store_16(event, 4, little_endian_read_16(buffer, 1) & 0x0fff);
+                controller_send(fd, event, sizeof(event));
+                break;
+            }
+            default:
+                fprintf(stderr, "controller: unexpected packet type %u\n", buffer[0]);
+                exit(1);
+        }
+        len = 0;
+    }
+}
+
+// host
+
+// block is sent when the posix driver has written it and its time on the wire has elapsed
+static void host_uart_check_block_sent(void){
+    if (uart_wire_pending || uart_write_pending) return;
+    (*uart_block_sent)();
+}
+
+static void host_uart_wire_done(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    uart_wire_pending = 0;
+    host_uart_check_block_sent();
+}
+
+static void host_uart_write_done(void){
+    uart_write_pending = 0;
+    host_uart_check_block_sent();
+}
+
+static void host_set_block_sent(void (*handler)(void)){
+    uart_block_sent = handler;
+}
+
+static void host_send_block(const uint8_t * data, uint16_t size){
+    // emulate time on the wire, 10 bits per byte
+    uint64_t now_us = benchmark_time_us();
+    uint64_t wire_us = size * 10ULL * 1000000ULL / BENCHMARK_UART_BAUDRATE;
+    uart_wire_done_us = (now_us > uart_wire_done_us ? now_us : uart_wire_done_us) + wire_us;
+    if (con_handle != HCI_CON_HANDLE_INVALID){
+        uart_wire_busy_us += wire_us;
+    }
+    uart_wire_pending  = 1;
+    uart_write_pending = 1;
+    btstack_uart_block_posix_instance()->send_block(data, size);
+    btstack_run_loop_set_timer(&uart_wire_timer, (uart_wire_done_us - now_us + 999) / 1000);
+    btstack_run_loop_set_timer_handler(&uart_wire_timer, &host_uart_wire_done);
+    btstack_run_loop_add_timer(&uart_wire_timer);
+}
+
+static void host_prepare_packet(uint8_t * packet, int packet_nr){
+    little_endian_store_16(packet, 0, con_handle | 0x2000);     // first automatically flushable packet
+    little_endian_store_16(packet, 2, BENCHMARK_ACL_PAYLOAD_LEN);
+    int pos;
+    for (pos = 0; pos < BENCHMARK_ACL_PAYLOAD_LEN; pos++){
+        packet[HCI_ACL_HEADER_SIZE + pos] = (uint8_t) (packet_nr * 7 + pos);
+    }
+    // e.g. encoding or encryption
+    uint64_t done_us = benchmark_time_us() + BENCHMARK_PREPARE_US;
+    while (benchmark_time_us() < done_us);
+}
+
+static void host_send_packets(void){
+    while (num_sent < num_packets && hci_can_send_acl_packet_now(con_handle)){
+        hci_reserve_packet_buffer();
+        uint8_t * packet = hci_get_outgoing_packet_buffer();
+        host_prepare_packet(packet, num_sent);
+        hci_send_acl_packet_buffer(HCI_ACL_HEADER_SIZE + BENCHMARK_ACL_PAYLOAD_LEN);
+        num_sent++;
+    }
+}
+
+static void host_report(void){
+    uint64_t delta_us = benchmark_time_us() - start_us;
+    printf("%u packet buffer(s): %6.1f packets/s, link utilization %5.1f%%\n", MAX_NR_HCI_OUTGOING_PACKET_BUFFERS,
+        num_packets * 1e6 / delta_us, 100.0 * uart_wire_busy_us / delta_us);
+    exit(0);
+}
+
+static void host_create_connection(void){
+    bd_addr_t address = { 0x00, 0x1b, 0xdc, 0x00, 0x00, 0x01 };
+    if (!create_connection) return;
+    if (!hci_can_send_command_packet_now()) return;
+    create_connection = 0;
+    hci_send_cmd(&hci_create_connection, address, hci_usable_acl_packet_types(), 0, 0, 0, 1);
+}
+
+static void host_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case BTSTACK_EVENT_STATE:
+            if (btstack_event_state_get_state(packet) != HCI_STATE_WORKING) break;
+            create_connection = 1;
+            host_create_connection();
+            break;
+        case HCI_EVENT_CONNECTION_COMPLETE:
+            con_handle = hci_event_connection_complete_get_connection_handle(packet);
+            start_us = benchmark_time_us();
+            host_send_packets();
+            break;
+        case HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS:
+            num_completed += little_endian_read_16(packet, 5);
+            if (num_completed == num_packets){
+                host_report();
+            }
+            host_send_packets();
+            break;
+        case HCI_EVENT_TRANSPORT_PACKET_SENT:
+            if (con_handle == HCI_CON_HANDLE_INVALID){
+                host_create_connection();
+                break;
+            }
+            host_send_packets();
+            break;
+        default:
+            break;
+    }
+}
+
+static void host_run(const char * device_name){
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+
+    // wrap posix driver to emulate time on the wire
+    uart_driver = *btstack_uart_block_posix_instance();
+    uart_driver.set_block_sent = &host_set_block_sent;
+    uart_driver.send_block     = &host_send_block;
+    btstack_uart_block_posix_instance()->set_block_sent(&host_uart_write_done);
+
+    transport_config.type = HCI_TRANSPORT_CONFIG_UART;
+    transport_config.baudrate_init = BENCHMARK_UART_BAUDRATE;
+    transport_config.device_name = device_name;
+    hci_init(hci_transport_h4_instance(&uart_driver), &transport_config);
+    hci_event_callback_registration.callback = &host_packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hci_power_control(HCI_POWER_ON);
+    btstack_run_loop_execute();
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_packets = atoi(argv[1]);
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)){
+        fprintf(stderr, "pseudo terminal not available, errno %d\n", errno);
+        return 1;
+    }
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    pid_t controller = fork();
+    if (controller == 0){
+        controller_run(master);
+    }
+    const char * slave_name = ptsname(master);
+    pid_t host = fork();
+    if (host == 0){
+        close(master);
+        host_run(slave_name);
+    }
+    int host_status;
+    waitpid(host, &host_status, 0);
+    close(master);
+    kill(controller, SIGTERM);
+    waitpid(controller, NULL, 0);
+    return !WIFEXITED(host_status) || WEXITSTATUS(host_status) != 0;
+}
@@ -0,0 +1,22 @@
+//
+// btstack_config.h for hci_dump benchmark
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_POSIX_TIME
+#define HAVE_POSIX_FILE_IO
+
+// BTstack features that can be enabled
+#define ENABLE_LOG_ERROR
+#define ENABLE_LOG_INFO
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 1021
+
+// HCI_DUMP_BUFFER_SIZE is set by Makefile
+
+#endif
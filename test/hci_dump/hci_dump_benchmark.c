@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  hci_dump_benchmark.c
+ *
+ *  Measures the time spent in hci_dump_packet for ACL packets of HCI_ACL_PAYLOAD_SIZE bytes logged in
+ *  PacketLogger format. hci_dump_flush is called every FLUSH_PACKETS packets, as the flush timer would
+ *  during a transfer. Built without HCI_DUMP_BUFFER_SIZE, each packet is written with two write calls.
+ *  With HCI_DUMP_BUFFER_SIZE, packets are copied into a ring buffer and written in batches.
+ *  Also verifies the written files, rotation by file size, and, with a buffer, dropped packets.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_config.h"
+#include "btstack_defines.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci_dump.h"
+
+#define DEFAULT_NUM_PACKETS     100000
+#define FLUSH_PACKETS           16
+#define PKTLOG_HDR_SIZE         13
+#define RECORD_SIZE             (PKTLOG_HDR_SIZE + HCI_ACL_PAYLOAD_SIZE)
+#define DUMP_FILE               "hci_dump_benchmark.pklg"
+#define ROTATION_FILE_SIZE      (64 * 1024)
+#define ROTATION_NUM_FILES      3
+#define ROTATION_NUM_PACKETS    500
+
+static int num_packets = DEFAULT_NUM_PACKETS;
+static uint8_t packet[HCI_ACL_PAYLOAD_SIZE];
+
+typedef struct {
+    int valid;
+    long size;
+    int num_packets;
+    int num_notes;
+    char last_note[80];
+} dump_file_info_t;
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// parse PacketLogger file, returns info with valid = 0 if file is missing or a record is truncated or unexpected
+static dump_file_info_t read_dump_file(const char * name){
+    dump_file_info_t info;
+    memset(&info, 0, sizeof(info));
+    FILE * file = fopen(name, "rb");
+    if (!file) return info;
+    fseek(file, 0, SEEK_END);
+    info.size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t * data = (uint8_t *) malloc(info.size);
+    size_t read = fread(data, 1, info.size, file);
+    fclose(file);
+    if ((long) read != info.size){
+        free(data);
+        return info;
+    }
+    info.valid = 1;
+    long pos = 0;
+    while (pos < info.size){
+        if (pos + 4 > info.size){
+            info.valid = 0;
+            break;
+        }
+        uint32_t len = big_endian_read_32(data, pos);
+        if (len < PKTLOG_HDR_SIZE - 4 || pos + 4 + (long) len > info.size){
+            info.valid = 0;
+            break;
+        }
+        uint8_t type = data[pos + 12];
+        uint32_t payload_len = len - (PKTLOG_HDR_SIZE - 4);
+        if (type == 0xfc){
+            info.num_notes++;
+            uint32_t note_len = btstack_min(payload_len, sizeof(info.last_note) - 1);
+            memcpy(info.last_note, &data[pos + PKTLOG_HDR_SIZE], note_len);
+            info.last_note[note_len] = 0;
+        } else if ((type == 0x02 || type == 0x03) && payload_len == HCI_ACL_PAYLOAD_SIZE){
+            info.num_packets++;
+        } else {
+            info.valid = 0;
+            break;
+        }
+        pos += 4 + len;
+    }
+    free(data);
+    return info;
+}
+
+static void dump_packets(int count){
+    int i;
+    for (i = 0; i < count; i++){
+        hci_dump_packet(HCI_ACL_DATA_PACKET, i & 1, packet, sizeof(packet));
+        if ((i % FLUSH_PACKETS) == FLUSH_PACKETS - 1){
+            hci_dump_flush();
+        }
+    }
+}
+
+static int run_throughput(void){
+    remove(DUMP_FILE);
+    hci_dump_open(DUMP_FILE, HCI_DUMP_PACKETLOGGER);
+    uint64_t start_ns = benchmark_time_ns();
+    dump_packets(num_packets);
+    hci_dump_flush();
+    uint64_t duration_ns = benchmark_time_ns() - start_ns;
+    hci_dump_close();
+
+    printf("%u packets: %8.1f ns/packet, %7.1f MB/s\n", num_packets, (double) duration_ns / num_packets,
+        (double) num_packets * RECORD_SIZE * 1000.0 / duration_ns);
+
+    dump_file_info_t info = read_dump_file(DUMP_FILE);
+    if (!info.valid || info.num_packets != num_packets){
+        fprintf(stderr, "throughput: %u of %u packets in file\n", info.num_packets, num_packets);
+        return 0;
+    }
+    return 1;
+}
+
+static int run_rotation(void){
+    char name[40];
+    int i;
+    for (i = 0; i <= ROTATION_NUM_FILES; i++){
+        snprintf(name, sizeof(name), i ? "%s.%u" : "%s", DUMP_FILE, i);
+        remove(name);
+    }
+
+    hci_dump_open(DUMP_FILE, HCI_DUMP_PACKETLOGGER);
+    hci_dump_set_max_file_size(ROTATION_FILE_SIZE, ROTATION_NUM_FILES);
+    dump_packets(ROTATION_NUM_PACKETS);
+    hci_dump_close();
+    hci_dump_set_max_file_size(0, 1);
+
+    int ok = 1;
+    int packets_per_file = ROTATION_FILE_SIZE / RECORD_SIZE;
+    for (i = 0; i < ROTATION_NUM_FILES; i++){
+        snprintf(name, sizeof(name), i ? "%s.%u" : "%s", DUMP_FILE, i);
+        dump_file_info_t info = read_dump_file(name);
+        if (!info.valid || info.size > ROTATION_FILE_SIZE || (i && info.num_packets != packets_per_file)){
+            fprintf(stderr, "rotation: %s invalid, %ld bytes, %u packets\n", name, info.size, info.num_packets);
+            ok = 0;
+        }
+    }
+    snprintf(name, sizeof(name), "%s.%u", DUMP_FILE, ROTATION_NUM_FILES);
+    if (read_dump_file(name).valid){
+        fprintf(stderr, "rotation: %s not removed\n", name);
+        ok = 0;
+    }
+    printf("rotation: %s\n", ok ? "ok" : "failed");
+    return ok;
+}
+
+#ifdef HCI_DUMP_BUFFER_SIZE
+// overflow buffer without flush, dropped packets are reported before the next stored packet
+static int run_drop(void){
+    int num_dropped_before = hci_dump_get_nr_packets_dropped();
+    int num_stored   = HCI_DUMP_BUFFER_SIZE / RECORD_SIZE;
+    int num_overflow = 2 * num_stored;
+
+    remove(DUMP_FILE);
+    hci_dump_open(DUMP_FILE, HCI_DUMP_PACKETLOGGER);
+    int i;
+    for (i = 0; i < num_overflow; i++){
+        hci_dump_packet(HCI_ACL_DATA_PACKET, 1, packet, sizeof(packet));
+    }
+    int num_dropped = hci_dump_get_nr_packets_dropped() - num_dropped_before;
+    hci_dump_flush();
+    hci_dump_packet(HCI_ACL_DATA_PACKET, 1, packet, sizeof(packet));
+    hci_dump_close();
+
+    char expected_note[80];
+    snprintf(expected_note, sizeof(expected_note), "hci_dump: %u packets dropped", num_overflow - num_stored);
+    dump_file_info_t info = read_dump_file(DUMP_FILE);
+    int ok = info.valid && num_dropped == num_overflow - num_stored && info.num_packets == num_stored + 1
+        && info.num_notes == 1 && strcmp(info.last_note, expected_note) == 0;
+    printf("drop: %u packets dropped, note '%s': %s\n", num_dropped, info.last_note, ok ? "ok" : "failed");
+    return ok;
+}
+#endif
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_packets = atoi(argv[1]);
+    }
+
+    // flush timer of buffered hci_dump requires run loop
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+
+    int i;
+    for (i = 0; i < HCI_ACL_PAYLOAD_SIZE; i++){
+        packet[i] = (uint8_t) i;
+    }
+
+#ifdef HCI_DUMP_BUFFER_SIZE
+    printf("hci_dump with %u byte buffer, flush every %u packets\n", HCI_DUMP_BUFFER_SIZE, FLUSH_PACKETS);
+#else
+    printf("hci_dump without buffer\n");
+#endif
+
+    int ok = run_throughput();
+    ok &= run_rotation();
+#ifdef HCI_DUMP_BUFFER_SIZE
+    ok &= run_drop();
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+//
+// btstack_config.h for H2 libusb transport benchmark
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_POSIX_TIME
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 1021
+#define HCI_INCOMING_PRE_BUFFER_SIZE 4
+
+// simulated dongle is opened by vendor and product id
+#define USB_VENDOR_ID  0x0a12
+#define USB_PRODUCT_ID 0x0001
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  hci_transport_h2_libusb_benchmark.c
+ *
+ *  Measures ACL packets/s of the libusb H2 transport with ACL_OUT_BUFFER_COUNT outgoing bulk
+ *  transfers. libusb is replaced by a simulated dongle (libusb_shim.c) that moves bulk-out
+ *  transfers over a Full Speed bus and reports their completion BENCHMARK_COMPLETION_LATENCY_US
+ *  later. The run loop uses simulated time, so the transport polls libusb every
+ *  ASYNC_POLLING_INTERVAL_MS like on a real system. The packet buffer is overwritten after each
+ *  send and the dongle checks that all packets arrive intact and in order.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libusb.h>
+
+#include "btstack_defines.h"
+#include "btstack_linked_list.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+
+#define DEFAULT_NUM_PACKETS               20000
+#define BENCHMARK_ACL_PAYLOAD_LEN         251
+#define BENCHMARK_BUS_NS_PER_BYTE         800
+#define BENCHMARK_COMPLETION_LATENCY_US   250
+
+static int num_packets = DEFAULT_NUM_PACKETS;
+
+static const hci_transport_t * transport;
+static int      num_sent;
+static int      num_packets_sent_events;
+static int      num_received;
+static uint32_t received_checksum = 2166136261u;
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint8_t acl_payload(int packet_nr, int pos){
+    return (uint8_t) (packet_nr * 7 + pos);
+}
+
+// run loop with simulated time
+
+static btstack_linked_list_t timers;
+
+static void virtual_run_loop_init(void){
+    timers = NULL;
+}
+
+static uint32_t virtual_run_loop_get_time_ms(void){
+    return (uint32_t) (libusb_shim_get_time_us() / 1000);
+}
+
+static void virtual_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = virtual_run_loop_get_time_ms() + timeout_in_ms;
+}
+
+static void virtual_run_loop_add_timer(btstack_timer_source_t * ts){
+    btstack_linked_item_t * it;
+    for (it = (btstack_linked_item_t *) &timers; it->next; it = it->next){
+        if (ts->timeout < ((btstack_timer_source_t *) it->next)->timeout) break;
+    }
+    ts->item.next = it->next;
+    it->next = (btstack_linked_item_t *) ts;
+}
+
+static int virtual_run_loop_remove_timer(btstack_timer_source_t * ts){
+    return btstack_linked_list_remove(&timers, (btstack_linked_item_t *) ts);
+}
+
+static void virtual_run_loop_add_data_source(btstack_data_source_t * ds){
+    UNUSED(ds);
+}
+
+static int virtual_run_loop_remove_data_source(btstack_data_source_t * ds){
+    UNUSED(ds);
+    return 0;
+}
+
+static void virtual_run_loop_enable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callbacks){
+    UNUSED(ds);
+    UNUSED(callbacks);
+}
+
+static void virtual_run_loop_disable_data_source_callbacks(btstack_data_source_t * ds, uint16_t callbacks){
+    UNUSED(ds);
+    UNUSED(callbacks);
+}
+
+static void virtual_run_loop_dump_timer(void){
+}
+
+// advance time to first timer and process it
+static void virtual_run_loop_process_next_timer(void){
+    btstack_timer_source_t * ts = (btstack_timer_source_t *) timers;
+    if (!ts){
+        fprintf(stderr, "no timer active\n");
+        exit(1);
+    }
+    btstack_linked_list_remove(&timers, (btstack_linked_item_t *) ts);
+    uint64_t timeout_us = ((uint64_t) ts->timeout) * 1000;
+    if (timeout_us > libusb_shim_get_time_us()){
+        libusb_shim_set_time_us(timeout_us);
+    }
+    ts->process(ts);
+}
+
+static void virtual_run_loop_execute(void){
+    while (timers){
+        virtual_run_loop_process_next_timer();
+    }
+}
+
+static const btstack_run_loop_t virtual_run_loop = {
+    &virtual_run_loop_init,
+    &virtual_run_loop_add_data_source,
+    &virtual_run_loop_remove_data_source,
+    &virtual_run_loop_enable_data_source_callbacks,
+    &virtual_run_loop_disable_data_source_callbacks,
+    &virtual_run_loop_set_timer,
+    &virtual_run_loop_add_timer,
+    &virtual_run_loop_remove_timer,
+    &virtual_run_loop_execute,
+    &virtual_run_loop_dump_timer,
+    &virtual_run_loop_get_time_ms,
+};
+
+// dongle
+
+static void dongle_handle_bulk_out(const uint8_t * data, int size){
+    if (size != HCI_ACL_HEADER_SIZE + BENCHMARK_ACL_PAYLOAD_LEN
+     || little_endian_read_16(data, 0) != 0x2001
+     || little_endian_read_16(data, 2) != BENCHMARK_ACL_PAYLOAD_LEN){
+        fprintf(stderr, "dongle: packet %u has invalid header\n", num_received);
+        exit(1);
+    }
+    int pos;
+    for (pos = 0; pos < BENCHMARK_ACL_PAYLOAD_LEN; pos++){
+        if (data[HCI_ACL_HEADER_SIZE + pos] != acl_payload(num_received, pos)){
+            fprintf(stderr, "dongle: packet %u corrupted or out of order\n", num_received);
+            exit(1);
+        }
+    }
+    for (pos = 0; pos < size; pos++){
+        received_checksum = (received_checksum ^ data[pos]) * 16777619u;
+    }
+    num_received++;
+}
+
+// host
+
+static void packet_handler(uint8_t packet_type, uint8_t *packet, uint16_t size){
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (packet[0] != HCI_EVENT_TRANSPORT_PACKET_SENT) return;
+    num_packets_sent_events++;
+}
+
+static void send_packets(void){
+    static uint8_t packet[HCI_ACL_HEADER_SIZE + BENCHMARK_ACL_PAYLOAD_LEN];
+    while (num_sent < num_packets && transport->can_send_packet_now(HCI_ACL_DATA_PACKET)){
+        little_endian_store_16(packet, 0, 0x2001);
+        little_endian_store_16(packet, 2, BENCHMARK_ACL_PAYLOAD_LEN);
+        int pos;
+        for (pos = 0; pos < BENCHMARK_ACL_PAYLOAD_LEN; pos++){
+            packet[HCI_ACL_HEADER_SIZE + pos] = acl_payload(num_sent, pos);
+        }
+        if (transport->send_packet(HCI_ACL_DATA_PACKET, packet, sizeof(packet))){
+            fprintf(stderr, "send_packet failed for packet %u\n", num_sent);
+            exit(1);
+        }
+        num_sent++;
+        // packet buffer can be used again after send_packet
+        memset(packet, 0xff, sizeof(packet));
+    }
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_packets = atoi(argv[1]);
+    }
+
+    btstack_run_loop_init(&virtual_run_loop);
+    libusb_shim_set_bulk_out_timing(BENCHMARK_BUS_NS_PER_BYTE, BENCHMARK_COMPLETION_LATENCY_US);
+    libusb_shim_register_bulk_out_handler(&dongle_handle_bulk_out);
+
+    transport = hci_transport_usb_instance();
+    transport->register_packet_handler(&packet_handler);
+    if (transport->open()){
+        fprintf(stderr, "transport open failed\n");
+        return 1;
+    }
+
+    uint64_t start_us = libusb_shim_get_time_us();
+    uint64_t start_ns = benchmark_time_ns();
+    while (num_received < num_packets){
+        send_packets();
+        virtual_run_loop_process_next_timer();
+    }
+    uint64_t duration_us = libusb_shim_get_time_us() - start_us;
+    uint64_t cpu_ns = benchmark_time_ns() - start_ns;
+
+    transport->close();
+
+    if (num_packets_sent_events < num_packets){
+        fprintf(stderr, "only %u of %u packets reported as sent\n", num_packets_sent_events, num_packets);
+        return 1;
+    }
+
+    double packets_per_second = (double) num_packets * 1000000.0 / (double) duration_us;
+    printf("H2 libusb: %u ACL packets with %u bytes, %u bulk-out transfers, max %u in flight: %.0f packets/s, %.1f kB/s, %.1f ns CPU per packet, checksum %08x\n",
+        num_packets, BENCHMARK_ACL_PAYLOAD_LEN, ACL_OUT_BUFFER_COUNT, libusb_shim_get_max_bulk_out_in_flight(),
+        packets_per_second, packets_per_second * BENCHMARK_ACL_PAYLOAD_LEN / 1000.0, (double) cpu_ns / num_packets, received_checksum);
+    return 0;
+}
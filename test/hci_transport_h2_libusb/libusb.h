@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  libusb.h
+ *
+ *  Subset of the libusb-1.0 API used by hci_transport_h2_libusb.c, implemented by libusb_shim.c
+ *  with a simulated Bluetooth dongle.
+ */
+
+#ifndef __LIBUSB_SHIM_H
+#define __LIBUSB_SHIM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#define LIBUSB_CALL
+
+#define LIBUSB_CONTROL_SETUP_SIZE 8
+
+enum libusb_error {
+    LIBUSB_SUCCESS             =   0,
+    LIBUSB_ERROR_IO            =  -1,
+    LIBUSB_ERROR_INVALID_PARAM =  -2,
+    LIBUSB_ERROR_NOT_FOUND     =  -5,
+    LIBUSB_ERROR_BUSY          =  -6,
+    LIBUSB_ERROR_NO_MEM        = -11,
+};
+
+enum libusb_log_level {
+    LIBUSB_LOG_LEVEL_NONE = 0,
+    LIBUSB_LOG_LEVEL_ERROR,
+    LIBUSB_LOG_LEVEL_WARNING,
+    LIBUSB_LOG_LEVEL_INFO,
+    LIBUSB_LOG_LEVEL_DEBUG,
+};
+
+enum libusb_transfer_type {
+    LIBUSB_TRANSFER_TYPE_CONTROL     = 0,
+    LIBUSB_TRANSFER_TYPE_ISOCHRONOUS = 1,
+    LIBUSB_TRANSFER_TYPE_BULK        = 2,
+    LIBUSB_TRANSFER_TYPE_INTERRUPT   = 3,
+};
+
+enum libusb_transfer_status {
+    LIBUSB_TRANSFER_COMPLETED = 0,
+    LIBUSB_TRANSFER_ERROR,
+    LIBUSB_TRANSFER_TIMED_OUT,
+    LIBUSB_TRANSFER_CANCELLED,
+    LIBUSB_TRANSFER_STALL,
+    LIBUSB_TRANSFER_NO_DEVICE,
+    LIBUSB_TRANSFER_OVERFLOW,
+};
+
+enum libusb_transfer_flags {
+    LIBUSB_TRANSFER_SHORT_NOT_OK    = 1 << 0,
+    LIBUSB_TRANSFER_FREE_BUFFER     = 1 << 1,
+    LIBUSB_TRANSFER_FREE_TRANSFER   = 1 << 2,
+};
+
+enum libusb_request_type {
+    LIBUSB_REQUEST_TYPE_STANDARD = (0x00 << 5),
+    LIBUSB_REQUEST_TYPE_CLASS    = (0x01 << 5),
+    LIBUSB_REQUEST_TYPE_VENDOR   = (0x02 << 5),
+};
+
+enum libusb_request_recipient {
+    LIBUSB_RECIPIENT_DEVICE    = 0x00,
+    LIBUSB_RECIPIENT_INTERFACE = 0x01,
+    LIBUSB_RECIPIENT_ENDPOINT  = 0x02,
+};
+
+typedef struct libusb_context       libusb_context;
+typedef struct libusb_device        libusb_device;
+typedef struct libusb_device_handle libusb_device_handle;
+
+struct libusb_iso_packet_descriptor {
+    unsigned int length;
+    unsigned int actual_length;
+    enum libusb_transfer_status status;
+};
+
+struct libusb_transfer;
+
+typedef void (LIBUSB_CALL *libusb_transfer_cb_fn)(struct libusb_transfer *transfer);
+
+struct libusb_transfer {
+    libusb_device_handle * dev_handle;
+    uint8_t flags;
+    unsigned char endpoint;
+    unsigned char type;
+    unsigned int timeout;
+    enum libusb_transfer_status status;
+    int length;
+    int actual_length;
+    libusb_transfer_cb_fn callback;
+    void * user_data;
+    unsigned char * buffer;
+    int num_iso_packets;
+    struct libusb_iso_packet_descriptor iso_packet_desc[0];
+};
+
+struct libusb_pollfd {
+    int fd;
+    short events;
+};
+
+int  libusb_init(libusb_context ** ctx);
+void libusb_exit(libusb_context * ctx);
+void libusb_set_debug(libusb_context * ctx, int level);
+
+libusb_device_handle * libusb_open_device_with_vid_pid(libusb_context * ctx, uint16_t vendor_id, uint16_t product_id);
+int  libusb_open(libusb_device * dev, libusb_device_handle ** handle);
+void libusb_close(libusb_device_handle * dev_handle);
+libusb_device * libusb_get_device(libusb_device_handle * dev_handle);
+int  libusb_get_port_numbers(libusb_device * dev, uint8_t * port_numbers, int port_numbers_len);
+int  libusb_reset_device(libusb_device_handle * dev_handle);
+
+int  libusb_kernel_driver_active(libusb_device_handle * dev_handle, int interface_number);
+int  libusb_detach_kernel_driver(libusb_device_handle * dev_handle, int interface_number);
+int  libusb_attach_kernel_driver(libusb_device_handle * dev_handle, int interface_number);
+int  libusb_set_configuration(libusb_device_handle * dev_handle, int configuration);
+int  libusb_claim_interface(libusb_device_handle * dev_handle, int interface_number);
+int  libusb_release_interface(libusb_device_handle * dev_handle, int interface_number);
+int  libusb_clear_halt(libusb_device_handle * dev_handle, unsigned char endpoint);
+
+struct libusb_transfer * libusb_alloc_transfer(int iso_packets);
+void libusb_free_transfer(struct libusb_transfer * transfer);
+int  libusb_submit_transfer(struct libusb_transfer * transfer);
+int  libusb_cancel_transfer(struct libusb_transfer * transfer);
+
+int  libusb_handle_events_timeout(libusb_context * ctx, struct timeval * tv);
+int  libusb_pollfds_handle_timeouts(libusb_context * ctx);
+const struct libusb_pollfd ** libusb_get_pollfds(libusb_context * ctx);
+
+static inline void libusb_fill_control_setup(unsigned char * buffer, uint8_t bmRequestType, uint8_t bRequest,
+    uint16_t wValue, uint16_t wIndex, uint16_t wLength){
+    buffer[0] = bmRequestType;
+    buffer[1] = bRequest;
+    buffer[2] = wValue & 0xff;
+    buffer[3] = wValue >> 8;
+    buffer[4] = wIndex & 0xff;
+    buffer[5] = wIndex >> 8;
+    buffer[6] = wLength & 0xff;
+    buffer[7] = wLength >> 8;
+}
+
+static inline void libusb_fill_control_transfer(struct libusb_transfer * transfer, libusb_device_handle * dev_handle,
+    unsigned char * buffer, libusb_transfer_cb_fn callback, void * user_data, unsigned int timeout){
+    transfer->dev_handle = dev_handle;
+    transfer->endpoint = 0;
+    transfer->type = LIBUSB_TRANSFER_TYPE_CONTROL;
+    transfer->timeout = timeout;
+    transfer->buffer = buffer;
+    if (buffer){
+        transfer->length = LIBUSB_CONTROL_SETUP_SIZE + (buffer[6] | (buffer[7] << 8));
+    }
+    transfer->user_data = user_data;
+    transfer->callback = callback;
+}
+
+static inline void libusb_fill_bulk_transfer(struct libusb_transfer * transfer, libusb_device_handle * dev_handle,
+    unsigned char endpoint, unsigned char * buffer, int length, libusb_transfer_cb_fn callback, void * user_data,
+    unsigned int timeout){
+    transfer->dev_handle = dev_handle;
+    transfer->endpoint = endpoint;
+    transfer->type = LIBUSB_TRANSFER_TYPE_BULK;
+    transfer->timeout = timeout;
+    transfer->buffer = buffer;
+    transfer->length = length;
+    transfer->user_data = user_data;
+    transfer->callback = callback;
+}
+
+static inline void libusb_fill_interrupt_transfer(struct libusb_transfer * transfer, libusb_device_handle * dev_handle,
+    unsigned char endpoint, unsigned char * buffer, int length, libusb_transfer_cb_fn callback, void * user_data,
+    unsigned int timeout){
+    libusb_fill_bulk_transfer(transfer, dev_handle, endpoint, buffer, length, callback, user_data, timeout);
+    transfer->type = LIBUSB_TRANSFER_TYPE_INTERRUPT;
+}
+
+// simulated dongle
+
+/**
+ * @brief Set timing of ACL bulk-out transfers: transfers are moved over the bus one after the other,
+ *        each taking bus_ns_per_byte * length, and the completion is reported completion_latency_us later
+ */
+void libusb_shim_set_bulk_out_timing(uint32_t bus_ns_per_byte, uint32_t completion_latency_us);
+
+/**
+ * @brief Register handler that receives the data of each bulk-out transfer in the order the transfers were moved over the bus
+ */
+void libusb_shim_register_bulk_out_handler(void (*handler)(const uint8_t * data, int size));
+
+/**
+ * @brief Simulated time used for transfer completion
+ */
+uint64_t libusb_shim_get_time_us(void);
+void     libusb_shim_set_time_us(uint64_t time_us);
+
+/**
+ * @brief Max number of bulk-out transfers that were submitted at the same time
+ */
+int libusb_shim_get_max_bulk_out_in_flight(void);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // __LIBUSB_SHIM_H
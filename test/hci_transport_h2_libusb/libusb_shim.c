@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  libusb_shim.c
+ *
+ *  Simulated libusb Bluetooth dongle: bulk-out transfers are moved over the bus one after the other
+ *  and completed after a configurable latency, all other transfers stay pending until cancelled.
+ *  Time is simulated and advanced by the caller.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libusb.h"
+
+#define MAX_NR_SUBMITTED_TRANSFERS 64
+
+struct libusb_device {
+    uint8_t port_numbers[2];
+};
+
+struct libusb_device_handle {
+    libusb_device * device;
+};
+
+typedef struct {
+    int      submitted;
+    int      cancelled;
+    uint64_t completion_time_us;
+    // assert: last field, followed by iso packet descriptors
+    struct libusb_transfer transfer;
+} shim_transfer_t;
+
+static libusb_device        shim_device = { { 1, 2 } };
+static libusb_device_handle shim_handle = { &shim_device };
+
+static uint64_t shim_time_us;
+static uint64_t shim_bus_time_ns;
+static uint32_t shim_bus_ns_per_byte;
+static uint32_t shim_completion_latency_us;
+static void (*shim_bulk_out_handler)(const uint8_t * data, int size);
+
+// submitted transfers in order of submission
+static shim_transfer_t * shim_submitted[MAX_NR_SUBMITTED_TRANSFERS];
+static int shim_num_submitted;
+static int shim_bulk_out_in_flight;
+static int shim_max_bulk_out_in_flight;
+
+static shim_transfer_t * shim_transfer_for_transfer(struct libusb_transfer * transfer){
+    return (shim_transfer_t *) (((uint8_t *) transfer) - offsetof(shim_transfer_t, transfer));
+}
+
+static int shim_transfer_is_bulk_out(struct libusb_transfer * transfer){
+    return transfer->type == LIBUSB_TRANSFER_TYPE_BULK && (transfer->endpoint & 0x80) == 0;
+}
+
+void libusb_shim_set_bulk_out_timing(uint32_t bus_ns_per_byte, uint32_t completion_latency_us){
+    shim_bus_ns_per_byte = bus_ns_per_byte;
+    shim_completion_latency_us = completion_latency_us;
+}
+
+void libusb_shim_register_bulk_out_handler(void (*handler)(const uint8_t * data, int size)){
+    shim_bulk_out_handler = handler;
+}
+
+uint64_t libusb_shim_get_time_us(void){
+    return shim_time_us;
+}
+
+void libusb_shim_set_time_us(uint64_t time_us){
+    shim_time_us = time_us;
+}
+
+int libusb_shim_get_max_bulk_out_in_flight(void){
+    return shim_max_bulk_out_in_flight;
+}
+
+int libusb_init(libusb_context ** ctx){
+    if (ctx) *ctx = NULL;
+    shim_num_submitted = 0;
+    shim_bulk_out_in_flight = 0;
+    shim_max_bulk_out_in_flight = 0;
+    shim_bus_time_ns = shim_time_us * 1000;
+    return LIBUSB_SUCCESS;
+}
+
+void libusb_exit(libusb_context * ctx){
+    (void) ctx;
+    if (shim_num_submitted){
+        fprintf(stderr, "libusb_exit: %u transfers still submitted\n", shim_num_submitted);
+        exit(1);
+    }
+}
+
+void libusb_set_debug(libusb_context * ctx, int level){
+    (void) ctx;
+    (void) level;
+}
+
+libusb_device_handle * libusb_open_device_with_vid_pid(libusb_context * ctx, uint16_t vendor_id, uint16_t product_id){
+    (void) ctx;
+    (void) vendor_id;
+    (void) product_id;
+    return &shim_handle;
+}
+
+int libusb_open(libusb_device * dev, libusb_device_handle ** handle){
+    (void) dev;
+    *handle = &shim_handle;
+    return LIBUSB_SUCCESS;
+}
+
+void libusb_close(libusb_device_handle * dev_handle){
+    (void) dev_handle;
+}
+
+libusb_device * libusb_get_device(libusb_device_handle * dev_handle){
+    return dev_handle->device;
+}
+
+int libusb_get_port_numbers(libusb_device * dev, uint8_t * port_numbers, int port_numbers_len){
+    int len = sizeof(dev->port_numbers);
+    if (port_numbers_len < len) return LIBUSB_ERROR_INVALID_PARAM;
+    memcpy(port_numbers, dev->port_numbers, len);
+    return len;
+}
+
+int libusb_reset_device(libusb_device_handle * dev_handle){
+    (void) dev_handle;
+    return LIBUSB_SUCCESS;
+}
+
+int libusb_kernel_driver_active(libusb_device_handle * dev_handle, int interface_number){
+    (void) dev_handle;
+    (void) interface_number;
+    return 0;
+}
+
+int libusb_detach_kernel_driver(libusb_device_handle * dev_handle, int interface_number){
+    (void) dev_handle;
+    (void) interface_number;
+    return LIBUSB_SUCCESS;
+}
+
+int libusb_attach_kernel_driver(libusb_device_handle * dev_handle, int interface_number){
+    (void) dev_handle;
+    (void) interface_number;
+    return LIBUSB_SUCCESS;
+}
+
+int libusb_set_configuration(libusb_device_handle * dev_handle, int configuration){
+    (void) dev_handle;
+    (void) configuration;
+    return LIBUSB_SUCCESS;
+}
+
+int libusb_claim_interface(libusb_device_handle * dev_handle, int interface_number){
+    (void) dev_handle;
+    (void) interface_number;
+    return LIBUSB_SUCCESS;
+}
+
+int libusb_release_interface(libusb_device_handle * dev_handle, int interface_number){
+    (void) dev_handle;
+    (void) interface_number;
+    return LIBUSB_SUCCESS;
+}
+
+int libusb_clear_halt(libusb_device_handle * dev_handle, unsigned char endpoint){
+    (void) dev_handle;
+    (void) endpoint;
+    return LIBUSB_SUCCESS;
+}
+
+struct libusb_transfer * libusb_alloc_transfer(int iso_packets){
+    shim_transfer_t * shim_transfer = (shim_transfer_t *) calloc(1, sizeof(shim_transfer_t) + iso_packets * sizeof(struct libusb_iso_packet_descriptor));
+    if (!shim_transfer) return NULL;
+    shim_transfer->transfer.num_iso_packets = iso_packets;
+    return &shim_transfer->transfer;
+}
+
+void libusb_free_transfer(struct libusb_transfer * transfer){
+    if (!transfer) return;
+    shim_transfer_t * shim_transfer = shim_transfer_for_transfer(transfer);
+    if (shim_transfer->submitted){
+        fprintf(stderr, "libusb_free_transfer: transfer %p still submitted\n", transfer);
+        exit(1);
+    }
+    free(shim_transfer);
+}
+
+int libusb_submit_transfer(struct libusb_transfer * transfer){
+    shim_transfer_t * shim_transfer = shim_transfer_for_transfer(transfer);
+    if (shim_transfer->submitted) return LIBUSB_ERROR_BUSY;
+    if (shim_num_submitted == MAX_NR_SUBMITTED_TRANSFERS) return LIBUSB_ERROR_NO_MEM;
+
+    shim_transfer->submitted = 1;
+    shim_transfer->cancelled = 0;
+    shim_transfer->completion_time_us = shim_time_us;
+    shim_submitted[shim_num_submitted++] = shim_transfer;
+
+    if (shim_transfer_is_bulk_out(transfer)){
+        // bulk-out transfers use the bus one after the other
+        uint64_t now_ns = shim_time_us * 1000;
+        if (shim_bus_time_ns < now_ns){
+            shim_bus_time_ns = now_ns;
+        }
+        shim_bus_time_ns += (uint64_t) transfer->length * shim_bus_ns_per_byte;
+        shim_transfer->completion_time_us = (shim_bus_time_ns + 999) / 1000 + shim_completion_latency_us;
+        shim_bulk_out_in_flight++;
+        if (shim_bulk_out_in_flight > shim_max_bulk_out_in_flight){
+            shim_max_bulk_out_in_flight = shim_bulk_out_in_flight;
+        }
+    }
+    return LIBUSB_SUCCESS;
+}
+
+int libusb_cancel_transfer(struct libusb_transfer * transfer){
+    if (!transfer) return LIBUSB_ERROR_NOT_FOUND;
+    shim_transfer_t * shim_transfer = shim_transfer_for_transfer(transfer);
+    if (!shim_transfer->submitted) return LIBUSB_ERROR_NOT_FOUND;
+    shim_transfer->cancelled = 1;
+    return LIBUSB_SUCCESS;
+}
+
+// @returns index of first transfer that is done, or -1
+static int shim_next_done_transfer(void){
+    int i;
+    for (i = 0; i < shim_num_submitted; i++){
+        shim_transfer_t * shim_transfer = shim_submitted[i];
+        struct libusb_transfer * transfer = &shim_transfer->transfer;
+        if (shim_transfer->cancelled) return i;
+        if (transfer->type == LIBUSB_TRANSFER_TYPE_CONTROL) return i;
+        if (shim_transfer_is_bulk_out(transfer) && shim_transfer->completion_time_us <= shim_time_us) return i;
+    }
+    return -1;
+}
+
+int libusb_handle_events_timeout(libusb_context * ctx, struct timeval * tv){
+    (void) ctx;
+    (void) tv;
+    while (1){
+        int index = shim_next_done_transfer();
+        if (index < 0) break;
+
+        shim_transfer_t * shim_transfer = shim_submitted[index];
+        memmove(&shim_submitted[index], &shim_submitted[index+1], (shim_num_submitted - index - 1) * sizeof(shim_transfer_t *));
+        shim_num_submitted--;
+        shim_transfer->submitted = 0;
+
+        struct libusb_transfer * transfer = &shim_transfer->transfer;
+        if (shim_transfer_is_bulk_out(transfer)){
+            shim_bulk_out_in_flight--;
+        }
+        if (shim_transfer->cancelled){
+            transfer->status = LIBUSB_TRANSFER_CANCELLED;
+            transfer->actual_length = 0;
+        } else {
+            transfer->status = LIBUSB_TRANSFER_COMPLETED;
+            transfer->actual_length = transfer->length;
+            if (shim_transfer_is_bulk_out(transfer) && shim_bulk_out_handler){
+                (*shim_bulk_out_handler)(transfer->buffer, transfer->length);
+            }
+        }
+        (*transfer->callback)(transfer);
+    }
+    return LIBUSB_SUCCESS;
+}
+
+int libusb_pollfds_handle_timeouts(libusb_context * ctx){
+    (void) ctx;
+    return 0;
+}
+
+const struct libusb_pollfd ** libusb_get_pollfds(libusb_context * ctx){
+    (void) ctx;
+    return (const struct libusb_pollfd **) calloc(1, sizeof(struct libusb_pollfd *));
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  hci_transport_h4_benchmark.c
+ *
+ *  Measures H4 receive rate and reads per packet with a fake controller on a pseudo terminal.
+ *  After receiving HCI Reset, the fake controller sends a burst of ACL packets. The UART 
+ *  driver is used in block mode (packet type, header, and payload read separately) and in
+ *  streaming mode.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack_defines.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_uart_block.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "hci_transport.h"
+
+#define DEFAULT_NUM_PACKETS 100000
+
+static const uint16_t acl_payload_lens[] = { 27, 251, 1021 };
+
+static int num_packets = DEFAULT_NUM_PACKETS;
+static uint16_t acl_payload_len;
+
+// host
+static btstack_uart_block_t   uart_driver;
+static hci_transport_config_uart_t transport_config;
+static const hci_transport_t * transport;
+static void (*uart_block_received)(void);
+static void (*uart_stream_received)(uint16_t len);
+static uint32_t num_uart_callbacks;
+static int      num_received;
+static uint64_t start_ns;
+static const char * mode_name;
+static uint8_t  hci_reset_command[] = { 0, 0x03, 0x0c, 0x00 };
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t benchmark_cpu_us(void){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((uint64_t) usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static uint8_t acl_payload(int packet_nr, int pos){
+    return (uint8_t) (packet_nr * 7 + pos);
+}
+
+// fake controller
+
+static void controller_run(int fd){
+    // wait for HCI Reset, the host has configured the pseudo terminal by then
+    int received = 0;
+    while (received < (int) sizeof(hci_reset_command)){
+        uint8_t buffer[sizeof(hci_reset_command)];
+        int res = read(fd, buffer, sizeof(hci_reset_command) - received);
+        if (res > 0) {
+            received += res;
+        } else if (res == 0 || (errno != EAGAIN && errno != EINTR)){
+            fprintf(stderr, "controller: read failed, errno %d\n", errno);
+            exit(1);
+        } else {
+            usleep(1000);
+        }
+    }
+
+    // encode all ACL packets
+    int packet_size = 1 + HCI_ACL_HEADER_SIZE + acl_payload_len;
+    uint8_t * stream = (uint8_t *) malloc(num_packets * packet_size);
+    int i;
+    for (i = 0; i < num_packets; i++){
+        uint8_t * packet = &stream[i * packet_size];
+        packet[0] = HCI_ACL_DATA_PACKET;
+        little_endian_store_16(packet, 1, 0x2001);
+        little_endian_store_16(packet, 3, acl_payload_len);
+        int pos;
+        for (pos = 0; pos < acl_payload_len; pos++){
+            packet[1 + HCI_ACL_HEADER_SIZE + pos] = acl_payload(i, pos);
+        }
+    }
+
+    // send packets
+    int stream_len = num_packets * packet_size;
+    int pos = 0;
+    while (pos < stream_len){
+        int res = write(fd, &stream[pos], stream_len - pos);
+        if (res > 0) {
+            pos += res;
+        } else if (res < 0 && errno != EAGAIN && errno != EINTR){
+            fprintf(stderr, "controller: write failed, errno %d\n", errno);
+            exit(1);
+        } else {
+            usleep(100);
+        }
+    }
+    free(stream);
+
+    // keep pty open until host is done
+    while (1){
+        uint8_t buffer[16];
+        int res = read(fd, buffer, sizeof(buffer));
+        if (res == 0 || (res < 0 && errno == EIO)) break;
+        if (res < 0) usleep(1000);
+    }
+    exit(0);
+}
+
+// host
+
+static void host_block_received(void){
+    num_uart_callbacks++;
+    (*uart_block_received)();
+}
+
+static void host_stream_received(uint16_t len){
+    num_uart_callbacks++;
+    (*uart_stream_received)(len);
+}
+
+static void host_set_block_received(void (*handler)(void)){
+    uart_block_received = handler;
+    btstack_uart_block_posix_instance()->set_block_received(&host_block_received);
+}
+
+static void host_set_stream_received(void (*handler)(uint16_t len)){
+    uart_stream_received = handler;
+    btstack_uart_block_posix_instance()->set_stream_received(&host_stream_received);
+}
+
+static void host_packet_handler(uint8_t packet_type, uint8_t *packet, uint16_t size){
+    if (packet_type != HCI_ACL_DATA_PACKET) return;
+    if (num_received == 0){
+        start_ns = benchmark_time_ns();
+        num_uart_callbacks = 0;
+    }
+    int pos;
+    if (size != HCI_ACL_HEADER_SIZE + acl_payload_len || little_endian_read_16(packet, 2) != acl_payload_len){
+        fprintf(stderr, "%s: packet %u has wrong size %u\n", mode_name, num_received, size);
+        exit(1);
+    }
+    for (pos = 0; pos < acl_payload_len; pos++){
+        if (packet[HCI_ACL_HEADER_SIZE + pos] == acl_payload(num_received, pos)) continue;
+        fprintf(stderr, "%s: packet %u corrupted at offset %u\n", mode_name, num_received, pos);
+        exit(1);
+    }
+    num_received++;
+    if (num_received < num_packets) return;
+
+    // first packet excluded
+    uint64_t delta_ns = benchmark_time_ns() - start_ns;
+    uint64_t cpu_us   = benchmark_cpu_us();
+    printf("ACL %4u, %-6s: %8.0f packets/s, %5.2f reads/packet, %6.2f us CPU/packet\n", acl_payload_len, mode_name,
+        (num_packets - 1) * 1e9 / delta_ns, (double) num_uart_callbacks / (num_packets - 1), (double) cpu_us / num_packets);
+    exit(0);
+}
+
+static void host_run(const char * device_name, int streaming){
+    mode_name = streaming ? "stream" : "block";
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+
+    // wrap posix driver to count callbacks, hide streaming support for block mode
+    uart_driver = *btstack_uart_block_posix_instance();
+    uart_driver.set_block_received  = &host_set_block_received;
+    uart_driver.set_stream_received = &host_set_stream_received;
+    if (!streaming){
+        uart_driver.set_stream_received = NULL;
+        uart_driver.receive_stream      = NULL;
+    }
+
+    transport_config.type = HCI_TRANSPORT_CONFIG_UART;
+    transport_config.baudrate_init = 3000000;
+    transport_config.device_name = device_name;
+    transport = hci_transport_h4_instance(&uart_driver);
+    transport->init(&transport_config);
+    transport->register_packet_handler(&host_packet_handler);
+    if (transport->open()){
+        fprintf(stderr, "%s: open %s failed\n", mode_name, device_name);
+        exit(1);
+    }
+    // H4 stores packet type in front of the packet
+    transport->send_packet(HCI_COMMAND_DATA_PACKET, &hci_reset_command[1], sizeof(hci_reset_command) - 1);
+    btstack_run_loop_execute();
+}
+
+static int run_benchmark(int streaming){
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)){
+        fprintf(stderr, "pseudo terminal not available, errno %d\n", errno);
+        return 1;
+    }
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    pid_t controller = fork();
+    if (controller == 0){
+        controller_run(master);
+    }
+    const char * slave_name = ptsname(master);
+    pid_t host = fork();
+    if (host == 0){
+        close(master);
+        host_run(slave_name, streaming);
+    }
+    int host_status;
+    waitpid(host, &host_status, 0);
+    close(master);
+    kill(controller, SIGTERM);
+    waitpid(controller, NULL, 0);
+    return !WIFEXITED(host_status) || WEXITSTATUS(host_status) != 0;
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_packets = atoi(argv[1]);
+    }
+    printf("H4 receive of %u ACL packets\n", num_packets);
+    fflush(stdout);
+    int res = 0;
+    unsigned int i;
+    for (i = 0; i < sizeof(acl_payload_lens) / sizeof(acl_payload_lens[0]); i++){
+        acl_payload_len = acl_payload_lens[i];
+        res |= run_benchmark(0);
+        res |= run_benchmark(1);
+        fflush(stdout);
+    }
+    return res;
+}
@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  hci_transport_h5_benchmark.c
+ *
+ *  Measures H5 receive throughput and CPU load with a fake controller on a pseudo terminal.
+ *  The fake controller completes link establishment and then sends a burst of reliable
+ *  HCI event packets. The UART driver is used in block mode (one byte per read) and in 
+ *  streaming mode.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack_debug.h"
+#include "btstack_defines.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_slip.h"
+#include "btstack_uart_block.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "hci_transport.h"
+
+#define DEFAULT_NUM_PACKETS 10000
+#define EVENT_PARAM_LEN     253
+
+// link control messages
+static const uint8_t link_control_sync[] =            { 0x01, 0x7e};
+static const uint8_t link_control_sync_response[] =   { 0x02, 0x7d};
+static const uint8_t link_control_config_prefix[] =   { 0x03, 0xfc};
+static const uint8_t link_control_config_response[] = { 0x04, 0x7b, 0x01};
+
+static int num_packets = DEFAULT_NUM_PACKETS;
+
+// host
+static btstack_uart_block_t   uart_driver;
+static hci_transport_config_uart_t transport_config;
+static const hci_transport_t * transport;
+static void (*uart_block_received)(void);
+static void (*uart_stream_received)(uint16_t len);
+static uint32_t num_uart_callbacks;
+static int      num_received;
+static uint64_t start_ns;
+static const char * mode_name;
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t benchmark_cpu_us(void){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((uint64_t) usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static uint8_t event_param(int packet_nr, int pos){
+    return (uint8_t) (packet_nr * 7 + pos);
+}
+
+// fake controller
+
+static void controller_write(int fd, const uint8_t * data, int len){
+    while (len){
+        int res = write(fd, data, len);
+        if (res < 0){
+            if (errno == EAGAIN || errno == EINTR) continue;
+            fprintf(stderr, "controller: write failed, errno %d\n", errno);
+            exit(1);
+        }
+        data += res;
+        len  -= res;
+    }
+}
+
+static int controller_encode_frame(uint8_t * buffer, uint8_t seq_nr, uint8_t reliable, uint8_t packet_type, const uint8_t * payload, uint16_t len){
+    uint8_t header[4];
+    header[0] = seq_nr | (reliable << 7);
+    header[1] = packet_type | ((len & 0x0f) << 4);
+    header[2] = len >> 4;
+    header[3] = 0xff - (header[0] + header[1] + header[2]);
+    int pos = 0;
+    buffer[pos++] = BTSTACK_SLIP_SOF;
+    btstack_slip_encoder_start(header, 4);
+    while (btstack_slip_encoder_has_data()){
+        buffer[pos++] = btstack_slip_encoder_get_byte();
+    }
+    btstack_slip_encoder_start(payload, len);
+    while (btstack_slip_encoder_has_data()){
+        buffer[pos++] = btstack_slip_encoder_get_byte();
+    }
+    buffer[pos++] = BTSTACK_SLIP_SOF;
+    return pos;
+}
+
+static void controller_send_link_control(int fd, const uint8_t * message, uint16_t len){
+    uint8_t frame[32];
+    int frame_len = controller_encode_frame(frame, 0, 0, 15, message, len);
+    controller_write(fd, frame, frame_len);
+}
+
+static void controller_run(int fd){
+    // complete link establishment: answer sync and config
+    uint8_t frame[300];
+    btstack_slip_decoder_init(frame, sizeof(frame));
+    int link_active = 0;
+    while (!link_active){
+        uint8_t data;
+        int res = read(fd, &data, 1);
+        if (res < 0 && (errno == EAGAIN || errno == EINTR)) {
+            usleep(1000);
+            continue;
+        }
+        if (res <= 0){
+            fprintf(stderr, "controller: read failed, errno %d\n", errno);
+            exit(1);
+        }
+        btstack_slip_decoder_process(data);
+        uint16_t frame_size = btstack_slip_decoder_frame_size();
+        if (!frame_size) continue;
+        btstack_slip_decoder_init(frame, sizeof(frame));
+        if (frame_size < 6 || (frame[1] & 0x0f) != 15) continue;
+        if (memcmp(&frame[4], link_control_sync, sizeof(link_control_sync)) == 0){
+            controller_send_link_control(fd, link_control_sync_response, sizeof(link_control_sync_response));
+            continue;
+        }
+        if (memcmp(&frame[4], link_control_config_prefix, sizeof(link_control_config_prefix)) == 0){
+            controller_send_link_control(fd, link_control_config_response, sizeof(link_control_config_response));
+            link_active = 1;
+        }
+    }
+
+    // encode all event packets
+    uint8_t * stream = (uint8_t *) malloc(num_packets * (2 * (4 + 2 + EVENT_PARAM_LEN) + 2));
+    int stream_len = 0;
+    int i;
+    for (i = 0; i < num_packets; i++){
+        uint8_t event[2 + EVENT_PARAM_LEN];
+        event[0] = HCI_EVENT_VENDOR_SPECIFIC;
+        event[1] = EVENT_PARAM_LEN;
+        int pos;
+        for (pos = 0; pos < EVENT_PARAM_LEN; pos++){
+            event[2 + pos] = event_param(i, pos);
+        }
+        stream_len += controller_encode_frame(&stream[stream_len], i & 7, 1, HCI_EVENT_PACKET, event, sizeof(event));
+    }
+
+    // send events, drop acknowledgements from host
+    int pos = 0;
+    while (pos < stream_len){
+        int res = write(fd, &stream[pos], stream_len - pos);
+        if (res > 0) {
+            pos += res;
+        } else if (res < 0 && errno != EAGAIN && errno != EINTR){
+            fprintf(stderr, "controller: write failed, errno %d\n", errno);
+            exit(1);
+        }
+        uint8_t acks[256];
+        while (read(fd, acks, sizeof(acks)) > 0);
+        if (res <= 0){
+            usleep(100);
+        }
+    }
+    free(stream);
+
+    // keep pty open until host is done
+    while (1){
+        uint8_t acks[256];
+        int res = read(fd, acks, sizeof(acks));
+        if (res == 0 || (res < 0 && errno == EIO)) break;
+        if (res < 0) usleep(1000);
+    }
+    exit(0);
+}
+
+// host
+
+static void host_block_received(void){
+    num_uart_callbacks++;
+    (*uart_block_received)();
+}
+
+static void host_stream_received(uint16_t len){
+    num_uart_callbacks++;
+    (*uart_stream_received)(len);
+}
+
+static void host_set_block_received(void (*handler)(void)){
+    uart_block_received = handler;
+    btstack_uart_block_posix_instance()->set_block_received(&host_block_received);
+}
+
+static void host_set_stream_received(void (*handler)(uint16_t len)){
+    uart_stream_received = handler;
+    btstack_uart_block_posix_instance()->set_stream_received(&host_stream_received);
+}
+
+static void host_packet_handler(uint8_t packet_type, uint8_t *packet, uint16_t size){
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (packet[0]){
+        case HCI_EVENT_TRANSPORT_PACKET_SENT:
+            // link active
+            if (!start_ns){
+                start_ns = benchmark_time_ns();
+            }
+            return;
+        case HCI_EVENT_VENDOR_SPECIFIC:
+            break;
+        default:
+            return;
+    }
+    int pos;
+    if (size != 2 + EVENT_PARAM_LEN || packet[1] != EVENT_PARAM_LEN){
+        fprintf(stderr, "%s: packet %u has wrong size %u\n", mode_name, num_received, size);
+        exit(1);
+    }
+    for (pos = 0; pos < EVENT_PARAM_LEN; pos++){
+        if (packet[2 + pos] == event_param(num_received, pos)) continue;
+        fprintf(stderr, "%s: packet %u corrupted at offset %u\n", mode_name, num_received, pos);
+        exit(1);
+    }
+    num_received++;
+    if (num_received < num_packets) return;
+
+    uint64_t delta_ns = benchmark_time_ns() - start_ns;
+    uint64_t cpu_us   = benchmark_cpu_us();
+    double   kbytes   = (double) num_packets * (2 + EVENT_PARAM_LEN) / 1000.0;
+    printf("%-6s: %6.0f kB/s, %6.2f ms CPU per 100 kB, %6.1f bytes per UART callback\n", mode_name,
+        kbytes * 1e9 / delta_ns, (double) cpu_us / 10.0 / kbytes, kbytes * 1000.0 / num_uart_callbacks);
+    exit(0);
+}
+
+static void host_run(const char * device_name, int streaming){
+    mode_name = streaming ? "stream" : "block";
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+
+    // wrap posix driver to count callbacks, hide streaming support for block mode
+    uart_driver = *btstack_uart_block_posix_instance();
+    uart_driver.set_block_received  = &host_set_block_received;
+    uart_driver.set_stream_received = &host_set_stream_received;
+    if (!streaming){
+        uart_driver.set_stream_received = NULL;
+        uart_driver.receive_stream      = NULL;
+    }
+
+    transport_config.type = HCI_TRANSPORT_CONFIG_UART;
+    transport_config.baudrate_init = 3000000;
+    transport_config.device_name = device_name;
+    transport = hci_transport_h5_instance(&uart_driver);
+    transport->init(&transport_config);
+    transport->register_packet_handler(&host_packet_handler);
+    if (transport->open()){
+        fprintf(stderr, "%s: open %s failed\n", mode_name, device_name);
+        exit(1);
+    }
+    btstack_run_loop_execute();
+}
+
+static int run_benchmark(int streaming){
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)){
+        fprintf(stderr, "pseudo terminal not available, errno %d\n", errno);
+        return 1;
+    }
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    pid_t controller = fork();
+    if (controller == 0){
+        controller_run(master);
+    }
+    const char * slave_name = ptsname(master);
+    pid_t host = fork();
+    if (host == 0){
+        close(master);
+        host_run(slave_name, streaming);
+    }
+    int host_status;
+    waitpid(host, &host_status, 0);
+    close(master);
+    kill(controller, SIGTERM);
+    waitpid(controller, NULL, 0);
+    return !WIFEXITED(host_status) || WEXITSTATUS(host_status) != 0;
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_packets = atoi(argv[1]);
+    }
+    printf("H5 receive of %u HCI events with %u bytes each\n", num_packets, 2 + EVENT_PARAM_LEN);
+    fflush(stdout);
+    int res = 0;
+    res |= run_benchmark(0);
+    res |= run_benchmark(1);
+    return res;
+}
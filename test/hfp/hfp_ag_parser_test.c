@@ -48,6 +48,7 @@
 #include "classic/hfp_ag.h"
 
 void hfp_parse(hfp_connection_t * context, uint8_t byte, int isHandsFree);
+void hfp_parse_buffer(hfp_connection_t * context, const uint8_t * buffer, uint16_t size, int isHandsFree);
 
 hfp_ag_indicator_t * hfp_ag_get_ag_indicators(hfp_connection_t * hfp_connection);
 
@@ -274,6 +275,20 @@ TEST(HFPParser, HFP_AG_CONFIRM_COMMON_CODEC){
     CHECK_EQUAL(context.codec_confirmed, codec);
 }
 
+TEST(HFPParser, HFP_AG_PARSE_BUFFER){
+    sprintf(packet, "\r\nAT%s=0,1,2\r\nAT%s=3,0\r\nAT%s\r\n", HFP_AVAILABLE_CODECS, HFP_QUERY_OPERATOR_SELECTION, HFP_LIST_CURRENT_CALLS);
+    // payload split at arbitrary positions
+    uint16_t size = strlen(packet);
+    hfp_parse_buffer(&context, (const uint8_t *) packet, 7, 0);
+    hfp_parse_buffer(&context, (const uint8_t *) &packet[7], 12, 0);
+    CHECK_EQUAL(HFP_CMD_AVAILABLE_CODECS, context.command);
+    CHECK_EQUAL(3, context.remote_codecs_nr);
+    hfp_parse_buffer(&context, (const uint8_t *) &packet[19], 14, 0);
+    CHECK_EQUAL(HFP_CMD_QUERY_OPERATOR_SELECTION_NAME_FORMAT, context.command);
+    hfp_parse_buffer(&context, (const uint8_t *) &packet[33], size - 33, 0);
+    CHECK_EQUAL(HFP_CMD_LIST_CURRENT_CALLS, context.command);
+}
+
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
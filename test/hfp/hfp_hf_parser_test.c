@@ -47,6 +47,7 @@
 #include "classic/hfp.h"
 
 void hfp_parse(hfp_connection_t * context, uint8_t byte, int isHandsFree);
+void hfp_parse_buffer(hfp_connection_t * context, const uint8_t * buffer, uint16_t size, int isHandsFree);
 
 static  hfp_connection_t context;
 static int hfp_ag_indicators_nr = 7;
@@ -146,6 +147,16 @@ TEST(HFPParser, HFP_HF_INDICATOR_STATUS){
 }
 
 
+TEST(HFPParser, HFP_HF_PARSE_BUFFER){
+    sprintf(packet, "\r\n%s:1007\r\n\r\nOK\r\n", HFP_SUPPORTED_FEATURES);
+    // payload split at arbitrary positions
+    hfp_parse_buffer(&context, (const uint8_t *) packet, 5, 1);
+    hfp_parse_buffer(&context, (const uint8_t *) &packet[5], 4, 1);
+    hfp_parse_buffer(&context, (const uint8_t *) &packet[9], strlen(packet) - 9, 1);
+    CHECK_EQUAL(HFP_CMD_OK, context.command);
+    CHECK_EQUAL(1007, context.remote_supported_features);
+}
+
 TEST(HFPParser, HFP_HF_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES){
     sprintf(packet, "\r\n%s:(1,1x,2,2x,3)\r\n\r\nOK\r\n", HFP_SUPPORT_CALL_HOLD_AND_MULTIPARTY_SERVICES);
     for (pos = 0; pos < strlen(packet); pos++){
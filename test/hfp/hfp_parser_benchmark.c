@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+
+/*
+ *  hfp_parser_benchmark.c
+ *
+ *  Feeds typical RFCOMM payloads of an AG serving a headset (CLCC polling, indicator and volume updates)
+ *  and of a HF talking to an AG (+CIEV, +CLCC, OK) into the HFP parser, once byte by byte via hfp_parse
+ *  and once per payload via hfp_parse_buffer, and reports the time per payload. A checksum over the
+ *  parsed commands and parser state is printed per mode; both modes have to produce the same checksum.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "classic/hfp.h"
+#include "hci_dump.h"
+
+#define DEFAULT_NUM_ITERATIONS 100000
+
+typedef struct {
+    const char * name;
+    int is_hands_free;
+    const char * payloads[6];
+} benchmark_role_t;
+
+static const benchmark_role_t roles[] = {
+    { "AG, HF commands", 0, {
+        "AT+CLCC\r",
+        "AT+BIEV=2,85\r",
+        "AT+VGS=10\r",
+        "AT+CIND?\r",
+        "AT+NREC=0\r",
+        NULL }
+    },
+    { "HF, AG responses", 1, {
+        "\r\n+CIEV: 2,1\r\n",
+        "\r\n+CLCC: 1,1,4,0,0,\"1234567\",129\r\n",
+        "\r\n+VGS:5\r\n",
+        "\r\n+BCS:2\r\n",
+        "\r\nOK\r\n",
+        NULL }
+    },
+};
+
+static int num_iterations = DEFAULT_NUM_ITERATIONS;
+static hfp_connection_t hfp_connection;
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static void reset_connection(void){
+    memset(&hfp_connection, 0, sizeof(hfp_connection));
+    hfp_connection.parser_state = HFP_PARSER_CMD_HEADER;
+}
+
+static uint32_t run(const benchmark_role_t * role, int use_buffer){
+    uint32_t checksum = 2166136261u;
+    int num_payloads = 0;
+    reset_connection();
+    uint64_t start_ns = benchmark_time_ns();
+    int i;
+    for (i = 0; i < num_iterations; i++){
+        int j;
+        for (j = 0; role->payloads[j]; j++){
+            const uint8_t * payload = (const uint8_t *) role->payloads[j];
+            uint16_t size = strlen(role->payloads[j]);
+            if (use_buffer){
+                hfp_parse_buffer(&hfp_connection, payload, size, role->is_hands_free);
+            } else {
+                uint16_t pos;
+                for (pos = 0; pos < size; pos++){
+                    hfp_parse(&hfp_connection, payload[pos], role->is_hands_free);
+                }
+            }
+            // FNV-1a
+            checksum = (checksum ^ (uint32_t) hfp_connection.command) * 16777619;
+            checksum = (checksum ^ (uint32_t) hfp_connection.parser_state) * 16777619;
+            checksum = (checksum ^ (uint32_t) hfp_connection.line_size) * 16777619;
+            hfp_connection.command = HFP_CMD_NONE;
+            num_payloads++;
+        }
+    }
+    uint64_t duration_ns = benchmark_time_ns() - start_ns;
+    printf("%-20s %-18s %8.1f ns/payload, checksum %08x\n", role->name, use_buffer ? "hfp_parse_buffer" : "hfp_parse",
+        (double) duration_ns / num_payloads, checksum);
+    return checksum;
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_iterations = atoi(argv[1]);
+    }
+
+    // no log output while measuring
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+    hci_dump_enable_log_level(LOG_LEVEL_ERROR, 0);
+
+    int result = 0;
+    unsigned int i;
+    for (i = 0; i < sizeof(roles) / sizeof(benchmark_role_t); i++){
+        uint32_t checksum_bytes  = run(&roles[i], 0);
+        uint32_t checksum_buffer = run(&roles[i], 1);
+        if (checksum_bytes != checksum_buffer){
+            printf("%s: checksum mismatch\n", roles[i].name);
+            result = 1;
+        }
+    }
+    return result;
+}
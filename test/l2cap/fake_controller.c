@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  fake_controller.c
+ */
+
+#include "fake_controller.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btstack_defines.h"
+#include "hci.h"
+#include "hci_cmd.h"
+#include "l2cap_signaling.h"
+
+#define MAX_RESPONSES 8
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+static void (*data_handler)(int index, uint8_t * packet, uint16_t size);
+static uint16_t controller_acl_packets;
+static int      command_pending;
+static uint16_t command_opcode;
+static int      acl_packets_in_flight;
+static uint16_t local_cids[FAKE_CONTROLLER_MAX_CHANNELS];
+static uint8_t  responses[MAX_RESPONSES][HCI_ACL_HEADER_SIZE + L2CAP_HEADER_SIZE + 16];
+static uint16_t responses_len[MAX_RESPONSES];
+static int      num_responses;
+
+// remote
+
+static void remote_queue_signaling_packet(uint8_t code, uint8_t sig_id, const uint8_t * data, uint16_t len){
+    if (num_responses >= MAX_RESPONSES){
+        fprintf(stderr, "too many signaling responses\n");
+        exit(1);
+    }
+    uint8_t * packet = responses[num_responses];
+    little_endian_store_16(packet, 0, FAKE_CONTROLLER_CON_HANDLE | 0x2000);
+    little_endian_store_16(packet, 2, L2CAP_HEADER_SIZE + 4 + len);
+    little_endian_store_16(packet, 4, 4 + len);
+    little_endian_store_16(packet, 6, L2CAP_CID_SIGNALING);
+    packet[8] = code;
+    packet[9] = sig_id;
+    little_endian_store_16(packet, 10, len);
+    memcpy(&packet[12], data, len);
+    responses_len[num_responses] = HCI_ACL_HEADER_SIZE + L2CAP_HEADER_SIZE + 4 + len;
+    num_responses++;
+}
+
+static void remote_handle_signaling_packet(uint8_t * command){
+    uint8_t code   = command[0];
+    uint8_t sig_id = command[1];
+    uint8_t data[8];
+    int index;
+    switch (code){
+        case CONNECTION_REQUEST:
+            // accept and send configure request without options
+            index = little_endian_read_16(command, 4) - FAKE_CONTROLLER_PSM_BASE;
+            if (index < 0 || index >= FAKE_CONTROLLER_MAX_CHANNELS) break;
+            local_cids[index] = little_endian_read_16(command, 6);
+            little_endian_store_16(data, 0, FAKE_CONTROLLER_REMOTE_CID_BASE + index);
+            little_endian_store_16(data, 2, local_cids[index]);
+            little_endian_store_16(data, 4, 0);
+            little_endian_store_16(data, 6, 0);
+            remote_queue_signaling_packet(CONNECTION_RESPONSE, sig_id, data, 8);
+            little_endian_store_16(data, 0, local_cids[index]);
+            little_endian_store_16(data, 2, 0);
+            remote_queue_signaling_packet(CONFIGURE_REQUEST, 0x80 | sig_id, data, 4);
+            break;
+        case CONFIGURE_REQUEST:
+            index = little_endian_read_16(command, 4) - FAKE_CONTROLLER_REMOTE_CID_BASE;
+            if (index < 0 || index >= FAKE_CONTROLLER_MAX_CHANNELS) break;
+            little_endian_store_16(data, 0, local_cids[index]);
+            little_endian_store_16(data, 2, 0);
+            little_endian_store_16(data, 4, 0);
+            remote_queue_signaling_packet(CONFIGURE_RESPONSE, sig_id, data, 6);
+            break;
+        default:
+            break;
+    }
+}
+
+// dummy transport
+
+static int dummy_transport_open(void){
+    return 0;
+}
+
+static int dummy_transport_close(void){
+    return 0;
+}
+
+static void dummy_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int dummy_transport_send_packet(uint8_t packet_type, uint8_t *packet, int size){
+    switch (packet_type){
+        case HCI_COMMAND_DATA_PACKET:
+            command_pending = 1;
+            command_opcode  = little_endian_read_16(packet, 0);
+            break;
+        case HCI_ACL_DATA_PACKET: {
+            acl_packets_in_flight++;
+            uint16_t cid = little_endian_read_16(packet, 6);
+            if (cid == L2CAP_CID_SIGNALING){
+                remote_handle_signaling_packet(&packet[8]);
+                break;
+            }
+            int index = cid - FAKE_CONTROLLER_REMOTE_CID_BASE;
+            if (index < 0 || index >= FAKE_CONTROLLER_MAX_CHANNELS) break;
+            if (data_handler){
+                (*data_handler)(index, packet, size);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return 0;
+}
+
+static const hci_transport_t dummy_transport = {
+    /* const char * name; */                                        "Dummy",
+    /* void   (*init) (const void *transport_config); */            NULL,
+    /* int    (*open)(void); */                                     &dummy_transport_open,
+    /* int    (*close)(void); */                                    &dummy_transport_close,
+    /* void   (*register_packet_handler)(void (*handler)(...); */   &dummy_transport_register_packet_handler,
+    /* int    (*can_send_packet_now)(uint8_t packet_type); */       NULL,
+    /* int    (*send_packet)(...); */                               &dummy_transport_send_packet,
+    /* int    (*set_baudrate)(uint32_t baudrate); */                NULL,
+    /* void   (*reset_link)(void); */                               NULL,
+    /* void   (*set_sco_config)(uint16_t voice_setting, int num_connections); */ NULL,
+};
+
+// controller
+
+static void controller_command_complete(uint16_t opcode){
+    uint8_t event[6 + 64];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    if (opcode == hci_read_local_supported_commands.opcode){
+        // Read Buffer Size supported: octet 14, bit 7
+        event[6 + 14] = 0x80;
+    }
+    if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, HCI_ACL_PAYLOAD_SIZE);
+        little_endian_store_16(event, 9, controller_acl_packets);
+    }
+    (*hci_packet_handler)(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+const hci_transport_t * fake_controller_init(uint16_t num_acl_packets){
+    controller_acl_packets = num_acl_packets;
+    command_pending = 0;
+    acl_packets_in_flight = 0;
+    num_responses = 0;
+    data_handler = NULL;
+    memset(local_cids, 0, sizeof(local_cids));
+    return &dummy_transport;
+}
+
+void fake_controller_register_data_handler(void (*handler)(int index, uint8_t * packet, uint16_t size)){
+    data_handler = handler;
+}
+
+void fake_controller_power_on(void){
+    hci_power_control(HCI_POWER_ON);
+    fake_controller_run();
+    if (hci_get_state() != HCI_STATE_WORKING){
+        fprintf(stderr, "HCI not working\n");
+        exit(1);
+    }
+}
+
+void fake_controller_connect(bd_addr_t address){
+    uint8_t event[13];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_CONNECTION_REQUEST;
+    event[1] = 10;
+    reverse_bd_addr(address, &event[2]);
+    event[11] = 1;
+    (*hci_packet_handler)(HCI_EVENT_PACKET, event, 12);
+    event[0] = HCI_EVENT_CONNECTION_COMPLETE;
+    event[1] = 11;
+    event[2] = 0;
+    little_endian_store_16(event, 3, FAKE_CONTROLLER_CON_HANDLE);
+    reverse_bd_addr(address, &event[5]);
+    event[11] = 1;
+    event[12] = 0;
+    (*hci_packet_handler)(HCI_EVENT_PACKET, event, 13);
+    // no features, in particular no SSP
+    uint8_t features[11];
+    memset(features, 0, sizeof(features));
+    features[0] = HCI_EVENT_READ_REMOTE_SUPPORTED_FEATURES_COMPLETE;
+    features[1] = sizeof(features) - 2;
+    little_endian_store_16(features, 3, FAKE_CONTROLLER_CON_HANDLE);
+    (*hci_packet_handler)(HCI_EVENT_PACKET, features, sizeof(features));
+    fake_controller_run();
+}
+
+// process commands and signaling responses outside of send_packet
+void fake_controller_run(void){
+    while (command_pending || num_responses){
+        if (command_pending){
+            command_pending = 0;
+            controller_command_complete(command_opcode);
+            continue;
+        }
+        uint8_t  packet[sizeof(responses[0])];
+        uint16_t len = responses_len[0];
+        memcpy(packet, responses[0], len);
+        num_responses--;
+        memmove(responses[0], responses[1], num_responses * sizeof(responses[0]));
+        memmove(&responses_len[0], &responses_len[1], num_responses * sizeof(responses_len[0]));
+        (*hci_packet_handler)(HCI_ACL_DATA_PACKET, packet, len);
+    }
+}
+
+void fake_controller_run_until_idle(void){
+    fake_controller_run();
+    while (acl_packets_in_flight){
+        fake_controller_complete_packet();
+        fake_controller_run();
+    }
+}
+
+int fake_controller_acl_packets_in_flight(void){
+    return acl_packets_in_flight;
+}
+
+void fake_controller_complete_packet(void){
+    uint8_t event[7] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1 };
+    little_endian_store_16(event, 3, FAKE_CONTROLLER_CON_HANDLE);
+    little_endian_store_16(event, 5, 1);
+    acl_packets_in_flight--;
+    (*hci_packet_handler)(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+void fake_controller_receive_acl_packet(uint8_t * packet, uint16_t size){
+    (*hci_packet_handler)(HCI_ACL_DATA_PACKET, packet, size);
+}
+
+uint16_t fake_controller_remote_cid(int index){
+    return FAKE_CONTROLLER_REMOTE_CID_BASE + index;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  fake_controller.h
+ *
+ *  Dummy synchronous HCI transport with a controller that accepts all commands and a remote
+ *  that accepts L2CAP channels, shared by the L2CAP benchmarks
+ */
+
+#ifndef __FAKE_CONTROLLER_H
+#define __FAKE_CONTROLLER_H
+
+#include <stdint.h>
+
+#include "bluetooth.h"
+#include "btstack_util.h"
+#include "hci_transport.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#define FAKE_CONTROLLER_CON_HANDLE      0x0040
+#define FAKE_CONTROLLER_REMOTE_CID_BASE 0x0100
+#define FAKE_CONTROLLER_PSM_BASE        0x1001
+#define FAKE_CONTROLLER_MAX_CHANNELS    8
+
+// transport for hci_init, controller reports num_acl_packets ACL buffers
+const hci_transport_t * fake_controller_init(uint16_t num_acl_packets);
+
+// called for each L2CAP data packet sent by the host, index is the channel's PSM - FAKE_CONTROLLER_PSM_BASE
+void fake_controller_register_data_handler(void (*handler)(int index, uint8_t * packet, uint16_t size));
+
+// power on HCI and answer all commands, exits on failure
+void fake_controller_power_on(void);
+
+// create classic connection with FAKE_CONTROLLER_CON_HANDLE
+void fake_controller_connect(bd_addr_t address);
+
+// answer pending commands and signaling packets
+void fake_controller_run(void);
+
+// answer pending commands and signaling packets and complete all packets sent by the host
+void fake_controller_run_until_idle(void);
+
+// number of ACL packets sent by host and not completed yet
+int  fake_controller_acl_packets_in_flight(void);
+
+// complete oldest ACL packet sent by the host
+void fake_controller_complete_packet(void);
+
+// forward ACL packet received from the remote to the host
+void fake_controller_receive_acl_packet(uint8_t * packet, uint16_t size);
+
+// local cid for channel with PSM FAKE_CONTROLLER_PSM_BASE + index, as seen by the remote
+uint16_t fake_controller_remote_cid(int index);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // __FAKE_CONTROLLER_H
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  l2cap_reassembly_benchmark.c
+ *
+ *  Opens an L2CAP channel via a fake remote and injects SDUs split into FRAGMENT_SIZE ACL fragments.
+ *  Reports throughput when fragments are recombined in the connection's recombination buffer and then
+ *  copied by the application, and when they are recombined directly into a buffer set with
+ *  l2cap_set_receive_buffer. Also verifies that an SDU larger than HCI_ACL_PAYLOAD_SIZE is only
+ *  received with a receive buffer.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_defines.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "l2cap.h"
+
+#include "fake_controller.h"
+
+#define DEFAULT_NUM_SDUS    100000
+#define SDU_SIZE            1000
+#define LARGE_SDU_SIZE      8000
+#define FRAGMENT_SIZE       255
+#define BUFFER_SIZE         (HCI_INCOMING_PRE_BUFFER_SIZE + HCI_ACL_HEADER_SIZE + L2CAP_HEADER_SIZE + LARGE_SDU_SIZE)
+
+static int num_sdus = DEFAULT_NUM_SDUS;
+static bd_addr_t remote_address = { 0x00, 0x1b, 0xdc, 0x07, 0x32, 0xef };
+static uint16_t local_cid;
+static int      channel_open;
+static uint8_t  receive_buffer[BUFFER_SIZE];
+static uint8_t  application_buffer[LARGE_SDU_SIZE];
+static uint8_t  sdu[LARGE_SDU_SIZE];
+static int      copy_data;
+static int      num_received;
+static uint16_t received_size;
+static const uint8_t * received_data;
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static void channel_packet_handler(uint8_t packet_type, uint16_t cid, uint8_t *packet, uint16_t size){
+    UNUSED(cid);
+    switch (packet_type){
+        case HCI_EVENT_PACKET:
+            if (hci_event_packet_get_type(packet) != L2CAP_EVENT_CHANNEL_OPENED) break;
+            if (l2cap_event_channel_opened_get_status(packet)) break;
+            channel_open = 1;
+            break;
+        case L2CAP_DATA_PACKET:
+            num_received++;
+            received_size = size;
+            received_data = packet;
+            if (!copy_data) break;
+            // application keeps SDU beyond packet handler
+            memcpy(application_buffer, packet, size);
+            received_data = application_buffer;
+            break;
+        default:
+            break;
+    }
+}
+
+static void open_channel(int use_receive_buffer){
+    btstack_memory_init();
+    hci_init(fake_controller_init(4), NULL);
+    l2cap_init();
+    fake_controller_power_on();
+    fake_controller_connect(remote_address);
+
+    channel_open = 0;
+    l2cap_create_channel(&channel_packet_handler, remote_address, FAKE_CONTROLLER_PSM_BASE, l2cap_max_mtu(), &local_cid);
+    if (use_receive_buffer){
+        l2cap_set_receive_buffer(local_cid, receive_buffer, sizeof(receive_buffer));
+    }
+    fake_controller_run_until_idle();
+    if (!channel_open){
+        fprintf(stderr, "channel not opened\n");
+        exit(1);
+    }
+}
+
+// send SDU from remote in fragments of FRAGMENT_SIZE
+static void receive_sdu(uint16_t size){
+    uint8_t fragment[HCI_ACL_HEADER_SIZE + FRAGMENT_SIZE];
+    uint8_t l2cap_header[L2CAP_HEADER_SIZE];
+    little_endian_store_16(l2cap_header, 0, size);
+    little_endian_store_16(l2cap_header, 2, local_cid);
+    int total = L2CAP_HEADER_SIZE + size;
+    int pos = 0;
+    while (pos < total){
+        int len = btstack_min(FRAGMENT_SIZE, total - pos);
+        uint16_t flags = pos ? 0x1000 : 0x2000;
+        little_endian_store_16(fragment, 0, FAKE_CONTROLLER_CON_HANDLE | flags);
+        little_endian_store_16(fragment, 2, len);
+        if (pos == 0){
+            memcpy(&fragment[HCI_ACL_HEADER_SIZE], l2cap_header, L2CAP_HEADER_SIZE);
+            memcpy(&fragment[HCI_ACL_HEADER_SIZE + L2CAP_HEADER_SIZE], sdu, len - L2CAP_HEADER_SIZE);
+        } else {
+            memcpy(&fragment[HCI_ACL_HEADER_SIZE], &sdu[pos - L2CAP_HEADER_SIZE], len);
+        }
+        fake_controller_receive_acl_packet(fragment, HCI_ACL_HEADER_SIZE + len);
+        pos += len;
+    }
+}
+
+static int received_sdu_valid(uint16_t size){
+    return received_size == size && memcmp(received_data, sdu, size) == 0;
+}
+
+static int run(const char * name, int use_receive_buffer){
+    open_channel(use_receive_buffer);
+    copy_data = !use_receive_buffer;
+    num_received = 0;
+
+    uint64_t start_ns = benchmark_time_ns();
+    int i;
+    for (i = 0; i < num_sdus; i++){
+        receive_sdu(SDU_SIZE);
+    }
+    uint64_t duration_ns = benchmark_time_ns() - start_ns;
+
+    int ok = 1;
+    if (num_received != num_sdus || !received_sdu_valid(SDU_SIZE)){
+        fprintf(stderr, "%s: received %u of %u SDUs\n", name, num_received, num_sdus);
+        ok = 0;
+    }
+    if (use_receive_buffer && received_data != &receive_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + HCI_ACL_HEADER_SIZE + L2CAP_HEADER_SIZE]){
+        fprintf(stderr, "%s: SDU not delivered in receive buffer\n", name);
+        ok = 0;
+    }
+
+    // SDU larger than connection's recombination buffer
+    num_received = 0;
+    receive_sdu(LARGE_SDU_SIZE);
+    int large_received = num_received == 1 && received_sdu_valid(LARGE_SDU_SIZE);
+    if (large_received != use_receive_buffer){
+        fprintf(stderr, "%s: %u byte SDU %s\n", name, LARGE_SDU_SIZE, large_received ? "received" : "dropped");
+        ok = 0;
+    }
+
+    double mb_per_s = (double) num_sdus * SDU_SIZE * 1000.0 / duration_ns;
+    printf("%-40s %8.1f MB/s  %6.1f ns/SDU  %u byte SDU: %s\n", name, mb_per_s, (double) duration_ns / num_sdus,
+        LARGE_SDU_SIZE, large_received ? "received" : "dropped");
+    return ok;
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_sdus = atoi(argv[1]);
+    }
+
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+    hci_dump_enable_log_level(LOG_LEVEL_ERROR, 0);
+
+    int i;
+    for (i = 0; i < LARGE_SDU_SIZE; i++){
+        sdu[i] = (uint8_t) (i * 7);
+    }
+
+    printf("%u SDUs of %u bytes in %u byte fragments\n", num_sdus, SDU_SIZE, FRAGMENT_SIZE);
+    int ok = run("recombination buffer + application copy", 0);
+    ok &= run("receive buffer", 1);
+    return ok ? 0 : 1;
+}
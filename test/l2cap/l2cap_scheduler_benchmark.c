@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  l2cap_scheduler_benchmark.c
+ *
+ *  Opens several L2CAP channels on one classic connection via a fake remote and lets them
+ *  saturate a controller with NUM_CONTROLLER_ACL_PACKETS buffers. The controller completes one
+ *  packet per tick. A high priority control channel requests to send every CONTROL_INTERVAL
+ *  ticks. For each channel, the share of sent packets and the latency from request to
+ *  L2CAP_EVENT_CAN_SEND_NOW in ticks is reported, once for the weighted round robin scheduler
+ *  and once for a scheduler that always serves the channels in list order.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btstack_defines.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "hci_transport.h"
+#include "l2cap.h"
+
+#include "fake_controller.h"
+
+#define DEFAULT_NUM_TICKS           100000
+#define NUM_CONTROLLER_ACL_PACKETS  4
+#define NUM_CHANNELS                5
+#define CONTROL_INTERVAL            50
+#define PAYLOAD_LEN                 40
+
+typedef struct {
+    uint8_t  weight;
+    uint8_t  high_priority;
+    uint16_t local_cid;
+    int      open;
+    int      waiting;
+    uint32_t request_tick;
+    int      num_sent;
+    int      num_latencies;
+    uint32_t * latencies;
+} benchmark_channel_t;
+
+// channel 0 is the control channel, the others saturate the link
+static const uint8_t channel_weights[NUM_CHANNELS] = { 1, 1, 1, 2, 4 };
+
+static benchmark_channel_t channels[NUM_CHANNELS];
+static uint32_t num_ticks = DEFAULT_NUM_TICKS;
+static uint32_t tick;
+static bd_addr_t remote_address = { 0x00, 0x1b, 0xdc, 0x07, 0x32, 0xef };
+static uint8_t payload[PAYLOAD_LEN];
+
+static void data_handler(int index, uint8_t * packet, uint16_t size){
+    UNUSED(packet);
+    UNUSED(size);
+    if (index < NUM_CHANNELS){
+        channels[index].num_sent++;
+    }
+}
+
+// host
+
+static benchmark_channel_t * channel_for_local_cid(uint16_t local_cid){
+    int i;
+    for (i = 0; i < NUM_CHANNELS; i++){
+        if (channels[i].local_cid == local_cid) return &channels[i];
+    }
+    return NULL;
+}
+
+static void channel_request_can_send_now(benchmark_channel_t * channel);
+
+static void channel_packet_handler(uint8_t packet_type, uint16_t cid, uint8_t *packet, uint16_t size){
+    UNUSED(cid);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    benchmark_channel_t * channel;
+    switch (hci_event_packet_get_type(packet)){
+        case L2CAP_EVENT_CHANNEL_OPENED:
+            if (l2cap_event_channel_opened_get_status(packet)) break;
+            channel = channel_for_local_cid(l2cap_event_channel_opened_get_local_cid(packet));
+            if (!channel) break;
+            channel->open = 1;
+            l2cap_set_channel_weight(channel->local_cid, channel->weight);
+            if (channel->high_priority){
+                l2cap_set_channel_priority(channel->local_cid, L2CAP_CHANNEL_PRIORITY_HIGH);
+            }
+            break;
+        case L2CAP_EVENT_CAN_SEND_NOW:
+            channel = channel_for_local_cid(little_endian_read_16(packet, 2));
+            if (!channel) break;
+            channel->waiting = 0;
+            channel->latencies[channel->num_latencies++] = tick - channel->request_tick;
+            if (l2cap_send(channel->local_cid, payload, PAYLOAD_LEN)){
+                fprintf(stderr, "l2cap_send failed\n");
+                exit(1);
+            }
+            if (channel->high_priority) break;
+            // saturate
+            channel_request_can_send_now(channel);
+            break;
+        default:
+            break;
+    }
+}
+
+static void channel_request_can_send_now(benchmark_channel_t * channel){
+    channel->waiting = 1;
+    channel->request_tick = tick;
+    l2cap_request_can_send_now_event(channel->local_cid);
+}
+
+// old behaviour: first waiting channel in list order
+static l2cap_channel_t * list_order_next_channel(btstack_linked_list_t * list){
+    btstack_linked_item_t * it;
+    for (it = *list; it ; it = it->next){
+        l2cap_channel_t * channel = (l2cap_channel_t *) it;
+        if (!channel->waiting_for_can_send_now) continue;
+        if (!hci_can_send_acl_packet_now(channel->con_handle)) continue;
+        return channel;
+    }
+    return NULL;
+}
+
+static const l2cap_scheduler_t list_order_scheduler = {
+    /* l2cap_channel_t * (*next_channel)(btstack_linked_list_t * channels); */ &list_order_next_channel,
+};
+
+static int compare_latencies(const void * a, const void * b){
+    uint32_t latency_a = *(const uint32_t *) a;
+    uint32_t latency_b = *(const uint32_t *) b;
+    if (latency_a < latency_b) return -1;
+    if (latency_a > latency_b) return 1;
+    return 0;
+}
+
+static uint32_t percentile(benchmark_channel_t * channel, int percent){
+    if (!channel->num_latencies) return 0;
+    return channel->latencies[(channel->num_latencies - 1) * percent / 100];
+}
+
+static void run(const char * name, const l2cap_scheduler_t * scheduler){
+    btstack_memory_init();
+    hci_init(fake_controller_init(NUM_CONTROLLER_ACL_PACKETS), NULL);
+    l2cap_init();
+    l2cap_set_scheduler(scheduler);
+
+    memset(channels, 0, sizeof(channels));
+    int i;
+    for (i = 0; i < NUM_CHANNELS; i++){
+        channels[i].weight = channel_weights[i];
+        channels[i].high_priority = i == 0;
+        channels[i].latencies = (uint32_t *) malloc(num_ticks * sizeof(uint32_t));
+    }
+    tick = 0;
+    fake_controller_register_data_handler(&data_handler);
+    fake_controller_power_on();
+
+    // connect and open channels
+    fake_controller_connect(remote_address);
+    for (i = 0; i < NUM_CHANNELS; i++){
+        l2cap_create_channel(&channel_packet_handler, remote_address, FAKE_CONTROLLER_PSM_BASE + i, 100, &channels[i].local_cid);
+        fake_controller_run_until_idle();
+    }
+    for (i = 0; i < NUM_CHANNELS; i++){
+        if (!channels[i].open){
+            fprintf(stderr, "channel %u not opened\n", i);
+            exit(1);
+        }
+    }
+
+    // saturate
+    for (i = 1; i < NUM_CHANNELS; i++){
+        channel_request_can_send_now(&channels[i]);
+    }
+    for (tick = 1; tick <= num_ticks; tick++){
+        if ((tick % CONTROL_INTERVAL) == 0 && !channels[0].waiting){
+            channel_request_can_send_now(&channels[0]);
+        }
+        if (fake_controller_acl_packets_in_flight()){
+            fake_controller_complete_packet();
+        }
+        fake_controller_run();
+    }
+
+    // starved channels are still waiting
+    int total_sent = 0;
+    for (i = 0; i < NUM_CHANNELS; i++){
+        total_sent += channels[i].num_sent;
+        if (channels[i].waiting){
+            channels[i].latencies[channels[i].num_latencies++] = num_ticks - channels[i].request_tick;
+        }
+    }
+
+    printf("%s scheduler, %u ticks, %u controller buffers\n", name, num_ticks, NUM_CONTROLLER_ACL_PACKETS);
+    printf("channel  weight  priority  packets   share  latency p50   p99   max\n");
+    for (i = 0; i < NUM_CHANNELS; i++){
+        benchmark_channel_t * channel = &channels[i];
+        qsort(channel->latencies, channel->num_latencies, sizeof(uint32_t), &compare_latencies);
+        printf("%7u  %6u  %8s  %7u  %5.1f%%  %11u %5u %5u\n", i, channel->weight, channel->high_priority ? "high" : "normal",
+            channel->num_sent, 100.0 * channel->num_sent / total_sent, percentile(channel, 50), percentile(channel, 99), percentile(channel, 100));
+    }
+    printf("\n");
+}
+
+// weighted round robin: saturating channels share link according to their weights, control channel is served within a tick
+static int verify(void){
+    int total_sent = 0;
+    int total_weight = 0;
+    int i;
+    for (i = 1; i < NUM_CHANNELS; i++){
+        total_sent   += channels[i].num_sent;
+        total_weight += channels[i].weight;
+    }
+    int ok = 1;
+    for (i = 1; i < NUM_CHANNELS; i++){
+        double share = (double) channels[i].num_sent / total_sent;
+        double expected = (double) channels[i].weight / total_weight;
+        if (share < expected - 0.01 || share > expected + 0.01){
+            fprintf(stderr, "channel %u: share %.3f, expected %.3f\n", i, share, expected);
+            ok = 0;
+        }
+    }
+    if (percentile(&channels[0], 100) > 1){
+        fprintf(stderr, "control channel: max latency %u ticks\n", percentile(&channels[0], 100));
+        ok = 0;
+    }
+    return ok;
+}
+
+static void free_latencies(void){
+    int i;
+    for (i = 0; i < NUM_CHANNELS; i++){
+        free(channels[i].latencies);
+    }
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_ticks = atoi(argv[1]);
+    }
+
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+
+    run("list order", &list_order_scheduler);
+    free_latencies();
+
+    run("weighted round robin", l2cap_scheduler_weighted_round_robin_get_instance());
+    int ok = verify();
+    free_latencies();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+//
+// btstack_config.h for le_device_db_fs test and benchmark
+//
+
+#ifndef __BTSTACK_CONFIG
+#define __BTSTACK_CONFIG
+
+// Port related features
+#define HAVE_POSIX_TIME
+
+// BTstack features that can be enabled
+#define ENABLE_BLE
+#define ENABLE_LE_SIGNED_WRITE
+#define ENABLE_LOG_ERROR
+#define ENABLE_LOG_INFO
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 52
+#define LE_DEVICE_DB_FS_JOURNAL_MAX_SIZE 65536
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  le_device_db_fs_benchmark.c
+ *
+ *  Bonds NUM_DEVICES devices and measures the time for NUM_UPDATES remote signing counter updates, as done for every
+ *  received signed write. Afterwards, the db is reloaded from the file system and all counters are verified.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "ble/le_device_db.h"
+#include "btstack_debug.h"
+#include "btstack_util.h"
+#include "hci_dump.h"
+
+#define NUM_DEVICES 20
+#define NUM_UPDATES 100000
+
+static bd_addr_t local_addr = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x23 };
+#define DB_PATH_PREFIX "/tmp/btstack_at_00-00-00-00-10-23_le_device_db"
+
+static int num_updates = NUM_UPDATES;
+static uint32_t expected_counters[NUM_DEVICES];
+
+uint32_t btstack_run_loop_get_time_ms(void) { return 0; }
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static void remove_files(void){
+    remove(DB_PATH_PREFIX ".bin");
+    remove(DB_PATH_PREFIX ".txt");
+}
+
+static long file_size(const char * path){
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    return (long) st.st_size;
+}
+
+static void setup_devices(void){
+    le_device_db_init();
+    le_device_db_set_local_bd_addr(local_addr);
+    int i;
+    for (i = 0; i < NUM_DEVICES; i++){
+        bd_addr_t addr = { 0x00, 0x1B, 0xDC, 0x00, 0x00, (uint8_t) i };
+        sm_key_t key;
+        memset(key, i, 16);
+        uint8_t rand[8];
+        memset(rand, i, 8);
+        int index = le_device_db_add(BD_ADDR_TYPE_LE_RANDOM, addr, key);
+        le_device_db_encryption_set(index, 0x1000 + i, rand, key, 16, 1, 0);
+        le_device_db_remote_csrk_set(index, key);
+        expected_counters[index] = 0;
+    }
+}
+
+static int verify_devices(void){
+    int i;
+    for (i = 0; i < NUM_DEVICES; i++){
+        bd_addr_t addr;
+        le_device_db_info(i, NULL, addr, NULL);
+        if (addr[5] != i) return 0;
+        if (le_device_db_remote_counter_get(i) != expected_counters[i]) return 0;
+    }
+    return le_device_db_count() == NUM_DEVICES;
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_updates = atoi(argv[1]);
+    }
+
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+    hci_dump_enable_log_level(LOG_LEVEL_ERROR, 0);
+
+    remove_files();
+    setup_devices();
+
+    uint64_t start_ns = benchmark_time_ns();
+    int i;
+    for (i = 0; i < num_updates; i++){
+        int index = i % NUM_DEVICES;
+        le_device_db_remote_counter_set(index, ++expected_counters[index]);
+    }
+    uint64_t duration_ns = benchmark_time_ns() - start_ns;
+    printf("%u devices, %u remote counter updates: %9.1f ns/update, file size %ld bytes\n", NUM_DEVICES, num_updates,
+        (double) duration_ns / num_updates, file_size(DB_PATH_PREFIX ".bin") + file_size(DB_PATH_PREFIX ".txt"));
+
+    start_ns = benchmark_time_ns();
+    le_device_db_init();
+    le_device_db_set_local_bd_addr(local_addr);
+    duration_ns = benchmark_time_ns() - start_ns;
+    printf("reload: %.1f us\n", (double) duration_ns / 1000);
+
+    int ok = verify_devices();
+    remove_files();
+    if (!ok){
+        printf("reloaded db differs\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "ble/le_device_db.h"
+#include "btstack_util.h"
+#include "hci_dump.h"
+
+#include "btstack_config.h"
+
+extern "C" uint32_t btstack_run_loop_get_time_ms(void) { return 0; }
+
+#define DB_PATH_PREFIX "/tmp/btstack_at_00-00-00-00-10-42_le_device_db"
+
+static bd_addr_t local_addr = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x42 };
+
+static long file_size(const char * path){
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    return (long) st.st_size;
+}
+
+static void reload(void){
+    le_device_db_init();
+    le_device_db_set_local_bd_addr(local_addr);
+}
+
+TEST_GROUP(LEDeviceDBFS){
+    bd_addr_t addr;
+    sm_key_t irk;
+    sm_key_t ltk;
+    uint8_t rand[8];
+
+    void setup(void){
+        remove(DB_PATH_PREFIX ".bin");
+        remove(DB_PATH_PREFIX ".txt");
+        bd_addr_t addr_1 = { 0x00, 0x1B, 0xDC, 0x01, 0x02, 0x03 };
+        bd_addr_copy(addr, addr_1);
+        memset(irk, 0x11, 16);
+        memset(ltk, 0x22, 16);
+        memset(rand, 0x33, 8);
+        reload();
+    }
+
+    void teardown(void){
+        le_device_db_init();
+        remove(DB_PATH_PREFIX ".bin");
+        remove(DB_PATH_PREFIX ".txt");
+    }
+
+    int add_device(void){
+        int index = le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, addr, irk);
+        CHECK(index >= 0);
+        le_device_db_encryption_set(index, 0x1234, rand, ltk, 16, 1, 0);
+        return index;
+    }
+
+    void check_device(int index){
+        int addr_type;
+        bd_addr_t test_addr;
+        sm_key_t test_key;
+        uint8_t test_rand[8];
+        uint16_t ediv;
+        int key_size, authenticated, authorized;
+        le_device_db_info(index, &addr_type, test_addr, test_key);
+        CHECK_EQUAL(BD_ADDR_TYPE_LE_PUBLIC, addr_type);
+        MEMCMP_EQUAL(addr, test_addr, 6);
+        MEMCMP_EQUAL(irk, test_key, 16);
+        le_device_db_encryption_get(index, &ediv, test_rand, test_key, &key_size, &authenticated, &authorized);
+        CHECK_EQUAL(0x1234, ediv);
+        MEMCMP_EQUAL(rand, test_rand, 8);
+        MEMCMP_EQUAL(ltk, test_key, 16);
+        CHECK_EQUAL(16, key_size);
+        CHECK_EQUAL(1, authenticated);
+        CHECK_EQUAL(0, authorized);
+    }
+};
+
+TEST(LEDeviceDBFS, AddReload){
+    int index = add_device();
+    le_device_db_remote_csrk_set(index, ltk);
+    le_device_db_remote_counter_set(index, 100000);
+    le_device_db_local_counter_set(index, 7);
+    reload();
+    CHECK_EQUAL(1, le_device_db_count());
+    check_device(index);
+    sm_key_t csrk;
+    le_device_db_remote_csrk_get(index, csrk);
+    MEMCMP_EQUAL(ltk, csrk, 16);
+    CHECK_EQUAL(100000, le_device_db_remote_counter_get(index));
+    CHECK_EQUAL(7, le_device_db_local_counter_get(index));
+}
+
+TEST(LEDeviceDBFS, RemoveReload){
+    int index = add_device();
+    le_device_db_remove(index);
+    reload();
+    CHECK_EQUAL(0, le_device_db_count());
+}
+
+TEST(LEDeviceDBFS, CounterUpdateAppendsRecord){
+    int index = add_device();
+    long size = file_size(DB_PATH_PREFIX ".bin");
+    le_device_db_remote_counter_set(index, 1);
+    long record_size = file_size(DB_PATH_PREFIX ".bin") - size;
+    CHECK(record_size > 0);
+    CHECK(record_size < 16);
+    le_device_db_remote_counter_set(index, 2);
+    CHECK_EQUAL(size + 2 * record_size, file_size(DB_PATH_PREFIX ".bin"));
+}
+
+TEST(LEDeviceDBFS, Compaction){
+    int index = add_device();
+    uint32_t counter;
+    for (counter = 1; counter <= 20000; counter++){
+        le_device_db_remote_counter_set(index, counter);
+        CHECK(file_size(DB_PATH_PREFIX ".bin") <= LE_DEVICE_DB_FS_JOURNAL_MAX_SIZE);
+    }
+    reload();
+    check_device(index);
+    CHECK_EQUAL(20000, le_device_db_remote_counter_get(index));
+}
+
+TEST(LEDeviceDBFS, IncompleteRecordIgnored){
+    int index = add_device();
+    le_device_db_remote_counter_set(index, 1);
+    le_device_db_remote_counter_set(index, 2);
+    long size = file_size(DB_PATH_PREFIX ".bin");
+    // simulate crash while appending last record
+    CHECK_EQUAL(0, truncate(DB_PATH_PREFIX ".bin", size - 1));
+    reload();
+    check_device(index);
+    CHECK_EQUAL(1, le_device_db_remote_counter_get(index));
+    // damaged record removed from journal
+    le_device_db_remote_counter_set(index, 3);
+    reload();
+    CHECK_EQUAL(3, le_device_db_remote_counter_get(index));
+}
+
+TEST(LEDeviceDBFS, TornRecordHeaderIgnored){
+    int index = add_device();
+    le_device_db_remote_counter_set(index, 5);
+    long size = file_size(DB_PATH_PREFIX ".bin");
+    le_device_db_remote_counter_set(index, 6);
+    // simulate crash after first two bytes of last record
+    CHECK_EQUAL(0, truncate(DB_PATH_PREFIX ".bin", size + 2));
+    reload();
+    CHECK_EQUAL(5, le_device_db_remote_counter_get(index));
+    // update written after torn record survives restart
+    le_device_db_remote_counter_set(index, 9);
+    reload();
+    check_device(index);
+    CHECK_EQUAL(9, le_device_db_remote_counter_get(index));
+}
+
+TEST(LEDeviceDBFS, CorruptRecordIgnored){
+    int index = add_device();
+    le_device_db_remote_counter_set(index, 1);
+    le_device_db_remote_counter_set(index, 2);
+    long size = file_size(DB_PATH_PREFIX ".bin");
+    // flip bit in counter value of last record
+    FILE * file = fopen(DB_PATH_PREFIX ".bin", "r+b");
+    CHECK(file != NULL);
+    fseek(file, size - 6, SEEK_SET);
+    int c = fgetc(file);
+    fseek(file, size - 6, SEEK_SET);
+    fputc(c ^ 0x01, file);
+    fclose(file);
+    reload();
+    check_device(index);
+    CHECK_EQUAL(1, le_device_db_remote_counter_get(index));
+}
+
+TEST(LEDeviceDBFS, MigrateCSV){
+    FILE * file = fopen(DB_PATH_PREFIX ".txt", "w");
+    CHECK(file != NULL);
+    fprintf(file, "# addr_type, addr, irk, ltk, ediv, rand[8], key_size, authenticated, authorized, remote_csrk, remote_counter, local_csrk, local_counter\n");
+    fprintf(file, "00,00:1B:DC:01:02:03,11111111111111111111111111111111,22222222222222222222222222222222,1234,3333333333333333,10,01,00,"
+        "22222222222222222222222222222222,0005,00000000000000000000000000000000,0000,\n");
+    fclose(file);
+    reload();
+    CHECK_EQUAL(1, le_device_db_count());
+    check_device(0);
+    CHECK_EQUAL(5, le_device_db_remote_counter_get(0));
+    CHECK(file_size(DB_PATH_PREFIX ".bin") > 0);
+    remove(DB_PATH_PREFIX ".txt");
+    reload();
+    check_device(0);
+}
+
+int main (int argc, const char * argv[]){
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+    hci_dump_enable_log_level(LOG_LEVEL_ERROR, 0);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  btstack_run_loop_benchmark.c
+ *
+ *  Measures the time from a file descriptor becoming readable until its data source
+ *  gets called, with a number of idle data sources registered with the run loop.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btstack_defines.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_epoll.h"
+#include "btstack_run_loop_posix.h"
+
+#define NUM_ITERATIONS 20000
+
+static const int idle_source_counts[] = { 1, 64, 1024 };
+
+static btstack_data_source_t   active_data_source;
+static int                     active_pipe[2];
+static btstack_data_source_t * idle_data_sources;
+
+static uint64_t wakeup_ns;
+static uint64_t total_ns;
+static uint64_t max_ns;
+static int      iteration;
+static const char * run_loop_name;
+static int      num_idle_sources;
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static void benchmark_trigger(void){
+    uint8_t byte = 0;
+    wakeup_ns = benchmark_time_ns();
+    if (write(active_pipe[1], &byte, 1) != 1){
+        fprintf(stderr, "write failed, errno %d\n", errno);
+        exit(1);
+    }
+}
+
+static void idle_process(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(ds);
+    UNUSED(callback_type);
+    fprintf(stderr, "idle data source got called\n");
+    exit(1);
+}
+
+static void active_process(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    uint64_t delta_ns = benchmark_time_ns() - wakeup_ns;
+    uint8_t byte;
+    if (read(ds->fd, &byte, 1) != 1){
+        fprintf(stderr, "read failed, errno %d\n", errno);
+        exit(1);
+    }
+    total_ns += delta_ns;
+    if (delta_ns > max_ns){
+        max_ns = delta_ns;
+    }
+    iteration++;
+    if (iteration < NUM_ITERATIONS){
+        benchmark_trigger();
+        return;
+    }
+    printf("%-6s %5u idle sources: avg %6.2f us, max %8.2f us\n", run_loop_name, num_idle_sources,
+        (double) total_ns / NUM_ITERATIONS / 1000.0, (double) max_ns / 1000.0);
+    exit(0);
+}
+
+// runs in child process as run loop can only be initialized once and btstack_run_loop_execute does not return
+static void benchmark_run(const btstack_run_loop_t * run_loop){
+    btstack_run_loop_init(run_loop);
+
+    int i;
+    idle_data_sources = (btstack_data_source_t *) calloc(num_idle_sources, sizeof(btstack_data_source_t));
+    for (i=0;i<num_idle_sources;i++){
+        int fd = eventfd(0, 0);
+        if (fd < 0){
+            fprintf(stderr, "eventfd failed, errno %d\n", errno);
+            exit(1);
+        }
+        btstack_data_source_t * ds = &idle_data_sources[i];
+        btstack_run_loop_set_data_source_fd(ds, fd);
+        btstack_run_loop_set_data_source_handler(ds, &idle_process);
+        btstack_run_loop_enable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_READ);
+        btstack_run_loop_add_data_source(ds);
+    }
+
+    if (pipe(active_pipe)){
+        fprintf(stderr, "pipe failed, errno %d\n", errno);
+        exit(1);
+    }
+    btstack_run_loop_set_data_source_fd(&active_data_source, active_pipe[0]);
+    btstack_run_loop_set_data_source_handler(&active_data_source, &active_process);
+    btstack_run_loop_enable_data_source_callbacks(&active_data_source, DATA_SOURCE_CALLBACK_READ);
+    btstack_run_loop_add_data_source(&active_data_source);
+
+    benchmark_trigger();
+    btstack_run_loop_execute();
+}
+
+static void benchmark(const char * name, const btstack_run_loop_t * run_loop, int num_idle, int max_fd){
+    run_loop_name = name;
+    num_idle_sources = num_idle;
+    // idle eventfds + pipe + stdio
+    if (max_fd && num_idle + 5 > max_fd){
+        printf("%-6s %5u idle sources: skipped, exceeds FD_SETSIZE\n", name, num_idle);
+        return;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0){
+        benchmark_run(run_loop);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+        printf("%-6s %5u idle sources: failed\n", name, num_idle);
+    }
+}
+
+int main(void){
+    // allow for more than 1024 file descriptors
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0){
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    printf("Wakeup-to-dispatch latency, %u iterations\n", NUM_ITERATIONS);
+    unsigned int i;
+    for (i=0;i<sizeof(idle_source_counts)/sizeof(int);i++){
+        benchmark("posix", btstack_run_loop_posix_get_instance(), idle_source_counts[i], FD_SETSIZE);
+        benchmark("epoll", btstack_run_loop_epoll_get_instance(), idle_source_counts[i], 0);
+    }
+    return 0;
+}
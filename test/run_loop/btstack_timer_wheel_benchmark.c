@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  btstack_timer_wheel_benchmark.c
+ *
+ *  Compares the sorted timer list used by the run loops so far with btstack_timer_wheel
+ *  with 10000 active timers: restarting timers (e.g. L2CAP RTX) and timer expiration.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_linked_list.h"
+#include "btstack_run_loop.h"
+#include "btstack_timer_wheel.h"
+
+#define NUM_TIMERS          10000
+#define NUM_RESTARTS        200000
+#define MAX_TIMEOUT_MS      60000
+#define EXPIRATION_TIME_MS  (2 * MAX_TIMEOUT_MS)
+
+static btstack_timer_source_t timers[NUM_TIMERS];
+
+static btstack_linked_list_t  timer_list;
+static btstack_timer_wheel_t  timer_wheel;
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// sorted list as used by btstack_run_loop_posix
+static void list_add(btstack_timer_source_t * ts){
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) &timer_list; it->next ; it = it->next){
+        btstack_timer_source_t * next = (btstack_timer_source_t *) it->next;
+        if (next->timeout > ts->timeout) {
+            break;
+        }
+    }
+    ts->item.next = it->next;
+    it->next = (btstack_linked_item_t *) ts;
+}
+
+static void list_remove(btstack_timer_source_t * ts){
+    btstack_linked_list_remove(&timer_list, (btstack_linked_item_t *) ts);
+}
+
+static btstack_timer_source_t * list_get_expired(uint32_t now){
+    btstack_timer_source_t * ts = (btstack_timer_source_t *) timer_list;
+    if (!ts || ts->timeout > now) return NULL;
+    list_remove(ts);
+    return ts;
+}
+
+static void wheel_add(btstack_timer_source_t * ts){
+    btstack_timer_wheel_add(&timer_wheel, ts);
+}
+
+static void wheel_remove(btstack_timer_source_t * ts){
+    btstack_timer_wheel_remove(&timer_wheel, ts);
+}
+
+static btstack_timer_source_t * wheel_get_expired(uint32_t now){
+    return btstack_timer_wheel_get_expired(&timer_wheel, now);
+}
+
+static void benchmark(const char * name, void (*add)(btstack_timer_source_t * ts), void (*remove)(btstack_timer_source_t * ts),
+    btstack_timer_source_t * (*get_expired)(uint32_t now)){
+
+    int i;
+    uint32_t now = 0;
+    srand(1);
+    memset(timers, 0, sizeof(timers));
+    timer_list = NULL;
+    btstack_timer_wheel_init(&timer_wheel, now);
+
+    for (i=0;i<NUM_TIMERS;i++){
+        timers[i].timeout = now + 1 + rand() % MAX_TIMEOUT_MS;
+        add(&timers[i]);
+    }
+
+    // restart random timers
+    uint64_t start_ns = benchmark_time_ns();
+    for (i=0;i<NUM_RESTARTS;i++){
+        btstack_timer_source_t * ts = &timers[rand() % NUM_TIMERS];
+        remove(ts);
+        ts->timeout = now + 1 + rand() % MAX_TIMEOUT_MS;
+        add(ts);
+    }
+    uint64_t restart_ns = benchmark_time_ns() - start_ns;
+
+    // advance time in 1 ms steps, re-arm expired timers
+    int num_expired = 0;
+    start_ns = benchmark_time_ns();
+    for (now = 1; now <= EXPIRATION_TIME_MS; now++){
+        btstack_timer_source_t * ts;
+        while ((ts = get_expired(now)) != NULL){
+            num_expired++;
+            ts->timeout = now + 1 + rand() % MAX_TIMEOUT_MS;
+            add(ts);
+        }
+    }
+    uint64_t expiration_ns = benchmark_time_ns() - start_ns;
+
+    printf("%-5s: restart %8.1f ns/timer, expiration %8.1f ns/timer (%u expired)\n", name,
+        (double) restart_ns / NUM_RESTARTS, (double) expiration_ns / num_expired, num_expired);
+}
+
+int main(void){
+    printf("%u active timers\n", NUM_TIMERS);
+    benchmark("list",  &list_add,  &list_remove,  &list_get_expired);
+    benchmark("wheel", &wheel_add, &wheel_remove, &wheel_get_expired);
+    return 0;
+}
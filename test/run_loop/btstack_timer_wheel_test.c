@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_timer_wheel.h"
+
+#define NUM_TIMERS 200
+
+static btstack_timer_wheel_t  wheel;
+static btstack_timer_source_t timers[NUM_TIMERS];
+static int active[NUM_TIMERS];
+// timers that were already expired when added are not sorted
+static int added_expired[NUM_TIMERS];
+
+static int timer_index(btstack_timer_source_t * ts){
+    return ts - timers;
+}
+
+// pop all expired timers and verify against reference model
+static void check_expired(uint32_t now){
+    int32_t last_delta = INT32_MIN;
+    btstack_timer_source_t * ts;
+    while ((ts = btstack_timer_wheel_get_expired(&wheel, now)) != NULL){
+        int index = timer_index(ts);
+        CHECK(active[index]);
+        int32_t delta = (int32_t)(ts->timeout - now);
+        CHECK(delta <= 0);
+        if (!added_expired[index]){
+            CHECK(delta >= last_delta);
+            last_delta = delta;
+        }
+        active[index] = 0;
+    }
+    int i;
+    for (i=0;i<NUM_TIMERS;i++){
+        if (!active[i]) continue;
+        CHECK((int32_t)(timers[i].timeout - now) > 0);
+    }
+}
+
+static void check_next_timeout(uint32_t now){
+    uint32_t timeout;
+    int has_timeout = btstack_timer_wheel_get_next_timeout(&wheel, &timeout);
+    int32_t min_delta = INT32_MAX;
+    int num_active = 0;
+    int i;
+    for (i=0;i<NUM_TIMERS;i++){
+        if (!active[i]) continue;
+        num_active++;
+        int32_t delta = (int32_t)(timers[i].timeout - now);
+        if (delta < min_delta){
+            min_delta = delta;
+        }
+    }
+    CHECK_EQUAL(num_active > 0, has_timeout);
+    CHECK_EQUAL(num_active == 0, btstack_timer_wheel_empty(&wheel));
+    if (!has_timeout) return;
+    // wheel must not sleep past the earliest timer
+    if (min_delta < 0){
+        min_delta = 0;
+    }
+    CHECK((int32_t)(timeout - now) <= min_delta);
+}
+
+static void run_random_operations(uint32_t start, int iterations){
+    uint32_t now = start;
+    btstack_timer_wheel_init(&wheel, now);
+    int i;
+    for (i=0;i<iterations;i++){
+        int index = rand() % NUM_TIMERS;
+        switch (rand() % 4){
+            case 0:
+            case 1:
+                btstack_timer_wheel_remove(&wheel, &timers[index]);
+                // timeouts on all levels, including already expired
+                timers[index].timeout = now + (rand() % (1 << (rand() % 24))) - 2;
+                btstack_timer_wheel_add(&wheel, &timers[index]);
+                active[index] = 1;
+                added_expired[index] = (int32_t)(timers[index].timeout - now) <= 0;
+                break;
+            case 2:
+                CHECK_EQUAL(active[index], btstack_timer_wheel_remove(&wheel, &timers[index]));
+                active[index] = 0;
+                break;
+            default:
+                now += rand() % (1 << (rand() % 20));
+                check_expired(now);
+                break;
+        }
+        check_next_timeout(now);
+    }
+    // expire everything
+    now += 1 << 24;
+    check_expired(now);
+    CHECK(btstack_timer_wheel_empty(&wheel));
+}
+
+TEST_GROUP(TimerWheel){
+    void setup(void){
+        memset(timers, 0, sizeof(timers));
+        memset(active, 0, sizeof(active));
+        memset(added_expired, 0, sizeof(added_expired));
+        srand(0);
+    }
+};
+
+TEST(TimerWheel, Empty){
+    uint32_t timeout;
+    btstack_timer_wheel_init(&wheel, 1000);
+    CHECK(btstack_timer_wheel_empty(&wheel));
+    CHECK_EQUAL(0, btstack_timer_wheel_get_next_timeout(&wheel, &timeout));
+    CHECK(btstack_timer_wheel_get_expired(&wheel, 5000) == NULL);
+    CHECK_EQUAL(0, btstack_timer_wheel_remove(&wheel, &timers[0]));
+}
+
+TEST(TimerWheel, ExpireInOrder){
+    btstack_timer_wheel_init(&wheel, 0);
+    timers[0].timeout = 5000;
+    timers[1].timeout = 20;
+    timers[2].timeout = 300;
+    timers[3].timeout = 20;
+    int i;
+    for (i=0;i<4;i++){
+        btstack_timer_wheel_add(&wheel, &timers[i]);
+    }
+    CHECK(btstack_timer_wheel_get_expired(&wheel, 19) == NULL);
+    btstack_timer_source_t * first  = btstack_timer_wheel_get_expired(&wheel, 20);
+    btstack_timer_source_t * second = btstack_timer_wheel_get_expired(&wheel, 20);
+    CHECK(first  == &timers[1] || first  == &timers[3]);
+    CHECK(second == &timers[1] || second == &timers[3]);
+    CHECK(btstack_timer_wheel_get_expired(&wheel, 20) == NULL);
+    CHECK(btstack_timer_wheel_get_expired(&wheel, 10000) == &timers[2]);
+    CHECK(btstack_timer_wheel_get_expired(&wheel, 10000) == &timers[0]);
+    CHECK(btstack_timer_wheel_empty(&wheel));
+}
+
+TEST(TimerWheel, AlreadyExpired){
+    btstack_timer_wheel_init(&wheel, 100);
+    timers[0].timeout = 50;
+    btstack_timer_wheel_add(&wheel, &timers[0]);
+    uint32_t timeout;
+    CHECK_EQUAL(1, btstack_timer_wheel_get_next_timeout(&wheel, &timeout));
+    CHECK_EQUAL(100, timeout);
+    CHECK(btstack_timer_wheel_get_expired(&wheel, 100) == &timers[0]);
+}
+
+TEST(TimerWheel, RemoveAndReAdd){
+    btstack_timer_wheel_init(&wheel, 0);
+    timers[0].timeout = 1000;
+    btstack_timer_wheel_add(&wheel, &timers[0]);
+    CHECK_EQUAL(1, btstack_timer_wheel_remove(&wheel, &timers[0]));
+    CHECK_EQUAL(0, btstack_timer_wheel_remove(&wheel, &timers[0]));
+    CHECK(btstack_timer_wheel_empty(&wheel));
+    timers[0].timeout = 2000;
+    btstack_timer_wheel_add(&wheel, &timers[0]);
+    CHECK(btstack_timer_wheel_get_expired(&wheel, 1000) == NULL);
+    CHECK(btstack_timer_wheel_get_expired(&wheel, 2000) == &timers[0]);
+}
+
+TEST(TimerWheel, Random){
+    run_random_operations(0, 100000);
+}
+
+TEST(TimerWheel, RandomWrapAround){
+    run_random_operations(0xffff0000, 100000);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
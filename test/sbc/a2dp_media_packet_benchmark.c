@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+
+/*
+ *  a2dp_media_packet_benchmark.c
+ *
+ *  Assembles A2DP media packets (RTP header, SBC payload header, SBC frames) for NUM_SECONDS of
+ *  44.1 kHz stereo audio, once the way avdtp_source_demo did it before - encoder buffer copied into
+ *  application storage, storage copied into the L2CAP outgoing buffer - and once with
+ *  btstack_sbc_encoder_process_data_to_buffer writing SBC frames directly into the reserved packet.
+ *  Reports bytes copied and time per second of audio. Both ways have to produce identical packets.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_util.h"
+#include "classic/btstack_sbc.h"
+
+#define NUM_SECONDS         60
+#define SAMPLE_RATE         44100
+#define NUM_CHANNELS        2
+#define BLOCKS              16
+#define SUBBANDS            8
+#define BITPOOL             53
+#define REMOTE_MTU          895
+#define MEDIA_HEADER_SIZE   12
+
+typedef struct {
+    const char * name;
+    // returns number of bytes written to payload
+    int (*assemble_payload)(uint8_t * payload, int max_payload_size, uint8_t * num_frames);
+} benchmark_assembly_t;
+
+static int num_seconds = NUM_SECONDS;
+static btstack_sbc_encoder_state_t sbc_encoder_state;
+static int16_t pcm_frame[BLOCKS * SUBBANDS * NUM_CHANNELS];
+static uint32_t pcm_sample_index;
+static uint8_t  sbc_storage[REMOTE_MTU];
+static uint8_t  outgoing_buffer[REMOTE_MTU];
+static uint64_t bytes_copied;
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// triangle wave with different period per channel
+static void produce_audio(void){
+    int i;
+    for (i = 0; i < BLOCKS * SUBBANDS; i++){
+        pcm_frame[i * 2]     = (int16_t) ((pcm_sample_index % 100) * 600 - 30000);
+        pcm_frame[i * 2 + 1] = (int16_t) ((pcm_sample_index % 73) * 800 - 29200);
+        pcm_sample_index++;
+    }
+}
+
+static void copy_bytes(uint8_t * dest, const uint8_t * src, int size){
+    memcpy(dest, src, size);
+    bytes_copied += size;
+}
+
+// encoder output -> application storage -> outgoing buffer
+static int assemble_payload_copy(uint8_t * payload, int max_payload_size, uint8_t * num_frames){
+    int sbc_frame_size = btstack_sbc_encoder_sbc_frame_length(&sbc_encoder_state);
+    int storage_count = 0;
+    while (max_payload_size - storage_count >= sbc_frame_size){
+        produce_audio();
+        btstack_sbc_encoder_process_data(&sbc_encoder_state, pcm_frame);
+        copy_bytes(&sbc_storage[storage_count], btstack_sbc_encoder_sbc_buffer(&sbc_encoder_state), sbc_frame_size);
+        storage_count += sbc_frame_size;
+        (*num_frames)++;
+    }
+    copy_bytes(payload, sbc_storage, storage_count);
+    return storage_count;
+}
+
+// encoder output written into outgoing buffer
+static int assemble_payload_in_place(uint8_t * payload, int max_payload_size, uint8_t * num_frames){
+    int sbc_frame_size = btstack_sbc_encoder_sbc_frame_length(&sbc_encoder_state);
+    int payload_size = 0;
+    while (max_payload_size - payload_size >= sbc_frame_size){
+        produce_audio();
+        btstack_sbc_encoder_process_data_to_buffer(&sbc_encoder_state, pcm_frame, &payload[payload_size]);
+        payload_size += sbc_frame_size;
+        (*num_frames)++;
+    }
+    return payload_size;
+}
+
+static const benchmark_assembly_t assemblies[] = {
+    { "copy via application storage", &assemble_payload_copy },
+    { "encode into media packet",     &assemble_payload_in_place },
+};
+
+static uint32_t run(const benchmark_assembly_t * assembly){
+    uint32_t checksum = 2166136261u;
+    uint32_t num_samples = 0;
+    uint16_t sequence_number = 0;
+
+    btstack_sbc_encoder_init(&sbc_encoder_state, SBC_MODE_STANDARD, BLOCKS, SUBBANDS, 0, SAMPLE_RATE, BITPOOL);
+    int samples_per_frame = btstack_sbc_encoder_num_audio_frames(&sbc_encoder_state);
+    pcm_sample_index = 0;
+    bytes_copied = 0;
+
+    uint64_t start_ns = benchmark_time_ns();
+    while (num_samples < (uint32_t) (num_seconds * SAMPLE_RATE)){
+        // media header, only sequence number is relevant here
+        memset(outgoing_buffer, 0, MEDIA_HEADER_SIZE);
+        big_endian_store_16(outgoing_buffer, 2, sequence_number++);
+        uint8_t num_frames = 0;
+        int payload_size = (*assembly->assemble_payload)(&outgoing_buffer[MEDIA_HEADER_SIZE + 1], REMOTE_MTU - MEDIA_HEADER_SIZE - 1, &num_frames);
+        outgoing_buffer[MEDIA_HEADER_SIZE] = num_frames;
+        num_samples += num_frames * samples_per_frame;
+        // FNV-1a over sent packet
+        int i;
+        for (i = 0; i < MEDIA_HEADER_SIZE + 1 + payload_size; i++){
+            checksum = (checksum ^ outgoing_buffer[i]) * 16777619;
+        }
+    }
+    uint64_t duration_ns = benchmark_time_ns() - start_ns;
+    double seconds_of_audio = (double) num_samples / SAMPLE_RATE;
+    printf("%-30s %8.0f bytes copied/s audio, %6.3f ms/s audio, checksum %08x\n", assembly->name,
+        bytes_copied / seconds_of_audio, duration_ns / 1000000.0 / seconds_of_audio, checksum);
+    return checksum;
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_seconds = atoi(argv[1]);
+    }
+
+    btstack_sbc_encoder_init(&sbc_encoder_state, SBC_MODE_STANDARD, BLOCKS, SUBBANDS, 0, SAMPLE_RATE, BITPOOL);
+    produce_audio();
+    btstack_sbc_encoder_process_data(&sbc_encoder_state, pcm_frame);
+    if (btstack_sbc_encoder_sbc_frame_length(&sbc_encoder_state) != btstack_sbc_encoder_sbc_buffer_length(&sbc_encoder_state)){
+        printf("frame length %u, but encoder produced %u bytes\n", btstack_sbc_encoder_sbc_frame_length(&sbc_encoder_state),
+            btstack_sbc_encoder_sbc_buffer_length(&sbc_encoder_state));
+        return 1;
+    }
+    printf("SBC frame %u bytes, %u byte media payload per packet\n", btstack_sbc_encoder_sbc_frame_length(&sbc_encoder_state), REMOTE_MTU - MEDIA_HEADER_SIZE);
+
+    uint32_t checksum_copy     = run(&assemblies[0]);
+    uint32_t checksum_in_place = run(&assemblies[1]);
+    if (checksum_copy != checksum_in_place){
+        printf("media packets differ\n");
+        return 1;
+    }
+    return 0;
+}
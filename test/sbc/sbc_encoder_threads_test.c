@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+// *****************************************************************************
+//
+// SBC encoder threading test
+//
+// Encodes NUM_STREAMS different sine waves with different encoder settings, 
+// first one after the other, then concurrently with one thread per stream, 
+// and verifies that the SBC output of each stream is identical.
+//
+// *****************************************************************************
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btstack_sbc.h"
+
+#define NUM_STREAMS         8
+#define NUM_FRAMES          2000
+#define MAX_SBC_FRAME_SIZE  512
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct {
+    btstack_sbc_mode_t mode;
+    int blocks;
+    int subbands;
+    int allocation_method;
+    int sample_rate;
+    int bitpool;
+    int frequency;
+} stream_config_t;
+
+typedef struct {
+    const stream_config_t * config;
+    btstack_sbc_encoder_state_t encoder_state;
+    uint8_t * sbc_data;
+    int sbc_data_len;
+} stream_t;
+
+static const stream_config_t stream_configs[NUM_STREAMS] = {
+    { SBC_MODE_STANDARD, 16, 8, 0, 44100, 53,  440 },
+    { SBC_MODE_STANDARD, 16, 4, 0, 44100, 31,  523 },
+    { SBC_MODE_STANDARD, 12, 8, 1, 48000, 35,  659 },
+    { SBC_MODE_STANDARD,  8, 8, 0, 32000, 64,  784 },
+    { SBC_MODE_STANDARD,  4, 4, 1, 16000, 18,  880 },
+    { SBC_MODE_STANDARD, 16, 8, 1, 48000, 51, 1046 },
+    { SBC_MODE_mSBC,     15, 8, 0, 16000, 26,  300 },
+    { SBC_MODE_STANDARD,  8, 4, 0, 44100, 24, 1318 },
+};
+
+static void encode_stream(stream_t * stream){
+    const stream_config_t * config = stream->config;
+    btstack_sbc_encoder_state_t * state = &stream->encoder_state;
+    btstack_sbc_encoder_init(state, config->mode, config->blocks, config->subbands, 
+        config->allocation_method, config->sample_rate, config->bitpool);
+
+    int num_channels = config->mode == SBC_MODE_mSBC ? 1 : 2;
+    int num_audio_frames = btstack_sbc_encoder_num_audio_frames(state);
+    int16_t pcm_frame[16*8*2];
+    int sample_index = 0;
+    int frame;
+    stream->sbc_data_len = 0;
+    for (frame = 0; frame < NUM_FRAMES; frame++){
+        int i;
+        for (i = 0; i < num_audio_frames; i++){
+            int16_t value = (int16_t) (16000.0 * sin(2.0 * M_PI * config->frequency * sample_index / config->sample_rate));
+            int channel;
+            for (channel = 0; channel < num_channels; channel++){
+                pcm_frame[i * num_channels + channel] = channel ? -value : value;
+            }
+            sample_index++;
+        }
+        btstack_sbc_encoder_process_data(state, pcm_frame);
+        int len = btstack_sbc_encoder_sbc_buffer_length(state);
+        memcpy(&stream->sbc_data[stream->sbc_data_len], btstack_sbc_encoder_sbc_buffer(state), len);
+        stream->sbc_data_len += len;
+    }
+}
+
+static void * encode_stream_thread(void * arg){
+    encode_stream((stream_t *) arg);
+    return NULL;
+}
+
+static void stream_setup(stream_t * stream, int index){
+    memset(stream, 0, sizeof(stream_t));
+    stream->config = &stream_configs[index];
+    stream->sbc_data = malloc(NUM_FRAMES * MAX_SBC_FRAME_SIZE);
+}
+
+int main (int argc, const char * argv[]){
+    (void) argc;
+    (void) argv;
+
+    static stream_t reference_streams[NUM_STREAMS];
+    static stream_t threaded_streams[NUM_STREAMS];
+    pthread_t threads[NUM_STREAMS];
+    int i;
+
+    for (i = 0; i < NUM_STREAMS; i++){
+        stream_setup(&reference_streams[i], i);
+        stream_setup(&threaded_streams[i], i);
+        encode_stream(&reference_streams[i]);
+    }
+
+    for (i = 0; i < NUM_STREAMS; i++){
+        if (pthread_create(&threads[i], NULL, &encode_stream_thread, &threaded_streams[i])){
+            printf("Can't create thread %u\n", i);
+            return -1;
+        }
+    }
+    for (i = 0; i < NUM_STREAMS; i++){
+        pthread_join(threads[i], NULL);
+    }
+
+    int failures = 0;
+    for (i = 0; i < NUM_STREAMS; i++){
+        stream_t * reference = &reference_streams[i];
+        stream_t * threaded  = &threaded_streams[i];
+        int ok = reference->sbc_data_len == threaded->sbc_data_len
+            && memcmp(reference->sbc_data, threaded->sbc_data, reference->sbc_data_len) == 0;
+        printf("Stream %u: %u bytes SBC, %s\n", i, reference->sbc_data_len, ok ? "match" : "MISMATCH");
+        if (!ok) failures++;
+        free(reference->sbc_data);
+        free(threaded->sbc_data);
+    }
+
+    if (failures){
+        printf("FAILED: %u of %u streams differ\n", failures, NUM_STREAMS);
+        return -1;
+    }
+    printf("Done\n");
+    return 0;
+}
@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+
+/*
+ *  sdp_server_benchmark.c
+ *
+ *  Registers NUM_RECORDS service records with NUM_SERVICE_CLASSES different service classes and measures the time
+ *  for complete SDP queries, including all continuation requests, as sent by connecting phones. Records and service
+ *  classes are chosen pseudo-randomly with a fixed seed. A checksum over all responses is printed to compare builds
+ *  with and without MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bluetooth_sdp.h"
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_util.h"
+#include "classic/sdp_server.h"
+#include "classic/sdp_util.h"
+#include "hci_dump.h"
+#include "l2cap.h"
+
+#define DEFAULT_NUM_QUERIES     10000
+#define NUM_RECORDS             100
+#define NUM_SERVICE_CLASSES     20
+#define SERVICE_CLASS_UUID16_BASE 0xfe00
+#define RECORD_SIZE             200
+#define SDP_CID                 0x0040
+#define REMOTE_MTU              672
+
+typedef struct {
+    const char * name;
+    uint16_t (*setup_request)(uint8_t * request);
+} benchmark_query_t;
+
+static int num_queries = DEFAULT_NUM_QUERIES;
+static uint32_t random_state;
+static uint32_t checksum;
+static uint16_t transaction_id;
+
+static uint8_t  records[NUM_RECORDS][RECORD_SIZE];
+static uint32_t record_handles[NUM_RECORDS];
+// sdp_unregister_service does not free items
+static service_record_item_t record_items[2 * NUM_RECORDS];
+static int      num_record_items;
+
+static btstack_packet_handler_t sdp_packet_handler;
+static uint8_t  response[REMOTE_MTU];
+static uint16_t response_len;
+
+// L2CAP and memory stubs for SDP server
+
+uint8_t l2cap_register_service(btstack_packet_handler_t packet_handler, uint16_t psm, uint16_t mtu, gap_security_level_t security_level){
+    UNUSED(psm);
+    UNUSED(mtu);
+    UNUSED(security_level);
+    sdp_packet_handler = packet_handler;
+    return 0;
+}
+
+void l2cap_accept_connection(uint16_t local_cid){
+    UNUSED(local_cid);
+}
+
+void l2cap_decline_connection(uint16_t local_cid){
+    UNUSED(local_cid);
+}
+
+uint16_t l2cap_get_remote_mtu_for_local_cid(uint16_t local_cid){
+    UNUSED(local_cid);
+    return REMOTE_MTU;
+}
+
+void l2cap_request_can_send_now_event(uint16_t local_cid){
+    uint8_t event[4];
+    event[0] = L2CAP_EVENT_CAN_SEND_NOW;
+    event[1] = 2;
+    little_endian_store_16(event, 2, local_cid);
+    (*sdp_packet_handler)(HCI_EVENT_PACKET, local_cid, event, sizeof(event));
+}
+
+int l2cap_send(uint16_t local_cid, uint8_t *data, uint16_t len){
+    UNUSED(local_cid);
+    memcpy(response, data, len);
+    response_len = len;
+    return 0;
+}
+
+service_record_item_t * btstack_memory_service_record_item_get(void){
+    if (num_record_items == 2 * NUM_RECORDS) return NULL;
+    return &record_items[num_record_items++];
+}
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t random_next(uint32_t range){
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 8) % range;
+}
+
+// similar to spp_create_sdp_record, every fourth record has an additional 128-bit service class
+static void create_record(uint8_t * service, uint32_t service_record_handle, uint16_t service_class, int rfcomm_channel){
+    uint8_t * attribute;
+    de_create_sequence(service);
+
+    de_add_number(service, DE_UINT, DE_SIZE_16, BLUETOOTH_ATTRIBUTE_SERVICE_RECORD_HANDLE);
+    de_add_number(service, DE_UINT, DE_SIZE_32, service_record_handle);
+
+    de_add_number(service, DE_UINT, DE_SIZE_16, BLUETOOTH_ATTRIBUTE_SERVICE_CLASS_ID_LIST);
+    attribute = de_push_sequence(service);
+    {
+        if ((rfcomm_channel % 4) == 0){
+            uint8_t uuid128[16];
+            uuid_add_bluetooth_prefix(uuid128, service_class);
+            uuid128[0] = 0xbe;
+            de_add_uuid128(attribute, uuid128);
+        }
+        de_add_number(attribute, DE_UUID, DE_SIZE_16, service_class);
+    }
+    de_pop_sequence(service, attribute);
+
+    de_add_number(service, DE_UINT, DE_SIZE_16, BLUETOOTH_ATTRIBUTE_PROTOCOL_DESCRIPTOR_LIST);
+    attribute = de_push_sequence(service);
+    {
+        uint8_t * l2cap_protocol = de_push_sequence(attribute);
+        {
+            de_add_number(l2cap_protocol, DE_UUID, DE_SIZE_16, BLUETOOTH_PROTOCOL_L2CAP);
+        }
+        de_pop_sequence(attribute, l2cap_protocol);
+
+        uint8_t * rfcomm_protocol = de_push_sequence(attribute);
+        {
+            de_add_number(rfcomm_protocol, DE_UUID, DE_SIZE_16, BLUETOOTH_PROTOCOL_RFCOMM);
+            de_add_number(rfcomm_protocol, DE_UINT, DE_SIZE_8,  rfcomm_channel);
+        }
+        de_pop_sequence(attribute, rfcomm_protocol);
+    }
+    de_pop_sequence(service, attribute);
+
+    de_add_number(service, DE_UINT, DE_SIZE_16, BLUETOOTH_ATTRIBUTE_BROWSE_GROUP_LIST);
+    attribute = de_push_sequence(service);
+    {
+        de_add_number(attribute, DE_UUID, DE_SIZE_16, BLUETOOTH_ATTRIBUTE_PUBLIC_BROWSE_ROOT);
+    }
+    de_pop_sequence(service, attribute);
+
+    de_add_number(service, DE_UINT, DE_SIZE_16, BLUETOOTH_ATTRIBUTE_LANGUAGE_BASE_ATTRIBUTE_ID_LIST);
+    attribute = de_push_sequence(service);
+    {
+        de_add_number(attribute, DE_UINT, DE_SIZE_16, 0x656e);
+        de_add_number(attribute, DE_UINT, DE_SIZE_16, 0x006a);
+        de_add_number(attribute, DE_UINT, DE_SIZE_16, 0x0100);
+    }
+    de_pop_sequence(service, attribute);
+
+    de_add_number(service, DE_UINT, DE_SIZE_16, BLUETOOTH_ATTRIBUTE_BLUETOOTH_PROFILE_DESCRIPTOR_LIST);
+    attribute = de_push_sequence(service);
+    {
+        uint8_t * profile = de_push_sequence(attribute);
+        {
+            de_add_number(profile, DE_UUID, DE_SIZE_16, service_class);
+            de_add_number(profile, DE_UINT, DE_SIZE_16, 0x0102);
+        }
+        de_pop_sequence(attribute, profile);
+    }
+    de_pop_sequence(service, attribute);
+
+    char name[20];
+    snprintf(name, sizeof(name), "Service %u", rfcomm_channel);
+    de_add_number(service, DE_UINT, DE_SIZE_16, 0x0100);
+    de_add_data(service, DE_STRING, strlen(name), (uint8_t *) name);
+}
+
+static void setup_server(void){
+    sdp_init();
+    int i;
+    for (i = 0; i < NUM_RECORDS; i++){
+        record_handles[i] = sdp_create_service_record_handle();
+        create_record(records[i], record_handles[i], SERVICE_CLASS_UUID16_BASE + (i % NUM_SERVICE_CLASSES), i + 1);
+        sdp_register_service(records[i]);
+    }
+    // re-register some records to change their order and remove them from the index
+    for (i = 0; i < NUM_RECORDS; i += 7){
+        sdp_unregister_service(record_handles[i]);
+        sdp_register_service(records[i]);
+    }
+
+    // open SDP channel
+    uint8_t event[4];
+    event[0] = L2CAP_EVENT_INCOMING_CONNECTION;
+    event[1] = 2;
+    little_endian_store_16(event, 2, SDP_CID);
+    (*sdp_packet_handler)(HCI_EVENT_PACKET, SDP_CID, event, sizeof(event));
+}
+
+static uint16_t store_service_search_pattern(uint8_t * request, uint16_t pos, uint16_t uuid16){
+    de_create_sequence(&request[pos]);
+    de_add_number(&request[pos], DE_UUID, DE_SIZE_16, uuid16);
+    return pos + de_get_len(&request[pos]);
+}
+
+static uint16_t store_attribute_id_range(uint8_t * request, uint16_t pos, uint16_t first, uint16_t last){
+    de_create_sequence(&request[pos]);
+    de_add_number(&request[pos], DE_UINT, DE_SIZE_32, (((uint32_t) first) << 16) | last);
+    return pos + de_get_len(&request[pos]);
+}
+
+static uint16_t random_service_class(void){
+    return SERVICE_CLASS_UUID16_BASE + random_next(NUM_SERVICE_CLASSES);
+}
+
+// parameters without continuation state
+static uint16_t setup_service_search_service_class(uint8_t * request){
+    request[0] = SDP_ServiceSearchRequest;
+    uint16_t pos = store_service_search_pattern(request, 5, random_service_class());
+    big_endian_store_16(request, pos, 0xffff);
+    return pos + 2;
+}
+
+// all records, needs continuation
+static uint16_t setup_service_search_l2cap(uint8_t * request){
+    request[0] = SDP_ServiceSearchRequest;
+    uint16_t pos = store_service_search_pattern(request, 5, BLUETOOTH_PROTOCOL_L2CAP);
+    big_endian_store_16(request, pos, 0xffff);
+    return pos + 2;
+}
+
+static uint16_t setup_service_attribute_all(uint8_t * request){
+    request[0] = SDP_ServiceAttributeRequest;
+    big_endian_store_32(request, 5, record_handles[random_next(NUM_RECORDS)]);
+    big_endian_store_16(request, 9, 0xffff);
+    return store_attribute_id_range(request, 11, 0x0000, 0xffff);
+}
+
+// RFCOMM channel lookup, see sdp_client_rfcomm
+static uint16_t setup_service_search_attribute_rfcomm(uint8_t * request){
+    request[0] = SDP_ServiceSearchAttributeRequest;
+    uint16_t pos = store_service_search_pattern(request, 5, random_service_class());
+    big_endian_store_16(request, pos, 0xffff);
+    return store_attribute_id_range(request, pos + 2, BLUETOOTH_ATTRIBUTE_SERVICE_CLASS_ID_LIST, BLUETOOTH_ATTRIBUTE_PROTOCOL_DESCRIPTOR_LIST);
+}
+
+// browse all records, needs continuation
+static uint16_t setup_service_search_attribute_browse(uint8_t * request){
+    request[0] = SDP_ServiceSearchAttributeRequest;
+    uint16_t pos = store_service_search_pattern(request, 5, BLUETOOTH_ATTRIBUTE_PUBLIC_BROWSE_ROOT);
+    big_endian_store_16(request, pos, 0xffff);
+    return store_attribute_id_range(request, pos + 2, 0x0000, 0xffff);
+}
+
+static const benchmark_query_t queries[] = {
+    { "service search, service class",          &setup_service_search_service_class },
+    { "service search, l2cap (all)",            &setup_service_search_l2cap },
+    { "service attribute, all attributes",      &setup_service_attribute_all },
+    { "service search attribute, rfcomm",       &setup_service_search_attribute_rfcomm },
+    { "service search attribute, browse (all)", &setup_service_search_attribute_browse },
+};
+
+static void update_checksum(const uint8_t * data, uint16_t len){
+    // FNV-1a
+    uint16_t i;
+    for (i = 0; i < len; i++){
+        checksum = (checksum ^ data[i]) * 16777619;
+    }
+}
+
+// send request and all continuation requests, returns number of requests
+static int run_query(const benchmark_query_t * query){
+    uint8_t request[64];
+    uint16_t parameters_len = (*query->setup_request)(request);
+    // no continuation state
+    request[parameters_len] = 0;
+    uint16_t request_len = parameters_len + 1;
+    int num_requests = 0;
+    while (1){
+        big_endian_store_16(request, 1, transaction_id++);
+        big_endian_store_16(request, 3, request_len - 5);
+        response_len = 0;
+        (*sdp_packet_handler)(L2CAP_DATA_PACKET, SDP_CID, request, request_len);
+        num_requests++;
+        update_checksum(response, response_len);
+        if (response_len < 8 || response[0] == SDP_ErrorResponse) break;
+        // continuation state follows handle list or attribute lists
+        uint16_t continuation_pos;
+        if (response[0] == SDP_ServiceSearchResponse){
+            continuation_pos = 9 + 4 * big_endian_read_16(response, 7);
+        } else {
+            continuation_pos = 7 + big_endian_read_16(response, 5);
+        }
+        uint8_t continuation_len = response[continuation_pos];
+        if (continuation_len == 0) break;
+        memcpy(&request[parameters_len], &response[continuation_pos], 1 + continuation_len);
+        request_len = parameters_len + 1 + continuation_len;
+    }
+    return num_requests;
+}
+
+static void run(const benchmark_query_t * query){
+    random_state = 1;
+    int num_requests = 0;
+    uint64_t start_ns = benchmark_time_ns();
+    int i;
+    for (i = 0; i < num_queries; i++){
+        num_requests += run_query(query);
+    }
+    uint64_t duration_ns = benchmark_time_ns() - start_ns;
+    printf("%-40s %9.1f ns/query, %.1f requests/query\n", query->name, (double) duration_ns / num_queries, (double) num_requests / num_queries);
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_queries = atoi(argv[1]);
+    }
+
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+    hci_dump_enable_log_level(LOG_LEVEL_ERROR, 0);
+
+    setup_server();
+
+#ifdef MAX_NR_SDP_SERVER_UUID_INDEX_ENTRIES
+    printf("%u service records, indexed\n", NUM_RECORDS);
+#else
+    printf("%u service records, record parsing\n", NUM_RECORDS);
+#endif
+
+    checksum = 2166136261u;
+    unsigned int i;
+    for (i = 0; i < sizeof(queries) / sizeof(benchmark_query_t); i++){
+        run(&queries[i]);
+    }
+    printf("checksum %08x\n", checksum);
+    return 0;
+}
@@ -0,0 +1,555 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  sm_pairing_benchmark.c
+ *
+ *  Runs the Security Manager as peripheral against NUM_CENTRALS simulated centrals that pair
+ *  with LE Legacy Pairing / Just Works, disconnect, and reconnect until the requested number of
+ *  pairings is done. The controller is mocked with a single HCI command credit and fixed command
+ *  and air latencies on a virtual clock. Reports pairings per second of virtual time, host CPU
+ *  time per pairing, and the number of HCI LE Encrypt commands. Build with HAVE_AES128 to use
+ *  the software AES backend and with MAX_NR_SM_SETUP_CONTEXTS > 1 to pair connections in parallel.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_config.h"
+#include "btstack_defines.h"
+#include "btstack_event.h"
+#include "btstack_linked_list.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_cmd.h"
+#include "hci_dump.h"
+#include "l2cap.h"
+#include "ble/le_device_db.h"
+#include "ble/sm.h"
+#include "rijndael.h"
+
+#define DEFAULT_NUM_PAIRINGS    1000
+#define NUM_CENTRALS            16
+#define HCI_COMMAND_LATENCY_US  500     // command to command complete
+#define AIR_LATENCY_US          3750    // half a 7.5 ms connection interval
+#define MAX_EVENT_SIZE          32
+#define MAX_SCHEDULED_EVENTS    (NUM_CENTRALS * 4 + 4)
+
+#ifndef MAX_NR_SM_SETUP_CONTEXTS
+#define MAX_NR_SM_SETUP_CONTEXTS 1
+#endif
+
+typedef enum {
+    SIM_HCI_EVENT,          // deliver HCI event to host
+    SIM_PDU_TO_HOST,        // deliver SM PDU from central to host
+    SIM_PDU_TO_CENTRAL,     // deliver SM PDU from host to central
+    SIM_CONNECT,            // central connects
+} sim_event_type_t;
+
+typedef struct {
+    uint64_t time_us;
+    uint32_t seq_nr;
+    sim_event_type_t type;
+    int central;
+    hci_con_handle_t con_handle;    // PDUs are dropped if connection was closed
+    uint16_t len;
+    uint8_t  data[MAX_EVENT_SIZE];
+} sim_event_t;
+
+typedef struct {
+    hci_connection_t connection;
+    bd_addr_t address;
+    uint8_t   preq[7];
+    uint8_t   pres[7];
+    sm_key_t  local_random;
+    sm_key_t  peer_confirm;
+} central_t;
+
+static int num_pairings = DEFAULT_NUM_PAIRINGS;
+static int num_pairings_started;
+static int num_pairings_completed;
+static int num_confirm_failures;
+static int num_pairing_failures;
+static int num_le_encrypt_commands;
+
+static uint64_t sim_time_us;
+static uint32_t sim_seq_nr;
+static sim_event_t sim_events[MAX_SCHEDULED_EVENTS];
+static int num_sim_events;
+
+static central_t centrals[NUM_CENTRALS];
+static btstack_linked_list_t connections;
+static uint16_t next_con_handle = 0x0040;
+static uint32_t random_state = 0x12345678;
+
+static int command_pending;
+
+static btstack_packet_handler_t sm_event_handler;
+static btstack_packet_handler_t sm_pdu_handler;
+
+static const uint8_t local_address[] = { 0x00, 0x1b, 0xdc, 0x07, 0x32, 0xef };
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint8_t random_byte(void){
+    random_state = random_state * 1103515245u + 12345u;
+    return (uint8_t) (random_state >> 16);
+}
+
+static void aes128_calc(const uint8_t * key, const uint8_t * plaintext, uint8_t * result){
+    uint32_t rk[RKLENGTH(KEYBITS)];
+    int nrounds = rijndaelSetupEncrypt(rk, key, KEYBITS);
+    rijndaelEncrypt(rk, nrounds, plaintext, result);
+}
+
+#ifdef HAVE_AES128
+void btstack_aes128_calc(uint8_t * key, uint8_t * plaintext, uint8_t * result);
+void btstack_aes128_calc(uint8_t * key, uint8_t * plaintext, uint8_t * result){
+    aes128_calc(key, plaintext, result);
+}
+#endif
+
+// virtual clock event queue
+
+static void sim_schedule(uint32_t delay_us, sim_event_type_t type, int central, const uint8_t * data, uint16_t len){
+    if (num_sim_events >= MAX_SCHEDULED_EVENTS || len > MAX_EVENT_SIZE){
+        fprintf(stderr, "event queue overflow\n");
+        exit(1);
+    }
+    sim_event_t * event = &sim_events[num_sim_events++];
+    event->time_us = sim_time_us + delay_us;
+    event->seq_nr  = sim_seq_nr++;
+    event->type    = type;
+    event->central = central;
+    event->con_handle = central < 0 ? HCI_CON_HANDLE_INVALID : centrals[central].connection.con_handle;
+    event->len     = len;
+    if (len){
+        memcpy(event->data, data, len);
+    }
+}
+
+static int sim_next_event(sim_event_t * event){
+    if (num_sim_events == 0) return 0;
+    int next = 0;
+    int i;
+    for (i = 1; i < num_sim_events; i++){
+        if (sim_events[i].time_us < sim_events[next].time_us) {
+            next = i;
+        } else if (sim_events[i].time_us == sim_events[next].time_us && sim_events[i].seq_nr < sim_events[next].seq_nr){
+            next = i;
+        }
+    }
+    *event = sim_events[next];
+    sim_events[next] = sim_events[--num_sim_events];
+    sim_time_us = event->time_us;
+    return 1;
+}
+
+static void sim_schedule_hci_event(uint32_t delay_us, const uint8_t * event, uint16_t len){
+    sim_schedule(delay_us, SIM_HCI_EVENT, -1, event, len);
+}
+
+static int central_for_handle(hci_con_handle_t con_handle){
+    int i;
+    for (i = 0; i < NUM_CENTRALS; i++){
+        if (centrals[i].connection.con_handle == con_handle) return i;
+    }
+    return -1;
+}
+
+// mocked HCI and L2CAP for sm.c
+
+HCI_STATE hci_get_state(void){
+    return HCI_STATE_WORKING;
+}
+
+int hci_can_send_command_packet_now(void){
+    return !command_pending;
+}
+
+int hci_send_cmd(const hci_cmd_t *cmd, ...){
+    uint8_t command[HCI_CMD_HEADER_SIZE + 64];
+    va_list argptr;
+    va_start(argptr, cmd);
+    hci_cmd_create_from_template(command, cmd, argptr);
+    va_end(argptr);
+
+    command_pending = 1;
+
+    uint8_t event[6 + 16];
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[2] = 1;
+    little_endian_store_16(event, 3, cmd->opcode);
+    event[5] = 0;
+    uint16_t len = 6;
+
+    if (cmd->opcode == hci_le_encrypt.opcode){
+        // key and plaintext are sent little endian, AES operates on big endian
+        sm_key_t key, plaintext, result;
+        reverse_128(&command[3],  key);
+        reverse_128(&command[19], plaintext);
+        aes128_calc(key, plaintext, result);
+        reverse_128(result, &event[6]);
+        len += 16;
+        num_le_encrypt_commands++;
+    } else if (cmd->opcode == hci_le_rand.opcode){
+        int i;
+        for (i = 0; i < 8; i++){
+            event[6 + i] = random_byte();
+        }
+        len += 8;
+    } else if (cmd->opcode == hci_le_long_term_key_request_reply.opcode){
+        // encryption gets enabled a connection event later
+        uint8_t encryption_change[] = { HCI_EVENT_ENCRYPTION_CHANGE, 4, 0, 0, 0, 1 };
+        memcpy(&encryption_change[3], &command[3], 2);
+        sim_schedule_hci_event(HCI_COMMAND_LATENCY_US + 2 * AIR_LATENCY_US, encryption_change, sizeof(encryption_change));
+    }
+    event[1] = len - 2;
+    sim_schedule_hci_event(HCI_COMMAND_LATENCY_US, event, len);
+    return 0;
+}
+
+void hci_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    sm_event_handler = callback_handler->callback;
+}
+
+hci_connection_t * hci_connection_for_handle(hci_con_handle_t con_handle){
+    int central = central_for_handle(con_handle);
+    if (central < 0) return NULL;
+    return &centrals[central].connection;
+}
+
+void hci_connections_get_iterator(btstack_linked_list_iterator_t *it){
+    btstack_linked_list_iterator_init(it, &connections);
+}
+
+void gap_local_bd_addr(bd_addr_t address_buffer){
+    memcpy(address_buffer, local_address, 6);
+}
+
+void gap_le_get_own_address(uint8_t * addr_type, bd_addr_t addr){
+    *addr_type = BD_ADDR_TYPE_LE_PUBLIC;
+    memcpy(addr, local_address, 6);
+}
+
+uint16_t hci_get_manufacturer(void){
+    return 0xffff;
+}
+
+void hci_le_set_own_address_type(uint8_t own_address_type){
+    UNUSED(own_address_type);
+}
+
+void hci_le_advertisements_set_params(uint16_t adv_int_min, uint16_t adv_int_max, uint8_t adv_type,
+    uint8_t direct_address_typ, bd_addr_t direct_address, uint8_t channel_map, uint8_t filter_policy) {
+}
+
+void hci_disconnect_security_block(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+}
+
+void l2cap_register_fixed_channel(btstack_packet_handler_t packet_handler, uint16_t channel_id){
+    UNUSED(channel_id);
+    sm_pdu_handler = packet_handler;
+}
+
+int l2cap_can_send_fixed_channel_packet_now(hci_con_handle_t con_handle, uint16_t channel_id){
+    UNUSED(con_handle);
+    UNUSED(channel_id);
+    return 1;
+}
+
+void l2cap_request_can_send_fix_channel_now_event(hci_con_handle_t con_handle, uint16_t channel_id){
+    UNUSED(con_handle);
+    UNUSED(channel_id);
+}
+
+int l2cap_send_connectionless(hci_con_handle_t con_handle, uint16_t cid, uint8_t * data, uint16_t len){
+    UNUSED(cid);
+    int central = central_for_handle(con_handle);
+    if (central < 0) return 0;
+    sim_schedule(AIR_LATENCY_US, SIM_PDU_TO_CENTRAL, central, data, len);
+    // number of completed packets after the packet was sent
+    uint8_t event[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 1, 0};
+    little_endian_store_16(event, 3, con_handle);
+    sim_schedule_hci_event(AIR_LATENCY_US, event, sizeof(event));
+    return 0;
+}
+
+// simulated central with LE Legacy Pairing, Just Works
+
+// c1 as in Core Spec, Vol 3, Part H, 2.2.3. Values are big endian
+static void central_c1(central_t * central, const sm_key_t r, sm_key_t c1){
+    sm_key_t tk;
+    memset(tk, 0, 16);
+    sm_key_t t;
+    reverse_56(central->pres, &t[0]);
+    reverse_56(central->preq, &t[7]);
+    t[14] = BD_ADDR_TYPE_LE_PUBLIC;     // rat
+    t[15] = BD_ADDR_TYPE_LE_PUBLIC;     // iat
+    int i;
+    for (i = 0; i < 16; i++){
+        t[i] ^= r[i];
+    }
+    sm_key_t t2;
+    aes128_calc(tk, t, t2);
+    sm_key_t p2;
+    memset(p2, 0, 16);
+    memcpy(&p2[4],  central->address, 6);
+    memcpy(&p2[10], local_address, 6);
+    for (i = 0; i < 16; i++){
+        t2[i] ^= p2[i];
+    }
+    aes128_calc(tk, t2, c1);
+}
+
+static void central_send_pdu(int index, const uint8_t * pdu, uint16_t len){
+    sim_schedule(AIR_LATENCY_US, SIM_PDU_TO_HOST, index, pdu, len);
+}
+
+static void central_schedule_connect(int index, uint32_t delay_us){
+    if (num_pairings_started >= num_pairings) return;
+    num_pairings_started++;
+    sim_schedule(delay_us, SIM_CONNECT, index, NULL, 0);
+}
+
+static void central_connect(int index){
+    central_t * central = &centrals[index];
+    hci_con_handle_t con_handle = next_con_handle++;
+    if (next_con_handle > 0x0eff){
+        next_con_handle = 0x0040;
+    }
+    memset(&central->connection, 0, sizeof(hci_connection_t));
+    central->connection.con_handle = con_handle;
+    btstack_linked_list_add(&connections, (btstack_linked_item_t *) &central->connection);
+
+    // public address, unique per connection
+    central->address[0] = 0x00;
+    central->address[1] = 0x11;
+    big_endian_store_32(central->address, 2, con_handle);
+
+    // LE Connection Complete, peripheral role
+    uint8_t event[] = { HCI_EVENT_LE_META, 19, HCI_SUBEVENT_LE_CONNECTION_COMPLETE, 0, 0, 0, 1, BD_ADDR_TYPE_LE_PUBLIC,
+        0, 0, 0, 0, 0, 0, 6, 0, 0, 0, 0x48, 0, 5 };
+    little_endian_store_16(event, 4, con_handle);
+    reverse_bd_addr(central->address, &event[8]);
+    sm_event_handler(HCI_EVENT_PACKET, 0, event, sizeof(event));
+
+    // Pairing Request: no input/no output, bonding, key size 16, no initiator keys, responder keys: enc, id, sign
+    uint8_t pairing_request[] = { SM_CODE_PAIRING_REQUEST, IO_CAPABILITY_NO_INPUT_NO_OUTPUT, 0, SM_AUTHREQ_BONDING, 16, 0, 0x07 };
+    memcpy(central->preq, pairing_request, 7);
+    central_send_pdu(index, pairing_request, sizeof(pairing_request));
+}
+
+static void central_disconnect(int index){
+    central_t * central = &centrals[index];
+    // drop bonding to keep LE Device DB from filling up
+    int le_device_index = sm_le_device_index(central->connection.con_handle);
+    if (le_device_index >= 0){
+        le_device_db_remove(le_device_index);
+    }
+    uint8_t event[] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0, 0, 0, 0x13 };
+    little_endian_store_16(event, 3, central->connection.con_handle);
+    sm_event_handler(HCI_EVENT_PACKET, 0, event, sizeof(event));
+    btstack_linked_list_remove(&connections, (btstack_linked_item_t *) &central->connection);
+    central->connection.con_handle = HCI_CON_HANDLE_INVALID;
+    central_schedule_connect(index, AIR_LATENCY_US);
+}
+
+static void central_handle_pdu(int index, const uint8_t * pdu, uint16_t len){
+    UNUSED(len);
+    central_t * central = &centrals[index];
+    int i;
+    switch (pdu[0]){
+        case SM_CODE_PAIRING_RESPONSE: {
+            memcpy(central->pres, pdu, 7);
+            for (i = 0; i < 16; i++){
+                central->local_random[i] = random_byte();
+            }
+            sm_key_t confirm;
+            central_c1(central, central->local_random, confirm);
+            uint8_t pairing_confirm[17];
+            pairing_confirm[0] = SM_CODE_PAIRING_CONFIRM;
+            reverse_128(confirm, &pairing_confirm[1]);
+            central_send_pdu(index, pairing_confirm, sizeof(pairing_confirm));
+            break;
+        }
+        case SM_CODE_PAIRING_CONFIRM: {
+            reverse_128(&pdu[1], central->peer_confirm);
+            uint8_t pairing_random[17];
+            pairing_random[0] = SM_CODE_PAIRING_RANDOM;
+            reverse_128(central->local_random, &pairing_random[1]);
+            central_send_pdu(index, pairing_random, sizeof(pairing_random));
+            break;
+        }
+        case SM_CODE_PAIRING_RANDOM: {
+            sm_key_t peer_random;
+            sm_key_t confirm;
+            reverse_128(&pdu[1], peer_random);
+            central_c1(central, peer_random, confirm);
+            if (memcmp(confirm, central->peer_confirm, 16) != 0){
+                num_confirm_failures++;
+            }
+            // start encryption with STK, controller requests it from host with ediv and rand = 0
+            uint8_t event[] = { HCI_EVENT_LE_META, 13, HCI_SUBEVENT_LE_LONG_TERM_KEY_REQUEST, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+            little_endian_store_16(event, 3, central->connection.con_handle);
+            sim_schedule_hci_event(AIR_LATENCY_US, event, sizeof(event));
+            break;
+        }
+        case SM_CODE_PAIRING_FAILED:
+            num_pairing_failures++;
+            central_disconnect(index);
+            break;
+        case SM_CODE_SIGNING_INFORMATION:
+            // last key distributed by responder
+            num_pairings_completed++;
+            central_disconnect(index);
+            break;
+        default:
+            break;
+    }
+}
+
+static void app_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case SM_EVENT_JUST_WORKS_REQUEST:
+            sm_just_works_confirm(little_endian_read_16(packet, 2));
+            break;
+        default:
+            break;
+    }
+}
+
+static void run_simulation(void){
+    sim_event_t event;
+    while (sim_next_event(&event)){
+        switch (event.type){
+            case SIM_HCI_EVENT:
+                if (event.data[0] == HCI_EVENT_COMMAND_COMPLETE){
+                    command_pending = 0;
+                }
+                sm_event_handler(HCI_EVENT_PACKET, 0, event.data, event.len);
+                break;
+            case SIM_PDU_TO_HOST:
+                if (centrals[event.central].connection.con_handle != event.con_handle) break;
+                sm_pdu_handler(SM_DATA_PACKET, centrals[event.central].connection.con_handle, event.data, event.len);
+                break;
+            case SIM_PDU_TO_CENTRAL:
+                if (centrals[event.central].connection.con_handle != event.con_handle) break;
+                central_handle_pdu(event.central, event.data, event.len);
+                break;
+            case SIM_CONNECT:
+                central_connect(event.central);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_pairings = atoi(argv[1]);
+    }
+
+    // no log output while measuring
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+    hci_dump_enable_log_level(LOG_LEVEL_ERROR, 0);
+
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    le_device_db_init();
+
+    static btstack_packet_callback_registration_t sm_event_callback_registration;
+    sm_init();
+    sm_set_io_capabilities(IO_CAPABILITY_NO_INPUT_NO_OUTPUT);
+    sm_set_authentication_requirements(SM_AUTHREQ_BONDING);
+    sm_event_callback_registration.callback = &app_packet_handler;
+    sm_add_event_handler(&sm_event_callback_registration);
+
+    int i;
+    for (i = 0; i < NUM_CENTRALS; i++){
+        centrals[i].connection.con_handle = HCI_CON_HANDLE_INVALID;
+    }
+
+    // derive IRK and DHK
+    uint8_t state_working[] = { BTSTACK_EVENT_STATE, 1, HCI_STATE_WORKING };
+    sm_event_handler(HCI_EVENT_PACKET, 0, state_working, sizeof(state_working));
+    run_simulation();
+
+    uint64_t start_time_us = sim_time_us;
+    int start_encrypt_commands = num_le_encrypt_commands;
+    for (i = 0; i < NUM_CENTRALS; i++){
+        central_schedule_connect(i, 0);
+    }
+    uint64_t start_ns = benchmark_time_ns();
+    run_simulation();
+    uint64_t duration_ns = benchmark_time_ns() - start_ns;
+    uint64_t duration_us = sim_time_us - start_time_us;
+
+#ifdef HAVE_AES128
+    const char * aes_backend = "software AES";
+#else
+    const char * aes_backend = "HCI LE Encrypt";
+#endif
+    printf("%u centrals, %s, %u setup contexts\n", NUM_CENTRALS, aes_backend, MAX_NR_SM_SETUP_CONTEXTS);
+    printf("pairings completed %u of %u, failed %u, confirm mismatches %u\n", num_pairings_completed, num_pairings,
+        num_pairing_failures, num_confirm_failures);
+    if (num_pairings_completed == 0) return 1;
+    printf("%8.1f pairings/s (virtual time), %6.1f ms per pairing, %5.1f LE Encrypt commands per pairing\n",
+        num_pairings_completed * 1000000.0 / duration_us,
+        duration_us / 1000.0 / num_pairings_completed,
+        (float) (num_le_encrypt_commands - start_encrypt_commands) / num_pairings_completed);
+    printf("%8.1f us host CPU time per pairing\n", duration_ns / 1000.0 / num_pairings_completed);
+
+    if (num_pairings_completed != num_pairings || num_pairing_failures || num_confirm_failures) return 1;
+    return 0;
+}
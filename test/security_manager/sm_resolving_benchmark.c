@@ -0,0 +1,463 @@
+/*
+ * Copyright (C) 2017 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/*
+ *  sm_resolving_benchmark.c
+ *
+ *  Resolves NUM_REPORTS advertisement addresses against NUM_BONDED_DEVICES IRKs with
+ *  sm_address_resolution_lookup. NUM_ADVERTISERS devices are in range, a quarter of them
+ *  not bonded, and each one rotates its resolvable private address every ROTATION_REPORTS
+ *  reports. The controller is mocked with a fixed HCI LE Encrypt latency on a virtual clock.
+ *  Reports resolutions per second of virtual time, host CPU time per resolution, and the number
+ *  of HCI LE Encrypt commands. Build with HAVE_AES128 to use the software AES backend and with
+ *  MAX_NR_SM_RESOLVING_CACHE_ENTRIES to set the size of the resolving cache.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_config.h"
+#include "btstack_defines.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_cmd.h"
+#include "hci_dump.h"
+#include "l2cap.h"
+#include "ble/le_device_db.h"
+#include "ble/sm.h"
+#include "rijndael.h"
+
+#define DEFAULT_NUM_REPORTS     10000
+#define NUM_BONDED_DEVICES      500
+#define NUM_ADVERTISERS         64
+#define ROTATION_REPORTS        1000    // reports per advertiser between address changes
+#define HCI_COMMAND_LATENCY_US  500     // command to command complete
+
+#ifndef MAX_NR_SM_RESOLVING_CACHE_ENTRIES
+#define MAX_NR_SM_RESOLVING_CACHE_ENTRIES 8
+#endif
+
+typedef struct {
+    int       addr_type;
+    bd_addr_t addr;
+    sm_key_t  irk;
+} bonded_device_t;
+
+typedef struct {
+    int       le_db_index;  // -1 if not bonded
+    sm_key_t  irk;
+    bd_addr_t address;
+    int       num_reports;
+} advertiser_t;
+
+static int num_reports = DEFAULT_NUM_REPORTS;
+static int num_resolved;
+static int num_not_resolved;
+static int num_mismatches;
+static int num_le_encrypt_commands;
+static int resolution_done;
+
+static uint64_t sim_time_us;
+static uint32_t random_state = 0x12345678;
+
+static bonded_device_t bonded_devices[NUM_BONDED_DEVICES];
+static advertiser_t advertisers[NUM_ADVERTISERS];
+static advertiser_t * current_advertiser;
+
+// single HCI command credit with the Command Complete event for the pending command
+static int     command_pending;
+static uint8_t command_complete_event[6 + 16];
+static uint16_t command_complete_len;
+
+static btstack_packet_handler_t sm_event_handler;
+
+static const uint8_t local_address[] = { 0x00, 0x1b, 0xdc, 0x07, 0x32, 0xef };
+
+static uint64_t benchmark_time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint8_t random_byte(void){
+    random_state = random_state * 1103515245u + 12345u;
+    return (uint8_t) (random_state >> 16);
+}
+
+static void aes128_calc(const uint8_t * key, const uint8_t * plaintext, uint8_t * result){
+    uint32_t rk[RKLENGTH(KEYBITS)];
+    int nrounds = rijndaelSetupEncrypt(rk, key, KEYBITS);
+    rijndaelEncrypt(rk, nrounds, plaintext, result);
+}
+
+#ifdef HAVE_AES128
+void btstack_aes128_calc(uint8_t * key, uint8_t * plaintext, uint8_t * result);
+void btstack_aes128_calc(uint8_t * key, uint8_t * plaintext, uint8_t * result){
+    aes128_calc(key, plaintext, result);
+}
+#endif
+
+// LE Device DB with NUM_BONDED_DEVICES entries
+
+void le_device_db_init(void){
+}
+
+void le_device_db_set_local_bd_addr(bd_addr_t bd_addr){
+    (void)bd_addr;
+}
+
+int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
+    UNUSED(addr_type);
+    (void)addr;
+    (void)irk;
+    return -1;
+}
+
+int le_device_db_count(void){
+    return NUM_BONDED_DEVICES;
+}
+
+void le_device_db_info(int index, int * addr_type, bd_addr_t addr, sm_key_t irk){
+    if (addr_type) *addr_type = bonded_devices[index].addr_type;
+    if (addr) memcpy(addr, bonded_devices[index].addr, 6);
+    if (irk) memcpy(irk, bonded_devices[index].irk, 16);
+}
+
+void le_device_db_encryption_set(int index, uint16_t ediv, uint8_t rand[8], sm_key_t ltk, int key_size, int authenticated, int authorized){
+    UNUSED(index);
+    UNUSED(ediv);
+    (void)rand;
+    (void)ltk;
+    UNUSED(key_size);
+    UNUSED(authenticated);
+    UNUSED(authorized);
+}
+
+void le_device_db_encryption_get(int index, uint16_t * ediv, uint8_t rand[8], sm_key_t ltk, int * key_size, int * authenticated, int * authorized){
+    UNUSED(index);
+    if (ediv) *ediv = 0;
+    if (rand) memset(rand, 0, 8);
+    if (ltk)  memset(ltk, 0, 16);
+    if (key_size) *key_size = 0;
+    if (authenticated) *authenticated = 0;
+    if (authorized) *authorized = 0;
+}
+
+void le_device_db_local_csrk_set(int index, sm_key_t csrk){
+    UNUSED(index);
+    (void)csrk;
+}
+
+void le_device_db_remote_csrk_set(int index, sm_key_t csrk){
+    UNUSED(index);
+    (void)csrk;
+}
+
+void le_device_db_remote_counter_set(int index, uint32_t counter){
+    UNUSED(index);
+    UNUSED(counter);
+}
+
+void le_device_db_local_counter_set(int index, uint32_t counter){
+    UNUSED(index);
+    UNUSED(counter);
+}
+
+void le_device_db_remove(int index){
+    UNUSED(index);
+}
+
+// mocked HCI and L2CAP for sm.c
+
+HCI_STATE hci_get_state(void){
+    return HCI_STATE_WORKING;
+}
+
+int hci_can_send_command_packet_now(void){
+    return !command_pending;
+}
+
+int hci_send_cmd(const hci_cmd_t *cmd, ...){
+    uint8_t command[HCI_CMD_HEADER_SIZE + 64];
+    va_list argptr;
+    va_start(argptr, cmd);
+    hci_cmd_create_from_template(command, cmd, argptr);
+    va_end(argptr);
+
+    command_pending = 1;
+
+    uint8_t * event = command_complete_event;
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[2] = 1;
+    little_endian_store_16(event, 3, cmd->opcode);
+    event[5] = 0;
+    uint16_t len = 6;
+
+    if (cmd->opcode == hci_le_encrypt.opcode){
+        // key and plaintext are sent little endian, AES operates on big endian
+        sm_key_t key, plaintext, result;
+        reverse_128(&command[3],  key);
+        reverse_128(&command[19], plaintext);
+        aes128_calc(key, plaintext, result);
+        reverse_128(result, &event[6]);
+        len += 16;
+        num_le_encrypt_commands++;
+    } else if (cmd->opcode == hci_le_rand.opcode){
+        int i;
+        for (i = 0; i < 8; i++){
+            event[6 + i] = random_byte();
+        }
+        len += 8;
+    }
+    event[1] = len - 2;
+    command_complete_len = len;
+    return 0;
+}
+
+void hci_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    sm_event_handler = callback_handler->callback;
+}
+
+hci_connection_t * hci_connection_for_handle(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+    return NULL;
+}
+
+static btstack_linked_list_t connections;
+void hci_connections_get_iterator(btstack_linked_list_iterator_t *it){
+    btstack_linked_list_iterator_init(it, &connections);
+}
+
+void gap_local_bd_addr(bd_addr_t address_buffer){
+    memcpy(address_buffer, local_address, 6);
+}
+
+void gap_le_get_own_address(uint8_t * addr_type, bd_addr_t addr){
+    *addr_type = BD_ADDR_TYPE_LE_PUBLIC;
+    memcpy(addr, local_address, 6);
+}
+
+uint16_t hci_get_manufacturer(void){
+    return 0xffff;
+}
+
+void hci_le_set_own_address_type(uint8_t own_address_type){
+    UNUSED(own_address_type);
+}
+
+void hci_le_advertisements_set_params(uint16_t adv_int_min, uint16_t adv_int_max, uint8_t adv_type,
+    uint8_t direct_address_typ, bd_addr_t direct_address, uint8_t channel_map, uint8_t filter_policy) {
+}
+
+void hci_disconnect_security_block(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+}
+
+void l2cap_register_fixed_channel(btstack_packet_handler_t packet_handler, uint16_t channel_id){
+    UNUSED(packet_handler);
+    UNUSED(channel_id);
+}
+
+int l2cap_can_send_fixed_channel_packet_now(hci_con_handle_t con_handle, uint16_t channel_id){
+    UNUSED(con_handle);
+    UNUSED(channel_id);
+    return 1;
+}
+
+void l2cap_request_can_send_fix_channel_now_event(hci_con_handle_t con_handle, uint16_t channel_id){
+    UNUSED(con_handle);
+    UNUSED(channel_id);
+}
+
+int l2cap_send_connectionless(hci_con_handle_t con_handle, uint16_t cid, uint8_t * data, uint16_t len){
+    UNUSED(con_handle);
+    UNUSED(cid);
+    UNUSED(data);
+    UNUSED(len);
+    return 0;
+}
+
+// deliver Command Complete events until no command is pending
+static void run_controller(void){
+    while (command_pending){
+        sim_time_us += HCI_COMMAND_LATENCY_US;
+        command_pending = 0;
+        sm_event_handler(HCI_EVENT_PACKET, 0, command_complete_event, command_complete_len);
+    }
+}
+
+// simulated advertisers
+
+static void random_key(sm_key_t key){
+    int i;
+    for (i = 0; i < 16; i++){
+        key[i] = random_byte();
+    }
+}
+
+// resolvable private address: prand with top bits 0b01 || ah(irk, prand)
+static void advertiser_rotate_address(advertiser_t * advertiser){
+    sm_key_t r_prime;
+    sm_key_t hash;
+    memset(r_prime, 0, 16);
+    r_prime[13] = 0x40 | (random_byte() & 0x3f);
+    r_prime[14] = random_byte();
+    r_prime[15] = random_byte();
+    aes128_calc(advertiser->irk, r_prime, hash);
+    memcpy(&advertiser->address[0], &r_prime[13], 3);
+    memcpy(&advertiser->address[3], &hash[13], 3);
+    advertiser->num_reports = 0;
+}
+
+static void advertisers_init(void){
+    int i;
+    for (i = 0; i < NUM_BONDED_DEVICES; i++){
+        bonded_devices[i].addr_type = BD_ADDR_TYPE_LE_PUBLIC;
+        bonded_devices[i].addr[0] = 0x00;
+        bonded_devices[i].addr[1] = 0x11;
+        big_endian_store_32(bonded_devices[i].addr, 2, i);
+        random_key(bonded_devices[i].irk);
+    }
+    for (i = 0; i < NUM_ADVERTISERS; i++){
+        advertiser_t * advertiser = &advertisers[i];
+        if (i % 4 == 3){
+            advertiser->le_db_index = -1;
+            random_key(advertiser->irk);
+        } else {
+            advertiser->le_db_index = (i * 7919) % NUM_BONDED_DEVICES;
+            memcpy(advertiser->irk, bonded_devices[advertiser->le_db_index].irk, 16);
+        }
+        advertiser_rotate_address(advertiser);
+        // spread address changes over time
+        advertiser->num_reports = (i * ROTATION_REPORTS) / NUM_ADVERTISERS;
+    }
+}
+
+static void app_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED:
+            num_resolved++;
+            resolution_done = 1;
+            if (sm_event_identity_resolving_succeeded_get_index_internal(packet) != current_advertiser->le_db_index){
+                num_mismatches++;
+            }
+            break;
+        case SM_EVENT_IDENTITY_RESOLVING_FAILED:
+            num_not_resolved++;
+            resolution_done = 1;
+            if (current_advertiser->le_db_index >= 0){
+                num_mismatches++;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+int main(int argc, const char * argv[]){
+    if (argc > 1){
+        num_reports = atoi(argv[1]);
+    }
+
+    // no log output while measuring
+    hci_dump_enable_log_level(LOG_LEVEL_INFO, 0);
+    hci_dump_enable_log_level(LOG_LEVEL_ERROR, 0);
+
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    le_device_db_init();
+    advertisers_init();
+
+    static btstack_packet_callback_registration_t sm_event_callback_registration;
+    sm_init();
+    sm_event_callback_registration.callback = &app_packet_handler;
+    sm_add_event_handler(&sm_event_callback_registration);
+
+    // derive IRK and DHK
+    uint8_t state_working[] = { BTSTACK_EVENT_STATE, 1, HCI_STATE_WORKING };
+    sm_event_handler(HCI_EVENT_PACKET, 0, state_working, sizeof(state_working));
+    run_controller();
+
+    uint64_t start_time_us = sim_time_us;
+    int start_encrypt_commands = num_le_encrypt_commands;
+    uint64_t start_ns = benchmark_time_ns();
+    int i;
+    for (i = 0; i < num_reports; i++){
+        current_advertiser = &advertisers[(random_byte() + (random_byte() << 8)) % NUM_ADVERTISERS];
+        if (current_advertiser->num_reports++ >= ROTATION_REPORTS){
+            advertiser_rotate_address(current_advertiser);
+        }
+        resolution_done = 0;
+        sm_address_resolution_lookup(BD_ADDR_TYPE_LE_RANDOM, current_advertiser->address);
+        run_controller();
+        if (!resolution_done){
+            fprintf(stderr, "resolution %u did not complete\n", i);
+            return 1;
+        }
+    }
+    uint64_t duration_ns = benchmark_time_ns() - start_ns;
+    uint64_t duration_us = sim_time_us - start_time_us;
+
+#ifdef HAVE_AES128
+    const char * aes_backend = "software AES";
+#else
+    const char * aes_backend = "HCI LE Encrypt";
+#endif
+    printf("%u reports from %u advertisers, %u IRKs, %s, %u cache entries\n", num_reports, NUM_ADVERTISERS,
+        NUM_BONDED_DEVICES, aes_backend, MAX_NR_SM_RESOLVING_CACHE_ENTRIES);
+    printf("resolved %u, not resolved %u, wrong results %u\n", num_resolved, num_not_resolved, num_mismatches);
+    if (duration_us){
+        printf("%10.1f resolutions/s (virtual time), %6.1f LE Encrypt commands per report\n",
+            num_reports * 1000000.0 / duration_us,
+            (float) (num_le_encrypt_commands - start_encrypt_commands) / num_reports);
+    }
+    printf("%10.1f us host CPU time per report\n", duration_ns / 1000.0 / num_reports);
+
+    if (num_mismatches || num_resolved + num_not_resolved != num_reports) return 1;
+    return 0;
+}